@@ -0,0 +1,383 @@
+//!*********************************************************************
+//! @file cerb_ila.cpp
+//!
+//! @brief
+//! ILA CSV importer. See cerb_ila.h.
+//!
+//! Hex digits are decoded 16 at a time (four int16 words): ASCII is
+//! folded to lower case, mapped to nibbles and checked, nibbles are
+//! merged into words and the words converted to float in the reversed
+//! (least significant first) order the samples are stored in.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cerb_ila.h"
+
+#if defined(__SSE2__)
+#define CERB_ILA_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define CERB_ILA_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define CERB_ILA_SCALE (1.0f / 32768.0f)
+
+//!******************************************************
+//! @brief
+//! Value of one hex digit, -1 when it is not one
+//!
+//!******************************************************
+static int hex_nibble(char c)
+{
+    if( c >= '0' && c <= '9' ) {
+        return c - '0';
+    }
+    c = static_cast<char>(c | 0x20);
+    if( c >= 'a' && c <= 'f' ) {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+//!******************************************************
+//! @brief
+//! Decodes nwords 4-digit hex words from hex and stores
+//! them scaled, last word first, at out[0..nwords)
+//!
+//!******************************************************
+static bool decode_words(const char* hex, size_t nwords, float* out)
+{
+    size_t k = 0;
+#if defined(CERB_ILA_SSE2)
+    const __m128i lower = _mm_set1_epi8(0x20);
+    const __m128i zero  = _mm_set1_epi8('0');
+    const __m128i nine  = _mm_set1_epi8('9');
+    const __m128i alpha_off = _mm_set1_epi8('a' - '0' - 10);
+    const __m128i fifteen   = _mm_set1_epi8(15);
+    const __m128i ten       = _mm_set1_epi8(10);
+    const __m128i mask8     = _mm_set1_epi16(0xFF);
+    const __m128i mask16    = _mm_set1_epi32(0xFFFF);
+    const __m128  scale     = _mm_set1_ps(CERB_ILA_SCALE);
+    for (; k + 4 <= nwords; k += 4) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&hex[4*k]));
+        __m128i l = _mm_or_si128(c, lower);
+        __m128i alpha = _mm_cmpgt_epi8(l, nine);
+        __m128i n = _mm_sub_epi8(_mm_sub_epi8(l, zero), _mm_and_si128(alpha, alpha_off));
+        // valid: 0 <= n <= 15 (unsigned), and letters must map to 10..15
+        __m128i in_range = _mm_cmpeq_epi8(_mm_max_epu8(n, fifteen), fifteen);
+        __m128i bad_alpha = _mm_and_si128(alpha, _mm_cmplt_epi8(n, ten));
+        if( _mm_movemask_epi8(_mm_andnot_si128(bad_alpha, in_range)) != 0xFFFF ) {
+            return false;
+        }
+        // nibble pairs -> bytes, byte pairs -> big endian words
+        __m128i b = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(n, mask8), 4), _mm_srli_epi16(n, 8));
+        __m128i w = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(b, mask16), 8), _mm_srli_epi32(b, 16));
+        __m128  f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(w, 16), 16)), scale);
+        _mm_storeu_ps(&out[nwords - 4 - k], _mm_shuffle_ps(f, f, _MM_SHUFFLE(0, 1, 2, 3)));
+    }
+#elif defined(CERB_ILA_NEON)
+    const uint8x16_t lower = vdupq_n_u8(0x20);
+    const uint8x16_t zero  = vdupq_n_u8('0');
+    const uint8x16_t nine  = vdupq_n_u8('9');
+    const uint8x16_t alpha_off = vdupq_n_u8('a' - '0' - 10);
+    const uint8x16_t fifteen   = vdupq_n_u8(15);
+    const uint8x16_t ten       = vdupq_n_u8(10);
+    for (; k + 4 <= nwords; k += 4) {
+        uint8x16_t c = vld1q_u8(reinterpret_cast<const uint8_t*>(&hex[4*k]));
+        uint8x16_t l = vorrq_u8(c, lower);
+        uint8x16_t alpha = vcgtq_u8(l, nine);
+        uint8x16_t n = vsubq_u8(vsubq_u8(l, zero), vandq_u8(alpha, alpha_off));
+        uint8x16_t bad = vorrq_u8(vcgtq_u8(n, fifteen), vandq_u8(alpha, vcltq_u8(n, ten)));
+        if( vmaxvq_u8(bad) ) {
+            return false;
+        }
+        uint16x8_t x = vreinterpretq_u16_u8(n);
+        uint16x8_t b = vorrq_u16(vshlq_n_u16(vandq_u16(x, vdupq_n_u16(0xFF)), 4), vshrq_n_u16(x, 8));
+        uint32x4_t y = vreinterpretq_u32_u16(b);
+        uint32x4_t w = vorrq_u32(vshlq_n_u32(vandq_u32(y, vdupq_n_u32(0xFFFF)), 8), vshrq_n_u32(y, 16));
+        int32x4_t  s = vshrq_n_s32(vshlq_n_s32(vreinterpretq_s32_u32(w), 16), 16);
+        float32x4_t f = vrev64q_f32(vmulq_n_f32(vcvtq_f32_s32(s), CERB_ILA_SCALE));
+        vst1q_f32(&out[nwords - 4 - k], vcombine_f32(vget_high_f32(f), vget_low_f32(f)));
+    }
+#endif
+    for (; k < nwords; k++) {
+        int v = 0;
+        for (size_t d = 0; d < 4; d++) {
+            int nib = hex_nibble(hex[4*k + d]);
+            if( nib < 0 ) {
+                return false;
+            }
+            v = (v << 4) | nib;
+        }
+        out[nwords - 1 - k] = static_cast<int16_t>(v) * CERB_ILA_SCALE;
+    }
+    return true;
+}
+
+cerb_ila_file::cerb_ila_file()
+    : m_base(nullptr), m_size(0), m_data(nullptr), m_col(0), m_rows(0), m_spc(0)
+{
+}
+
+cerb_ila_file::~cerb_ila_file()
+{
+    close();
+}
+
+void cerb_ila_file::close()
+{
+    if( m_base ) {
+        munmap(const_cast<char*>(m_base), m_size);
+        m_base = nullptr;
+    }
+    m_size = 0;
+    m_rows = 0;
+}
+
+//!******************************************************
+//! @brief
+//! Picks the first column whose name contains "tdata"
+//! (any case), e.g. ".../m00_axis_tdata[63:0]"
+//!
+//!******************************************************
+bool cerb_ila_file::find_column(const char* line, const char* end)
+{
+    size_t col = 0;
+    const char* p = line;
+    while( p < end ) {
+        const char* q = static_cast<const char*>(memchr(p, ',', end - p));
+        if( !q ) {
+            q = end;
+        }
+        std::string name(p, q);
+        std::string lower(name);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if( lower.find("tdata") != std::string::npos ) {
+            m_col    = col;
+            m_column = name;
+            return true;
+        }
+        col++;
+        p = q + 1;
+    }
+    printf("error: no tdata column in the ILA header\n");
+    return false;
+}
+
+//!******************************************************
+//! @brief
+//! Samples per cycle from the [msb:lsb] bus width of
+//! the column name, else from the digits of the first
+//! row; 32 bits per complex sample
+//!
+//!******************************************************
+void cerb_ila_file::infer_spc()
+{
+    unsigned msb = 0, lsb = 0;
+    size_t br = m_column.rfind('[');
+    if( br != std::string::npos && sscanf(m_column.c_str() + br, "[%u:%u]", &msb, &lsb) == 2 && msb >= lsb ) {
+        m_spc = (msb - lsb + 1) / 32;
+    }
+    if( !m_spc && m_rows ) {
+        const char* end = m_base + m_size;
+        const char* p = m_data;
+        for (size_t c = 0; p && c < m_col; c++) {
+            p = static_cast<const char*>(memchr(p, ',', end - p));
+            p = p ? p + 1 : nullptr;
+        }
+        if( p ) {
+            const char* q = p;
+            while( q < end && *q != ',' && *q != '\r' && *q != '\n' ) {
+                q++;
+            }
+            m_spc = static_cast<unsigned>((q - p + 7) / 8);
+        }
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Maps the export, finds the tdata column and counts
+//! the rows
+//!
+//!******************************************************
+bool cerb_ila_file::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 ) {
+        printf("error: failed to open [%s]: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if( fstat(fd, &st) < 0 || st.st_size == 0 ) {
+        printf("error: [%s] is empty\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if( base == MAP_FAILED ) {
+        printf("error: failed to map [%s]: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+    m_base = static_cast<const char*>(base);
+    m_size = st.st_size;
+
+    const char* end = m_base + m_size;
+    const char* p = m_base;
+    for (int h = 0; h < CERB_ILA_HEADER_LINES; h++) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        if( !nl ) {
+            printf("error: [%s] has no ILA header\n", path.c_str());
+            close();
+            return false;
+        }
+        if( h == 0 && !find_column(p, (nl > p && nl[-1] == '\r') ? nl - 1 : nl) ) {
+            close();
+            return false;
+        }
+        p = nl + 1;
+    }
+    m_data = p;
+
+    // rows are the non-empty lines that follow
+    m_rows = 0;
+    while( p < end ) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* eol = nl ? nl : end;
+        if( eol > p && !(eol - p == 1 && *p == '\r') ) {
+            m_rows++;
+        }
+        p = eol + 1;
+    }
+    m_spc = 0;
+    infer_spc();
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Decodes every row into iq (interleaved I/Q floats,
+//! max_samps complex samples). Short hex fields are
+//! zero extended on the left. Returns the samples
+//! written, or -1 on a malformed row.
+//!
+//!******************************************************
+long cerb_ila_file::decode(unsigned samps_per_cycle, float* iq, size_t max_samps) const
+{
+    unsigned spc = samps_per_cycle ? samps_per_cycle : m_spc;
+    if( !m_base || !spc || spc > CERB_ILA_MAX_SPC ) {
+        printf("error: unknown or unsupported samples per cycle [%u]\n", spc);
+        return -1;
+    }
+    const size_t nwords = 2 * spc;
+    const size_t ndigits = 4 * nwords;
+    char padded[4 * 2 * CERB_ILA_MAX_SPC];
+
+    const char* end = m_base + m_size;
+    const char* p = m_data;
+    size_t row = 0;
+    size_t out = 0;
+    while( p < end ) {
+        const char* nl  = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* eol = nl ? nl : end;
+        const char* next = eol + 1;
+        if( eol > p && eol[-1] == '\r' ) {
+            eol--;
+        }
+        if( eol == p ) {
+            p = next;
+            continue;
+        }
+        row++;
+
+        const char* f = p;
+        for (size_t c = 0; f && c < m_col; c++) {
+            f = static_cast<const char*>(memchr(f, ',', eol - f));
+            f = f ? f + 1 : nullptr;
+        }
+        const char* fend = f ? static_cast<const char*>(memchr(f, ',', eol - f)) : nullptr;
+        if( f && !fend ) {
+            fend = eol;
+        }
+        size_t len = f ? fend - f : 0;
+        if( !f || !len || len > ndigits ) {
+            printf("error: row [%zu]: tdata field missing or wider than [%zu] digits\n", row, ndigits);
+            return -1;
+        }
+        if( out + spc > max_samps ) {
+            printf("error: row [%zu]: output holds only [%zu] samples\n", row, max_samps);
+            return -1;
+        }
+        if( len < ndigits ) {
+            memset(padded, '0', ndigits - len);
+            memcpy(padded + ndigits - len, f, len);
+            f = padded;
+        }
+        if( !decode_words(f, nwords, &iq[2 * out]) ) {
+            printf("error: row [%zu]: bad hex digit in tdata\n", row);
+            return -1;
+        }
+        out += spc;
+        p = next;
+    }
+    return static_cast<long>(out);
+}
+
+//!******************************************************
+//! C API
+//!******************************************************
+struct cerb_ila {
+    cerb_ila_file file;
+};
+
+cerb_ila_t* cerb_ila_open(const char* path)
+{
+    cerb_ila_t* ila = new cerb_ila_t;
+    if( !path || !ila->file.open(path) ) {
+        delete ila;
+        return nullptr;
+    }
+    return ila;
+}
+
+size_t cerb_ila_rows(const cerb_ila_t* ila)
+{
+    return ila->file.rows();
+}
+
+unsigned cerb_ila_samps_per_cycle(const cerb_ila_t* ila)
+{
+    return ila->file.samps_per_cycle();
+}
+
+const char* cerb_ila_column(const cerb_ila_t* ila)
+{
+    return ila->file.column();
+}
+
+long cerb_ila_decode(const cerb_ila_t* ila, unsigned samps_per_cycle, float* iq, size_t max_samps)
+{
+    return ila->file.decode(samps_per_cycle, iq, max_samps);
+}
+
+void cerb_ila_close(cerb_ila_t* ila)
+{
+    delete ila;
+}
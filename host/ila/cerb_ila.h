@@ -0,0 +1,78 @@
+//!*********************************************************************
+//! @file cerb_ila.h
+//!
+//! @brief
+//! Native importer for Vivado ILA CSV exports of the RFDC AXI-S
+//! streams (host/python/cerb_ila.py). The file is memory mapped, the
+//! tdata column is located once from the first header line and every
+//! row's hex field is decoded with SIMD straight into a caller
+//! provided complex float array.
+//!
+//! A tdata word holds samps_per_cycle complex samples of two int16
+//! each, least significant word first: the rightmost four hex digits
+//! are I of the first sample, the next four its Q, and so on. Samples
+//! are scaled by 2^-15 like the capture files.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_ILA_H_
+#define CERB_ILA_H_
+
+#include <stddef.h>
+
+#define CERB_ILA_HEADER_LINES 2     // signal names, then radix
+#define CERB_ILA_MAX_SPC      64    // samples per cycle
+
+#ifdef __cplusplus
+#include <string>
+
+//!******************************************************
+//! @brief
+//! One mapped ILA export
+//!
+//!******************************************************
+class cerb_ila_file
+{
+public:
+    cerb_ila_file();
+    ~cerb_ila_file();
+
+    bool   open(const std::string& path);
+    void   close();
+    long   decode(unsigned samps_per_cycle, float* iq, size_t max_samps) const;
+
+    size_t      rows() const            { return m_rows; }
+    unsigned    samps_per_cycle() const { return m_spc; }
+    const char* column() const          { return m_column.c_str(); }
+
+private:
+    bool find_column(const char* line, const char* end);
+    void infer_spc();
+
+    const char* m_base;
+    size_t      m_size;
+    const char* m_data;     // first row after the header lines
+    size_t      m_col;      // tdata column index
+    std::string m_column;
+    size_t      m_rows;
+    unsigned    m_spc;      // from the column width, or the first row
+};
+
+extern "C" {
+#endif
+
+typedef struct cerb_ila cerb_ila_t;
+
+cerb_ila_t* cerb_ila_open(const char* path);
+size_t      cerb_ila_rows(const cerb_ila_t* ila);
+unsigned    cerb_ila_samps_per_cycle(const cerb_ila_t* ila);
+const char* cerb_ila_column(const cerb_ila_t* ila);
+long        cerb_ila_decode(const cerb_ila_t* ila, unsigned samps_per_cycle, float* iq, size_t max_samps);
+void        cerb_ila_close(cerb_ila_t* ila);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CERB_ILA_H_ */
@@ -0,0 +1,128 @@
+"""
+:module: cerb_capture_client.py
+
+:author: Michael Clark <mclark@ipsolonresearch.com>
+
+:since:  March 2022
+
+:about:
+Client for cerb_capture_server, the resident capture server on the
+Cerberus SDR. The server keeps the DMA channel and CWGEN open and
+streams each capture back over the socket, so a snapshot costs one
+request instead of an SSH session, a file transfer and a cleanup.
+
+On a PC the server can run with --backend=loopback:
+
+    cerb_capture_server --backend=loopback --port 5600 &
+    python3 cerb_capture_client.py localhost
+
+:license:
+Copyright (C) 2022 Ipsolon Research, Inc
+All rights reserved.
+"""
+import sys
+import socket
+import numpy as np
+
+CERB_CAPTURE_PORT = 5600
+CERB_IQ_SCALE = 1.0 / 32768.0
+
+class CerbCaptureClient:
+    """ Connection to cerb_capture_server over TCP or a Unix socket """
+
+    def __init__(self, host='localhost', port=CERB_CAPTURE_PORT, unix_path=None, timeout=10.0):
+        if unix_path:
+            self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+            self._sock.settimeout(timeout)
+            self._sock.connect(unix_path)
+        else:
+            self._sock = socket.create_connection((host, port), timeout=timeout)
+            self._sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self._rx = self._sock.makefile('rb')
+        self.seqno = None
+        self.timestamp_ns = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        if self._sock:
+            try:
+                self._sock.sendall(b'QUIT\n')
+            except OSError:
+                pass
+            self._rx.close()
+            self._sock.close()
+            self._sock = None
+
+    def _request(self, line):
+        self._sock.sendall(line.encode('ascii') + b'\n')
+        resp = self._rx.readline().decode('ascii').strip()
+        if not resp:
+            raise Exception("capture server closed the connection")
+        if resp.startswith('ERR'):
+            raise Exception("capture server: " + resp[4:])
+        return resp.split()[1:]
+
+    def info(self):
+        """ server backend, sample rate, maximum capture size and CWGEN settings """
+        info = {}
+        for field in self._request('INFO'):
+            key, val = field.split('=', 1)
+            info[key] = val if key == 'backend' else float(val)
+        return info
+
+    def capture(self, nsamps=2**16, fmt='sc16', cwgen_freq_hz=None, cwgen_ampl_scale=None):
+        """ capture nsamps samples as complex64
+
+        fmt='sc16' halves the transfer and converts on the host. The
+        server's request counter and the CLOCK_MONOTONIC completion time of
+        the capture are kept in self.seqno and self.timestamp_ns. The
+        counter numbers the CAPTURE requests the server has handled, failed
+        ones included; it is not a DMA buffer sequence number.
+        """
+        cmd = 'CAPTURE %d format=%s' % (int(nsamps), fmt)
+        if cwgen_freq_hz is not None:
+            cmd += ' cwgen_freq=%r' % float(cwgen_freq_hz)
+        if cwgen_ampl_scale is not None:
+            cmd += ' cwgen_ampl=%d' % int(cwgen_ampl_scale)
+
+        n, fmt, seqno, timestamp_ns = self._request(cmd)
+        n = int(n)
+        self.seqno = int(seqno)
+        self.timestamp_ns = int(timestamp_ns)
+
+        nbytes = n * (4 if fmt == 'sc16' else 8)
+        payload = bytearray(nbytes)
+        view = memoryview(payload)
+        pos = 0
+        while pos < nbytes:
+            got = self._rx.readinto(view[pos:])
+            if not got:
+                raise Exception("capture server closed the connection")
+            pos += got
+
+        if fmt == 'sc16':
+            iq = np.frombuffer(payload, dtype=np.int16).astype(np.float32) * np.float32(CERB_IQ_SCALE)
+            return iq.view(np.complex64)
+        return np.frombuffer(payload, dtype=np.complex64)
+
+if __name__ == '__main__':
+    import time
+    import matplotlib.pyplot as plt
+    from utils import plot_cmplx_waveform, plot_power_spectrum
+
+    host = sys.argv[1] if len(sys.argv) > 1 else 'localhost'
+    with CerbCaptureClient(host) as client:
+        print(client.info())
+        t0 = time.time()
+        for k in range(10):
+            iq = client.capture(nsamps=2**16, cwgen_freq_hz=50e6)
+        print("10 captures in %.3f s" % (time.time() - t0))
+
+    plot_cmplx_waveform(iq, nsamps=len(iq))
+    plot_power_spectrum(iq)
+    plt.show(block=True)
@@ -0,0 +1,78 @@
+"""
+:module: cerb_ila.py
+
+:author: Michael Clark <mclark@ipsolonresearch.com>
+
+:since:  March 2022
+
+:about:
+Python bindings for libcerb_ila (host/ila), the native importer for
+Vivado ILA CSV exports of the RFDC AXI-S streams. The export is memory
+mapped and the tdata hex is decoded straight into one preallocated
+complex64 array:
+
+    iq = load_ila('data/rfdc_adc_ila_data.csv')
+
+sampsPerCycle is taken from the tdata bus width in the header (32 bits
+per complex sample) unless given. The library is looked up in
+$CERB_ILA_LIB, next to this file and in the system library path.
+
+:license:
+Copyright (C) 2022 Ipsolon Research, Inc
+All rights reserved.
+"""
+import os
+import sys
+import time
+import ctypes
+import ctypes.util
+
+def load_library(path=None):
+    """ loads libcerb_ila.so and declares the C API """
+    paths = [path, os.environ.get('CERB_ILA_LIB'),
+             os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libcerb_ila.so')]
+    name = next((p for p in paths if p and os.path.exists(p)), None) or ctypes.util.find_library('cerb_ila')
+    if not name:
+        raise OSError("libcerb_ila.so not found, build host/ila or set CERB_ILA_LIB")
+    lib = ctypes.CDLL(name)
+
+    lib.cerb_ila_open.restype = ctypes.c_void_p
+    lib.cerb_ila_open.argtypes = [ctypes.c_char_p]
+    lib.cerb_ila_rows.restype = ctypes.c_size_t
+    lib.cerb_ila_rows.argtypes = [ctypes.c_void_p]
+    lib.cerb_ila_samps_per_cycle.restype = ctypes.c_uint
+    lib.cerb_ila_samps_per_cycle.argtypes = [ctypes.c_void_p]
+    lib.cerb_ila_column.restype = ctypes.c_char_p
+    lib.cerb_ila_column.argtypes = [ctypes.c_void_p]
+    lib.cerb_ila_decode.restype = ctypes.c_long
+    lib.cerb_ila_decode.argtypes = [ctypes.c_void_p, ctypes.c_uint, ctypes.c_void_p, ctypes.c_size_t]
+    lib.cerb_ila_close.restype = None
+    lib.cerb_ila_close.argtypes = [ctypes.c_void_p]
+    return lib
+
+def load_ila(fn, sampsPerCycle=None, lib=None):
+    """ ILA export as a complex64 array scaled to [-1, 1) """
+    import numpy as np
+    lib = load_library(lib)
+    ila = lib.cerb_ila_open(fn.encode())
+    if not ila:
+        raise Exception("failed to open ILA export %s" % fn)
+    try:
+        spc = sampsPerCycle or lib.cerb_ila_samps_per_cycle(ila)
+        if not spc:
+            raise Exception("samples per cycle unknown for %s" % fn)
+        iq = np.empty(lib.cerb_ila_rows(ila) * spc, dtype=np.complex64)
+        n = lib.cerb_ila_decode(ila, spc, iq.ctypes.data, len(iq))
+        if n < 0:
+            raise Exception("malformed ILA export %s" % fn)
+    finally:
+        lib.cerb_ila_close(ila)
+    return iq[:n]
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print("Usage: %s ila_export.csv [sampsPerCycle]" % sys.argv[0])
+        sys.exit(1)
+    t0 = time.time()
+    iq = load_ila(sys.argv[1], int(sys.argv[2]) if len(sys.argv) > 2 else None)
+    print("ila: [%d] samples in [%.3f s]" % (len(iq), time.time() - t0))
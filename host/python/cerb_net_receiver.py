@@ -0,0 +1,221 @@
+"""
+:module: cerb_net_receiver.py
+
+:author: Michael Clark <mclark@ipsolonresearch.com>
+
+:since:  March 2022
+
+:about:
+Receiver for the framed IQ stream sent by rx_samples_to_file --net.
+Listens on udp://<bind>:<port> or tcp://<bind>:<port> and writes the
+samples to a capture file (with the usual .hdr sidecar, so load_capture
+reads it) or into a numpy array:
+
+    python3 cerb_net_receiver.py udp://0.0.0.0:5700 capture.sc16
+    rx_samples_to_file --net udp://<host>:5700 --format sc16 --continuous
+
+Datagrams lost on UDP are replaced by zeros so the samples of every DMA
+block keep their position; blocks the DMA dropped are skipped, as in a
+capture file. Both are counted in the receiver statistics.
+
+This receiver is pure Python and tops out well below the DMA rate; for
+sustained streams use host/receiver (cerb_rx_to_file, cerb_receiver.py).
+
+:license:
+Copyright (C) 2022 Ipsolon Research, Inc
+All rights reserved.
+"""
+import sys
+import socket
+import struct
+import time
+
+CERB_NET_MAGIC = 0x46524543
+CERB_NET_HDR = struct.Struct('<IHHBBHIQQQIIII')
+CERB_NET_FLAG_LAST_FRAG = 0x1
+CERB_NET_FLAG_END = 0x2
+CERB_NET_RCVBUF = 32 << 20
+CERB_NET_MAX_DATAGRAM = 65536
+CERB_FORMATS = {0: ('fc32', 8, 1.0), 1: ('sc16', 4, 1.0 / 32768.0)}
+
+def parse_url(url):
+    """ split udp://host:port or tcp://host:port """
+    proto, rest = url.split('://', 1)
+    host, port = rest.rsplit(':', 1)
+    if proto not in ('udp', 'tcp'):
+        raise ValueError("expected udp://host:port or tcp://host:port")
+    return proto, host, int(port)
+
+class CerbNetReceiver:
+    """ receives framed IQ blocks and hands their payloads to a writer """
+
+    def __init__(self, url, timeout=5.0):
+        self.proto, host, port = parse_url(url)
+        self.timeout = timeout
+        self.format = None
+        self.sample_size = 0
+        self.sample_rate = 0
+        self.samples = 0
+        self.packets = 0
+        self.lost_packets = 0
+        self.lost_blocks = 0
+        self.first_timestamp_ns = None
+        self._next_packet = 0
+        self._block = None
+        self._block_pos = 0
+        self._block_samps = 0
+        self._next_block = None
+        self._buf = bytearray(max(CERB_NET_MAX_DATAGRAM, CERB_NET_HDR.size))
+        self._conn = None
+        self._written = 0
+
+        if self.proto == 'udp':
+            self._sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        else:
+            self._sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+            self._sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, CERB_NET_RCVBUF)
+        if self.proto == 'udp' and self._sock.getsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF) < CERB_NET_RCVBUF:
+            print("warn: UDP receive buffer capped by the kernel, raise net.core.rmem_max to %d" % CERB_NET_RCVBUF)
+        self._sock.bind((host, port))
+        if self.proto == 'tcp':
+            self._sock.listen(1)
+
+    def close(self):
+        if self._conn:
+            self._conn.close()
+        self._sock.close()
+
+    def _recv_exact(self, view):
+        pos = 0
+        while pos < len(view):
+            got = self._conn.recv_into(view[pos:])
+            if not got:
+                return False
+            pos += got
+        return True
+
+    def _next_frame(self):
+        """ returns (header tuple, payload memoryview) or None at end of stream """
+        if self.proto == 'udp':
+            n = self._sock.recv_into(self._buf)
+            view = memoryview(self._buf)[:n]
+            hdr = CERB_NET_HDR.unpack_from(view)
+            return hdr, view[hdr[2]:hdr[2] + hdr[6]]
+
+        if self._conn is None:
+            self._conn, _ = self._sock.accept()
+            self._conn.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, CERB_NET_RCVBUF)
+        view = memoryview(self._buf)
+        if not self._recv_exact(view[:CERB_NET_HDR.size]):
+            return None
+        hdr = CERB_NET_HDR.unpack_from(view)
+        need = hdr[2] - CERB_NET_HDR.size + hdr[6]
+        if need > len(self._buf):
+            self._buf = bytearray(need + CERB_NET_HDR.size)
+            view = memoryview(self._buf)
+        if not self._recv_exact(view[:need]):
+            return None
+        return hdr, view[hdr[2] - CERB_NET_HDR.size:need]
+
+    def run(self, write, nsamps=None):
+        """ passes received payload bytes to write() until the END frame
+        arrives, nsamps samples have been written or the stream stalls
+        for the timeout once started; returns the number of samples
+        written """
+        def emit(data):
+            self._written += len(data)
+            write(data)
+
+        def zeros(n):
+            if n > 0:
+                emit(bytes(n * self.sample_size))
+
+        self._sock.settimeout(None)
+        try:
+            while nsamps is None or self.samples < nsamps:
+                frame = self._next_frame()
+                if frame is None:
+                    break
+                (magic, version, hdr_bytes, fmt, channels, flags, payload_bytes,
+                 packet_seqno, block_seqno, timestamp_ns, offset, block_samps,
+                 sample_rate, _) = frame[0]
+                if magic != CERB_NET_MAGIC:
+                    continue
+                if packet_seqno != self._next_packet:
+                    self.lost_packets += packet_seqno - self._next_packet
+                self._next_packet = packet_seqno + 1
+                self.packets += 1
+                if flags & CERB_NET_FLAG_END:
+                    break
+
+                if self.format is None:
+                    self.format, self.sample_size, self.scale = CERB_FORMATS[fmt]
+                    self.sample_rate = sample_rate
+                    self.first_timestamp_ns = timestamp_ns
+                    (self._conn or self._sock).settimeout(self.timeout)
+
+                # keep lost datagrams in place, skip blocks lost as a whole
+                if block_seqno != self._block:
+                    if self._block is not None:
+                        zeros(self._block_samps - self._block_pos)
+                    if self._next_block is not None and block_seqno != self._next_block:
+                        self.lost_blocks += block_seqno - self._next_block
+                    self._block = block_seqno
+                    self._next_block = block_seqno + 1
+                    self._block_pos = 0
+                    self._block_samps = block_samps
+                zeros(offset - self._block_pos)
+                emit(frame[1])
+                self._block_pos = offset + payload_bytes // self.sample_size
+                self.samples = self._samples_written()
+        except socket.timeout:
+            pass
+        if self._block is not None and self._block_pos < self._block_samps:
+            zeros(self._block_samps - self._block_pos)
+            self._block_pos = self._block_samps
+        self.samples = self._samples_written()
+        return self.samples
+
+    def _samples_written(self):
+        return self._written // self.sample_size if self.sample_size else 0
+
+    def receive_file(self, fn, nsamps=None):
+        """ writes the stream to fn plus the .hdr sidecar """
+        with open(fn, 'wb') as f:
+            self.run(f.write, nsamps)
+        with open(fn + '.hdr', 'w') as f:
+            f.write('# Cerberus SDR capture header\n')
+            f.write('format=%s\n' % (self.format or 'sc16'))
+            f.write('sample_rate=%d\n' % (self.sample_rate or 500000000))
+            f.write('scale=%.10e\n' % (self.scale if self.format else 1.0 / 32768.0))
+        return self.samples
+
+    def receive_array(self, nsamps):
+        """ receives nsamps samples into a complex64 numpy array """
+        import numpy as np
+        raw = bytearray()
+        self.run(raw.extend, nsamps)
+        if self.format == 'sc16':
+            iq = np.frombuffer(raw, dtype=np.int16).astype(np.float32) * np.float32(self.scale)
+            iq = iq.view(np.complex64)
+        else:
+            iq = np.frombuffer(raw, dtype=np.complex64)
+        return iq[:nsamps]
+
+    def print_stats(self, elapsed_s):
+        print("net: packets=[%d] lost-packets=[%d] lost-blocks=[%d] samples=[%d]"
+              % (self.packets, self.lost_packets, self.lost_blocks, self.samples))
+        if elapsed_s > 0:
+            print("net: elapsed=[%.3f s] throughput=[%.1f MB/s]"
+                  % (elapsed_s, self.samples * self.sample_size / elapsed_s / 1e6))
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        print("Usage: %s udp://0.0.0.0:port|tcp://0.0.0.0:port output_file [nsamps]" % sys.argv[0])
+        sys.exit(1)
+    rx = CerbNetReceiver(sys.argv[1])
+    t0 = time.time()
+    rx.receive_file(sys.argv[2], int(sys.argv[3]) if len(sys.argv) > 3 else None)
+    rx.print_stats(time.time() - t0)
+    rx.close()
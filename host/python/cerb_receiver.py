@@ -0,0 +1,190 @@
+"""
+:module: cerb_receiver.py
+
+:author: Michael Clark <mclark@ipsolonresearch.com>
+
+:since:  March 2022
+
+:about:
+Python bindings for libcerb_receiver (host/receiver), the C++ receiver
+for the framed IQ stream of rx_samples_to_file --net. Frames are
+reassembled by a native thread into a ring of huge page backed blocks;
+Python only sees finished blocks, as NumPy views of the ring memory:
+
+    with CerbReceiver('udp://0.0.0.0:5700') as rx:
+        for blk in rx:
+            process(blk.iq())   # valid until the next block is requested
+
+fc32 blocks are complex64 views; sc16 blocks are (nsamps, 2) int16
+views, blk.to_complex64() converts them. A block stays valid until it
+is released; iteration releases the previous block automatically and
+ends when the stream does or stalls for five seconds. When analysis
+falls behind the ring fills up: by default the receiver then stops
+reading the socket, drop=True discards blocks instead and counts them
+in stats().
+
+The library is looked up in $CERB_RECEIVER_LIB, next to this file and
+in the system library path.
+
+:license:
+Copyright (C) 2022 Ipsolon Research, Inc
+All rights reserved.
+"""
+import os
+import sys
+import time
+import ctypes
+import ctypes.util
+
+CERB_RX_BLOCK = 0
+CERB_RX_DROP = 1
+CERB_IQ_SCALE = 1.0 / 32768.0
+CERB_FORMATS = {0: ('fc32', 8), 1: ('sc16', 4)}
+
+class _RxBlock(ctypes.Structure):
+    _fields_ = [('data', ctypes.c_void_p),
+                ('seqno', ctypes.c_uint64),
+                ('timestamp_ns', ctypes.c_uint64),
+                ('nsamps', ctypes.c_uint32),
+                ('lost_samps', ctypes.c_uint32),
+                ('sample_rate', ctypes.c_uint32),
+                ('format', ctypes.c_uint32)]
+
+class _RxStats(ctypes.Structure):
+    _fields_ = [('packets', ctypes.c_uint64),
+                ('lost_packets', ctypes.c_uint64),
+                ('blocks', ctypes.c_uint64),
+                ('lost_blocks', ctypes.c_uint64),
+                ('dropped_blocks', ctypes.c_uint64),
+                ('stalls', ctypes.c_uint64),
+                ('bad_frames', ctypes.c_uint64),
+                ('samples', ctypes.c_uint64),
+                ('hugetlb', ctypes.c_uint32),
+                ('pending', ctypes.c_uint32)]
+
+def load_library(path=None):
+    """ loads libcerb_receiver.so and declares the C API """
+    paths = [path, os.environ.get('CERB_RECEIVER_LIB'),
+             os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libcerb_receiver.so')]
+    name = next((p for p in paths if p and os.path.exists(p)), None) or ctypes.util.find_library('cerb_receiver')
+    if not name:
+        raise OSError("libcerb_receiver.so not found, build host/receiver or set CERB_RECEIVER_LIB")
+    lib = ctypes.CDLL(name)
+
+    lib.cerb_rx_open.restype = ctypes.c_void_p
+    lib.cerb_rx_open.argtypes = [ctypes.c_char_p, ctypes.c_uint, ctypes.c_size_t, ctypes.c_int]
+    lib.cerb_rx_acquire.restype = ctypes.c_int
+    lib.cerb_rx_acquire.argtypes = [ctypes.c_void_p, ctypes.POINTER(_RxBlock), ctypes.c_int]
+    lib.cerb_rx_release.restype = None
+    lib.cerb_rx_release.argtypes = [ctypes.c_void_p]
+    lib.cerb_rx_stats.restype = None
+    lib.cerb_rx_stats.argtypes = [ctypes.c_void_p, ctypes.POINTER(_RxStats)]
+    lib.cerb_rx_close.restype = None
+    lib.cerb_rx_close.argtypes = [ctypes.c_void_p]
+    return lib
+
+class CerbBlock:
+    """ one DMA block in the receive ring, valid until released """
+
+    def __init__(self, raw):
+        self.seqno = raw.seqno
+        self.timestamp_ns = raw.timestamp_ns
+        self.nsamps = raw.nsamps
+        self.lost_samps = raw.lost_samps
+        self.sample_rate = raw.sample_rate
+        self.format, self.sample_size = CERB_FORMATS[raw.format]
+        # zero-copy window on the ring slot
+        self.buffer = (ctypes.c_char * (self.nsamps * self.sample_size)).from_address(raw.data)
+
+    def iq(self):
+        """ NumPy view of the samples, complex64 for fc32 and (n, 2) int16 for sc16 """
+        import numpy as np
+        if self.format == 'fc32':
+            return np.frombuffer(self.buffer, dtype=np.complex64)
+        return np.frombuffer(self.buffer, dtype=np.int16).reshape(-1, 2)
+
+    def to_complex64(self):
+        """ samples as a new complex64 array, scaled to [-1, 1) """
+        import numpy as np
+        if self.format == 'fc32':
+            return np.array(self.iq())
+        iq = np.frombuffer(self.buffer, dtype=np.int16).astype(np.float32) * np.float32(CERB_IQ_SCALE)
+        return iq.view(np.complex64)
+
+class CerbReceiver:
+    """ listens on udp://bind:port or tcp://bind:port """
+
+    def __init__(self, url, nslots=64, slot_bytes=2 << 20, drop=False, lib=None):
+        self._lib = load_library(lib)
+        self._rx = self._lib.cerb_rx_open(url.encode('ascii'), nslots, slot_bytes,
+                                          CERB_RX_DROP if drop else CERB_RX_BLOCK)
+        if not self._rx:
+            raise Exception("failed to open receiver on %s" % url)
+        self._held = 0
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *args):
+        self.close()
+
+    def close(self):
+        """ stops the receiver, held blocks become invalid """
+        if self._rx:
+            self._lib.cerb_rx_close(self._rx)
+            self._rx = None
+
+    def acquire(self, timeout=None):
+        """ next block, None at the end of the stream; raises TimeoutError
+        when no block arrives within timeout seconds """
+        raw = _RxBlock()
+        ms = -1 if timeout is None else int(timeout * 1000)
+        rc = self._lib.cerb_rx_acquire(self._rx, ctypes.byref(raw), ms)
+        if rc < 0:
+            raise TimeoutError("no block within %.3f s" % timeout)
+        if rc == 0:
+            return None
+        self._held += 1
+        return CerbBlock(raw)
+
+    def release(self):
+        """ returns the oldest acquired block to the ring """
+        if self._held:
+            self._lib.cerb_rx_release(self._rx)
+            self._held -= 1
+
+    def blocks(self, timeout=5.0):
+        """ yields blocks until the stream ends or, once started, stalls
+        for timeout seconds; each block is released when the next one is
+        requested """
+        blk = self.acquire()
+        while blk is not None:
+            yield blk
+            self.release()
+            try:
+                blk = self.acquire(timeout)
+            except TimeoutError:
+                blk = None
+
+    def __iter__(self):
+        return self.blocks()
+
+    def stats(self):
+        st = _RxStats()
+        self._lib.cerb_rx_stats(self._rx, ctypes.byref(st))
+        return {name: getattr(st, name) for name, _ in _RxStats._fields_}
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        print("Usage: %s udp://0.0.0.0:port|tcp://0.0.0.0:port output_file" % sys.argv[0])
+        sys.exit(1)
+    t0 = None
+    nbytes = 0
+    with CerbReceiver(sys.argv[1]) as rx, open(sys.argv[2], 'wb') as f:
+        for blk in rx:
+            t0 = t0 or time.time()
+            f.write(blk.buffer)
+            nbytes += len(blk.buffer)
+        print(rx.stats())
+    if t0:
+        print("rx: [%d] bytes in [%.3f s]" % (nbytes, time.time() - t0))
@@ -19,11 +19,16 @@ import os
 import numpy as np
 from ssh import SSH
 from pathlib import Path
-from utils import plot_cmplx_waveform, plot_power_spectrum, plot_inst_frequency
+from utils import plot_cmplx_waveform, plot_power_spectrum, plot_inst_frequency, load_capture, read_capture_header
 import matplotlib.pyplot as plt
 
-def cerb_request_samples(ip, nsamps=2**16, cwgen_freq_hz=50e6, cwgen_ampl_scale=0):
-    """ Requests IQ Samples and configures the AXI CWGEN IP """
+def cerb_request_samples(ip, nsamps=2**16, cwgen_freq_hz=50e6, cwgen_ampl_scale=0, fmt='fc32', sigmf=False):
+    """ Requests IQ Samples and configures the AXI CWGEN IP
+
+    fmt='sc16' transfers the raw wire samples (half the size) and
+    converts them on the host. sigmf=True also retrieves the SigMF
+    metadata, returned with the samples as (iq, header).
+    """
     ssh = SSH(ip)
 
     fn = 'rx_samples_to_file.cfile'
@@ -32,6 +37,9 @@ def cerb_request_samples(ip, nsamps=2**16, cwgen_freq_hz=50e6, cwgen_ampl_scale=
     cmd += " --nsamps=" + str(int(nsamps))
     cmd += " --cwgen-freq=" + str(cwgen_freq_hz)
     cmd += " --cwgen-ampl=" + str(int(cwgen_ampl_scale))
+    cmd += " --format=" + fmt
+    if sigmf:
+        cmd += " --sigmf"
 
     resp = ssh.user_cmd(cmd)
     if not resp or resp.find("Done") == -1:
@@ -43,12 +51,24 @@ def cerb_request_samples(ip, nsamps=2**16, cwgen_freq_hz=50e6, cwgen_ampl_scale=
     remote = ssh.current_directory() + '/' + fn
 
     ok = ssh.retrieve_file(remote, local)
+    if ok and fmt == 'sc16':
+        ok = ssh.retrieve_file(remote + '.hdr', local + '.hdr')
+        ssh.rm(remote + '.hdr')
+    if ok and sigmf:
+        ok = ssh.retrieve_file(remote + '.sigmf-meta', local + '.sigmf-meta')
+        ssh.rm(remote + '.sigmf-meta')
     ssh.rm(remote)
     if not ok:
         raise Exception("failed to retrieve file")
 
-    wv = np.fromfile(local, dtype='complex64')
+    wv = load_capture(local)
+    hdr = read_capture_header(local)
     os.remove(local)
+    for ext in ('.hdr', '.sigmf-meta'):
+        if os.path.exists(local + ext):
+            os.remove(local + ext)
+    if sigmf:
+        return wv, hdr
     return wv
 
 if __name__ == '__main__':
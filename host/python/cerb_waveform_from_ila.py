@@ -20,6 +20,17 @@ from utils import plot_cmplx_waveform, plot_power_spectrum
 import matplotlib.pyplot as plt
 
 def parse_ila_csv_file(fn, sampsPerCycle=2):
+    """ ILA export as complex samples, through libcerb_ila (cerb_ila.py)
+    when it is available """
+    try:
+        from cerb_ila import load_ila
+        return load_ila(fn, sampsPerCycle)
+    except OSError:
+        return parse_ila_csv_file_py(fn, sampsPerCycle)
+
+def parse_ila_csv_file_py(fn, sampsPerCycle=2):
+    """ pure Python fallback: tdata holds sampsPerCycle (I, Q) int16
+    pairs, least significant 16-bit word first """
     wv = []
     with open(fn, newline='') as csvfile:
         reader = csv.reader(csvfile, delimiter=',')
@@ -27,8 +38,8 @@ def parse_ila_csv_file(fn, sampsPerCycle=2):
         header2 = next(reader)
         tdata_idx = [i for i, s in enumerate(header1) if 'tdata' in s.lower()]
         for row in reader:
-            fmt = ''.join(2 * sampsPerCycle * ["."])  # parse 16-bit words
-            samples_hex = re.findall(fmt, row[tdata_idx[0]])
+            field = row[tdata_idx[0]].rjust(8 * sampsPerCycle, '0')
+            samples_hex = re.findall('....', field)  # parse 16-bit words
             samples_hex.reverse()
             samps = []
             for word in samples_hex:
@@ -36,8 +47,8 @@ def parse_ila_csv_file(fn, sampsPerCycle=2):
                 s = struct.unpack('>h', cmplx_bytes)
                 samps += [float(s[0]) / 2**15]
 
-            wv.append(complex(samps[0], samps[1]))
-            wv.append(complex(samps[2], samps[3]))
+            for k in range(sampsPerCycle):
+                wv.append(complex(samps[2*k], samps[2*k + 1]))
 
     return np.asarray(wv)
 
@@ -12,10 +12,116 @@ Implement general-purposes utility functions.
 Copyright (C) 2022 Ipsolon Research, Inc
 All rights reserved.
 """
+import os
+import json
 import numpy as np
 import matplotlib.pyplot as plt
 from scipy.fftpack import fft, fftfreq, fftshift
 
+def read_capture_header(fn):
+    """ read the sidecar header written next to a capture file
+
+    The fields of a .sigmf-meta sidecar, when present, are merged over
+    the .hdr ones; keys only the .hdr carries are kept.
+    """
+    hdr = {'format': 'fc32', 'sample_rate': 500e6, 'scale': 1.0, 'channels': 1}
+    if os.path.exists(fn + '.hdr'):
+        _read_hdr(fn + '.hdr', hdr)
+    if os.path.exists(fn + '.sigmf-meta'):
+        hdr.update(read_sigmf_meta(fn))
+    return hdr
+
+def _read_hdr(path, hdr):
+    """ parse the key=value lines of a .hdr sidecar into hdr """
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith('#') or '=' not in line:
+                continue
+            key, val = line.split('=', 1)
+            if key in ('sample_rate', 'scale', 'center_freq', 'enbw_bins'):
+                hdr[key] = float(val)
+            elif key in ('decim', 'nfft', 'overlap', 'navg', 'sweep_steps', 'sweep_nsamps'):
+                hdr[key] = int(val)
+            elif key == 'channels':
+                hdr['channel_list'] = [int(c) for c in val.split(',')]
+                hdr['channels'] = len(hdr['channel_list'])
+            else:
+                hdr[key] = val
+
+def read_sigmf_meta(fn):
+    """ read the SigMF metadata written by rx_samples_to_file --sigmf
+
+    'blocks' holds one (sample_start, seqno, timestamp_ns) tuple per DMA
+    block; a jump in seqno marks blocks dropped before that sample.
+    """
+    with open(fn + '.sigmf-meta') as f:
+        meta = json.load(f)
+    g = meta['global']
+    hdr = {
+        'format': 'sc16' if g['core:datatype'].startswith('ci16') else 'fc32',
+        'sample_rate': float(g['core:sample_rate']),
+        'scale': float(g.get('cerb:scale', 1.0)),
+        'channels': int(g.get('core:num_channels', 1)),
+        'start_realtime_ns': g.get('cerb:start_realtime_ns'),
+        'blocks': [(c['core:sample_start'], c.get('cerb:seqno'), c.get('cerb:timestamp_ns'))
+                   for c in meta.get('captures', [])],
+    }
+    if meta.get('captures'):
+        hdr['center_freq'] = float(meta['captures'][0].get('core:frequency', 250e6))
+    if 'cerb:cwgen_freq' in g:
+        hdr['cwgen_freq'] = float(g['cerb:cwgen_freq'])
+        hdr['cwgen_ampl'] = int(g['cerb:cwgen_ampl'])
+    return hdr
+
+def load_capture(fn, mmap=False):
+    """ load a capture file as complex64, converting raw sc16 captures
+
+    Interleaved multi-channel captures come back as (samples, channels).
+    """
+    hdr = read_capture_header(fn)
+    nch = hdr['channels'] if hdr.get('layout', 'interleaved') == 'interleaved' else 1
+    if hdr['format'] == 'sc16':
+        if mmap:
+            raw = np.memmap(fn, dtype=np.int16, mode='r')
+        else:
+            raw = np.fromfile(fn, dtype=np.int16)
+        iq = raw.reshape(-1, 2).astype(np.float32) * np.float32(hdr['scale'])
+        iq = iq.view(np.complex64).ravel()
+    elif mmap:
+        iq = np.memmap(fn, dtype=np.complex64, mode='r')
+    else:
+        iq = np.fromfile(fn, dtype=np.complex64)
+    if nch > 1:
+        return iq.reshape(-1, nch)
+    return iq
+
+def load_psd(fn):
+    """ load the spectrum frames of rx_samples_to_file --psd
+
+    Returns (frames, freqs): frames is (nframes, nfft) in dBFS, freqs the
+    bin frequencies in Hz relative to the center frequency.
+    """
+    hdr = read_capture_header(fn)
+    nfft = hdr['nfft']
+    frames = np.fromfile(fn, dtype=np.float32).reshape(-1, nfft)
+    freqs = fftshift(fftfreq(nfft, 1/hdr['sample_rate']))
+    return frames, freqs
+
+def load_sweep(fn):
+    """ load a CWGEN sweep of rx_samples_to_file --sweep
+
+    Returns (steps, iq): steps holds one (freq_hz, ampl_scale, seqno,
+    timestamp_ns) tuple per step and iq is (nsteps, nsamps) complex64.
+    """
+    hdr = read_capture_header(fn)
+    steps = []
+    for k in range(hdr['sweep_steps']):
+        freq, ampl, seqno, ts = hdr['step_%d' % k].split(',')
+        steps.append((float(freq), int(ampl), int(seqno), int(ts)))
+    iq = load_capture(fn)
+    return steps, iq.reshape(len(steps), hdr['sweep_nsamps'])
+
 def get_power_spectrum(x, Fs=1):
     N = len(x)
     yf = fft(x)/N
@@ -0,0 +1,535 @@
+//!*********************************************************************
+//! @file cerb_receiver.cpp
+//!
+//! @brief
+//! Host receiver for the framed IQ stream. See cerb_receiver.h.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // recvmmsg()
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include "cerb_receiver.h"
+
+#define CERB_RX_POLL_US     20      // consumer and back-pressure wait step
+#define CERB_RX_STOP_MS     100     // receive timeout to notice close()
+
+cerb_receiver::cerb_receiver()
+    : m_fd(-1), m_udp(true), m_policy(CERB_RX_BLOCK), m_stop(false), m_eof(false),
+      m_started(false), m_open_block(false), m_dropping(false), m_slot(0), m_block_seqno(0), m_next_block(0),
+      m_next_packet(0), m_sample_size(0), m_pos(0), m_received(0),
+      m_packets(0), m_lost_packets(0), m_blocks(0), m_lost_blocks(0), m_dropped_blocks(0),
+      m_stalls(0), m_bad_frames(0), m_samples(0)
+{
+}
+
+cerb_receiver::~cerb_receiver()
+{
+    close();
+}
+
+//!******************************************************
+//! @brief
+//! Binds the socket, maps the ring and starts the
+//! receive thread
+//!
+//!******************************************************
+bool cerb_receiver::open(const std::string& url, size_t nslots, size_t slot_bytes, cerb_rx_policy_e policy)
+{
+    std::string host;
+    int port;
+    if( !cerb_net_parse_url(url, m_udp, host, port) ) {
+        printf("error: invalid listen address [%s], expected udp://bind:port or tcp://bind:port\n", url.c_str());
+        return false;
+    }
+    if( !nslots || !slot_bytes ) {
+        printf("error: the ring needs at least one slot\n");
+        return false;
+    }
+    if( !m_ring.allocate(nslots, slot_bytes) ) {
+        printf("error: failed to map [%zu x %zu] byte ring [%s]\n", nslots, slot_bytes, strerror(errno));
+        return false;
+    }
+    m_policy = policy;
+
+    struct addrinfo hints;
+    struct addrinfo* res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = m_udp ? SOCK_DGRAM : SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+    int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res);
+    if( rc ) {
+        printf("error: failed to resolve [%s] [%s]\n", host.c_str(), gai_strerror(rc));
+        return false;
+    }
+
+    m_fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if( m_fd >= 0 ) {
+        int on = 1;
+        int rcvbuf = CERB_RX_RCVBUF;
+        setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        setsockopt(m_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+        if( bind(m_fd, res->ai_addr, res->ai_addrlen) < 0 || (!m_udp && listen(m_fd, 1) < 0) ) {
+            printf("error: failed to listen on [%s] [%s]\n", url.c_str(), strerror(errno));
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if( m_fd < 0 ) {
+        return false;
+    }
+
+    m_stop = false;
+    m_eof  = false;
+    m_thread = std::thread(&cerb_receiver::rx_thread, this);
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Stops the receive thread, blocks still held by the
+//! consumer become invalid
+//!
+//!******************************************************
+void cerb_receiver::close()
+{
+    m_stop = true;
+    if( m_thread.joinable() ) {
+        m_thread.join();
+    }
+    if( m_fd >= 0 ) {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+}
+
+void cerb_receiver::rx_thread()
+{
+    if( m_udp ) {
+        rx_udp();
+    }
+    else {
+        rx_tcp();
+    }
+    commit_block();
+    m_eof.store(true, std::memory_order_release);
+}
+
+//!******************************************************
+//! @brief
+//! Counts the frame and checks it fits the block it
+//! claims to belong to
+//!
+//!******************************************************
+bool cerb_receiver::check_frame(const cerb_net_hdr_t& hdr)
+{
+    if( hdr.magic != CERB_NET_MAGIC || hdr.version != CERB_NET_VERSION || hdr.hdr_bytes < sizeof(cerb_net_hdr_t) ) {
+        m_bad_frames++;
+        return false;
+    }
+    if( hdr.packet_seqno > m_next_packet ) {
+        m_lost_packets += hdr.packet_seqno - m_next_packet;
+    }
+    else if( hdr.packet_seqno == 0 && m_started ) {
+        // the sender restarted, its block numbers start over
+        commit_block();
+        m_started = false;
+    }
+    m_next_packet = hdr.packet_seqno + 1;
+    m_packets++;
+    if( hdr.flags & CERB_NET_FLAG_END ) {
+        return true;
+    }
+
+    size_t sample_size = cerb_format_sample_size(static_cast<cerb_format_e>(hdr.format));
+    if( hdr.format > CERB_FORMAT_SC16 || hdr.payload_bytes % sample_size ||
+        hdr.sample_offset + hdr.payload_bytes / sample_size > hdr.block_samps ) {
+        m_bad_frames++;
+        return false;
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Returns where the payload of the frame goes, or null
+//! when its block is being dropped. A new block sequence
+//! number closes the previous block and claims a slot.
+//!
+//!******************************************************
+uint8_t* cerb_receiver::begin_frame(const cerb_net_hdr_t& hdr)
+{
+    // late datagram of a block already handed over
+    if( m_started && hdr.block_seqno < m_next_block && !(m_open_block && hdr.block_seqno == m_block_seqno) ) {
+        return nullptr;
+    }
+    if( !m_open_block || hdr.block_seqno != m_block_seqno ) {
+        commit_block();
+        if( m_started && hdr.block_seqno > m_next_block ) {
+            m_lost_blocks += hdr.block_seqno - m_next_block;
+        }
+        m_started     = true;
+        m_open_block  = true;
+        m_block_seqno = hdr.block_seqno;
+        m_next_block  = hdr.block_seqno + 1;
+        m_sample_size = cerb_format_sample_size(static_cast<cerb_format_e>(hdr.format));
+        m_pos         = 0;
+        m_received    = 0;
+        m_dropping    = false;
+
+        if( hdr.block_samps * m_sample_size > m_ring.slot_bytes() ) {
+            printf("error: [%u] sample block exceeds the [%zu] byte ring slots\n", hdr.block_samps, m_ring.slot_bytes());
+            m_bad_frames++;
+            m_dropping = true;
+        }
+        else if( !m_ring.producer_slot(m_slot) ) {
+            if( m_policy == CERB_RX_DROP ) {
+                m_dropped_blocks++;
+                m_dropping = true;
+            }
+            else {
+                m_stalls++;
+                while( !m_ring.producer_slot(m_slot) && !m_stop ) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(CERB_RX_POLL_US));
+                }
+                m_dropping = m_stop;
+            }
+        }
+        if( !m_dropping ) {
+            cerb_rx_slot_info_t& info = m_ring.slot_info(m_slot);
+            info.seqno        = hdr.block_seqno;
+            info.timestamp_ns = hdr.timestamp_ns;
+            info.nsamps       = hdr.block_samps;
+            info.sample_rate  = hdr.sample_rate;
+            info.format       = hdr.format;
+        }
+    }
+    if( m_dropping ) {
+        return nullptr;
+    }
+
+    // datagrams lost before this one read as zeros
+    uint8_t* data = m_ring.slot_data(m_slot);
+    if( hdr.sample_offset > m_pos ) {
+        memset(data + m_pos * m_sample_size, 0, (hdr.sample_offset - m_pos) * m_sample_size);
+    }
+    return data + hdr.sample_offset * m_sample_size;
+}
+
+//!******************************************************
+//! @brief
+//! Accounts for a stored payload, publishes the block
+//! once it is complete
+//!
+//!******************************************************
+void cerb_receiver::end_frame(const cerb_net_hdr_t& hdr)
+{
+    if( m_dropping || !m_open_block || hdr.block_seqno != m_block_seqno ) {
+        return;
+    }
+    size_t nsamps = hdr.payload_bytes / m_sample_size;
+    m_pos       = std::max(m_pos, hdr.sample_offset + nsamps);
+    m_received += nsamps;
+    if( (hdr.flags & CERB_NET_FLAG_LAST_FRAG) && m_received >= m_ring.slot_info(m_slot).nsamps ) {
+        commit_block();
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Zero-fills what is missing of the open block and
+//! hands it to the consumer
+//!
+//!******************************************************
+void cerb_receiver::commit_block()
+{
+    if( !m_open_block ) {
+        return;
+    }
+    m_open_block = false;
+    if( m_dropping ) {
+        return;
+    }
+    cerb_rx_slot_info_t& info = m_ring.slot_info(m_slot);
+    if( m_pos < info.nsamps ) {
+        memset(m_ring.slot_data(m_slot) + m_pos * m_sample_size, 0, (info.nsamps - m_pos) * m_sample_size);
+    }
+    info.lost_samps = info.nsamps - std::min<size_t>(m_received, info.nsamps);
+    m_samples += info.nsamps;
+    m_blocks++;
+    m_ring.publish();
+}
+
+//!******************************************************
+//! @brief
+//! UDP: up to CERB_RX_UDP_BATCH datagrams per recvmmsg(),
+//! payloads are copied into their slot
+//!
+//!******************************************************
+void cerb_receiver::rx_udp()
+{
+    struct timeval tv = { 0, CERB_RX_STOP_MS * 1000 };
+    setsockopt(m_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::vector<uint8_t> buf(CERB_RX_UDP_BATCH * CERB_RX_MAX_DATAGRAM);
+    std::vector<struct iovec> iov(CERB_RX_UDP_BATCH);
+    std::vector<struct mmsghdr> msgs(CERB_RX_UDP_BATCH);
+    for (size_t k = 0; k < CERB_RX_UDP_BATCH; k++) {
+        iov[k].iov_base = &buf[k * CERB_RX_MAX_DATAGRAM];
+        iov[k].iov_len  = CERB_RX_MAX_DATAGRAM;
+    }
+
+    while( !m_stop )
+    {
+        for (size_t k = 0; k < CERB_RX_UDP_BATCH; k++) {
+            memset(&msgs[k], 0, sizeof(msgs[k]));
+            msgs[k].msg_hdr.msg_iov    = &iov[k];
+            msgs[k].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(m_fd, &msgs[0], CERB_RX_UDP_BATCH, MSG_WAITFORONE, nullptr);
+        if( n < 0 ) {
+            if( errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ) {
+                continue;
+            }
+            printf("error: udp receive failed [%s]\n", strerror(errno));
+            return;
+        }
+
+        for (int k = 0; k < n; k++) {
+            const uint8_t* dgram = static_cast<const uint8_t*>(iov[k].iov_base);
+            cerb_net_hdr_t hdr;
+            if( msgs[k].msg_len < sizeof(hdr) ) {
+                m_bad_frames++;
+                continue;
+            }
+            memcpy(&hdr, dgram, sizeof(hdr));
+            if( !check_frame(hdr) ) {
+                continue;
+            }
+            if( hdr.flags & CERB_NET_FLAG_END ) {
+                return;
+            }
+            if( hdr.hdr_bytes + hdr.payload_bytes > msgs[k].msg_len ) {
+                m_bad_frames++;
+                continue;
+            }
+            uint8_t* dst = begin_frame(hdr);
+            if( dst ) {
+                memcpy(dst, dgram + hdr.hdr_bytes, hdr.payload_bytes);
+            }
+            end_frame(hdr);
+        }
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Reads bytes from the TCP stream, false on close or
+//! when the receiver is stopped
+//!
+//!******************************************************
+bool cerb_receiver::recv_exact(int fd, void* buf, size_t bytes)
+{
+    uint8_t* p = static_cast<uint8_t*>(buf);
+    while( bytes )
+    {
+        ssize_t n = recv(fd, p, bytes, 0);
+        if( n < 0 ) {
+            if( (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && !m_stop ) {
+                continue;
+            }
+            return false;
+        }
+        if( n == 0 ) {
+            return false;
+        }
+        p     += n;
+        bytes -= n;
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! TCP: accepts one sender, payloads are received
+//! straight into their slot
+//!
+//!******************************************************
+void cerb_receiver::rx_tcp()
+{
+    int conn = -1;
+    while( conn < 0 && !m_stop )
+    {
+        struct pollfd pfd = { m_fd, POLLIN, 0 };
+        if( poll(&pfd, 1, CERB_RX_STOP_MS) > 0 ) {
+            conn = accept(m_fd, nullptr, nullptr);
+        }
+    }
+    if( conn < 0 ) {
+        return;
+    }
+    struct timeval tv = { 0, CERB_RX_STOP_MS * 1000 };
+    setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    cerb_net_hdr_t hdr;
+    while( recv_exact(conn, &hdr, sizeof(hdr)) )
+    {
+        // later header versions may append fields
+        if( hdr.hdr_bytes > sizeof(hdr) ) {
+            m_discard.resize(std::max<size_t>(m_discard.size(), hdr.hdr_bytes - sizeof(hdr)));
+            if( !recv_exact(conn, &m_discard[0], hdr.hdr_bytes - sizeof(hdr)) ) {
+                break;
+            }
+        }
+        if( !check_frame(hdr) ) {
+            // a stream cannot resync after a bad header
+            printf("error: malformed frame on the tcp stream\n");
+            break;
+        }
+        if( hdr.flags & CERB_NET_FLAG_END ) {
+            break;
+        }
+        uint8_t* dst = begin_frame(hdr);
+        if( !dst ) {
+            m_discard.resize(std::max<size_t>(m_discard.size(), hdr.payload_bytes));
+            dst = m_discard.empty() ? nullptr : &m_discard[0];
+        }
+        if( hdr.payload_bytes && !recv_exact(conn, dst, hdr.payload_bytes) ) {
+            break;
+        }
+        end_frame(hdr);
+    }
+    ::close(conn);
+}
+
+//!******************************************************
+//! @brief
+//! Next block in arrival order; timeout_ms < 0 waits
+//! until a block arrives or the stream ends
+//!
+//!******************************************************
+int cerb_receiver::acquire(cerb_rx_block_t& blk, int timeout_ms)
+{
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+    uint64_t idx;
+    for (;;) {
+        bool eof = m_eof.load(std::memory_order_acquire);
+        if( m_ring.acquire(idx) ) {
+            break;
+        }
+        // the receive thread publishes before it flags the end
+        if( eof ) {
+            return 0;
+        }
+        if( timeout_ms >= 0 && std::chrono::steady_clock::now() >= deadline ) {
+            return -1;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(CERB_RX_POLL_US));
+    }
+
+    const cerb_rx_slot_info_t& info = m_ring.slot_info(idx);
+    blk.data         = m_ring.slot_data(idx);
+    blk.seqno        = info.seqno;
+    blk.timestamp_ns = info.timestamp_ns;
+    blk.nsamps       = info.nsamps;
+    blk.lost_samps   = info.lost_samps;
+    blk.sample_rate  = info.sample_rate;
+    blk.format       = info.format;
+    return 1;
+}
+
+//!******************************************************
+//! @brief
+//! Returns the oldest acquired block to the ring
+//!
+//!******************************************************
+void cerb_receiver::release()
+{
+    m_ring.release();
+}
+
+void cerb_receiver::stats(cerb_rx_stats_t& st) const
+{
+    st.packets        = m_packets;
+    st.lost_packets   = m_lost_packets;
+    st.blocks         = m_blocks;
+    st.lost_blocks    = m_lost_blocks;
+    st.dropped_blocks = m_dropped_blocks;
+    st.stalls         = m_stalls;
+    st.bad_frames     = m_bad_frames;
+    st.samples        = m_samples;
+    st.hugetlb        = m_ring.hugetlb() ? 1 : 0;
+    st.pending        = m_ring.pending();
+}
+
+//!******************************************************
+//! C API
+//!******************************************************
+struct cerb_rx {
+    cerb_receiver rx;
+};
+
+//!******************************************************
+//! @brief
+//! The ring indices are cache line aligned, which plain
+//! new does not honour before C++17
+//!
+//!******************************************************
+static void cerb_rx_destroy(cerb_rx_t* rx)
+{
+    rx->~cerb_rx_t();
+    free(rx);
+}
+
+cerb_rx_t* cerb_rx_open(const char* url, unsigned nslots, size_t slot_bytes, int policy)
+{
+    void* mem = nullptr;
+    if( !url || posix_memalign(&mem, alignof(cerb_rx_t), sizeof(cerb_rx_t)) ) {
+        return nullptr;
+    }
+    cerb_rx_t* rx = new (mem) cerb_rx_t;
+    if( !rx->rx.open(url, nslots ? nslots : CERB_RX_DEFAULT_SLOTS,
+                     slot_bytes ? slot_bytes : CERB_RX_DEFAULT_SLOT_BYTES,
+                     policy == CERB_RX_DROP ? CERB_RX_DROP : CERB_RX_BLOCK) ) {
+        cerb_rx_destroy(rx);
+        return nullptr;
+    }
+    return rx;
+}
+
+int cerb_rx_acquire(cerb_rx_t* rx, cerb_rx_block_t* blk, int timeout_ms)
+{
+    return rx->rx.acquire(*blk, timeout_ms);
+}
+
+void cerb_rx_release(cerb_rx_t* rx)
+{
+    rx->rx.release();
+}
+
+void cerb_rx_stats(cerb_rx_t* rx, cerb_rx_stats_t* st)
+{
+    rx->rx.stats(*st);
+}
+
+void cerb_rx_close(cerb_rx_t* rx)
+{
+    if( rx ) {
+        cerb_rx_destroy(rx);
+    }
+}
@@ -0,0 +1,148 @@
+//!*********************************************************************
+//! @file cerb_receiver.h
+//!
+//! @brief
+//! Host receiver for the framed IQ stream of rx_samples_to_file --net.
+//! A receive thread reassembles the frames of every DMA block straight
+//! into a slot of a huge page backed SPSC ring (cerb_rx_ring.h); the
+//! consumer gets pointers into the ring, so Python can wrap them as
+//! NumPy arrays without a copy (host/python/cerb_receiver.py).
+//!
+//! When the consumer falls behind, CERB_RX_BLOCK stops reading the
+//! socket (TCP then slows the sender down, UDP loses datagrams in the
+//! kernel) and CERB_RX_DROP discards whole blocks and counts them.
+//!
+//! The C API at the end is what the Python bindings load.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_RECEIVER_H_
+#define CERB_RECEIVER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CERB_RX_DEFAULT_SLOTS       64
+#define CERB_RX_DEFAULT_SLOT_BYTES  (2 << 20)   // 262144 fc32 samples
+#define CERB_RX_UDP_BATCH           64          // datagrams per recvmmsg()
+#define CERB_RX_MAX_DATAGRAM        65536
+#define CERB_RX_RCVBUF              (32 << 20)
+
+//! Back-pressure policy when the ring is full
+typedef enum {
+    CERB_RX_BLOCK = 0,      // wait for the consumer
+    CERB_RX_DROP,           // discard the incoming block
+} cerb_rx_policy_e;
+
+//! One received block, valid until released
+typedef struct {
+    const void* data;
+    uint64_t    seqno;          // DMA block sequence number
+    uint64_t    timestamp_ns;   // CLOCK_MONOTONIC DMA completion time on the board
+    uint32_t    nsamps;
+    uint32_t    lost_samps;     // zero-filled for lost datagrams
+    uint32_t    sample_rate;    // Hz
+    uint32_t    format;         // 0 = fc32, 1 = sc16
+} cerb_rx_block_t;
+
+//! Receiver counters
+typedef struct {
+    uint64_t packets;           // frames received
+    uint64_t lost_packets;      // frame sequence gaps (UDP)
+    uint64_t blocks;            // blocks handed to the consumer
+    uint64_t lost_blocks;       // DMA sequence gaps, dropped on the board or in transit
+    uint64_t dropped_blocks;    // discarded because the ring was full (CERB_RX_DROP)
+    uint64_t stalls;            // waits for a free slot (CERB_RX_BLOCK)
+    uint64_t bad_frames;        // malformed or oversized frames
+    uint64_t samples;
+    uint32_t hugetlb;           // 1 when the ring is on MAP_HUGETLB pages
+    uint32_t pending;           // blocks waiting for the consumer
+} cerb_rx_stats_t;
+
+#ifdef __cplusplus
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cerb_net.h"
+#include "cerb_rx_ring.h"
+
+//!******************************************************
+//! @brief
+//! Listens on udp://bind:port or tcp://bind:port and
+//! fills the ring from a receive thread
+//!
+//!******************************************************
+class cerb_receiver
+{
+public:
+    cerb_receiver();
+    ~cerb_receiver();
+
+    bool open(const std::string& url, size_t nslots, size_t slot_bytes, cerb_rx_policy_e policy);
+    void close();
+
+    //! 1 with a block, 0 at the end of the stream, -1 on timeout
+    int  acquire(cerb_rx_block_t& blk, int timeout_ms);
+    void release();
+    void stats(cerb_rx_stats_t& st) const;
+
+private:
+    void     rx_thread();
+    void     rx_udp();
+    void     rx_tcp();
+    bool     recv_exact(int fd, void* buf, size_t bytes);
+    bool     check_frame(const cerb_net_hdr_t& hdr);
+    uint8_t* begin_frame(const cerb_net_hdr_t& hdr);
+    void     end_frame(const cerb_net_hdr_t& hdr);
+    void     commit_block();
+
+    int                     m_fd;
+    bool                    m_udp;
+    cerb_rx_policy_e        m_policy;
+    cerb_rx_ring            m_ring;
+    std::thread             m_thread;
+    std::atomic<bool>       m_stop;
+    std::atomic<bool>       m_eof;
+    std::vector<uint8_t>    m_discard;      // payload of dropped TCP frames
+
+    // block being assembled (receive thread only)
+    bool                    m_started;
+    bool                    m_open_block;
+    bool                    m_dropping;
+    uint64_t                m_slot;
+    uint64_t                m_block_seqno;
+    uint64_t                m_next_block;
+    uint64_t                m_next_packet;
+    size_t                  m_sample_size;
+    size_t                  m_pos;          // samples written or zeroed
+    size_t                  m_received;     // samples received
+
+    std::atomic<uint64_t>   m_packets;
+    std::atomic<uint64_t>   m_lost_packets;
+    std::atomic<uint64_t>   m_blocks;
+    std::atomic<uint64_t>   m_lost_blocks;
+    std::atomic<uint64_t>   m_dropped_blocks;
+    std::atomic<uint64_t>   m_stalls;
+    std::atomic<uint64_t>   m_bad_frames;
+    std::atomic<uint64_t>   m_samples;
+};
+
+extern "C" {
+#endif
+
+typedef struct cerb_rx cerb_rx_t;
+
+cerb_rx_t* cerb_rx_open(const char* url, unsigned nslots, size_t slot_bytes, int policy);
+int        cerb_rx_acquire(cerb_rx_t* rx, cerb_rx_block_t* blk, int timeout_ms);
+void       cerb_rx_release(cerb_rx_t* rx);
+void       cerb_rx_stats(cerb_rx_t* rx, cerb_rx_stats_t* st);
+void       cerb_rx_close(cerb_rx_t* rx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CERB_RECEIVER_H_ */
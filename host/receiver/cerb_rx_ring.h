@@ -0,0 +1,142 @@
+//!*********************************************************************
+//! @file cerb_rx_ring.h
+//!
+//! @brief
+//! Lock-free single producer / single consumer ring of fixed size
+//! sample blocks. The slots live in one mapping backed by huge pages
+//! when the system has them (MAP_HUGETLB, else transparent huge pages),
+//! so a block handed to the consumer is never copied again.
+//!
+//! The producer fills the slot from producer_slot() and publishes it,
+//! the consumer acquires slots in order and releases them in the same
+//! order. Several slots may be held by the consumer at a time.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_RX_RING_H_
+#define CERB_RX_RING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <sys/mman.h>
+
+#define CERB_RX_HUGE_PAGE (2 << 20)
+
+//! Metadata of one slot, the samples follow in the slot memory
+typedef struct {
+    uint64_t seqno;         // DMA block sequence number
+    uint64_t timestamp_ns;  // CLOCK_MONOTONIC DMA completion time on the board
+    uint32_t nsamps;        // samples in the block
+    uint32_t lost_samps;    // samples zero-filled for lost datagrams
+    uint32_t sample_rate;   // Hz
+    uint8_t  format;        // cerb_format_e
+} cerb_rx_slot_info_t;
+
+//!******************************************************
+//! @brief
+//! SPSC ring of nslots x slot_bytes sample blocks
+//!
+//!******************************************************
+class cerb_rx_ring
+{
+public:
+    cerb_rx_ring()
+        : m_mem(nullptr), m_map_bytes(0), m_slot_bytes(0), m_nslots(0), m_huge(false),
+          m_info(nullptr), m_head(0), m_tail(0), m_read(0)
+    {
+    }
+
+    ~cerb_rx_ring()
+    {
+        if( m_mem ) {
+            munmap(m_mem, m_map_bytes);
+        }
+        delete [] m_info;
+    }
+
+    //! Maps the slots, slot_bytes is rounded up to whole pages
+    bool allocate(size_t nslots, size_t slot_bytes)
+    {
+        m_slot_bytes = (slot_bytes + 4095) & ~size_t(4095);
+        m_nslots     = nslots;
+        m_map_bytes  = (m_nslots * m_slot_bytes + CERB_RX_HUGE_PAGE - 1) & ~size_t(CERB_RX_HUGE_PAGE - 1);
+        m_mem = mmap(nullptr, m_map_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        m_huge = (m_mem != MAP_FAILED);
+        if( !m_huge ) {
+            m_mem = mmap(nullptr, m_map_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if( m_mem == MAP_FAILED ) {
+                m_mem = nullptr;
+                return false;
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(m_mem, m_map_bytes, MADV_HUGEPAGE);
+#endif
+        }
+        m_info = new cerb_rx_slot_info_t[m_nslots]();
+        return true;
+    }
+
+    size_t slot_bytes() const { return m_slot_bytes; }
+    size_t nslots() const     { return m_nslots; }
+    bool   hugetlb() const    { return m_huge; }
+
+    uint8_t* slot_data(uint64_t idx)              { return static_cast<uint8_t*>(m_mem) + (idx % m_nslots) * m_slot_bytes; }
+    cerb_rx_slot_info_t& slot_info(uint64_t idx)  { return m_info[idx % m_nslots]; }
+
+    //! Producer: index of the slot to fill, false while the ring is full
+    bool producer_slot(uint64_t& idx)
+    {
+        idx = m_head.load(std::memory_order_relaxed);
+        return idx - m_tail.load(std::memory_order_acquire) < m_nslots;
+    }
+
+    //! Producer: hands the filled slot to the consumer
+    void publish()
+    {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    //! Consumer: index of the next published slot, false when none is ready
+    bool acquire(uint64_t& idx)
+    {
+        if( m_read == m_head.load(std::memory_order_acquire) ) {
+            return false;
+        }
+        idx = m_read++;
+        return true;
+    }
+
+    //! Consumer: returns the oldest acquired slot to the producer
+    bool release()
+    {
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        if( tail == m_read ) {
+            return false;
+        }
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Published slots not yet acquired
+    size_t pending() const { return m_head.load(std::memory_order_acquire) - m_read; }
+
+private:
+    cerb_rx_ring(const cerb_rx_ring&);
+    cerb_rx_ring& operator=(const cerb_rx_ring&);
+
+    void*                   m_mem;
+    size_t                  m_map_bytes;
+    size_t                  m_slot_bytes;
+    size_t                  m_nslots;
+    bool                    m_huge;
+    cerb_rx_slot_info_t*    m_info;
+
+    // producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<uint64_t> m_head;   // next slot to fill
+    alignas(64) std::atomic<uint64_t> m_tail;   // oldest slot held by the consumer
+    alignas(64) uint64_t              m_read;   // next slot to acquire (consumer only)
+};
+
+#endif /* CERB_RX_RING_H_ */
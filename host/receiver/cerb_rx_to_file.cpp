@@ -0,0 +1,150 @@
+//!*********************************************************************
+//! @file cerb_rx_to_file.cpp
+//!
+//! @brief
+//! Receives the framed IQ stream of rx_samples_to_file --net into a
+//! capture file, at rates the Python receiver cannot keep up with:
+//!
+//!   cerb_rx_to_file --url udp://0.0.0.0:5700 --file capture.sc16 &
+//!   rx_samples_to_file --net udp://<host>:5700 --format sc16 --duration 5
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <signal.h>
+#include "cerb_receiver.h"
+#include "cerb_writer.h"
+
+namespace po = boost::program_options;
+
+// globals
+po::variables_map   m_opts;
+std::string         m_url = "udp://0.0.0.0:5700";
+std::string         m_file = "capture.sc16";
+uint64_t            m_nsamps = 0;
+unsigned            m_nslots = CERB_RX_DEFAULT_SLOTS;
+size_t              m_slot_bytes = CERB_RX_DEFAULT_SLOT_BYTES;
+int                 m_timeout_ms = 5000;
+std::atomic<bool>   m_stop(false);
+
+//!******************************************************
+//! @brief
+//! Handles command line options
+//!
+//!******************************************************
+int init_options(int argc, char *argv[])
+{
+    po::options_description desc("Command Line Options");
+    desc.add_options()
+        ("help,h",      "help message")
+        ("url",         po::value<std::string>(&m_url)->default_value(m_url),                  "Listen address, udp://bind:port or tcp://bind:port")
+        ("file",        po::value<std::string>(&m_file)->default_value(m_file),                "Output file")
+        ("nsamps",      po::value<uint64_t>(&m_nsamps)->default_value(m_nsamps),               "Samples to receive (0 = until the stream ends)")
+        ("nslots",      po::value<unsigned>(&m_nslots)->default_value(m_nslots),               "Blocks in the receive ring")
+        ("slot-bytes",  po::value<size_t>(&m_slot_bytes)->default_value(m_slot_bytes),         "Bytes per ring slot, at least one DMA block")
+        ("timeout",     po::value<int>(&m_timeout_ms)->default_value(m_timeout_ms),            "Give up after this many ms without data once started")
+        ("drop",        "Drop blocks when the disk falls behind instead of pausing the receiver")
+    ;
+
+    po::store( po::parse_command_line(argc, argv, desc), m_opts);
+    if (m_opts.count("help")){
+        std::cout << "Usage: options_description [options]\n";
+        std::cout << desc;
+        return 0;
+    }
+
+    try {
+        po::notify(m_opts);
+    }
+    catch (std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 0;
+    }
+    return 1;
+}
+
+void signal_handler( int )
+{
+    m_stop = true;
+}
+
+//!******************************************************
+//! @brief
+//! Main entry point
+//!
+//!******************************************************
+int main(int argc, char *argv[])
+{
+    if( !init_options(argc, argv) ) {
+        return 1;
+    }
+
+    cerb_receiver rx;
+    if( !rx.open(m_url, m_nslots, m_slot_bytes, m_opts.count("drop") ? CERB_RX_DROP : CERB_RX_BLOCK) ) {
+        return 1;
+    }
+    cerb_file_writer fout;
+    if( !fout.open(m_file, false) ) {
+        return 1;
+    }
+    signal(SIGINT,  signal_handler);
+    signal(SIGTERM, signal_handler);
+    printf("receiving on [%s]\n", m_url.c_str());
+
+    bool ok = true;
+    bool started = false;
+    uint64_t written = 0;
+    cerb_format_e format = CERB_FORMAT_SC16;
+    std::chrono::steady_clock::time_point t0;
+    while( !m_stop && (!m_nsamps || written < m_nsamps) )
+    {
+        cerb_rx_block_t blk;
+        int rc = rx.acquire(blk, started ? m_timeout_ms : 100);
+        if( rc == 0 ) {
+            break;
+        }
+        if( rc < 0 ) {
+            if( started ) {
+                printf("warn: no data for [%d ms]\n", m_timeout_ms);
+                break;
+            }
+            continue;
+        }
+        if( !started ) {
+            started = true;
+            format  = static_cast<cerb_format_e>(blk.format);
+            t0      = std::chrono::steady_clock::now();
+        }
+        uint64_t n = m_nsamps ? std::min<uint64_t>(blk.nsamps, m_nsamps - written) : blk.nsamps;
+        ok = fout.write(blk.data, n * cerb_format_sample_size(format));
+        rx.release();
+        if( !ok ) {
+            break;
+        }
+        written += n;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    fout.close();
+    rx.close();
+    if( !cerb_write_header(m_file, format) ) {
+        ok = false;
+    }
+
+    cerb_rx_stats_t st;
+    rx.stats(st);
+    printf("rx: packets=[%llu] lost-packets=[%llu] blocks=[%llu] lost-blocks=[%llu] dropped-blocks=[%llu] stalls=[%llu]\n",
+           (unsigned long long)st.packets, (unsigned long long)st.lost_packets, (unsigned long long)st.blocks,
+           (unsigned long long)st.lost_blocks, (unsigned long long)st.dropped_blocks, (unsigned long long)st.stalls);
+    printf("rx: samples=[%llu] ring=[%s]", (unsigned long long)written, st.hugetlb ? "hugetlb" : "4k/thp");
+    if( started && elapsed > 0 ) {
+        printf(" elapsed=[%.3f s] throughput=[%.1f MB/s]", elapsed,
+               written * cerb_format_sample_size(format) / elapsed / 1e6);
+    }
+    printf("\n");
+    return ok ? 0 : 1;
+}
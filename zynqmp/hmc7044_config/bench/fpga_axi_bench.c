@@ -0,0 +1,138 @@
+/*
+ * fpga_axi_bench.c
+ *
+ * Measures AXI register accesses per second through the per-call
+ * fpgaAxiRegRead/fpgaAxiRegWrite API and through a persistent
+ * fpga_axi_region_t handle. Runs against a sparse file standing in for
+ * /dev/mem, so it can be run off-target:
+ *
+ *   fpga_axi_bench [mem file] [iterations]
+ *
+ * On the target, pass /dev/mem to measure the real AXI path (the reads
+ * and writes hit the JESD204 PHY scratch range, so only do this on a
+ * bench setup).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "fpga_axi.h"
+
+#define BENCH_BASEADDR		BASEADDR_JESD204_PHY
+#define BENCH_REG_COUNT		(FPGA_AXI_JESD_WINDOW_SIZE / 4)
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, uint32_t accesses, double elapsed_s)
+{
+	printf("%-24s %10u accesses %9.3f ms %14.0f accesses/s\n", name, accesses, elapsed_s * 1e3, accesses / elapsed_s);
+}
+
+int main(int argc, char *argv[])
+{
+	const char			*path = "/tmp/fpga_axi_bench.mem";
+	uint32_t			iterations = 20;
+	uint32_t			data[BENCH_REG_COUNT];
+	uint32_t			i, k, value;
+	uint32_t			errors = 0;
+	int					created = 0;
+	double				t0;
+	fpga_axi_region_t	region;
+
+	if (argc > 1)
+	{
+		path = argv[1];
+	}
+	if (argc > 2)
+	{
+		iterations = strtoul(argv[2], NULL, 0);
+	}
+
+	// sparse file large enough to cover the physical window
+	if (strcmp(path, FPGA_AXI_MEM_DEV) != 0)
+	{
+		int fd = open(path, O_RDWR | O_CREAT, 0600);
+		if (fd < 0 || ftruncate(fd, (off_t)BENCH_BASEADDR + FPGA_AXI_JESD_WINDOW_SIZE) < 0)
+		{
+			perror("error: failed to create stand-in file ");
+			return EXIT_FAILURE;
+		}
+		close(fd);
+		created = 1;
+	}
+	fpgaAxiSetMemDevice(path);
+	printf("AXI window 0x%08X, %u registers x %u iterations on [%s]\n", BENCH_BASEADDR, BENCH_REG_COUNT, iterations, path);
+
+	// per-register open/mmap/munmap/close
+	t0 = now_s();
+	for (k = 0; k < iterations; k++)
+	{
+		for (i = 0; i < BENCH_REG_COUNT; i++)
+		{
+			fpgaAxiRegWrite(BENCH_BASEADDR, i * 4, i ^ k);
+		}
+	}
+	report("fpgaAxiRegWrite", iterations * BENCH_REG_COUNT, now_s() - t0);
+
+	t0 = now_s();
+	for (k = 0; k < iterations; k++)
+	{
+		for (i = 0; i < BENCH_REG_COUNT; i++)
+		{
+			fpgaAxiRegRead(BENCH_BASEADDR, i * 4, &value);
+		}
+	}
+	report("fpgaAxiRegRead", iterations * BENCH_REG_COUNT, now_s() - t0);
+
+	// one mapping for the whole window
+	t0 = now_s();
+	if (fpgaAxiRegionOpen(&region, BENCH_BASEADDR, FPGA_AXI_JESD_WINDOW_SIZE) != EXIT_SUCCESS)
+	{
+		return EXIT_FAILURE;
+	}
+	for (k = 0; k < iterations; k++)
+	{
+		for (i = 0; i < BENCH_REG_COUNT; i++)
+		{
+			fpgaAxiRegionWrite32(&region, i * 4, i ^ k);
+		}
+	}
+	report("fpgaAxiRegionWrite32", iterations * BENCH_REG_COUNT, now_s() - t0);
+
+	t0 = now_s();
+	for (k = 0; k < iterations; k++)
+	{
+		fpgaAxiRegionReadBlock(&region, 0, BENCH_REG_COUNT, data);
+	}
+	report("fpgaAxiRegionReadBlock", iterations * BENCH_REG_COUNT, now_s() - t0);
+	fpgaAxiRegionClose(&region);
+
+	// both paths must see the same registers
+	fpgaAxiReadPhysicalMemory(BENCH_BASEADDR, BENCH_REG_COUNT, 0, data);
+	for (i = 0; i < BENCH_REG_COUNT; i++)
+	{
+		if (data[i] != (i ^ (iterations - 1)))
+		{
+			errors++;
+		}
+	}
+	if (errors)
+	{
+		printf("error: [%u] registers read back wrong\n", errors);
+	}
+
+	if (created)
+	{
+		unlink(path);
+	}
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
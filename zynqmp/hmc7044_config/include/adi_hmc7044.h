@@ -29,6 +29,11 @@
 #define HMC7044_NOF_CLK_IN					4
 #define HMC7044_NOF_GPIO_MAX				4
 #define HMC7044_PLL2_R_DIV_MAX				4095
+#define HMC7044_PLL2_N_DIV_MIN				8
+#define HMC7044_PLL2_N_DIV_MAX				65535
+#define HMC7044_PLL1_R_DIV_MAX				65535
+#define HMC7044_PLL1_N_DIV_MAX				65535
+#define HMC7044_PRESCALER_MAX				255
 #define HMC7044_HW_RESET_PERIOD_US			10
 #define HMC7044_REF_CLK_FREQ_HZ_MIN			150
 #define HMC7044_REF_CLK_FREQ_HZ_MAX 		800000000ull
@@ -109,6 +114,22 @@ typedef struct {
     uint8_t  dev_prod_id;                       /*!< Product ID */
 }adi_hmc7044_info_t;
 
+typedef struct {
+    uint64_t lcm_freq_hz;                       /*!< Common prescaler output of the reference and VCXO */
+    uint64_t pfd1_freq_hz;                      /*!< PLL1 phase frequency detector */
+    uint64_t pll2ref_freq_hz;                   /*!< VCXO after the optional PLL2 doubler */
+    uint64_t pfd2_freq_hz;                      /*!< PLL2 phase frequency detector */
+    uint64_t vco_freq_hz;                       /*!< VCO and distribution frequency */
+    uint8_t  ref_prescaler;                     /*!< CLKINx prescaler, reference to fLCM */
+    uint8_t  vcxo_prescaler;                    /*!< OSCIN prescaler, VCXO to fLCM */
+    uint16_t r1_div;                            /*!< PLL1 reference divider */
+    uint16_t n1_div;                            /*!< PLL1 feedback divider */
+    uint8_t  pll2_freq_dbl_en;                  /*!< PLL2 reference doubler enable */
+    uint16_t r2_div;                            /*!< PLL2 reference divider */
+    uint16_t n2_div;                            /*!< PLL2 feedback divider */
+    uint16_t ch_div[HMC7044_NOF_OP_CH];         /*!< Output channel dividers, 0 when unused */
+}adi_hmc7044_freq_plan_t;
+
 typedef struct {
     adi_hmc7044_hal_t  hal_info;                /*!< HAL information */
     adi_hmc7044_info_t dev_info;                /*!< DEV information */
@@ -645,7 +666,7 @@ int32_t adi_hmc7044_clk_config(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_
  * @param ref_ch                  Channel mask of Clock Input reference source
  * @param ref_clk_freq_hz           Ref clk from clock input channel
  * @param fvcxo_clk_freq_hz         Desired fvcxo clk frequency
- * @param fpfd1_freq_hz             Phase frequency detector for pll1
+ * @param fpfd1_freq_hz             Highest phase frequency detector for pll1, 0 for the device limit
  * @param fvco_freq_hz              Desired fvco clk frequency
  *
  * @return API_CMS_ERROR_OK                     API Completed Successfully
@@ -655,6 +676,43 @@ int32_t adi_hmc7044_clk_config(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_
  */
 int32_t adi_hmc7044_pll_config(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_e ref_ch, uint64_t ref_clk_freq_hz, uint64_t fvcxo_clk_freq_hz, uint64_t fpfd1_freq_hz, uint64_t fvco_freq_hz);
 
+/**
+ * @brief  Solve a frequency plan without touching the device
+ *
+ * Searches the prescalers, R1/N1, the PLL2 doubler, R2/N2, the VCO and the
+ * channel dividers (1, 3, 5 or even) within the HMC7044 frequency limits.
+ * Plans are ranked by PFD2 frequency, then without the doubler, then by
+ * the lowest VCO; PLL1 takes the highest PFD1 the dividers allow.
+ *
+ * @param ref_clk_freq_hz           Ref clk from clock input channel
+ * @param fvcxo_clk_freq_hz         VCXO frequency
+ * @param output_ch                 Channel mask of desired output channel
+ * @param output_freq_hz[14]        Desired generated clocks, 0 for unused channels
+ * @param plan                      Solved plan
+ *
+ * @return API_CMS_ERROR_OK                     API Completed Successfully
+ * @return API_CMS_ERROR_NULL_PARAM             Null Parameter
+ * @return API_CMS_ERROR_INVALID_PARAM          Invalid Parameter
+ * @return API_CMS_ERROR_ERROR                  No plan meets the constraints
+ */
+int32_t adi_hmc7044_freq_plan_solve(uint64_t ref_clk_freq_hz, uint64_t fvcxo_clk_freq_hz, uint16_t output_ch, const uint64_t output_freq_hz[14], adi_hmc7044_freq_plan_t *plan);
+
+/**
+ * @brief  Program a plan from adi_hmc7044_freq_plan_solve()
+ *
+ * @param device                    Pointer to the device structure
+ * @param ref_ch				    Channel mask of Clock Input reference source
+ * @param ref_priority				Ref clk priority
+ * @param output_ch                 Channel mask of desired output channel
+ * @param plan                      Plan to program
+ *
+ * @return API_CMS_ERROR_OK                     API Completed Successfully
+ * @return API_CMS_ERROR_INVALID_HANDLE_PARAM   Invalid Device Handle
+ * @return API_CMS_ERROR_SPI_XFER               SPI Access Failed
+ * @return API_CMS_ERROR_INVALID_PARAM          Invalid Parameter
+ */
+int32_t adi_hmc7044_freq_plan_set(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_e ref_ch, uint8_t ref_priority[4], uint16_t output_ch, const adi_hmc7044_freq_plan_t *plan);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,8 @@
 #ifndef SRC_COMMAND_LINE_PARSER_H_
 #define SRC_COMMAND_LINE_PARSER_H_
 
-int command_line_parser(int argc, char *argv[]);
+#include "adi_hmc7044.h"
+
+int command_line_parser(adi_hmc7044_device_t *hmc7044_dev, int argc, char *argv[]);
 
 #endif /* SRC_COMMAND_LINE_PARSER_H_ */
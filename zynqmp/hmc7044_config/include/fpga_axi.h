@@ -8,8 +8,61 @@
 #ifndef FPGA_AXI_H_
 #define FPGA_AXI_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
+#define FPGA_AXI_MEM_DEV		"/dev/mem"
+#define FPGA_AXI_JESD_WINDOW_SIZE	0x1000	// JESD204 TX/RX and PHY register windows
+
+/**
+ * \brief Persistent mapping of an AXI IP register window. Open once, access
+ * any number of registers through the inline accessors, close once.
+ */
+typedef struct
+{
+	volatile uint8_t	*base;			// first byte of the requested window
+	void				*map;			// page aligned mapping
+	size_t				map_size;		// bytes mapped
+	uint32_t			phys_addr;		// physical address of base
+	uint32_t			size;			// bytes usable from base
+} fpga_axi_region_t;
+
+void fpgaAxiSetMemDevice(const char *path);
+int32_t fpgaAxiRegionOpen(fpga_axi_region_t *region, uint32_t physical_address, uint32_t size);
+void fpgaAxiRegionClose(fpga_axi_region_t *region);
+int32_t fpgaAxiRegionReadBlock(const fpga_axi_region_t *region, uint32_t reg_addr_offset, uint32_t regCount, uint32_t *data);
+int32_t fpgaAxiRegionWriteBlock(const fpga_axi_region_t *region, uint32_t reg_addr_offset, uint32_t regCount, const uint32_t *data);
+
+/* offsets are bytes from region->base, no bounds checking on the fast path */
+static inline uint32_t fpgaAxiRegionRead32(const fpga_axi_region_t *region, uint32_t reg_addr_offset)
+{
+	return *((volatile uint32_t *)(region->base + reg_addr_offset));
+}
+
+static inline void fpgaAxiRegionWrite32(const fpga_axi_region_t *region, uint32_t reg_addr_offset, uint32_t w_data)
+{
+	*((volatile uint32_t *)(region->base + reg_addr_offset)) = w_data;
+}
+
+static inline uint16_t fpgaAxiRegionRead16(const fpga_axi_region_t *region, uint32_t reg_addr_offset)
+{
+	return *((volatile uint16_t *)(region->base + reg_addr_offset));
+}
+
+static inline void fpgaAxiRegionWrite16(const fpga_axi_region_t *region, uint32_t reg_addr_offset, uint16_t w_data)
+{
+	*((volatile uint16_t *)(region->base + reg_addr_offset)) = w_data;
+}
+
+static inline uint8_t fpgaAxiRegionRead8(const fpga_axi_region_t *region, uint32_t reg_addr_offset)
+{
+	return region->base[reg_addr_offset];
+}
+
+static inline void fpgaAxiRegionWrite8(const fpga_axi_region_t *region, uint32_t reg_addr_offset, uint8_t w_data)
+{
+	region->base[reg_addr_offset] = w_data;
+}
 
 int32_t fpgaAxiReadWrite(char *uiod, uint32_t map_size, uint32_t count, uint32_t offset, uint8_t rw, uint32_t *data);
 uint32_t fpgaAxiRegRead(uint32_t physical_address,uint32_t reg_addr_offset, uint32_t *regData);
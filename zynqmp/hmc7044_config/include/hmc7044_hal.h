@@ -17,6 +17,8 @@
 
 /*============= I N C L U D E S ============*/
 #include "adi_cms_api_common.h"
+#include "hmc7044_profile.h"
+#include "spi_transport.h"
 
 /*============= D E F I N E S ==============*/
 #define SPI_IN_OUT_BUFF_SZ 0x3
@@ -33,6 +35,9 @@ int32_t hmc7044_sw_delay_us(adi_hmc7044_device_t *device, uint32_t us);
 
 int32_t hmc7044_hw_reset(adi_hmc7044_device_t *device);
 
+int32_t hmc7044_spi_transport_set(adi_hmc7044_device_t *device,
+        spi_transport_t *spi);
+
 int32_t hmc7044_spi_reg_get(adi_hmc7044_device_t *device,
         uint32_t reg, uint8_t *data);
 int32_t hmc7044_spi_reg_set(adi_hmc7044_device_t *device,
@@ -44,6 +49,20 @@ int32_t hmc7044_spi_reg_tbl_set(adi_hmc7044_device_t *device,
 int32_t hmc7044_spi_reg_block_get(adi_hmc7044_device_t *device,
         const uint16_t address, uint8_t *data, uint32_t count);
 
+int32_t hmc7044_spi_reg_list_get(adi_hmc7044_device_t *device,
+        const uint16_t *regs, uint8_t *data, uint32_t count);
+
+int32_t hmc7044_lock_gpio_set(int gpio);
+int32_t hmc7044_wait_lock(adi_hmc7044_device_t *device, uint16_t reg,
+        uint8_t mask, uint32_t timeout_us, uint32_t *lock_time_us);
+
+int32_t hmc7044_profile_apply(adi_hmc7044_device_t *device,
+        const hmc7044_profile_t *profile);
+int32_t hmc7044_profile_read_image(adi_hmc7044_device_t *device,
+        const hmc7044_profile_t *profile, int16_t *image);
+int32_t hmc7044_profile_verify(adi_hmc7044_device_t *device,
+        const hmc7044_profile_t *profile, uint32_t *checked, uint32_t *mismatches);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,97 @@
+/*
+ * hmc7044_profile.h
+ *
+ * Compiled HMC7044 clock profile. The GUI generated dut.write() scripts
+ * are compiled offline (hmc7044_profile_compile) into a checksummed table
+ * of register writes, delays and lock waits that hmc7044_config loads
+ * with a single read.
+ *
+ * File layout, little endian:
+ *   hmc7044_profile_hdr_t
+ *   hmc7044_profile_entry_t[count]
+ */
+
+#ifndef SRC_HMC7044_PROFILE_H_
+#define SRC_HMC7044_PROFILE_H_
+
+#include <stdint.h>
+#include "adi_cms_api_common.h"
+
+#define HMC7044_PROFILE_MAGIC			0x50374D48	// "HM7P"
+#define HMC7044_PROFILE_VERSION			1
+#define HMC7044_PROFILE_MAX_ENTRIES		4096
+
+#define HMC7044_PROFILE_NOF_REGS		0x200
+
+#define HMC7044_PROFILE_FLAG_REDUCED	0x0001		// writes matching the reset defaults removed
+#define HMC7044_PROFILE_FLAG_DIFF		0x0002		// only the registers that differ from the device
+
+// request strobes in reg 0x1 (restart, pulse generator, reseed), never part of an image
+#define HMC7044_PROFILE_REQ_STROBES		0x86
+
+// chip ID, alarm and status readback; the GUI scripts write them, readback never matches
+#define HMC7044_PROFILE_RO_FIRST_REG	0x78
+#define HMC7044_PROFILE_RO_LAST_REG		0x91
+#define HMC7044_PROFILE_REG_IS_RO(reg)	(((reg) >= HMC7044_PROFILE_RO_FIRST_REG) && ((reg) <= HMC7044_PROFILE_RO_LAST_REG))
+
+// what a differential update had to do
+#define HMC7044_PROFILE_DIFF_RESTART	0x1			// divider/FSM restart needed
+#define HMC7044_PROFILE_DIFF_PLL		0x2			// PLL configuration changed, full lock wait
+
+// divider restart and PLL2 lock wait appended to every script
+#define HMC7044_PROFILE_LOCK_REG		0x7D
+#define HMC7044_PROFILE_LOCK_MASK		0x01
+#define HMC7044_PROFILE_LOCK_TIMEOUT_MS	250
+
+typedef enum {
+	HMC7044_PROFILE_OP_WRITE = 0,		// reg = val
+	HMC7044_PROFILE_OP_DELAY_US,		// wait arg microseconds
+	HMC7044_PROFILE_OP_WAIT_LOCK,		// wait up to arg ms for (reg & val) == val
+	HMC7044_PROFILE_OP_PULSE,			// set val bits in reg, hold arg us extra, clear them
+	HMC7044_PROFILE_NOF_OPS
+} hmc7044_profile_op_e;
+
+typedef struct __attribute__((__packed__)) {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t flags;
+	uint32_t count;			// number of entries
+	uint32_t crc32;			// over the entries
+} hmc7044_profile_hdr_t;
+
+typedef struct __attribute__((__packed__)) {
+	uint8_t  op;
+	uint8_t  val;
+	uint16_t reg;
+	uint32_t arg;
+} hmc7044_profile_entry_t;
+
+typedef struct {
+	hmc7044_profile_hdr_t	hdr;
+	hmc7044_profile_entry_t	*entries;
+	uint32_t				size;		// allocated entries
+} hmc7044_profile_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t hmc7044_profile_crc32(const void *data, uint32_t len);
+
+void    hmc7044_profile_init(hmc7044_profile_t *profile);
+void    hmc7044_profile_free(hmc7044_profile_t *profile);
+int32_t hmc7044_profile_add(hmc7044_profile_t *profile, uint8_t op, uint16_t reg, uint8_t val, uint32_t arg);
+
+int32_t hmc7044_profile_parse_script(const char *path, uint8_t epilogue, hmc7044_profile_t *profile);
+int32_t hmc7044_profile_reduce(hmc7044_profile_t *profile, const adi_cms_reg_data_t *defaults, uint32_t count);
+int32_t hmc7044_profile_image(const hmc7044_profile_t *profile, int16_t *image);
+int32_t hmc7044_profile_diff(const hmc7044_profile_t *target, const int16_t *current,
+	hmc7044_profile_t *out, uint32_t *changed, uint32_t *actions);
+int32_t hmc7044_profile_write(const char *path, hmc7044_profile_t *profile);
+int32_t hmc7044_profile_load(const char *path, hmc7044_profile_t *profile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SRC_HMC7044_PROFILE_H_ */
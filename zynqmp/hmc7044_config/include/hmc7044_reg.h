@@ -53,7 +53,7 @@
 #define HMC7044_PLL1_N_DIV_MSB_REG             0x0027
 
 #define HMC7044_PLL2_FREQ_DOUBLER_REG          0x0032
-#define HMC7044_PLL2_FREQ_DOUBLER_EN           ADI_UTILS_BIT(1)
+#define HMC7044_PLL2_FREQ_DOUBLER_BYPASS       ADI_UTILS_BIT(0)
 #define HMC7044_PLL2_R_DIV_LSB_REG             0x0033
 #define HMC7044_PLL2_R_DIV_MSB_REG             0x0034
 
@@ -11,9 +11,17 @@
 
 #define		SPI0_SS_HMC7044		1
 
+// transfers per SPI_IOC_MESSAGE, keeps the ioctl size field in range
+#define		SPI_BATCH_MAX_XFERS	128
+
 int32_t HAL_initSpi(uint8_t chipSelectIndex, uint8_t spiMode, uint32_t spiClk_Hz);
 
 int HAL_spiWrite(uint8_t chipSelectIndex, const unsigned char *txbuf, uint32_t n_tx);
 int HAL_spiRead(uint8_t chipSelectIndex, unsigned char *txbuf, uint8_t n_tx, unsigned char *readdata);
+int HAL_spiXfer(uint8_t chipSelectIndex, const unsigned char *txbuf, unsigned char *rxbuf, uint32_t n);
+int HAL_spiWriteBatch(uint8_t chipSelectIndex, const unsigned char *txbuf, uint32_t n_tx,
+                      uint32_t count, const uint16_t *delay_us);
+int HAL_spiReadBatch(uint8_t chipSelectIndex, const unsigned char *txbuf, uint8_t n_tx,
+                     uint32_t count, unsigned char *readdata);
 
 #endif /* SRC_SPI_H_ */
@@ -0,0 +1,74 @@
+/*
+ * spi_stats.h
+ *
+ * Bring-up instrumentation enabled with --stats (or --stats=json). Each
+ * layer of the SPI path records its calls with CLOCK_MONOTONIC, so the
+ * summary printed at exit splits the run between the spidev ioctls, the
+ * transport, the HAL register accessors, sleeps and the lock wait.
+ *
+ * Disabled, a record is one test of spi_stats_on.
+ */
+
+#ifndef SRC_SPI_STATS_H_
+#define SRC_SPI_STATS_H_
+
+#include <stdint.h>
+
+#define SPI_STATS_NOF_BUCKETS	26		// <1 us, then powers of two up to 16 s
+
+typedef enum {
+	SPI_STAT_SPIDEV_WRITE = 0,		// HAL_spiWrite
+	SPI_STAT_SPIDEV_READ,			// HAL_spiRead
+	SPI_STAT_SPIDEV_XFER,			// HAL_spiXfer
+	SPI_STAT_SPIDEV_WRITE_BATCH,	// HAL_spiWriteBatch
+	SPI_STAT_SPIDEV_READ_BATCH,		// HAL_spiReadBatch
+	SPI_STAT_TRANSPORT_XFER,		// spi_transport_xfer
+	SPI_STAT_TRANSPORT_WRITE_BATCH,	// spi_transport_write_batch
+	SPI_STAT_TRANSPORT_READ_BATCH,	// spi_transport_read_batch
+	SPI_STAT_REG_GET,				// hmc7044_spi_reg_get
+	SPI_STAT_REG_SET,				// hmc7044_spi_reg_set
+	SPI_STAT_REG_TBL_SET,			// hmc7044_spi_reg_tbl_set
+	SPI_STAT_REG_LIST_GET,			// hmc7044_spi_reg_list_get
+	SPI_STAT_SLEEP,					// usleep between accesses and profile delays
+	SPI_STAT_LOCK_WAIT,				// hmc7044_wait_lock, retries are the extra polls
+	SPI_STAT_NOF_OPS
+} spi_stat_op_e;
+
+typedef enum {
+	SPI_STATS_OFF = 0,
+	SPI_STATS_TEXT,
+	SPI_STATS_JSON
+} spi_stats_mode_e;
+
+extern int spi_stats_on;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void spi_stats_enable(spi_stats_mode_e mode);
+uint64_t spi_stats_now_ns(void);
+void spi_stats_record(spi_stat_op_e op, uint64_t start_ns, uint64_t bytes);
+void spi_stats_retry(spi_stat_op_e op, uint32_t retries);
+void spi_stats_usleep(uint32_t us);
+void spi_stats_print(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/* start time of a call, 0 when disabled */
+static inline uint64_t spi_stats_begin(void)
+{
+	return spi_stats_on ? spi_stats_now_ns() : 0;
+}
+
+static inline void spi_stats_end(spi_stat_op_e op, uint64_t start_ns, uint64_t bytes)
+{
+	if (spi_stats_on)
+	{
+		spi_stats_record(op, start_ns, bytes);
+	}
+}
+
+#endif /* SRC_SPI_STATS_H_ */
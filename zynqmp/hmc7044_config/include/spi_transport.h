@@ -0,0 +1,77 @@
+/*
+ * spi_transport.h
+ *
+ * Pluggable SPI transport behind the HMC7044 HAL. Every register access
+ * goes through one of these, selected with --spi=<spec>:
+ *
+ *   spidev         one SPI_IOC_MESSAGE per chip-select frame
+ *   spidev-batch   table writes and register lists queued into as few
+ *                  SPI_IOC_MESSAGE transfers as possible (default)
+ *   emu[:lock_us]  in-memory HMC7044 register model, no hardware needed
+ *
+ * hmc7044_spi_transport_set() hooks a transport into hal_info.spi_xfer
+ * with the transport as user_data.
+ */
+
+#ifndef SRC_SPI_TRANSPORT_H_
+#define SRC_SPI_TRANSPORT_H_
+
+#include <stdint.h>
+
+#define SPI_TRANSPORT_DEFAULT	"spidev-batch"
+
+/**
+ * \brief Traffic counters, kept for every transport
+ */
+typedef struct
+{
+	uint64_t	frames;			// chip-select frames
+	uint64_t	calls;			// transport calls, ioctls on spidev (counted by the transport)
+	uint64_t	bytes;			// bytes shifted out
+	uint64_t	settle_us;		// settle delays requested after frames
+} spi_transport_stats_t;
+
+typedef struct spi_transport spi_transport_t;
+
+struct spi_transport
+{
+	const char	*name;
+	void		*ctx;
+	uint32_t	clk_hz;
+
+	/* one full duplex frame of size bytes */
+	int32_t (*xfer)(spi_transport_t *spi, uint8_t *in_data, uint8_t *out_data, uint32_t size_bytes);
+	/* count frames of n_tx bytes, delay_us (may be NULL) is the settle time after each */
+	int32_t (*write_batch)(spi_transport_t *spi, const uint8_t *txbuf, uint32_t n_tx, uint32_t count,
+		const uint16_t *delay_us);
+	/* count one byte reads behind n_tx byte instruction words, the read bit is set here */
+	int32_t (*read_batch)(spi_transport_t *spi, const uint8_t *txbuf, uint8_t n_tx, uint32_t count,
+		uint8_t *readdata);
+	void (*close)(spi_transport_t *spi);
+
+	spi_transport_stats_t	stats;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+spi_transport_t *spi_transport_open(const char *spec, uint8_t chipSelectIndex, uint8_t spiMode, uint32_t spiClk_Hz);
+void spi_transport_close(spi_transport_t *spi);
+
+int32_t spi_transport_xfer(void *user_data, uint8_t *in_data, uint8_t *out_data, uint32_t size_bytes);
+int32_t spi_transport_write_batch(spi_transport_t *spi, const uint8_t *txbuf, uint32_t n_tx,
+	uint32_t count, const uint16_t *delay_us);
+int32_t spi_transport_read_batch(spi_transport_t *spi, const uint8_t *txbuf, uint8_t n_tx,
+	uint32_t count, uint8_t *readdata);
+
+void spi_transport_print_stats(const spi_transport_t *spi);
+
+/* in-memory HMC7044, see hmc7044_emu.c */
+spi_transport_t *hmc7044_emu_open(const char *options, uint32_t spiClk_Hz);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SRC_SPI_TRANSPORT_H_ */
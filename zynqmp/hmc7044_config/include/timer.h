@@ -18,6 +18,9 @@ typedef struct
 
 } timerSettings_t;
 
+extern timerSettings_t global_timerData;
+
+int32_t HAL_startTimer_us(void);
 int32_t HAL_setTimeout_ms(uint32_t timeOut_ms);
 uint32_t HAL_setTimeout_us(uint32_t timeOut_us);
 int32_t HAL_hasTimeoutExpired(void);
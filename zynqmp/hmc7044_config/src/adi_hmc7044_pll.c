@@ -14,6 +14,7 @@
 
 /*============= I N C L U D E S ============*/
 #include <stdlib.h>
+#include <string.h>
 #include "adi_utils.h"
 #include "adi_hmc7044.h"
 #include "hmc7044_hal.h"
@@ -208,7 +209,7 @@ int32_t adi_hmc7044_pll2_config_set(adi_hmc7044_device_t *device, uint8_t freq_d
     if (err != API_CMS_ERROR_OK) {
         return err;
     }
-    reg_val = freq_dbl_en ? HMC7044_PLL2_FREQ_DOUBLER_EN : 0x0;
+    reg_val = freq_dbl_en ? 0x0 : HMC7044_PLL2_FREQ_DOUBLER_BYPASS;
     err = adi_hmc7044_device_spi_register_set(device, HMC7044_PLL2_FREQ_DOUBLER_REG, reg_val);
     if (err != API_CMS_ERROR_OK) {
         return err;
@@ -315,7 +316,7 @@ int32_t adi_hmc7044_distribution_clk_config(adi_hmc7044_device_t *device, uint64
 		return err;
 	if (err = adi_hmc7044_gpo_config_set(device, 3, 0), err != API_CMS_ERROR_OK)
 		return err;
-    err = adi_hmc7044_pll2_config_set(device, 0x0, R2, N2);
+    err = adi_hmc7044_pll2_config_set(device, 0x1, R2, N2);
     if (err!= API_CMS_ERROR_OK) {
         return err;
     }
@@ -323,166 +324,233 @@ int32_t adi_hmc7044_distribution_clk_config(adi_hmc7044_device_t *device, uint64
     return API_CMS_ERROR_OK;
 }
 
-int32_t adi_hmc7044_clk_config(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_e ref_ch, uint8_t ref_priority[4], uint64_t ref_clk_freq_hz, uint64_t fvcxo_clk_freq_hz, uint16_t output_ch, uint64_t output_clk_freq_hz[14])
+/*
+ * Frequency plan solver. PLL1 locks the VCXO to the reference: both are
+ * prescaled to a common fLCM, R1 divides fLCM and N1 the VCXO down to
+ * fPFD1. PLL2 multiplies the VCXO, optionally doubled, by N2/R2 up to the
+ * VCO and every output divides the VCO by 1, 3, 5 or an even number.
+ */
+static int hmc7044_ch_div_valid(uint64_t div)
 {
-	int32_t err;
-    uint64_t flcm_clk_hz, pfd1_clk_hz, pfd2_clk_hz, vcxo_prescaler, pll2ref_clk_hz, pfd2_lcm_hz, pfd2_gcd_hz,fvco_clk_hz = 2949.12e6;
-	uint64_t R1, N1, N2, R2, output_chan_divider;
-	uint64_t i = 0;
-
-	/*range check*/
-	if (device == ADI_INVALID_POINTER) {
-		return API_CMS_ERROR_INVALID_HANDLE_PTR;
-	}
-
-	if (ref_ch > HMC7044_CLK_IN_ALL) {
-		return API_CMS_ERROR_INVALID_HANDLE_PTR;
-	}
-
-	if ((ref_clk_freq_hz > HMC7044_REF_CLK_FREQ_HZ_MAX || ref_clk_freq_hz< HMC7044_REF_CLK_FREQ_HZ_MIN)) {
-		return API_CMS_ERROR_INVALID_PARAM;
-	}
+	return (div == 1) || (div == 3) || (div == 5) || (((div % 2) == 0) && (div >= 2) && (div <= HMC7044_CH_DIV_MAX));
+}
 
-	if (fvcxo_clk_freq_hz < HMC7044_VCXO_CLK_FREQ_HZ_MIN || fvcxo_clk_freq_hz > HMC7044_VCXO_CLK_FREQ_HZ_MAX) {
-		return API_CMS_ERROR_INVALID_PARAM;
-	}
+static int hmc7044_vco_valid(uint64_t vco_hz, uint16_t output_ch, const uint64_t output_freq_hz[14])
+{
+	uint8_t i;
 
 	for (i = 0; i < HMC7044_NOF_OP_CH; i++) {
-		if (output_clk_freq_hz[i]) {
-			uint16_t opchan = 1 << i;
-			if ((output_ch & opchan) != opchan) {
-				return API_CMS_ERROR_INVALID_PARAM;
+		if (((output_ch >> i) & 0x1) && output_freq_hz[i]) {
+			if ((vco_hz % output_freq_hz[i] != 0) || !hmc7044_ch_div_valid(vco_hz / output_freq_hz[i])) {
+				return 0;
 			}
 		}
 	}
+	return 1;
+}
 
-	/*enable clkin*/
-	if (err = adi_hmc7044_input_reference_set(device, 0, IPBUFFER_INTERNAL_100_OHM_EN | IPBUFFER_AC_COUPLED_MODE_EN, (ref_ch & HMC7044_CLK_IN_0)), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_set(device, 1, IPBUFFER_INTERNAL_100_OHM_EN | IPBUFFER_AC_COUPLED_MODE_EN, (ref_ch & HMC7044_CLK_IN_1) >> 1), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_set(device, 2, IPBUFFER_INTERNAL_100_OHM_EN | IPBUFFER_AC_COUPLED_MODE_EN, (ref_ch & HMC7044_CLK_IN_2) >> 2), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_set(device, 3, IPBUFFER_INTERNAL_100_OHM_EN | IPBUFFER_AC_COUPLED_MODE_EN, (ref_ch & HMC7044_CLK_IN_3) >> 3), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_priority_set(device, ref_priority, 4), err != API_CMS_ERROR_OK)
-		return err;
-
-	/*calculate fLCM, typical range to be 30~40 MHz*/
-	flcm_clk_hz = ref_clk_freq_hz;
-
-	/*scale flcm to 30-40 range*/
-	if (ref_clk_freq_hz > HMC7044_PLL1REF_CLK_FREQ_HZ_MAX || ref_clk_freq_hz < HMC7044_PLL1REF_CLK_FREQ_HZ_MIN) {
-		uint8_t div = ref_clk_freq_hz / HMC7044_PLL1REF_CLK_FREQ_HZ_MIN;
-		flcm_clk_hz = ref_clk_freq_hz / div;
-	}
+/* highest fLCM the prescalers reach, then the highest fPFD1 up to pfd1_max_hz */
+static int32_t hmc7044_pll1_solve(uint64_t ref_clk_freq_hz, uint64_t fvcxo_clk_freq_hz, uint64_t pfd1_max_hz,
+	adi_hmc7044_freq_plan_t *plan)
+{
+	uint64_t common_hz, lcm_hz = 0, pfd1_hz, k, r1;
 
-	/*calculate vcxo prescaler*/
-	if (fvcxo_clk_freq_hz % flcm_clk_hz != 0) {
-		return API_CMS_ERROR_ERROR;
+	common_hz = gcd(ref_clk_freq_hz, fvcxo_clk_freq_hz);
+	for (k = 1; k <= HMC7044_PRESCALER_MAX; k++) {
+		if ((common_hz % k != 0) || (common_hz / k > HMC7044_LCM_CLK_FREQ_HZ_MAX)) {
+			continue;
+		}
+		if ((common_hz / k >= HMC7044_LCM_CLK_FREQ_HZ_MIN) &&
+			(ref_clk_freq_hz / (common_hz / k) <= HMC7044_PRESCALER_MAX) &&
+			(fvcxo_clk_freq_hz / (common_hz / k) <= HMC7044_PRESCALER_MAX)) {
+			lcm_hz = common_hz / k;
+		}
+		break;
 	}
-	vcxo_prescaler = fvcxo_clk_freq_hz / flcm_clk_hz;
-
-	if (err = adi_hmc7044_input_reference_los_config_set(device, 7, 0, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_prescaler_config_set(device, 0, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_prescaler_config_set(device, 1, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_prescaler_config_set(device, 2, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_prescaler_config_set(device, 3, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_oscin_prescaler_config_set(device, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
-
-	/*calculate fPFD1*/
-	pfd1_clk_hz = gcd(flcm_clk_hz, fvcxo_clk_freq_hz);
-	if (fvcxo_clk_freq_hz / 65535 > pfd1_clk_hz) {
+	if (lcm_hz == 0) {
 		return API_CMS_ERROR_ERROR;
 	}
 
-	/* calculate pll2ref*/
-	pll2ref_clk_hz = fvcxo_clk_freq_hz <= HMC7044_PLL2REF_CLK_DB_FREQ_HZ_MAX ? 2 * fvcxo_clk_freq_hz : fvcxo_clk_freq_hz;
-
-	/*calculate fvco*/
-	pfd2_gcd_hz = pll2ref_clk_hz;
-	for (i = 0; i < HMC7044_NOF_OP_CH; i++) {
-		if (output_clk_freq_hz[i]) {
-			pfd2_gcd_hz = gcd(pfd2_gcd_hz, output_clk_freq_hz[i]);
+	r1 = (lcm_hz + pfd1_max_hz - 1) / pfd1_max_hz;
+	for (r1 = (r1 < 1) ? 1 : r1; r1 <= HMC7044_PLL1_R_DIV_MAX; r1++) {
+		if (lcm_hz % r1 != 0) {
+			continue;
 		}
-	}
-
-
-	pfd2_lcm_hz = pfd2_gcd_hz;
-	for (i = 0; i < HMC7044_NOF_OP_CH; i++) {
-		if (output_clk_freq_hz[i]) {
-			pfd2_lcm_hz = lcm(pfd2_lcm_hz, output_clk_freq_hz[i]);
+		pfd1_hz = lcm_hz / r1;
+		if ((pfd1_hz < HMC7044_PD1_CLK_FREQ_HZ_MIN) || (fvcxo_clk_freq_hz / pfd1_hz > HMC7044_PLL1_N_DIV_MAX)) {
+			break;
 		}
+		plan->lcm_freq_hz = lcm_hz;
+		plan->pfd1_freq_hz = pfd1_hz;
+		plan->ref_prescaler = ref_clk_freq_hz / lcm_hz;
+		plan->vcxo_prescaler = fvcxo_clk_freq_hz / lcm_hz;
+		plan->r1_div = r1;
+		plan->n1_div = fvcxo_clk_freq_hz / pfd1_hz;
+		return API_CMS_ERROR_OK;
 	}
+	return API_CMS_ERROR_ERROR;
+}
 
-	uint64_t  fdist;
-	for (uint64_t k = 0; k < HMC7044_PLL2_R_DIV_MAX; k++) {
-		fdist = k * pfd2_lcm_hz;
-		if (fdist > HMC7044_VCO_CLK_FREQ_HZ_MIN && fdist < HMC7044_VCO_CLK_FREQ_HZ_MAX) {
-			/*check output divider, should be 1,3,5 or even numbers*/
-			for (i = 0; i < HMC7044_NOF_OP_CH; i++) {
-				if (output_clk_freq_hz[i]) {
-					output_chan_divider = fdist / output_clk_freq_hz[i];
-					if (output_chan_divider % 2 != 0) {
-						if (output_chan_divider != 1 || output_chan_divider != 3 || output_chan_divider != 5) {
-							break;
-						}
-					}
+/*
+ * Highest fPFD2 reaching a VCO in [vco_min_hz, vco_max_hz] that is a
+ * multiple of vco_step_hz and that every output divides into. R2 is walked
+ * upwards, so the first VCO found for a reference is the best for it; on a
+ * tie the undoubled reference and the lowest VCO are kept.
+ */
+static int32_t hmc7044_pll2_solve(uint64_t fvcxo_clk_freq_hz, uint64_t vco_min_hz, uint64_t vco_max_hz,
+	uint64_t vco_step_hz, uint16_t output_ch, const uint64_t output_freq_hz[14], adi_hmc7044_freq_plan_t *plan)
+{
+	uint64_t pll2ref_hz, pfd2_hz, step_hz, vco_hz, first_hz, last_hz, r2;
+	uint8_t dbl;
+
+	plan->pfd2_freq_hz = 0;
+	for (dbl = 0; dbl <= 1; dbl++) {
+		if (dbl && ((fvcxo_clk_freq_hz < HMC7044_PLL2REF_CLK_DB_FREQ_HZ_MIN) ||
+			(fvcxo_clk_freq_hz > HMC7044_PLL2REF_CLK_DB_FREQ_HZ_MAX))) {
+			continue;
+		}
+		pll2ref_hz = fvcxo_clk_freq_hz << dbl;
+		r2 = (pll2ref_hz + HMC7044_PD2_CLK_FREQ_HZ_MAX - 1) / HMC7044_PD2_CLK_FREQ_HZ_MAX;
+		for (r2 = (r2 < 1) ? 1 : r2; r2 <= HMC7044_PLL2_R_DIV_MAX; r2++) {
+			if (pll2ref_hz % r2 != 0) {
+				continue;
+			}
+			pfd2_hz = pll2ref_hz / r2;
+			if ((pfd2_hz < HMC7044_PD2_CLK_FREQ_HZ_MIN) || (pfd2_hz <= plan->pfd2_freq_hz)) {
+				break;
+			}
+			step_hz = lcm(pfd2_hz, vco_step_hz);
+			first_hz = (vco_min_hz > HMC7044_PLL2_N_DIV_MIN * pfd2_hz) ? vco_min_hz : HMC7044_PLL2_N_DIV_MIN * pfd2_hz;
+			last_hz = (vco_max_hz < HMC7044_PLL2_N_DIV_MAX * pfd2_hz) ? vco_max_hz : HMC7044_PLL2_N_DIV_MAX * pfd2_hz;
+			for (vco_hz = (first_hz + step_hz - 1) / step_hz * step_hz; vco_hz <= last_hz; vco_hz += step_hz) {
+				if (hmc7044_vco_valid(vco_hz, output_ch, output_freq_hz)) {
+					plan->pll2ref_freq_hz = pll2ref_hz;
+					plan->pfd2_freq_hz = pfd2_hz;
+					plan->vco_freq_hz = vco_hz;
+					plan->pll2_freq_dbl_en = dbl;
+					plan->r2_div = r2;
+					plan->n2_div = vco_hz / pfd2_hz;
+					break;
 				}
 			}
-			if (i == HMC7044_NOF_OP_CH) {
-				fvco_clk_hz = fdist;
+			if (plan->pfd2_freq_hz == pfd2_hz) {
 				break;
 			}
 		}
 	}
+	return plan->pfd2_freq_hz ? API_CMS_ERROR_OK : API_CMS_ERROR_ERROR;
+}
 
-	/*calculate fpfd2*/
-	pfd2_clk_hz = gcd(fvco_clk_hz, pll2ref_clk_hz);
+int32_t adi_hmc7044_freq_plan_solve(uint64_t ref_clk_freq_hz, uint64_t fvcxo_clk_freq_hz, uint16_t output_ch,
+	const uint64_t output_freq_hz[14], adi_hmc7044_freq_plan_t *plan)
+{
+	uint64_t vco_step_hz = 1, vco_max_hz = HMC7044_VCO_CLK_FREQ_HZ_MAX;
+	int32_t err;
+	uint8_t i;
 
-	if (pfd2_clk_hz < HMC7044_PD2_CLK_FREQ_HZ_MIN || pfd2_clk_hz > HMC7044_PD2_CLK_FREQ_HZ_MAX) {
-		return API_CMS_ERROR_ERROR;
+	if ((output_freq_hz == ADI_INVALID_POINTER) || (plan == ADI_INVALID_POINTER)) {
+		return API_CMS_ERROR_NULL_PARAM;
+	}
+	if ((ref_clk_freq_hz > HMC7044_REF_CLK_FREQ_HZ_MAX || ref_clk_freq_hz < HMC7044_REF_CLK_FREQ_HZ_MIN)) {
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+	if (fvcxo_clk_freq_hz < HMC7044_VCXO_CLK_FREQ_HZ_MIN || fvcxo_clk_freq_hz > HMC7044_VCXO_CLK_FREQ_HZ_MAX) {
+		return API_CMS_ERROR_INVALID_PARAM;
 	}
-	/*calculate R1, N1, R2, N2*/
-	R1 = flcm_clk_hz / pfd1_clk_hz;
-	N1 = fvcxo_clk_freq_hz / pfd1_clk_hz;
-	R2 = pll2ref_clk_hz / pfd2_clk_hz;
-	N2 = fvco_clk_hz / pfd2_clk_hz;
 
-	/*pll config*/
-	if (err = adi_hmc7044_pll1_config_set(device, R1, N1), err != API_CMS_ERROR_OK)
-		return err;
+	/* the VCO is a common multiple of the outputs, low enough for the slowest to divide down */
+	memset(plan, 0, sizeof(*plan));
+	for (i = 0; i < HMC7044_NOF_OP_CH; i++) {
+		if (output_freq_hz[i] == 0) {
+			continue;
+		}
+		if (((output_ch >> i) & 0x1) == 0 || output_freq_hz[i] > HMC7044_VCO_CLK_FREQ_HZ_MAX) {
+			return API_CMS_ERROR_INVALID_PARAM;
+		}
+		vco_step_hz = lcm(vco_step_hz, output_freq_hz[i]);
+		if (vco_step_hz > HMC7044_VCO_CLK_FREQ_HZ_MAX) {
+			return API_CMS_ERROR_ERROR;
+		}
+		if (output_freq_hz[i] * HMC7044_CH_DIV_MAX < vco_max_hz) {
+			vco_max_hz = output_freq_hz[i] * HMC7044_CH_DIV_MAX;
+		}
+	}
 
-	if (err = adi_hmc7044_gpi_config_set(device, 0, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpi_config_set(device, 1, 0), err != API_CMS_ERROR_OK)
+	if (err = hmc7044_pll1_solve(ref_clk_freq_hz, fvcxo_clk_freq_hz, HMC7044_PD1_CLK_FREQ_HZ_MAX, plan), err != API_CMS_ERROR_OK)
 		return err;
-	if (err = adi_hmc7044_gpi_config_set(device, 2, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpi_config_set(device, 3, 0), err != API_CMS_ERROR_OK)
+	if (err = hmc7044_pll2_solve(fvcxo_clk_freq_hz, HMC7044_VCO_CLK_FREQ_HZ_MIN, vco_max_hz, vco_step_hz,
+		output_ch, output_freq_hz, plan), err != API_CMS_ERROR_OK)
 		return err;
-	if (err = adi_hmc7044_gpo_config_set(device, 0, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpo_config_set(device, 1, 0), err != API_CMS_ERROR_OK)
+	for (i = 0; i < HMC7044_NOF_OP_CH; i++) {
+		if (((output_ch >> i) & 0x1) && output_freq_hz[i]) {
+			plan->ch_div[i] = plan->vco_freq_hz / output_freq_hz[i];
+		}
+	}
+	return API_CMS_ERROR_OK;
+}
+
+/* reference inputs, PLL1 and PLL2 of a solved plan */
+static int32_t hmc7044_freq_plan_pll_set(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_e ref_ch,
+	uint8_t ref_priority[4], const adi_hmc7044_freq_plan_t *plan)
+{
+	int32_t err;
+	uint8_t i;
+
+	/*enable clkin*/
+	for (i = 0; i < HMC7044_NOF_CLK_IN; i++) {
+		if (err = adi_hmc7044_input_reference_set(device, i, IPBUFFER_INTERNAL_100_OHM_EN | IPBUFFER_AC_COUPLED_MODE_EN, (ref_ch >> i) & 0x1), err != API_CMS_ERROR_OK)
+			return err;
+	}
+	if (err = adi_hmc7044_input_reference_priority_set(device, ref_priority, 4), err != API_CMS_ERROR_OK)
 		return err;
-	if (err = adi_hmc7044_gpo_config_set(device, 2, 0), err != API_CMS_ERROR_OK)
+
+	/*prescale the references and the vcxo to fLCM*/
+	if (err = adi_hmc7044_input_reference_los_config_set(device, 7, 0, 0), err != API_CMS_ERROR_OK)
 		return err;
-	if (err = adi_hmc7044_gpo_config_set(device, 3, 0), err != API_CMS_ERROR_OK)
+	for (i = 0; i < HMC7044_NOF_CLK_IN; i++) {
+		if (err = adi_hmc7044_input_reference_prescaler_config_set(device, i, plan->ref_prescaler), err != API_CMS_ERROR_OK)
+			return err;
+	}
+	if (err = adi_hmc7044_input_reference_oscin_prescaler_config_set(device, plan->vcxo_prescaler), err != API_CMS_ERROR_OK)
 		return err;
 
-	if (err = adi_hmc7044_pll2_config_set(device, 0x0, R2, N2), err != API_CMS_ERROR_OK)
+	/*pll config*/
+	if (err = adi_hmc7044_pll1_config_set(device, plan->r1_div, plan->n1_div), err != API_CMS_ERROR_OK)
+		return err;
+	for (i = 0; i < HMC7044_NOF_GPIO_MAX; i++) {
+		if (err = adi_hmc7044_gpi_config_set(device, i, 0), err != API_CMS_ERROR_OK)
+			return err;
+		if (err = adi_hmc7044_gpo_config_set(device, i, 0), err != API_CMS_ERROR_OK)
+			return err;
+	}
+	if (err = adi_hmc7044_pll2_config_set(device, plan->pll2_freq_dbl_en, plan->r2_div, plan->n2_div), err != API_CMS_ERROR_OK)
 		return err;
-
 	if (err = adi_hmc7044_gpo_config_set(device, 0, 0x2b), err != API_CMS_ERROR_OK)
 		return err;
 	if (err = adi_hmc7044_output_performance_set(device, 1), err != API_CMS_ERROR_OK)
 		return err;
+	return API_CMS_ERROR_OK;
+}
+
+int32_t adi_hmc7044_freq_plan_set(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_e ref_ch, uint8_t ref_priority[4],
+	uint16_t output_ch, const adi_hmc7044_freq_plan_t *plan)
+{
+	int32_t err;
+	uint8_t i;
+
+	/*range check*/
+	if (device == ADI_INVALID_POINTER) {
+		return API_CMS_ERROR_INVALID_HANDLE_PTR;
+	}
+	if (plan == ADI_INVALID_POINTER) {
+		return API_CMS_ERROR_NULL_PARAM;
+	}
+	if (ref_ch > HMC7044_CLK_IN_ALL) {
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+
+	if (err = hmc7044_freq_plan_pll_set(device, ref_ch, ref_priority, plan), err != API_CMS_ERROR_OK)
+		return err;
 
 	/*output config*/
 	adi_hmc7044_op_driver_config_t hmc_driver_config;
@@ -492,21 +560,26 @@ int32_t adi_hmc7044_clk_config(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_
 	hmc_driver_config.dynamic_driver_en = 0;
 
 	for (i = 0; i < HMC7044_NOF_OP_CH; i++) {
-		if ((output_ch >> i & 0x1)) {
-			if (err = adi_hmc7044_output_config_set(device, i, HMC7044_OP_SIG_CH_DIV, fvco_clk_hz / output_clk_freq_hz[i], 0 , 1), err != API_CMS_ERROR_OK)
+		if (((output_ch >> i) & 0x1) && plan->ch_div[i]) {
+			if (err = adi_hmc7044_output_config_set(device, i, HMC7044_OP_SIG_CH_DIV, plan->ch_div[i], 0 , 1), err != API_CMS_ERROR_OK)
 				return err;
-			if (adi_hmc7044_output_driver_config_set(device, i, &hmc_driver_config), err != API_CMS_ERROR_OK)
+			if (err = adi_hmc7044_output_driver_config_set(device, i, &hmc_driver_config), err != API_CMS_ERROR_OK)
 				return err;
 		}
 	}
-	if (err = adi_hmc7044_output_config_set(device, 3, HMC7044_OP_SIG_CH_DIV, 0x40, 0, 1), err != API_CMS_ERROR_OK)
-		return err;
-	if (adi_hmc7044_output_driver_config_set(device, 3, &hmc_driver_config), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_output_config_set(device, 13, HMC7044_OP_SIG_CH_DIV, 0x40, 0, 1), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_output_driver_config_set(device, 13, &hmc_driver_config), err != API_CMS_ERROR_OK)
-		return err;
+	/*board defaults of /64 on channels 3 and 13, unless the plan drives them*/
+	if ((output_ch & HMC7044_OP_CH_3) == 0) {
+		if (err = adi_hmc7044_output_config_set(device, 3, HMC7044_OP_SIG_CH_DIV, 0x40, 0, 1), err != API_CMS_ERROR_OK)
+			return err;
+		if (err = adi_hmc7044_output_driver_config_set(device, 3, &hmc_driver_config), err != API_CMS_ERROR_OK)
+			return err;
+	}
+	if ((output_ch & HMC7044_OP_CH_13) == 0) {
+		if (err = adi_hmc7044_output_config_set(device, 13, HMC7044_OP_SIG_CH_DIV, 0x40, 0, 1), err != API_CMS_ERROR_OK)
+			return err;
+		if (err = adi_hmc7044_output_driver_config_set(device, 13, &hmc_driver_config), err != API_CMS_ERROR_OK)
+			return err;
+	}
 	if (err = adi_hmc7044_output_multi_slip_config_set(device, 13, 0, 0), err != API_CMS_ERROR_OK)
 		return err;
 	if (err = adi_hmc7044_vco_enable_set(device, 1), err != API_CMS_ERROR_OK)
@@ -516,10 +589,28 @@ int32_t adi_hmc7044_clk_config(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_
 	return API_CMS_ERROR_OK;
 }
 
+int32_t adi_hmc7044_clk_config(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_e ref_ch, uint8_t ref_priority[4], uint64_t ref_clk_freq_hz, uint64_t fvcxo_clk_freq_hz, uint16_t output_ch, uint64_t output_clk_freq_hz[14])
+{
+	adi_hmc7044_freq_plan_t plan;
+	int32_t err;
+
+	/*range check*/
+	if (device == ADI_INVALID_POINTER) {
+		return API_CMS_ERROR_INVALID_HANDLE_PTR;
+	}
+
+	if (ref_ch > HMC7044_CLK_IN_ALL) {
+		return API_CMS_ERROR_INVALID_HANDLE_PTR;
+	}
+
+	if (err = adi_hmc7044_freq_plan_solve(ref_clk_freq_hz, fvcxo_clk_freq_hz, output_ch, output_clk_freq_hz, &plan), err != API_CMS_ERROR_OK)
+		return err;
+	return adi_hmc7044_freq_plan_set(device, ref_ch, ref_priority, output_ch, &plan);
+}
+
 int32_t adi_hmc7044_pll_config(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_e ref_ch, uint64_t ref_clk_freq_hz, uint64_t fvcxo_clk_freq_hz, uint64_t fpfd1_freq_hz, uint64_t fvco_freq_hz){
+	adi_hmc7044_freq_plan_t plan;
 	int32_t err;
-	uint64_t flcm_clk_hz, pfd1_clk_hz, pfd2_clk_hz, vcxo_prescaler, pll2ref_clk_hz;
-	uint64_t R1, N1, N2, R2;
 	uint8_t  hmc_priority[] = { 0, 1, 2, 3 };
 
 	/*range check*/
@@ -539,89 +630,21 @@ int32_t adi_hmc7044_pll_config(adi_hmc7044_device_t *device, adi_hmc7044_clk_in_
 		return API_CMS_ERROR_INVALID_PARAM;
 	}
 
-	/*enable clkin*/
-	if (err = adi_hmc7044_input_reference_set(device, 0, IPBUFFER_INTERNAL_100_OHM_EN | IPBUFFER_AC_COUPLED_MODE_EN, (ref_ch & HMC7044_CLK_IN_0)), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_set(device, 1, IPBUFFER_INTERNAL_100_OHM_EN | IPBUFFER_AC_COUPLED_MODE_EN, (ref_ch & HMC7044_CLK_IN_1) >> 1), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_set(device, 2, IPBUFFER_INTERNAL_100_OHM_EN | IPBUFFER_AC_COUPLED_MODE_EN, (ref_ch & HMC7044_CLK_IN_2) >> 2), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_set(device, 3, IPBUFFER_INTERNAL_100_OHM_EN | IPBUFFER_AC_COUPLED_MODE_EN, (ref_ch & HMC7044_CLK_IN_3) >> 3), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_priority_set(device, hmc_priority, 4), err != API_CMS_ERROR_OK)
-		return err;
-
-	/*calculate fLCM, typical range to be 30~40 MHz*/
-	flcm_clk_hz = ref_clk_freq_hz;
-
-	/*scale flcm to 30-40 range*/
-	if (ref_clk_freq_hz > HMC7044_PLL1REF_CLK_FREQ_HZ_MAX || ref_clk_freq_hz < HMC7044_PLL1REF_CLK_FREQ_HZ_MIN) {
-		uint8_t div = ref_clk_freq_hz / HMC7044_PLL1REF_CLK_FREQ_HZ_MIN;
-		flcm_clk_hz = ref_clk_freq_hz / div;
-	}
-	/*calculate vcxo prescaler*/
-	if (fvcxo_clk_freq_hz % flcm_clk_hz != 0) {
-		return API_CMS_ERROR_ERROR;
+	if (fvco_freq_hz < HMC7044_VCO_CLK_FREQ_HZ_MIN || fvco_freq_hz > HMC7044_VCO_CLK_FREQ_HZ_MAX) {
+		return API_CMS_ERROR_INVALID_PARAM;
 	}
-	vcxo_prescaler = fvcxo_clk_freq_hz / flcm_clk_hz;
-
-	if (err = adi_hmc7044_input_reference_los_config_set(device, 7, 0, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_prescaler_config_set(device, 0, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_prescaler_config_set(device, 1, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_prescaler_config_set(device, 2, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_prescaler_config_set(device, 3, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_input_reference_oscin_prescaler_config_set(device, vcxo_prescaler), err != API_CMS_ERROR_OK)
-		return err;
 
-	/*calculate fPFD1*/
-	pfd1_clk_hz = gcd(flcm_clk_hz, fvcxo_clk_freq_hz);
-	if (fvcxo_clk_freq_hz / 65535 > pfd1_clk_hz) {
-		return API_CMS_ERROR_ERROR;
+	/*same solver as adi_hmc7044_clk_config, with the VCO fixed*/
+	memset(&plan, 0, sizeof(plan));
+	if ((fpfd1_freq_hz == 0) || (fpfd1_freq_hz > HMC7044_PD1_CLK_FREQ_HZ_MAX)) {
+		fpfd1_freq_hz = HMC7044_PD1_CLK_FREQ_HZ_MAX;
 	}
-
-	/* calculate pll2ref*/
-	pll2ref_clk_hz = fvcxo_clk_freq_hz <= 125e6 ? 2 * fvcxo_clk_freq_hz : fvcxo_clk_freq_hz;
-
-	/*calculate fpfd2*/
-	pfd2_clk_hz = gcd(fvco_freq_hz, pll2ref_clk_hz);
-
-	/*calculate R1, N1, R2, N2*/
-	R1 = flcm_clk_hz / pfd1_clk_hz;
-	N1 = fvcxo_clk_freq_hz / pfd1_clk_hz;
-	R2 = pll2ref_clk_hz / pfd2_clk_hz;
-	N2 = fvco_freq_hz / pfd2_clk_hz;
-
-	/*pll config*/
-	if (err = adi_hmc7044_pll1_config_set(device, R1, N1), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpi_config_set(device, 0, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpi_config_set(device, 1, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpi_config_set(device, 2, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpi_config_set(device, 3, 0), err != API_CMS_ERROR_OK)
+	if (err = hmc7044_pll1_solve(ref_clk_freq_hz, fvcxo_clk_freq_hz, fpfd1_freq_hz, &plan), err != API_CMS_ERROR_OK)
 		return err;
-	if (err = adi_hmc7044_gpo_config_set(device, 0, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpo_config_set(device, 1, 0), err != API_CMS_ERROR_OK)
+	if (err = hmc7044_pll2_solve(fvcxo_clk_freq_hz, fvco_freq_hz, fvco_freq_hz, fvco_freq_hz, 0, NULL, &plan), err != API_CMS_ERROR_OK)
 		return err;
-	if (err = adi_hmc7044_gpo_config_set(device, 2, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpo_config_set(device, 3, 0), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_pll2_config_set(device, 0x0, R2, N2), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_gpo_config_set(device, 0, 0x2b), err != API_CMS_ERROR_OK)
-		return err;
-	if (err = adi_hmc7044_output_performance_set(device, 1), err != API_CMS_ERROR_OK)
-		return err;
-	return API_CMS_ERROR_OK;
+
+	return hmc7044_freq_plan_pll_set(device, ref_ch, hmc_priority, &plan);
 }
 
 uint64_t gcd(uint64_t value1, uint64_t value2)
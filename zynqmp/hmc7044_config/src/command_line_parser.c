@@ -12,6 +12,7 @@
 #include <fcntl.h>
 #include <sys/time.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <stdint.h>
 #include <string.h>
 #include "spi.h"
@@ -22,11 +23,15 @@
 #include "adi_cms_api_common.h"
 #include "adi_cms_api_config.h"
 #include "adi_utils.h"
+#include "hmc7044_profile.h"
+#include "command_line_parser.h"
 #include "fpga_axi.h"
 
 
 
-int command_line_parser(int argc, char *argv[])
+#define HMC7044_DUMP_LAST_REG	0x153
+
+int command_line_parser(adi_hmc7044_device_t *hmc7044_dev, int argc, char *argv[])
 {
 	uint32_t spiAddressOffset = 0;
 	uint32_t axiAddress = 0;
@@ -43,7 +48,6 @@ int command_line_parser(int argc, char *argv[])
 	unsigned long int iqSampleCount;
 	int i;
 	int flags;
-	adi_hmc7044_device_t hmc7044_dev;
 
 	if (argc > 1)	// decode command line argument
 	{
@@ -145,82 +149,240 @@ int command_line_parser(int argc, char *argv[])
         #endif
 		if (strcmp("clock_config", argv[1]) == 0)
         {
-			if (argc >= 3 && argc <= 4)
+			if (argc >= 3 && argc <= 5)
             {
-				FILE *fp;
 				int x;
 				char filename[120];
-				char str[1000];
 				char cmdOptionStr[80];
-				uint32_t addr;
-				uint32_t data;
-                uint8_t rdata;
+				hmc7044_profile_t profile;
 
                 // SPI readback
                 int debug = 0;
+                // only write registers that differ from the device
+                int diff = 0;
 
 				for (x=0; x<argc; x++)
 				  printf("***%s***\n", argv[x]);  
 				sscanf(argv[2], "%s", filename);
-				if (argc == 4) {
-					sscanf(argv[3], "%s", cmdOptionStr);
+				for (x = 3; x < argc; x++) {
+					int gpio;
+
+					sscanf(argv[x], "%s", cmdOptionStr);
 					if (strcmp(cmdOptionStr, "debug") == 0) {
 						debug = 1;
 					}
+					else if (strcmp(cmdOptionStr, "diff") == 0) {
+						diff = 1;
+					}
+					else if (sscanf(cmdOptionStr, "gpio=%d", &gpio) == 1) {
+						// GPO carrying PLL2 lock wired to this sysfs GPIO
+						hmc7044_lock_gpio_set(gpio);
+					}
 				}
 
-				fp = fopen(filename, "r");
-				if (fp == NULL){
-					printf("Could not open file %s",filename);
+				// compiled profile, or a GUI script parsed on the fly
+				if (hmc7044_profile_load(filename, &profile) != API_CMS_ERROR_OK) {
 					return -1;
 				}
-				while (fgets(str, 1000, fp) != NULL)
-                {
-					if (strncmp(str, "dut.write", 9) == 0)
-                    {
-						sscanf(str, "dut.write(%x, %x)" ,&addr, &data);
-						hmc7044_spi_reg_set(&hmc7044_dev, addr, data);
-						if (debug == 1) {
-							// read data from addr
-							hmc7044_spi_reg_get(&hmc7044_dev, addr, &rdata);
-                            if( data != rdata ) {
-                                printf("readback error: ADDR=[0x%04X], RVAL=[0x%02X] != VAL=[0x%02X]\n", addr, data, rdata);
-                            }
-						}
+				printf("%s: [%u] entries%s\n", filename, profile.hdr.count,
+					(profile.hdr.flags & HMC7044_PROFILE_FLAG_REDUCED) ? " (reduced)" : "");
+
+				hmc7044_profile_t delta;
+				hmc7044_profile_t *program = &profile;
+				if (diff) {
+					int16_t image[HMC7044_PROFILE_NOF_REGS];
+					uint32_t changed, actions;
+
+					errorFlag = hmc7044_profile_read_image(hmc7044_dev, &profile, image);
+					if (errorFlag == API_CMS_ERROR_OK) {
+						errorFlag = hmc7044_profile_diff(&profile, image, &delta, &changed, &actions);
+					}
+					if (errorFlag != API_CMS_ERROR_OK) {
+						printf("error: failed to compare %s with the device [%d]\n", filename, errorFlag);
+						hmc7044_profile_free(&profile);
+						return -1;
+					}
+					printf("diff: [%u] registers changed, restart [%s], pll [%s]\n", changed,
+						(actions & HMC7044_PROFILE_DIFF_RESTART) ? "yes" : "no",
+						(actions & HMC7044_PROFILE_DIFF_PLL) ? "yes" : "no");
+					program = &delta;
+				}
+
+				// the profile ends with the divider restart and PLL2 lock wait
+				errorFlag = hmc7044_profile_apply(hmc7044_dev, program);
+				if (program == &delta) {
+					hmc7044_profile_free(&delta);
+				}
+				if ((errorFlag == API_CMS_ERROR_OK) && debug) {
+					// one readback pass over the whole profile
+					uint32_t checked, mismatches;
+					errorFlag = hmc7044_profile_verify(hmc7044_dev, &profile, &checked, &mismatches);
+					if (errorFlag == API_CMS_ERROR_OK) {
+						printf("verify: [%u] of [%u] registers match\n", checked - mismatches, checked);
 					}
 				}
-				fclose(fp);
-
-                //https://ez.analog.com/clock_and_timing/f/q-a/19676/hmc7044-pll2-not-locking
-                //https://ez.analog.com/clock_and_timing/f/q-a/19761/hmc7044-defaults-clock-outputs-after-reset
-
-                // restart divider amd state machine
-                hmc7044_spi_reg_get(&hmc7044_dev, 0x1, &rdata);
-                rdata |= 0x2;
-                hmc7044_spi_reg_set(&hmc7044_dev, 0x1, rdata);
-                hmc7044_spi_reg_get(&hmc7044_dev, 0x1, &rdata);
-                rdata &= ~0x2;
-                hmc7044_spi_reg_set(&hmc7044_dev, 0x1, rdata);
-
-                usleep(250000);
-                hmc7044_spi_reg_get(&hmc7044_dev, 0x7D, &rdata);
-                if( !(rdata & 0x1) ){
-                    printf("PLL2 failed to lock: [0x%02X]\n", rdata);
-                    return -1;
-                }
-                printf("PLL2 locked! [0x%02X]\n", rdata);
+				hmc7044_profile_free(&profile);
+				if (errorFlag == API_CMS_ERROR_PLL_NOT_LOCKED) {
+					printf("PLL2 failed to lock\n");
+					return -1;
+				}
+				else if (errorFlag != API_CMS_ERROR_OK) {
+					printf("error: failed to program %s [%d]\n", filename, errorFlag);
+					return -1;
+				}
+                printf("PLL2 locked!\n");
 			}
 			else if (argc == 2) {
 				printf("Usage:\n");
 				printf("./spi_test clock_config [filename]\n");
-				printf("To take a configuration file from the HMC7044 GUI and program the HMC7044 OR\n");
+				printf("To take a configuration file from the HMC7044 GUI (or a profile built with\n");
+				printf("hmc7044_profile_compile) and program the HMC7044 OR\n");
 				printf("./spi_test clock_config [filename] debug\n");
-				printf("To do the same but print the writes and read back from the register\n");
+				printf("To do the same and then read back every register and report mismatches OR\n");
+				printf("./spi_test clock_config [filename] diff\n");
+				printf("To read back the device and only write the registers that differ\n");
+				printf("Any of the above can add gpio=[n] to wake the PLL2 lock wait on the rising\n");
+				printf("edge of sysfs GPIO n when an HMC7044 GPO carrying the lock status is wired to it\n");
+				printf("Put --spi=spidev, --spi=spidev-batch (default) or --spi=emu[:lock_us] before the\n");
+				printf("command to pick the SPI transport, emu being an in-memory HMC7044 for PC testing\n");
+				printf("and --stats (or --stats=json) to print SPI call latencies, bytes, sleeps and\n");
+				printf("lock wait retries at exit\n");
 			}
 			else {
 				printf("Incorrect num of arguments\n");
 			}
 		}
+		else if (strcmp("clock_verify", argv[1]) == 0)
+        {
+			if (argc == 3)
+			{
+				hmc7044_profile_t profile;
+				uint32_t checked, mismatches;
+
+				if (hmc7044_profile_load(argv[2], &profile) != API_CMS_ERROR_OK) {
+					return -1;
+				}
+				errorFlag = hmc7044_profile_verify(hmc7044_dev, &profile, &checked, &mismatches);
+				hmc7044_profile_free(&profile);
+				if (errorFlag != API_CMS_ERROR_OK) {
+					printf("error: register read failed [%d]\n", errorFlag);
+					return -1;
+				}
+				printf("verify: [%u] of [%u] registers match\n", checked - mismatches, checked);
+				return mismatches ? -1 : 0;
+			}
+			else {
+				printf("Usage:\n");
+				printf("./spi_test clock_verify [filename]\n");
+				printf("To compare the HMC7044 registers with a GUI script or profile in one pass\n");
+				return -1;
+			}
+		}
+		else if (strcmp("clock_dump", argv[1]) == 0)
+        {
+			// register snapshot in GUI script form, e.g. reset defaults for hmc7044_profile_compile -d
+			uint32_t first = 0x0;
+			uint32_t last = HMC7044_DUMP_LAST_REG;
+			uint8_t regs[HMC7044_DUMP_LAST_REG + 1];
+
+			if (argc == 4) {
+				sscanf(argv[2], "%x", &first);
+				sscanf(argv[3], "%x", &last);
+			}
+			else if (argc != 2) {
+				printf("Usage:\n");
+				printf("./spi_test clock_dump [first last]\n");
+				printf("To print HMC7044 registers (hex addresses) as dut.write() lines\n");
+				return -1;
+			}
+			if (first > last || last > HMC7044_DUMP_LAST_REG) {
+				printf("error: register range must be within 0x0-0x%X\n", HMC7044_DUMP_LAST_REG);
+				return -1;
+			}
+			if (hmc7044_spi_reg_block_get(hmc7044_dev, first, regs, last - first + 1) != API_CMS_ERROR_OK) {
+				printf("error: register read failed\n");
+				return -1;
+			}
+			for (addr = first; addr <= last; addr++) {
+				printf("dut.write(0x%X, 0x%X)\n", addr, regs[addr - first]);
+			}
+		}
+		else if (strcmp("clock_plan", argv[1]) == 0)
+        {
+			// solve the divider plan for a target spec and program it, no GUI script needed
+			uint64_t ref_hz, vcxo_hz;
+			uint64_t out_hz[HMC7044_NOF_OP_CH] = {0};
+			uint8_t priority[] = { 0, 1, 2, 3 };
+			adi_hmc7044_freq_plan_t plan;
+			struct timespec t0, t1;
+			uint32_t lock_time_us;
+			uint16_t output_ch = 0;
+			unsigned ch;
+			double hz;
+			int dry = 0;
+
+			if (argc < 5) {
+				printf("Usage:\n");
+				printf("./spi_test clock_plan [ref_hz] [vcxo_hz] [ch]=[hz] ... [dry]\n");
+				printf("To solve R1/N1/R2/N2, the VCO and the channel dividers for the given output\n");
+				printf("frequencies (e.g. 0=500e6 2=250e6), highest PLL2 PFD first, and program the\n");
+				printf("HMC7044 from CLKIN0; dry only prints the plan\n");
+				return -1;
+			}
+			ref_hz = (uint64_t)(strtod(argv[2], NULL) + 0.5);
+			vcxo_hz = (uint64_t)(strtod(argv[3], NULL) + 0.5);
+			for (x = 4; x < argc; x++) {
+				if (strcmp(argv[x], "dry") == 0) {
+					dry = 1;
+				}
+				else if ((sscanf(argv[x], "%u=%lf", &ch, &hz) == 2) && (ch < HMC7044_NOF_OP_CH) && (hz > 0)) {
+					out_hz[ch] = (uint64_t)(hz + 0.5);
+					output_ch |= 1 << ch;
+				}
+				else {
+					printf("error: [%s] is not [ch]=[hz] with ch 0-%d\n", argv[x], HMC7044_NOF_OP_CH - 1);
+					return -1;
+				}
+			}
+
+			clock_gettime(CLOCK_MONOTONIC, &t0);
+			errorFlag = adi_hmc7044_freq_plan_solve(ref_hz, vcxo_hz, output_ch, out_hz, &plan);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			if (errorFlag != API_CMS_ERROR_OK) {
+				printf("error: no frequency plan for these frequencies [%d]\n", errorFlag);
+				return -1;
+			}
+			printf("plan: solved in [%.1f us]\n", (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3);
+			printf("plan: pll1 ref /%u vcxo /%u lcm [%.6f MHz], R1 [%u] N1 [%u], pfd1 [%.6f MHz]\n",
+				plan.ref_prescaler, plan.vcxo_prescaler, plan.lcm_freq_hz / 1e6, plan.r1_div, plan.n1_div,
+				plan.pfd1_freq_hz / 1e6);
+			printf("plan: pll2 doubler [%s] R2 [%u] N2 [%u], pfd2 [%.6f MHz], vco [%.6f MHz]\n",
+				plan.pll2_freq_dbl_en ? "on" : "off", plan.r2_div, plan.n2_div, plan.pfd2_freq_hz / 1e6,
+				plan.vco_freq_hz / 1e6);
+			for (i = 0; i < HMC7044_NOF_OP_CH; i++) {
+				if (plan.ch_div[i]) {
+					printf("plan: ch%d [%.6f MHz] = vco / %u\n", i, out_hz[i] / 1e6, plan.ch_div[i]);
+				}
+			}
+			if (dry) {
+				return 0;
+			}
+
+			errorFlag = adi_hmc7044_freq_plan_set(hmc7044_dev, HMC7044_CLK_IN_0, priority, output_ch, &plan);
+			if (errorFlag == API_CMS_ERROR_OK) {
+				errorFlag = hmc7044_wait_lock(hmc7044_dev, HMC7044_PROFILE_LOCK_REG, HMC7044_PROFILE_LOCK_MASK,
+					HMC7044_PROFILE_LOCK_TIMEOUT_MS * 1000, &lock_time_us);
+			}
+			if (errorFlag == API_CMS_ERROR_PLL_NOT_LOCKED) {
+				printf("PLL2 failed to lock\n");
+				return -1;
+			}
+			else if (errorFlag != API_CMS_ERROR_OK) {
+				printf("error: failed to program the plan [%d]\n", errorFlag);
+				return -1;
+			}
+			printf("PLL2 locked in [%u.%03u ms]\n", lock_time_us / 1000, lock_time_us % 1000);
+		}
 	}
 	return 0;
 }
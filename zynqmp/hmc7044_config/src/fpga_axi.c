@@ -73,6 +73,136 @@ int32_t fpgaAxiReadWrite(char *uiod, uint32_t map_size, uint32_t count, uint32_t
     return(EXIT_SUCCESS);
 }
 
+/////////////////////////////////
+// Region handle
+
+static const char *s_mem_dev = FPGA_AXI_MEM_DEV;
+
+/**
+ * \brief fpgaAxiSetMemDevice selects the file mapped for physical memory
+ * @param path is the device (default /dev/mem) or a file-backed stand-in for off-target testing
+ */
+void fpgaAxiSetMemDevice(const char *path)
+{
+	s_mem_dev = path ? path : FPGA_AXI_MEM_DEV;
+}
+
+/**
+ * \brief fpgaAxiRegionOpen maps an AXI IP register window once for repeated access
+ * @param region is the handle to initialize
+ * @param physical_address is the absolute address of the window, need not be page aligned
+ * @param size is the window size in bytes
+ * @return returns EXIT_FAILURE if failure, EXIT_SUCCESS if successful
+ */
+int32_t fpgaAxiRegionOpen(fpga_axi_region_t *region, uint32_t physical_address, uint32_t size)
+{
+	int			fd;
+	void		*ptr;
+	uint32_t	page_size = sysconf(_SC_PAGESIZE);
+	uint32_t	page_addr;
+	uint32_t	page_offset;
+
+	region->base = NULL;
+	region->map = NULL;
+	region->map_size = 0;
+
+	if (size == 0)
+	{
+		printf("error: empty AXI region at 0x%08X\n", physical_address);
+		return(EXIT_FAILURE);
+	}
+
+	fd = open(s_mem_dev, O_RDWR | O_SYNC);
+	if (fd < 0)
+	{
+		perror("Error opening /dev/mem ");
+		return(EXIT_FAILURE);
+	}
+
+	// base address must be on page boundary of page_size (typically=0x1000)
+	page_addr	= (physical_address & ~(page_size-1));
+	page_offset	= (physical_address & (page_size-1));
+	region->map_size = ((size_t)page_offset + size + page_size - 1) & ~((size_t)page_size - 1);
+
+	ptr = mmap(NULL, region->map_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, page_addr);
+	close(fd);	// the mapping stays valid
+	if (ptr == MAP_FAILED)
+	{
+		perror("Error mmap returned error");
+		region->map_size = 0;
+		return(EXIT_FAILURE);
+	}
+
+	region->map = ptr;
+	region->base = (volatile uint8_t *)ptr + page_offset;
+	region->phys_addr = physical_address;
+	region->size = size;
+	return(EXIT_SUCCESS);
+}
+
+/**
+ * \brief fpgaAxiRegionClose unmaps a region opened with fpgaAxiRegionOpen
+ * @param region is the handle to release, safe to call twice
+ */
+void fpgaAxiRegionClose(fpga_axi_region_t *region)
+{
+	if (region->map)
+	{
+		munmap(region->map, region->map_size);
+	}
+	region->base = NULL;
+	region->map = NULL;
+	region->map_size = 0;
+}
+
+/**
+ * \brief fpgaAxiRegionReadBlock reads consecutive 32-bit registers from a mapped region
+ * @param region is an open region handle
+ * @param reg_addr_offset is the (byte) offset of the first register from the region base
+ * @param regCount is the number of uint32_t wide reads
+ * @param data is a uint32_t pointer for read capture
+ * @return returns EXIT_FAILURE if the span is outside the region, EXIT_SUCCESS if successful
+ */
+int32_t fpgaAxiRegionReadBlock(const fpga_axi_region_t *region, uint32_t reg_addr_offset, uint32_t regCount, uint32_t *data)
+{
+	uint32_t i;
+
+	if (!region->base || (uint64_t)reg_addr_offset + (uint64_t)regCount * 4 > region->size)
+	{
+		printf("error: AXI read 0x%X+%u outside region 0x%08X\n", reg_addr_offset, regCount, region->phys_addr);
+		return(EXIT_FAILURE);
+	}
+	for (i = 0; i < regCount; i++)
+	{
+		data[i] = fpgaAxiRegionRead32(region, reg_addr_offset + (i*4));
+	}
+	return(EXIT_SUCCESS);
+}
+
+/**
+ * \brief fpgaAxiRegionWriteBlock writes consecutive 32-bit registers in a mapped region
+ * @param region is an open region handle
+ * @param reg_addr_offset is the (byte) offset of the first register from the region base
+ * @param regCount is the number of uint32_t wide writes
+ * @param data is a uint32_t pointer for write source
+ * @return returns EXIT_FAILURE if the span is outside the region, EXIT_SUCCESS if successful
+ */
+int32_t fpgaAxiRegionWriteBlock(const fpga_axi_region_t *region, uint32_t reg_addr_offset, uint32_t regCount, const uint32_t *data)
+{
+	uint32_t i;
+
+	if (!region->base || (uint64_t)reg_addr_offset + (uint64_t)regCount * 4 > region->size)
+	{
+		printf("error: AXI write 0x%X+%u outside region 0x%08X\n", reg_addr_offset, regCount, region->phys_addr);
+		return(EXIT_FAILURE);
+	}
+	for (i = 0; i < regCount; i++)
+	{
+		fpgaAxiRegionWrite32(region, reg_addr_offset + (i*4), data[i]);
+	}
+	return(EXIT_SUCCESS);
+}
+
 /////////////////////////////////
 // New
 
@@ -87,25 +217,23 @@ int32_t fpgaAxiReadWrite(char *uiod, uint32_t map_size, uint32_t count, uint32_t
  */
 int32_t fpgaAxiReadPhysicalMemory(uint32_t physical_address_base, uint32_t regCount, uint32_t reg_addr_offset, uint32_t *data)
 	{
-		int 		fd;
-		unsigned long int	x;
-		void 		*ptr;
-		// volatile void 		*ptr;
-		unsigned 	page_addr;
-		unsigned 	page_size = sysconf(_SC_PAGESIZE);
-		uint32_t	regData;
-		int 		regCnt = 0;
-
+		fpga_axi_region_t	region;
+		int32_t				status;
 
+		if (regCount == 0)
+		{
+			return(EXIT_SUCCESS);
+		}
 
-		for (x=0;x<regCount;(++x))
+		// one mapping for the whole span
+		if (fpgaAxiRegionOpen(&region, physical_address_base + reg_addr_offset, regCount * 4) != EXIT_SUCCESS)
 		{
-			fpgaAxiRegRead(physical_address_base, (reg_addr_offset+regCnt), &(data[x]));
-			// printf("x=0x%04X, addr 0x%X = 0x%08X\n", x, (physical_address_base+reg_addr_offset+regCnt), data[x]);
-			regCnt += 4;
+			return(EXIT_FAILURE);
 		}
+		status = fpgaAxiRegionReadBlock(&region, 0, regCount, data);
+		fpgaAxiRegionClose(&region);
 
-		return(EXIT_SUCCESS);
+		return(status);
 	}
 
 /**
@@ -118,38 +246,18 @@ int32_t fpgaAxiReadPhysicalMemory(uint32_t physical_address_base, uint32_t regCo
  */
 int32_t fpgaAxiReadPhysicalMemoryPage(uint32_t page_addr, uint32_t *data)
 {
-	int fd;
-	unsigned long int x;
-	void *ptr;
-	unsigned page_size = sysconf(_SC_PAGESIZE);
-
-	fd = open("/dev/mem",O_RDWR | O_SYNC);
-	if (fd < 1)
-	{
-		perror("Error opening /dev/mem ");
-		close(fd);
-		return(EXIT_FAILURE);
-	}
+	fpga_axi_region_t	region;
+	int32_t				status;
+	unsigned			page_size = sysconf(_SC_PAGESIZE);
 
-	ptr = mmap(NULL,page_size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,(page_addr & ~(page_size-1)));
-	if (ptr == MAP_FAILED)
+	if (fpgaAxiRegionOpen(&region, (page_addr & ~(page_size-1)), page_size) != EXIT_SUCCESS)
 	{
-		perror ("Error mmap returned error");
-		close(fd);
 		return(EXIT_FAILURE);
 	}
+	status = fpgaAxiRegionReadBlock(&region, 0, page_size / sizeof(uint32_t), data);
+	fpgaAxiRegionClose(&region);
 
-	uint32_t page_reg_count = page_size / sizeof(uint32_t);
-	for (int x = 0; x < page_reg_count; x++)
-	{
-		uint32_t reg_num = x * 4;
-		data[x] = *((uint32_t *)(ptr + reg_num));
-	}
-
-	close(fd);
-	munmap(ptr, page_size);
-
-	return(0);
+	return(status);
 }
 
 /**
@@ -162,54 +270,27 @@ int32_t fpgaAxiReadPhysicalMemoryPage(uint32_t page_addr, uint32_t *data)
  */
 int32_t fpgaAxiWritePhysicalMemory(uint32_t physical_address, uint32_t range, uint32_t reg_addr_offset, uint32_t *data)
 {
-	int 		fd;
-	void 		*ptr;
-	uint32_t 	page_addr;
-	uint32_t 	page_size = sysconf(_SC_PAGESIZE);
-	uint32_t i;
+	fpga_axi_region_t	region;
+	int32_t				status;
 
-    /* Open the UIO device file for reading */
-	fd = open("/dev/mem",O_RDWR | O_SYNC);
-	if (fd < 1)
+	if (range == 0)
 	{
-		perror("Error opening /dev/mem ");
-		close(fd);
-		return(EXIT_FAILURE);
+		return(EXIT_SUCCESS);
 	}
 
-    /* reg_addr_offset must be page aligned */
-	// calculate base and reg_addr_offset, base address must be on page boundary of page_size (typically=0x1000)
-	page_addr	= (physical_address & ~(page_size-1));
-	reg_addr_offset = reg_addr_offset + (physical_address&(page_size-1));
-	ptr = mmap(NULL,page_size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,page_addr);
-
-    if (ptr == MAP_FAILED)
-    {
-        munmap(ptr, page_size);
-        close(fd);
-        perror("Error mapping the file ");
-        return(EXIT_FAILURE);
-    }
-    else
-    {
-        for(i = 0; i < range; i++)
-        {
-            *((uint32_t *)(ptr + reg_addr_offset)) = data[i];  // write data register
-			// data[i] = *((uint32_t *)(ptr + reg_addr_offset));  // read data register
-			// printf("reg addr 0x%08X = 0x%08X\n", (ptr + reg_addr_offset), data[i]);
-            reg_addr_offset += 0x00000004;
-        }
-
-        /* clean up */
-        munmap(ptr, page_size);
-        close(fd);
-    }
+	if (fpgaAxiRegionOpen(&region, physical_address + reg_addr_offset, range * 4) != EXIT_SUCCESS)
+	{
+		return(EXIT_FAILURE);
+	}
+	status = fpgaAxiRegionWriteBlock(&region, 0, range, data);
+	fpgaAxiRegionClose(&region);
 
-    return(EXIT_SUCCESS);
+	return(status);
 }
 
 /**
- * \brief fpgaAxiRegRead function for reading from AXI mapped FPGA space in PL
+ * \brief fpgaAxiRegRead function for reading from AXI mapped FPGA space in PL.
+ * Maps the register for a single access, use an fpga_axi_region_t for anything repeated.
  * @param physical_address is the absolute address in the ARM PS physical memory space
  * @param reg_addr_offset is the FPGA space (byte) offset address
  * @param data is a uint32_t pointer for read capture or write source
@@ -219,37 +300,14 @@ int32_t fpgaAxiWritePhysicalMemory(uint32_t physical_address, uint32_t range, ui
 	// Read physical AXI PL memory
 	uint32_t fpgaAxiRegRead(uint32_t physical_address,uint32_t reg_addr_offset, uint32_t *regData)
 	{
-		int 		fd;
-		unsigned long int	x;
-		void 		*ptr;
-		uint32_t 	page_addr;
-		uint32_t 	page_size = sysconf(_SC_PAGESIZE);
-		//uint32_t	regData;
-
-		fd = open("/dev/mem",O_RDWR | O_SYNC);
-		if (fd < 1)
-		{
-			perror("Error opening /dev/mem ");
-			close(fd);
-			return(EXIT_FAILURE);
-		}
-
-		// calculate base and offset, base address must be on page boundary of page_size (typically=0x1000)
-		page_addr	= (physical_address & ~(page_size-1));
-		reg_addr_offset = reg_addr_offset + (physical_address&(page_size-1));
-		ptr = mmap(NULL,page_size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,(page_addr & ~(page_size-1)));
+		fpga_axi_region_t	region;
 
-		if (ptr == MAP_FAILED)
+		if (fpgaAxiRegionOpen(&region, physical_address + reg_addr_offset, 4) != EXIT_SUCCESS)
 		{
-			perror ("Error mmap returned error");
-			close(fd);
 			return(EXIT_FAILURE);
 		}
-
-		*regData = *((uint32_t *)(ptr+reg_addr_offset));
-
-		munmap(ptr, page_size);
-		close(fd);
+		*regData = fpgaAxiRegionRead32(&region, 0);
+		fpgaAxiRegionClose(&region);
 		return(EXIT_SUCCESS);
 	}
 
@@ -258,42 +316,14 @@ int32_t fpgaAxiWritePhysicalMemory(uint32_t physical_address, uint32_t range, ui
 	// Write physical AXI PL reg memory
 	int32_t fpgaAxiRegWrite(uint32_t physical_address,uint32_t reg_addr_offset, uint32_t w_data)
 	{
-		int 		fd;
-		unsigned long int	x;
-		void 		*ptr;		// volatile void 		*ptr;
-		uint32_t 	page_addr;
-		uint32_t 	page_size = sysconf(_SC_PAGESIZE);
-		uint32_t	regData;
-
-		fd = open("/dev/mem",O_RDWR | O_SYNC);
-		if (fd < 1)
-		{
-			perror("Error opening /dev/mem ");
-			close(fd);
-			return(EXIT_FAILURE);
-		}
-
-		// calculate base and offset, base address must be on page boundary of page_size (typically=0x1000)
-		page_addr	= (physical_address & ~(page_size-1));
-		reg_addr_offset = reg_addr_offset + (physical_address&(page_size-1));
+		fpga_axi_region_t	region;
 
-		//printf("page_size = 0x%X\n", page_size);
-		//printf("w_data = 0x%X\n", w_data);
-
-		ptr = mmap(NULL,page_size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,page_addr);
-		if (ptr == MAP_FAILED)
+		if (fpgaAxiRegionOpen(&region, physical_address + reg_addr_offset, 4) != EXIT_SUCCESS)
 		{
-			perror ("Error mmap returned error");
-			close(fd);
 			return(EXIT_FAILURE);
 		}
-
-		*((uint32_t *)(ptr+reg_addr_offset))= w_data;	// write the axi register
-		//regData = *((uint32_t *)(ptr+reg_addr_offset));
-		//printf("w_data = 0x%08X, addr 0x%X = 0x%08X\n", w_data, (page_addr+reg_addr_offset), regData);
-
-		munmap(ptr, page_size);
-		close(fd);
+		fpgaAxiRegionWrite32(&region, 0, w_data);	// write the axi register
+		fpgaAxiRegionClose(&region);
 		return(EXIT_SUCCESS);
 	}
 
@@ -307,68 +337,75 @@ int32_t fpgaAxiWritePhysicalMemory(uint32_t physical_address, uint32_t range, ui
 	{
 		int x;
 		uint32_t	data[0x1000];
-		uint32_t	regData;
+		fpga_axi_region_t	region;
+
+		// one mapping for the whole IP register window
+		if (fpgaAxiRegionOpen(&region, jesd_phy_physical_address_base, FPGA_AXI_JESD_WINDOW_SIZE) != EXIT_SUCCESS)
+		{
+			return;
+		}
 
 		printf("JESD PHY Base Regs:\n");
-		fpgaAxiReadPhysicalMemory(jesd_phy_physical_address_base, 16, 0, data);
+		fpgaAxiRegionReadBlock(&region, 0, 16, data);
 		for (x=0;x<16;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X,	%d\n", (jesd_phy_physical_address_base + (x*4)), data[x], data[x]);
 			data[x] = x;
 		}
 		printf("JESD PHY PLL Status:\n");
-		fpgaAxiReadPhysicalMemory((jesd_phy_physical_address_base), 1, 0x80, data);
+		fpgaAxiRegionReadBlock(&region, 0x80, 1, data);
 			printf("reg addr 0x%08X = 0x%08X,	%d\n", (jesd_phy_physical_address_base + 0x80), data[0], data[0]);
 		printf("JESD PHY Clocks:\n");
-		fpgaAxiReadPhysicalMemory((jesd_phy_physical_address_base), 21, 0x90, data);
+		fpgaAxiRegionReadBlock(&region, 0x90, 21, data);
 		for (x=0;x<21;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X,	%d\n", (jesd_phy_physical_address_base + 0x90 + (x*4)), data[x], data[x]);
 			data[x] = x;
 		}
 		printf("JESD PHY Common DRP Control:\n");
-		fpgaAxiReadPhysicalMemory(jesd_phy_physical_address_base, 7, 0x104, data);
+		fpgaAxiRegionReadBlock(&region, 0x104, 7, data);
 		for (x=0;x<7;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X,	%d\n", (jesd_phy_physical_address_base + 0x104 + (x*4)), data[x], data[x]);
 			data[x] = x;
 		}
 		printf("JESD PHY Transceiver DRP Control:\n");
-		fpgaAxiReadPhysicalMemory(jesd_phy_physical_address_base, 7, 0x204, data);
+		fpgaAxiRegionReadBlock(&region, 0x204, 7, data);
 		for (x=0;x<7;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X,	%d\n", (jesd_phy_physical_address_base + 0x204 + (x*4)), data[x], data[x]);
 			data[x] = x;
 		}
 		printf("JESD PHY Common QPLL Control:\n");
-		fpgaAxiReadPhysicalMemory(jesd_phy_physical_address_base, 2, 0x304, data);
+		fpgaAxiRegionReadBlock(&region, 0x304, 2, data);
 		for (x=0;x<2;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X,	%d\n", (jesd_phy_physical_address_base + 0x304 + (x*4)), data[x], data[x]);
 			data[x] = x;
 		}
 		printf("JESD PHY Transceiver Control Bank 1:\n");
-		fpgaAxiReadPhysicalMemory(jesd_phy_physical_address_base, 9, 0x404, data);
+		fpgaAxiRegionReadBlock(&region, 0x404, 9, data);
 		for (x=0;x<9;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X,	%d\n", (jesd_phy_physical_address_base + 0x404 + (x*4)), data[x], data[x]);
 			data[x] = x;
 		}
 		printf("JESD PHY Transceiver Control Bank 2:\n");
-		fpgaAxiReadPhysicalMemory((jesd_phy_physical_address_base+0x400), 4, 0x104, data);
+		fpgaAxiRegionReadBlock(&region, 0x504, 4, data);
 		for (x=0;x<4;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X,	%d\n", (jesd_phy_physical_address_base + 0x504 + (x*4)), data[x], data[x]);
 			data[x] = x;
 		}
 		printf("JESD PHY Transceiver Control Bank 3:\n");
-		fpgaAxiReadPhysicalMemory(jesd_phy_physical_address_base, 4, 0x604, data);
+		fpgaAxiRegionReadBlock(&region, 0x604, 4, data);
 		for (x=0;x<4;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X,	%d\n", (jesd_phy_physical_address_base + 0x604 + (x*4)), data[x], data[x]);
 			data[x] = x;
 		}
-		
+
+		fpgaAxiRegionClose(&region);
 		return;
 	}
 
@@ -378,52 +415,59 @@ int32_t fpgaAxiWritePhysicalMemory(uint32_t physical_address, uint32_t range, ui
 	{
 		int x;
 		uint32_t	data[0x1000];
-		uint32_t	regData;
+		fpga_axi_region_t	region;
+
+		// one mapping for the whole IP register window
+		if (fpgaAxiRegionOpen(&region, jesd_tx_physical_address_base, FPGA_AXI_JESD_WINDOW_SIZE) != EXIT_SUCCESS)
+		{
+			return;
+		}
 
 		printf("JESD TXRX Base Regs:\n");
-		fpgaAxiReadPhysicalMemory(jesd_tx_physical_address_base, 16, 0, data);
+		fpgaAxiRegionReadBlock(&region, 0, 16, data);
 		for (x=0;x<16;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X\n", (jesd_tx_physical_address_base + (x*4)), data[x]);
 			data[x] = x;
 		}
 		printf("JESD TXRX Lane 0-3 IDs:\n");
-		fpgaAxiReadPhysicalMemory((jesd_tx_physical_address_base), 4, 0x400, data);
+		fpgaAxiRegionReadBlock(&region, 0x400, 4, data);
 		for (x=0;x<4;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X\n", (jesd_tx_physical_address_base + 0x400 + (x*4)), data[x]);
 			data[x] = x;
 		}
 		printf("JESD TXRX Lane 0 ILA Config Data:\n");
-		fpgaAxiReadPhysicalMemory(jesd_tx_physical_address_base, 13, 0x800, data);
+		fpgaAxiRegionReadBlock(&region, 0x800, 13, data);
 		for (x=0;x<13;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X\n", (jesd_tx_physical_address_base + 0x800 + (x*4)), data[x]);
 			data[x] = x;
 		}
 		printf("JESD TXRX Lane 1 ILA Config Data:\n");
-		fpgaAxiReadPhysicalMemory(jesd_tx_physical_address_base, 13, 0x840, data);
+		fpgaAxiRegionReadBlock(&region, 0x840, 13, data);
 		for (x=0;x<13;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X\n", (jesd_tx_physical_address_base + 0x840 + (x*4)), data[x]);
 			data[x] = x;
 		}
 		printf("JESD TXRX Lane 2 ILA Config Data:\n");
-		fpgaAxiReadPhysicalMemory(jesd_tx_physical_address_base, 13, 0x880, data);
+		fpgaAxiRegionReadBlock(&region, 0x880, 13, data);
 		for (x=0;x<13;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X\n", (jesd_tx_physical_address_base + 0x880 + (x*4)), data[x]);
 			data[x] = x;
 		}
 		printf("JESD TXRX Lane 3 ILA Config Data:\n");
-		fpgaAxiReadPhysicalMemory(jesd_tx_physical_address_base, 13, 0x8C0, data);
+		fpgaAxiRegionReadBlock(&region, 0x8C0, 13, data);
 		for (x=0;x<13;++x)
 		{
 			printf("reg addr 0x%08X = 0x%08X\n", (jesd_tx_physical_address_base + 0x8C0 + (x*4)), data[x]);
 			data[x] = x;
 		}
 		printf("\n");
-		
+
+		fpgaAxiRegionClose(&region);
 		return;
 	}
 
@@ -0,0 +1,216 @@
+/*
+ * hmc7044_emu.c
+ *
+ * In-memory HMC7044 behind the SPI transport interface (--spi=emu), so
+ * clock_config, clock_verify and clock_dump run and can be timed on a PC.
+ *
+ * The model is a register file with the behaviour the tool depends on:
+ *  - the chip ID (0x78-0x7A) reads 0x045201
+ *  - the status block (HMC7044_PROFILE_RO_FIRST_REG..LAST_REG, the
+ *    range verify and diff skip) is read-only, writes are dropped
+ *  - a soft reset (0x0 bit 0) restores the reset state
+ *  - PLL2 reports lock in 0x7D bits 0 and 3 once lock_us has passed
+ *    since the last PLL2 configuration write, soft reset or divider
+ *    restart; a negative lock_us never locks
+ *
+ * Frames are decoded like the device: bit 7 of the first byte is the
+ * read flag, 13 address bits follow, one data byte per frame.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "spi_transport.h"
+#include "spi_stats.h"
+#include "hmc7044_reg.h"
+#include "hmc7044_profile.h"
+#include "adi_cms_api_common.h"
+
+#define HMC7044_EMU_NOF_REGS		0x200
+#define HMC7044_EMU_ALARM_REG		0x7D
+#define HMC7044_EMU_PLL2_LOCKED		0x01
+#define HMC7044_EMU_SYSREF_UNSYNCED	0x02
+#define HMC7044_EMU_PLLS_LOCKED		0x08
+#define HMC7044_EMU_PLL2_FIRST_REG	0x31
+#define HMC7044_EMU_PLL2_LAST_REG	0x37
+#define HMC7044_EMU_LOCK_US			3000	// default time to PLL2 lock
+
+typedef struct
+{
+	uint8_t		regs[HMC7044_EMU_NOF_REGS];
+	int32_t		lock_us;
+	uint64_t	lock_start_ns;			// last event that dropped lock
+} hmc7044_emu_t;
+
+static uint64_t hmc7044_emu_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void hmc7044_emu_reset(hmc7044_emu_t *emu)
+{
+	memset(emu->regs, 0, sizeof(emu->regs));
+	emu->regs[HMC7044_CHIP_ID_0_REG] = 0x01;
+	emu->regs[HMC7044_CHIP_ID_1_REG] = 0x52;
+	emu->regs[HMC7044_CHIP_ID_2_REG] = 0x04;
+	emu->lock_start_ns = hmc7044_emu_now_ns();
+}
+
+static uint8_t hmc7044_emu_read(hmc7044_emu_t *emu, uint16_t reg)
+{
+	uint8_t val;
+
+	if (reg >= HMC7044_EMU_NOF_REGS)
+	{
+		return 0;
+	}
+	if (reg != HMC7044_EMU_ALARM_REG)
+	{
+		return emu->regs[reg];
+	}
+
+	val = HMC7044_EMU_SYSREF_UNSYNCED;
+	if (emu->lock_us >= 0 && hmc7044_emu_now_ns() - emu->lock_start_ns >= (uint64_t)emu->lock_us * 1000)
+	{
+		val |= HMC7044_EMU_PLL2_LOCKED | HMC7044_EMU_PLLS_LOCKED;
+	}
+	return val;
+}
+
+static void hmc7044_emu_write(hmc7044_emu_t *emu, uint16_t reg, uint8_t val)
+{
+	if (reg >= HMC7044_EMU_NOF_REGS || HMC7044_PROFILE_REG_IS_RO(reg))
+	{
+		return;
+	}
+	if (reg == HMC7044_GLOBAL_SW_RESET_CTRL_REG && (val & HMC7044_SOFT_RESET))
+	{
+		hmc7044_emu_reset(emu);
+		return;
+	}
+	if ((reg >= HMC7044_EMU_PLL2_FIRST_REG && reg <= HMC7044_EMU_PLL2_LAST_REG) ||
+		(reg == HMC7044_GLOBAL_REQUEST_MODE_CTRL_REG && (val & HMC7044_RESET_DIV_FSM)))
+	{
+		emu->lock_start_ns = hmc7044_emu_now_ns();
+	}
+	emu->regs[reg] = val;
+}
+
+/**
+ * \brief One chip-select frame: instruction word, then data
+ */
+static void hmc7044_emu_frame(hmc7044_emu_t *emu, const uint8_t *in_data, uint8_t *out_data, uint32_t size_bytes)
+{
+	uint16_t reg;
+
+	if (out_data)
+	{
+		memset(out_data, 0, size_bytes);
+	}
+	if (size_bytes < 3)
+	{
+		return;
+	}
+	reg = ((in_data[0] & 0x1F) << 8) | in_data[1];
+	if (in_data[0] & 0x80)
+	{
+		if (out_data)
+		{
+			out_data[2] = hmc7044_emu_read(emu, reg);
+		}
+	}
+	else
+	{
+		hmc7044_emu_write(emu, reg, in_data[2]);
+	}
+}
+
+static int32_t hmc7044_emu_xfer(spi_transport_t *spi, uint8_t *in_data, uint8_t *out_data, uint32_t size_bytes)
+{
+	spi->stats.calls++;
+	hmc7044_emu_frame((hmc7044_emu_t *)spi->ctx, in_data, out_data, size_bytes);
+	return API_CMS_ERROR_OK;
+}
+
+static int32_t hmc7044_emu_write_batch(spi_transport_t *spi, const uint8_t *txbuf, uint32_t n_tx, uint32_t count,
+	const uint16_t *delay_us)
+{
+	uint32_t i;
+
+	spi->stats.calls++;
+	for (i = 0; i < count; i++)
+	{
+		hmc7044_emu_frame((hmc7044_emu_t *)spi->ctx, &txbuf[i * n_tx], NULL, n_tx);
+		// settle times are kept so bring-up timing stays representative
+		if (delay_us && delay_us[i])
+		{
+			spi_stats_usleep(delay_us[i]);
+		}
+	}
+	return API_CMS_ERROR_OK;
+}
+
+static int32_t hmc7044_emu_read_batch(spi_transport_t *spi, const uint8_t *txbuf, uint8_t n_tx, uint32_t count,
+	uint8_t *readdata)
+{
+	hmc7044_emu_t *emu = (hmc7044_emu_t *)spi->ctx;
+	uint32_t i;
+
+	if (n_tx < 1 || n_tx > 2)
+	{
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+	spi->stats.calls++;
+	for (i = 0; i < count; i++)
+	{
+		const uint8_t *tx = &txbuf[i * n_tx];
+		readdata[i] = hmc7044_emu_read(emu, (n_tx == 2) ? (((tx[0] & 0x1F) << 8) | tx[1]) : tx[0]);
+	}
+	return API_CMS_ERROR_OK;
+}
+
+/**
+ * \brief Emulated device in its reset state. options is the time to PLL2
+ * lock in microseconds, empty for the default.
+ */
+spi_transport_t *hmc7044_emu_open(const char *options, uint32_t spiClk_Hz)
+{
+	spi_transport_t *spi;
+	hmc7044_emu_t *emu;
+	char *end;
+	long lock_us = HMC7044_EMU_LOCK_US;
+
+	if (options && *options)
+	{
+		lock_us = strtol(options, &end, 0);
+		if (*end)
+		{
+			printf("error: emu lock time [%s] is not a number of microseconds\n", options);
+			return NULL;
+		}
+	}
+
+	spi = calloc(1, sizeof(*spi));
+	emu = calloc(1, sizeof(*emu));
+	if (spi == NULL || emu == NULL)
+	{
+		free(spi);
+		free(emu);
+		return NULL;
+	}
+	emu->lock_us = (int32_t)lock_us;
+	hmc7044_emu_reset(emu);
+
+	spi->name = "emu";
+	spi->ctx = emu;
+	spi->clk_hz = spiClk_Hz;
+	spi->xfer = hmc7044_emu_xfer;
+	spi->write_batch = hmc7044_emu_write_batch;
+	spi->read_batch = hmc7044_emu_read_batch;
+	return spi;
+}
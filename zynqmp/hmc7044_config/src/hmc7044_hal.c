@@ -14,13 +14,27 @@
 
 /*============= I N C L U D E S ============*/
 #include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include "adi_hmc7044.h"
 #include "hmc7044_hal.h"
-#include "spi.h"
+#include "hmc7044_reg.h"
+#include "spi_transport.h"
+#include "spi_stats.h"
+#include "timer.h"
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 
 /*============= D E F I N E S ==============*/
+/* lock poll interval, doubled after every miss */
+#define HMC7044_LOCK_POLL_MIN_US    50
+#define HMC7044_LOCK_POLL_MAX_US    5000
+
+#define HMC7044_GPIO_SYSFS_PATH     "/sys/class/gpio/gpio%d/%s"
+
+/* sysfs GPIO the lock status GPO is routed to, -1 to poll over SPI only */
+static int hmc7044_lock_gpio = -1;
 
 /*============= C O D E ====================*/
 int32_t hmc7044_hw_open(adi_hmc7044_device_t *device)
@@ -107,8 +121,27 @@ int32_t hmc7044_hw_reset(adi_hmc7044_device_t *device)
     return API_CMS_ERROR_OK;
 }
 
+/*
+ * Routes the HAL SPI traffic through a transport, which becomes
+ * hal_info.user_data for the single accesses and the batches alike.
+ */
+int32_t hmc7044_spi_transport_set(adi_hmc7044_device_t *device, spi_transport_t *spi)
+{
+    if (device == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_HANDLE_PTR;
+    }
+    if (spi == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_NULL_PARAM;
+    }
+    device->hal_info.user_data = spi;
+    device->hal_info.spi_xfer = spi_transport_xfer;
+
+    return API_CMS_ERROR_OK;
+}
+
 int32_t hmc7044_spi_reg_get(adi_hmc7044_device_t *device , uint32_t reg, uint8_t *data)
 {
+    uint64_t t0;
     int32_t err;
     uint8_t in_data[SPI_IN_OUT_BUFF_SZ] = {0};
     uint8_t out_data[SPI_IN_OUT_BUFF_SZ] = {0};
@@ -117,31 +150,30 @@ int32_t hmc7044_spi_reg_get(adi_hmc7044_device_t *device , uint32_t reg, uint8_t
         return API_CMS_ERROR_INVALID_HANDLE_PTR;
     }
 
-//    if (device->hal_info.spi_xfer == ADI_INVALID_POINTER) {
-//        return API_CMS_ERROR_INVALID_XFER_PTR;
-//    }
+    if (device->hal_info.spi_xfer == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_XFER_PTR;
+    }
     if (data == ADI_INVALID_POINTER) {
         return API_CMS_ERROR_NULL_PARAM;
     }
 
+    t0 = spi_stats_begin();
     in_data[0] = (((reg >> 8) & 0x1F) | 0x80);
     in_data[1] = (reg & 0xFF);
-//    err = device->hal_info.spi_xfer(device->hal_info.user_data, in_data, out_data, SPI_IN_OUT_BUFF_SZ);
-//    err = spi_transfer(device->hmc7044_spi, in_data, out_data, SPI_IN_OUT_BUFF_SZ);
-//    HAL_spiWrite(SPI0_SS_HMC7044, in_data, uint32_t n_tx)
-    HAL_spiRead(SPI0_SS_HMC7044, in_data, 2, out_data);
-    err = 0;
+    err = device->hal_info.spi_xfer(device->hal_info.user_data, in_data, out_data, SPI_IN_OUT_BUFF_SZ);
     if (err != API_CMS_ERROR_OK) {
         return API_CMS_ERROR_SPI_XFER;
     }
-    *data = out_data[0];
-    usleep(100);
+    *data = out_data[2];
+    spi_stats_usleep(100);
+    spi_stats_end(SPI_STAT_REG_GET, t0, SPI_IN_OUT_BUFF_SZ);
 
     return API_CMS_ERROR_OK;
 }
 
 int32_t hmc7044_spi_reg_set(adi_hmc7044_device_t *device, uint32_t reg, uint8_t data)
 {
+    uint64_t t0;
     int32_t err;
     uint8_t in_data[SPI_IN_OUT_BUFF_SZ] = {0};
     uint8_t out_data[SPI_IN_OUT_BUFF_SZ] = {0};
@@ -150,50 +182,443 @@ int32_t hmc7044_spi_reg_set(adi_hmc7044_device_t *device, uint32_t reg, uint8_t
         return API_CMS_ERROR_INVALID_HANDLE_PTR;
     }
 
-//    if (device->hal_info.spi_xfer == ADI_INVALID_POINTER) {
-//        return API_CMS_ERROR_INVALID_XFER_PTR;
-//    }
+    if (device->hal_info.spi_xfer == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_XFER_PTR;
+    }
     in_data[0] = ((reg >> 8) & 0x1F);
     in_data[1] = (reg & 0xFF);
     in_data[2] = data;
-//    err = device->hal_info.spi_xfer(device->hal_info.user_data, in_data, out_data, SPI_IN_OUT_BUFF_SZ);
-//    err = spi_transfer(device->hmc7044_spi, in_data, out_data, SPI_IN_OUT_BUFF_SZ);
-    HAL_spiWrite(SPI0_SS_HMC7044, in_data, 3);
-    err = 0;
+    t0 = spi_stats_begin();
+    err = device->hal_info.spi_xfer(device->hal_info.user_data, in_data, out_data, SPI_IN_OUT_BUFF_SZ);
     if (err != API_CMS_ERROR_OK) {
         return API_CMS_ERROR_SPI_XFER;
     }
-    usleep(100);
+    spi_stats_usleep(100);
+    spi_stats_end(SPI_STAT_REG_SET, t0, SPI_IN_OUT_BUFF_SZ);
+    return API_CMS_ERROR_OK;
+}
+
+/*
+ * Reads an arbitrary list of registers, queued into as few SPI transfers
+ * as the transport allows. The HMC7044 has no multi-byte streaming mode
+ * (the W1:W0 length bits must be zero), so every register is its own
+ * frame.
+ */
+int32_t hmc7044_spi_reg_list_get(adi_hmc7044_device_t *device,
+    const uint16_t *regs, uint8_t *data, uint32_t count)
+{
+    uint64_t t0;
+    uint8_t *tx;
+    uint32_t i;
+    int err;
+
+    if (device == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_HANDLE_PTR;
+    }
+    if ((regs == ADI_INVALID_POINTER) || (data == ADI_INVALID_POINTER)) {
+        return API_CMS_ERROR_NULL_PARAM;
+    }
+    if (device->hal_info.user_data == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_XFER_PTR;
+    }
+    if (count == 0) {
+        return API_CMS_ERROR_OK;
+    }
+
+    t0 = spi_stats_begin();
+    tx = malloc(count * 2);
+    if (tx == NULL) {
+        return API_CMS_ERROR_ERROR;
+    }
+    for (i = 0; i < count; i++) {
+        tx[i * 2 + 0] = ((regs[i] >> 8) & 0x1F);
+        tx[i * 2 + 1] = (regs[i] & 0xFF);
+    }
+    err = spi_transport_read_batch(device->hal_info.user_data, tx, 2, count, data);
+    free(tx);
+    spi_stats_end(SPI_STAT_REG_LIST_GET, t0, count * 3);
+    if (err != 0) {
+        return API_CMS_ERROR_SPI_XFER;
+    }
+
     return API_CMS_ERROR_OK;
 }
 
 int32_t hmc7044_spi_reg_block_get(adi_hmc7044_device_t *device,
     const uint16_t address, uint8_t *data, uint32_t count)
 {
+    uint16_t *regs;
+    uint32_t i;
     int err;
-    uint16_t i =0;
 
-    for (i = 0; i<count; i++) {
-        err = hmc7044_spi_reg_get(device, (address + i), &data[i]);
-        if (err != API_CMS_ERROR_OK) {
-            return err;
-        }
+    if (count == 0) {
+        return API_CMS_ERROR_OK;
+    }
+    regs = malloc(count * sizeof(uint16_t));
+    if (regs == NULL) {
+        return API_CMS_ERROR_ERROR;
+    }
+    for (i = 0; i < count; i++) {
+        regs[i] = address + i;
     }
+    err = hmc7044_spi_reg_list_get(device, regs, data, count);
+    free(regs);
 
-    return API_CMS_ERROR_OK;
+    return err;
+}
+
+/*
+ * Settle time the datasheet requires after a write before the next SPI
+ * access, 0 for ordinary configuration registers.
+ */
+static uint16_t hmc7044_reg_settle_us(uint16_t reg, uint8_t val)
+{
+    if ((reg == HMC7044_GLOBAL_SW_RESET_CTRL_REG) && (val & HMC7044_SOFT_RESET)) {
+        return HMC7044_SPI_RESET_PERIOD_US;
+    }
+    if ((reg == HMC7044_GLOBAL_REQUEST_MODE_CTRL_REG) && (val & HMC7044_RESET_DIV_FSM)) {
+        return HMC7044_DIV_RESET_PERIOD_US;
+    }
+    return 0;
 }
 
 int32_t hmc7044_spi_reg_tbl_set(adi_hmc7044_device_t *device,
     adi_cms_reg_data_t *tbl, uint32_t count)
 {
-    uint16_t i =0;
+    uint32_t i = 0;
+    uint64_t t0;
+    uint8_t *tx;
+    uint16_t *delay;
     int err;
 
-    for (i = 0; i<count; i++) {
-        err = hmc7044_spi_reg_set(device, tbl[i].reg, tbl[i].val);
+    if (device == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_HANDLE_PTR;
+    }
+    if (tbl == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_NULL_PARAM;
+    }
+    if (device->hal_info.user_data == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_XFER_PTR;
+    }
+    if (count == 0) {
+        return API_CMS_ERROR_OK;
+    }
+
+    t0 = spi_stats_begin();
+    tx = malloc(count * SPI_IN_OUT_BUFF_SZ);
+    delay = malloc(count * sizeof(uint16_t));
+    if ((tx == NULL) || (delay == NULL)) {
+        free(tx);
+        free(delay);
+        return API_CMS_ERROR_ERROR;
+    }
+
+    /* one chip-select frame per register, sent in as few transfers as the transport allows */
+    for (i = 0; i < count; i++) {
+        tx[i * SPI_IN_OUT_BUFF_SZ + 0] = ((tbl[i].reg >> 8) & 0x1F);
+        tx[i * SPI_IN_OUT_BUFF_SZ + 1] = (tbl[i].reg & 0xFF);
+        tx[i * SPI_IN_OUT_BUFF_SZ + 2] = tbl[i].val;
+        delay[i] = hmc7044_reg_settle_us(tbl[i].reg, tbl[i].val);
+    }
+    err = spi_transport_write_batch(device->hal_info.user_data, tx, SPI_IN_OUT_BUFF_SZ, count, delay);
+
+    free(tx);
+    free(delay);
+    spi_stats_end(SPI_STAT_REG_TBL_SET, t0, count * SPI_IN_OUT_BUFF_SZ);
+    if (err != 0) {
+        return API_CMS_ERROR_SPI_XFER;
+    }
+
+    return API_CMS_ERROR_OK;
+}
+
+/*
+ * Selects the sysfs GPIO a lock status GPO is wired to, -1 to disable.
+ * The GPIO only shortens the sleep between polls, lock is always
+ * confirmed over SPI.
+ */
+int32_t hmc7044_lock_gpio_set(int gpio)
+{
+    hmc7044_lock_gpio = (gpio < 0) ? -1 : gpio;
+    return API_CMS_ERROR_OK;
+}
+
+static int hmc7044_lock_gpio_open(int gpio)
+{
+    char path[64];
+    int fd;
+
+    /* best effort, the board setup may already have configured the edge */
+    snprintf(path, sizeof(path), HMC7044_GPIO_SYSFS_PATH, gpio, "edge");
+    fd = open(path, O_WRONLY);
+    if (fd >= 0) {
+        if (write(fd, "rising", 6) != 6) {
+            printf("lock gpio %d: could not set rising edge\n", gpio);
+        }
+        close(fd);
+    }
+
+    snprintf(path, sizeof(path), HMC7044_GPIO_SYSFS_PATH, gpio, "value");
+    return open(path, O_RDONLY | O_NONBLOCK);
+}
+
+/* consumes a pending edge so the next poll() only wakes on a new one */
+static void hmc7044_lock_gpio_arm(int fd)
+{
+    char c;
+
+    lseek(fd, 0, SEEK_SET);
+    if (read(fd, &c, 1) < 0) {
+        /* nothing to clear */
+    }
+}
+
+/*
+ * Waits up to timeout_us for (reg & mask) == mask and returns as soon as
+ * it is set. The register is polled with an interval starting at
+ * HMC7044_LOCK_POLL_MIN_US and doubling up to HMC7044_LOCK_POLL_MAX_US;
+ * with a lock GPIO configured the wait between polls ends early on its
+ * rising edge. lock_time_us is the time from the call to the first read
+ * that saw lock.
+ */
+int32_t hmc7044_wait_lock(adi_hmc7044_device_t *device, uint16_t reg,
+    uint8_t mask, uint32_t timeout_us, uint32_t *lock_time_us)
+{
+    uint32_t interval = HMC7044_LOCK_POLL_MIN_US;
+    uint32_t polls = 0;
+    uint32_t wait_us;
+    uint64_t t0;
+    struct pollfd pfd;
+    int32_t expired;
+    uint8_t rdata;
+    int32_t err;
+    int fd = -1;
+
+    if (device == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_HANDLE_PTR;
+    }
+    if (lock_time_us == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_NULL_PARAM;
+    }
+
+    if (hmc7044_lock_gpio >= 0) {
+        fd = hmc7044_lock_gpio_open(hmc7044_lock_gpio);
+        if (fd < 0) {
+            printf("lock gpio %d unavailable, polling over SPI\n", hmc7044_lock_gpio);
+        }
+    }
+
+    t0 = spi_stats_begin();
+    HAL_setTimeout_us(timeout_us);
+    for (;;) {
+        if (fd >= 0) {
+            hmc7044_lock_gpio_arm(fd);
+        }
+        err = hmc7044_spi_reg_list_get(device, &reg, &rdata, 1);
+        expired = HAL_hasTimeoutExpired();
+        polls++;
+        if (err != API_CMS_ERROR_OK) {
+            break;
+        }
+        if ((rdata & mask) == mask) {
+            *lock_time_us = global_timerData.elapsedTime_us;
+            break;
+        }
+        if (expired) {
+            printf("lock wait failed: ADDR=[0x%04X], RVAL=[0x%02X], MASK=[0x%02X] after [%u] polls\n",
+                reg, rdata, mask, polls);
+            err = API_CMS_ERROR_PLL_NOT_LOCKED;
+            break;
+        }
+
+        wait_us = timeout_us - global_timerData.elapsedTime_us;
+        if (wait_us > interval) {
+            wait_us = interval;
+        }
+        if (fd >= 0) {
+            pfd.fd = fd;
+            pfd.events = POLLPRI | POLLERR;
+            pfd.revents = 0;
+            poll(&pfd, 1, (wait_us + 999) / 1000);
+        }
+        else {
+            HAL_wait_us(wait_us);
+        }
+        if (interval < HMC7044_LOCK_POLL_MAX_US) {
+            interval = (interval * 2 < HMC7044_LOCK_POLL_MAX_US) ? interval * 2 : HMC7044_LOCK_POLL_MAX_US;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    spi_stats_end(SPI_STAT_LOCK_WAIT, t0, 0);
+    spi_stats_retry(SPI_STAT_LOCK_WAIT, polls - 1);
+    return err;
+}
+
+static int32_t hmc7044_profile_flush(adi_hmc7044_device_t *device,
+    adi_cms_reg_data_t *tbl, uint32_t *count)
+{
+    int32_t err = API_CMS_ERROR_OK;
+
+    if (*count > 0) {
+        err = hmc7044_spi_reg_tbl_set(device, tbl, *count);
+        *count = 0;
+    }
+    return err;
+}
+
+/*
+ * Programs a clock profile. Runs of writes go out as one batched table.
+ */
+int32_t hmc7044_profile_apply(adi_hmc7044_device_t *device,
+    const hmc7044_profile_t *profile)
+{
+    adi_cms_reg_data_t *tbl;
+    adi_cms_reg_data_t pulse[2];
+    const hmc7044_profile_entry_t *e;
+    uint32_t i, n = 0;
+    uint32_t lock_time_us;
+    uint8_t rdata;
+    int32_t err = API_CMS_ERROR_OK;
+
+    if (device == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_HANDLE_PTR;
+    }
+    if (profile == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_NULL_PARAM;
+    }
+
+    tbl = malloc((profile->hdr.count + 1) * sizeof(*tbl));
+    if (tbl == NULL) {
+        return API_CMS_ERROR_ERROR;
+    }
+
+    for (i = 0; (i < profile->hdr.count) && (err == API_CMS_ERROR_OK); i++) {
+        e = &profile->entries[i];
+        if (e->op == HMC7044_PROFILE_OP_WRITE) {
+            tbl[n].reg = e->reg;
+            tbl[n].val = e->val;
+            n++;
+            continue;
+        }
+
+        err = hmc7044_profile_flush(device, tbl, &n);
         if (err != API_CMS_ERROR_OK) {
-        	printf("here3, err = %d\n\r", err);
-            return err;
+            break;
+        }
+        switch (e->op) {
+        case HMC7044_PROFILE_OP_DELAY_US:
+            spi_stats_usleep(e->arg);
+            break;
+        case HMC7044_PROFILE_OP_PULSE:
+            err = hmc7044_spi_reg_get(device, e->reg, &rdata);
+            if (err != API_CMS_ERROR_OK) {
+                break;
+            }
+            pulse[0].reg = e->reg;
+            pulse[0].val = rdata | e->val;
+            pulse[1].reg = e->reg;
+            pulse[1].val = rdata & ~e->val;
+            err = hmc7044_spi_reg_tbl_set(device, &pulse[0], 1);
+            if (err == API_CMS_ERROR_OK) {
+                spi_stats_usleep(e->arg);
+                err = hmc7044_spi_reg_tbl_set(device, &pulse[1], 1);
+            }
+            break;
+        case HMC7044_PROFILE_OP_WAIT_LOCK:
+            err = hmc7044_wait_lock(device, e->reg, e->val, e->arg * 1000, &lock_time_us);
+            if (err == API_CMS_ERROR_OK) {
+                printf("lock: ADDR=[0x%04X] in [%u.%03u ms]\n", e->reg,
+                    lock_time_us / 1000, lock_time_us % 1000);
+            }
+            break;
+        default:
+            err = API_CMS_ERROR_INVALID_PARAM;
+            break;
+        }
+    }
+    if (err == API_CMS_ERROR_OK) {
+        err = hmc7044_profile_flush(device, tbl, &n);
+    }
+
+    free(tbl);
+    return err;
+}
+
+/*
+ * Reads back every register the profile writes in one batch, -1
+ * elsewhere and for the read-only status registers.
+ */
+int32_t hmc7044_profile_read_image(adi_hmc7044_device_t *device,
+    const hmc7044_profile_t *profile, int16_t *image)
+{
+    int16_t target[HMC7044_PROFILE_NOF_REGS];
+    uint16_t regs[HMC7044_PROFILE_NOF_REGS];
+    uint8_t data[HMC7044_PROFILE_NOF_REGS];
+    uint32_t reg, i, n = 0;
+    int32_t err;
+
+    if (device == ADI_INVALID_POINTER) {
+        return API_CMS_ERROR_INVALID_HANDLE_PTR;
+    }
+
+    err = hmc7044_profile_image(profile, target);
+    if (err != API_CMS_ERROR_OK) {
+        return err;
+    }
+    for (reg = 0; reg < HMC7044_PROFILE_NOF_REGS; reg++) {
+        image[reg] = -1;
+        if ((target[reg] >= 0) && !HMC7044_PROFILE_REG_IS_RO(reg)) {
+            regs[n++] = reg;
+        }
+    }
+
+    err = hmc7044_spi_reg_list_get(device, regs, data, n);
+    if (err != API_CMS_ERROR_OK) {
+        return err;
+    }
+    for (i = 0; i < n; i++) {
+        image[regs[i]] = (regs[i] == HMC7044_GLOBAL_REQUEST_MODE_CTRL_REG) ?
+            (data[i] & ~HMC7044_PROFILE_REQ_STROBES) : data[i];
+    }
+
+    return API_CMS_ERROR_OK;
+}
+
+/*
+ * Compares the device with the final register values of the profile in a
+ * single read pass, printing every mismatch. The read-only status
+ * registers are not checked.
+ */
+int32_t hmc7044_profile_verify(adi_hmc7044_device_t *device,
+    const hmc7044_profile_t *profile, uint32_t *checked, uint32_t *mismatches)
+{
+    int16_t target[HMC7044_PROFILE_NOF_REGS];
+    int16_t image[HMC7044_PROFILE_NOF_REGS];
+    uint32_t reg;
+    int32_t err;
+
+    *checked = 0;
+    *mismatches = 0;
+    err = hmc7044_profile_image(profile, target);
+    if (err != API_CMS_ERROR_OK) {
+        return err;
+    }
+    err = hmc7044_profile_read_image(device, profile, image);
+    if (err != API_CMS_ERROR_OK) {
+        return err;
+    }
+
+    for (reg = 0; reg < HMC7044_PROFILE_NOF_REGS; reg++) {
+        if ((target[reg] < 0) || HMC7044_PROFILE_REG_IS_RO(reg)) {
+            continue;
+        }
+        (*checked)++;
+        if (image[reg] != target[reg]) {
+            printf("readback error: ADDR=[0x%04X], RVAL=[0x%02X] != VAL=[0x%02X]\n", reg, image[reg], target[reg]);
+            (*mismatches)++;
         }
     }
 
@@ -0,0 +1,500 @@
+/*
+ * hmc7044_profile.c
+ *
+ * Compiled HMC7044 clock profiles, see hmc7044_profile.h. Nothing in
+ * here touches the SPI bus, so the offline compiler links it on its own.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "hmc7044_profile.h"
+#include "hmc7044_reg.h"
+#include "adi_hmc7044.h"
+
+#define HMC7044_PROFILE_MAX_FILE_SIZE	(1 << 20)	// also bounds the scripts parsed as a fallback
+
+// output channel register blocks
+#define HMC7044_PROFILE_CH_BASE_REG		0xC8
+#define HMC7044_PROFILE_CH_STRIDE		10
+#define HMC7044_PROFILE_CH_EN			0x01
+
+/**
+ * \brief CRC-32 (IEEE 802.3, reflected), bitwise since profiles are small
+ */
+uint32_t hmc7044_profile_crc32(const void *data, uint32_t len)
+{
+	const uint8_t *p = (const uint8_t *)data;
+	uint32_t crc = 0xFFFFFFFF;
+	uint32_t i;
+	int k;
+
+	for (i = 0; i < len; i++)
+	{
+		crc ^= p[i];
+		for (k = 0; k < 8; k++)
+		{
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+		}
+	}
+	return ~crc;
+}
+
+void hmc7044_profile_init(hmc7044_profile_t *profile)
+{
+	memset(profile, 0, sizeof(*profile));
+	profile->hdr.magic = HMC7044_PROFILE_MAGIC;
+	profile->hdr.version = HMC7044_PROFILE_VERSION;
+}
+
+void hmc7044_profile_free(hmc7044_profile_t *profile)
+{
+	free(profile->entries);
+	profile->entries = NULL;
+	profile->size = 0;
+	profile->hdr.count = 0;
+}
+
+/**
+ * \brief Appends one entry, growing the table as needed
+ */
+int32_t hmc7044_profile_add(hmc7044_profile_t *profile, uint8_t op, uint16_t reg, uint8_t val, uint32_t arg)
+{
+	hmc7044_profile_entry_t *grown;
+	hmc7044_profile_entry_t *e;
+
+	if (profile->hdr.count >= HMC7044_PROFILE_MAX_ENTRIES)
+	{
+		printf("error: profile exceeds %u entries\n", HMC7044_PROFILE_MAX_ENTRIES);
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+	if (profile->hdr.count == profile->size)
+	{
+		uint32_t size = profile->size ? 2 * profile->size : 256;
+		grown = realloc(profile->entries, size * sizeof(*grown));
+		if (grown == NULL)
+		{
+			return API_CMS_ERROR_ERROR;
+		}
+		profile->entries = grown;
+		profile->size = size;
+	}
+
+	e = &profile->entries[profile->hdr.count++];
+	e->op = op;
+	e->val = val;
+	e->reg = reg;
+	e->arg = arg;
+	return API_CMS_ERROR_OK;
+}
+
+/**
+ * \brief Parses a GUI generated script. Recognizes
+ *   dut.write(addr, val)
+ *   time.sleep(seconds)
+ *   # @wait_lock(reg, mask, timeout_ms)
+ * and ignores everything else. With epilogue set, the divider restart
+ * and PLL2 lock wait clock_config always performed are appended.
+ */
+int32_t hmc7044_profile_parse_script(const char *path, uint8_t epilogue, hmc7044_profile_t *profile)
+{
+	FILE *fp;
+	char str[1000];
+	uint32_t addr, data, timeout_ms;
+	double seconds;
+	int32_t err = API_CMS_ERROR_OK;
+
+	hmc7044_profile_init(profile);
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+	{
+		printf("Could not open file %s\n", path);
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+	while ((err == API_CMS_ERROR_OK) && (fgets(str, sizeof(str), fp) != NULL))
+	{
+		if (sscanf(str, "dut.write(%x, %x)", &addr, &data) == 2)
+		{
+			err = hmc7044_profile_add(profile, HMC7044_PROFILE_OP_WRITE, addr, data, 0);
+		}
+		else if (sscanf(str, "time.sleep(%lf)", &seconds) == 1)
+		{
+			err = hmc7044_profile_add(profile, HMC7044_PROFILE_OP_DELAY_US, 0, 0, (uint32_t)(seconds * 1e6));
+		}
+		else if (sscanf(str, "# @wait_lock(%x, %x, %u)", &addr, &data, &timeout_ms) == 3)
+		{
+			err = hmc7044_profile_add(profile, HMC7044_PROFILE_OP_WAIT_LOCK, addr, data, timeout_ms);
+		}
+	}
+	fclose(fp);
+
+	//https://ez.analog.com/clock_and_timing/f/q-a/19676/hmc7044-pll2-not-locking
+	//https://ez.analog.com/clock_and_timing/f/q-a/19761/hmc7044-defaults-clock-outputs-after-reset
+	if ((err == API_CMS_ERROR_OK) && epilogue)
+	{
+		err = hmc7044_profile_add(profile, HMC7044_PROFILE_OP_PULSE,
+			HMC7044_GLOBAL_REQUEST_MODE_CTRL_REG, HMC7044_RESET_DIV_FSM, 0);
+	}
+	if ((err == API_CMS_ERROR_OK) && epilogue)
+	{
+		err = hmc7044_profile_add(profile, HMC7044_PROFILE_OP_WAIT_LOCK,
+			HMC7044_PROFILE_LOCK_REG, HMC7044_PROFILE_LOCK_MASK, HMC7044_PROFILE_LOCK_TIMEOUT_MS);
+	}
+	if (err != API_CMS_ERROR_OK)
+	{
+		hmc7044_profile_free(profile);
+	}
+	return err;
+}
+
+static void hmc7044_profile_reset_state(int16_t *state, const adi_cms_reg_data_t *defaults, uint32_t count)
+{
+	uint32_t i;
+
+	for (i = 0; i < HMC7044_PROFILE_NOF_REGS; i++)
+	{
+		state[i] = -1;
+	}
+	for (i = 0; i < count; i++)
+	{
+		if (defaults[i].reg < HMC7044_PROFILE_NOF_REGS)
+		{
+			state[defaults[i].reg] = defaults[i].val;
+		}
+	}
+}
+
+/**
+ * \brief Drops writes that leave a register at the value it already holds,
+ * starting from the reset defaults. A soft reset is prepended so the
+ * reduced profile does not depend on what was programmed before it.
+ * The global control registers (0x0, 0x1) carry strobe bits and are
+ * always kept.
+ */
+int32_t hmc7044_profile_reduce(hmc7044_profile_t *profile, const adi_cms_reg_data_t *defaults, uint32_t count)
+{
+	int16_t state[HMC7044_PROFILE_NOF_REGS];
+	hmc7044_profile_t out;
+	hmc7044_profile_entry_t *e;
+	uint32_t i;
+	int32_t err;
+
+	hmc7044_profile_init(&out);
+	out.hdr.flags = profile->hdr.flags | HMC7044_PROFILE_FLAG_REDUCED;
+
+	e = profile->entries;
+	if (!(profile->hdr.count > 0 && e[0].op == HMC7044_PROFILE_OP_PULSE &&
+		  e[0].reg == HMC7044_GLOBAL_SW_RESET_CTRL_REG && (e[0].val & HMC7044_SOFT_RESET)))
+	{
+		err = hmc7044_profile_add(&out, HMC7044_PROFILE_OP_PULSE,
+			HMC7044_GLOBAL_SW_RESET_CTRL_REG, HMC7044_SOFT_RESET, 0);
+		if (err != API_CMS_ERROR_OK)
+		{
+			return err;
+		}
+	}
+
+	hmc7044_profile_reset_state(state, defaults, count);
+	for (i = 0; i < profile->hdr.count; i++)
+	{
+		e = &profile->entries[i];
+		if (e->op == HMC7044_PROFILE_OP_WRITE)
+		{
+			if (e->reg == HMC7044_GLOBAL_SW_RESET_CTRL_REG && (e->val & HMC7044_SOFT_RESET))
+			{
+				hmc7044_profile_reset_state(state, defaults, count);
+			}
+			else if (e->reg > HMC7044_GLOBAL_REQUEST_MODE_CTRL_REG && e->reg < HMC7044_PROFILE_NOF_REGS)
+			{
+				if (state[e->reg] == e->val)
+				{
+					continue;
+				}
+				state[e->reg] = e->val;
+			}
+		}
+		else if (e->op == HMC7044_PROFILE_OP_PULSE && e->reg == HMC7044_GLOBAL_SW_RESET_CTRL_REG &&
+				 (e->val & HMC7044_SOFT_RESET))
+		{
+			hmc7044_profile_reset_state(state, defaults, count);
+		}
+
+		err = hmc7044_profile_add(&out, e->op, e->reg, e->val, e->arg);
+		if (err != API_CMS_ERROR_OK)
+		{
+			hmc7044_profile_free(&out);
+			return err;
+		}
+	}
+
+	hmc7044_profile_free(profile);
+	*profile = out;
+	return API_CMS_ERROR_OK;
+}
+
+/**
+ * \brief Final value the profile leaves in each register, -1 where it
+ * does not write. The soft reset register is never part of the image and
+ * the request strobes are masked out of reg 0x1.
+ */
+int32_t hmc7044_profile_image(const hmc7044_profile_t *profile, int16_t *image)
+{
+	const hmc7044_profile_entry_t *e;
+	uint32_t i;
+
+	for (i = 0; i < HMC7044_PROFILE_NOF_REGS; i++)
+	{
+		image[i] = -1;
+	}
+	for (i = 0; i < profile->hdr.count; i++)
+	{
+		e = &profile->entries[i];
+		if (e->op != HMC7044_PROFILE_OP_WRITE || e->reg == HMC7044_GLOBAL_SW_RESET_CTRL_REG)
+		{
+			continue;
+		}
+		if (e->reg >= HMC7044_PROFILE_NOF_REGS)
+		{
+			printf("error: register 0x%X out of range\n", e->reg);
+			return API_CMS_ERROR_INVALID_PARAM;
+		}
+		image[e->reg] = (e->reg == HMC7044_GLOBAL_REQUEST_MODE_CTRL_REG) ?
+			(e->val & ~HMC7044_PROFILE_REQ_STROBES) : e->val;
+	}
+	return API_CMS_ERROR_OK;
+}
+
+/*
+ * What changing reg from old to val requires. PLL1/reference, PLL2 and
+ * the global enables need a restart and a full lock wait. The SYSREF
+ * timer and the channel dividers need a restart. Turning a channel off
+ * needs nothing, turning one on needs a restart to start its divider in
+ * phase. Output delays, driver modes and the rest apply on the fly.
+ */
+static uint32_t hmc7044_profile_change_actions(uint16_t reg, int16_t old, uint8_t val)
+{
+	uint32_t ch_off;
+
+	if ((reg == HMC7044_GLOBAL_ENABLE_CTRL_REG) || (reg >= 0x05 && reg <= 0x2A) || (reg >= 0x31 && reg <= 0x3B))
+	{
+		return HMC7044_PROFILE_DIFF_RESTART | HMC7044_PROFILE_DIFF_PLL;
+	}
+	if (reg >= 0x5A && reg <= 0x5D)
+	{
+		return HMC7044_PROFILE_DIFF_RESTART;
+	}
+	if (reg >= HMC7044_PROFILE_CH_BASE_REG && reg < HMC7044_PROFILE_CH_BASE_REG + HMC7044_NOF_OP_CH * HMC7044_PROFILE_CH_STRIDE)
+	{
+		ch_off = (reg - HMC7044_PROFILE_CH_BASE_REG) % HMC7044_PROFILE_CH_STRIDE;
+		if (ch_off == 1 || ch_off == 2)
+		{
+			return HMC7044_PROFILE_DIFF_RESTART;
+		}
+		if (ch_off == 0)
+		{
+			if (old < 0 || ((old ^ val) & ~HMC7044_PROFILE_CH_EN) || ((val & HMC7044_PROFILE_CH_EN) && !(old & HMC7044_PROFILE_CH_EN)))
+			{
+				return HMC7044_PROFILE_DIFF_RESTART;
+			}
+		}
+	}
+	return 0;
+}
+
+/**
+ * \brief Builds the update from the current register image to target.
+ * Registers are written in the order the target script writes them, only
+ * where the value differs, followed by a divider restart when one of the
+ * changes needs it and a lock check (full wait when the PLL was touched).
+ * current holds -1 for registers that could not be read. Writes to the
+ * read-only status registers are dropped.
+ */
+int32_t hmc7044_profile_diff(const hmc7044_profile_t *target, const int16_t *current,
+	hmc7044_profile_t *out, uint32_t *changed, uint32_t *actions)
+{
+	int16_t image[HMC7044_PROFILE_NOF_REGS];
+	int32_t last[HMC7044_PROFILE_NOF_REGS];
+	const hmc7044_profile_entry_t *e;
+	uint32_t i;
+	int32_t err;
+
+	*changed = 0;
+	*actions = 0;
+	hmc7044_profile_init(out);
+	out->hdr.flags = HMC7044_PROFILE_FLAG_DIFF;
+
+	err = hmc7044_profile_image(target, image);
+	if (err != API_CMS_ERROR_OK)
+	{
+		return err;
+	}
+	for (i = 0; i < HMC7044_PROFILE_NOF_REGS; i++)
+	{
+		last[i] = -1;
+	}
+	for (i = 0; i < target->hdr.count; i++)
+	{
+		if (target->entries[i].op == HMC7044_PROFILE_OP_WRITE)
+		{
+			last[target->entries[i].reg] = i;
+		}
+	}
+
+	for (i = 0; i < target->hdr.count; i++)
+	{
+		e = &target->entries[i];
+		if (e->op != HMC7044_PROFILE_OP_WRITE || e->reg == HMC7044_GLOBAL_SW_RESET_CTRL_REG ||
+			HMC7044_PROFILE_REG_IS_RO(e->reg) || last[e->reg] != (int32_t)i || image[e->reg] == current[e->reg])
+		{
+			continue;
+		}
+		*actions |= hmc7044_profile_change_actions(e->reg, current[e->reg], image[e->reg]);
+		err = hmc7044_profile_add(out, HMC7044_PROFILE_OP_WRITE, e->reg, image[e->reg], 0);
+		if (err != API_CMS_ERROR_OK)
+		{
+			hmc7044_profile_free(out);
+			return err;
+		}
+		(*changed)++;
+	}
+
+	if (*actions & HMC7044_PROFILE_DIFF_RESTART)
+	{
+		err = hmc7044_profile_add(out, HMC7044_PROFILE_OP_PULSE,
+			HMC7044_GLOBAL_REQUEST_MODE_CTRL_REG, HMC7044_RESET_DIV_FSM, 0);
+	}
+	if (err == API_CMS_ERROR_OK)
+	{
+		err = hmc7044_profile_add(out, HMC7044_PROFILE_OP_WAIT_LOCK, HMC7044_PROFILE_LOCK_REG, HMC7044_PROFILE_LOCK_MASK,
+			(*actions & HMC7044_PROFILE_DIFF_PLL) ? HMC7044_PROFILE_LOCK_TIMEOUT_MS : 0);
+	}
+	if (err != API_CMS_ERROR_OK)
+	{
+		hmc7044_profile_free(out);
+	}
+	return err;
+}
+
+/**
+ * \brief Writes the profile with a fresh checksum
+ */
+int32_t hmc7044_profile_write(const char *path, hmc7044_profile_t *profile)
+{
+	FILE *fp;
+	uint32_t len = profile->hdr.count * sizeof(hmc7044_profile_entry_t);
+	int ok;
+
+	profile->hdr.magic = HMC7044_PROFILE_MAGIC;
+	profile->hdr.version = HMC7044_PROFILE_VERSION;
+	profile->hdr.crc32 = hmc7044_profile_crc32(profile->entries, len);
+
+	fp = fopen(path, "wb");
+	if (fp == NULL)
+	{
+		printf("error: could not create %s\n", path);
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+	ok = (fwrite(&profile->hdr, sizeof(profile->hdr), 1, fp) == 1);
+	if (ok && len)
+	{
+		ok = (fwrite(profile->entries, len, 1, fp) == 1);
+	}
+	if (fclose(fp) != 0)
+	{
+		ok = 0;
+	}
+	if (!ok)
+	{
+		printf("error: failed writing %s\n", path);
+		return API_CMS_ERROR_ERROR;
+	}
+	return API_CMS_ERROR_OK;
+}
+
+/**
+ * \brief Loads a compiled profile with a single read and validates it.
+ * Anything without the profile magic is parsed as a GUI script instead.
+ */
+int32_t hmc7044_profile_load(const char *path, hmc7044_profile_t *profile)
+{
+	struct stat st;
+	uint8_t *buf;
+	uint32_t len, i;
+	ssize_t rc;
+	int fd;
+
+	hmc7044_profile_init(profile);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		printf("Could not open file %s\n", path);
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size > HMC7044_PROFILE_MAX_FILE_SIZE)
+	{
+		printf("error: %s is not a clock profile\n", path);
+		close(fd);
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+
+	buf = malloc(st.st_size + 1);
+	if (buf == NULL)
+	{
+		close(fd);
+		return API_CMS_ERROR_ERROR;
+	}
+	rc = read(fd, buf, st.st_size);
+	close(fd);
+	if (rc != st.st_size)
+	{
+		printf("error: short read on %s\n", path);
+		free(buf);
+		return API_CMS_ERROR_ERROR;
+	}
+
+	if ((size_t)rc < sizeof(hmc7044_profile_hdr_t) ||
+		((hmc7044_profile_hdr_t *)buf)->magic != HMC7044_PROFILE_MAGIC)
+	{
+		free(buf);
+		return hmc7044_profile_parse_script(path, 1, profile);
+	}
+
+	memcpy(&profile->hdr, buf, sizeof(profile->hdr));
+	len = profile->hdr.count * sizeof(hmc7044_profile_entry_t);
+	if (profile->hdr.version != HMC7044_PROFILE_VERSION ||
+		profile->hdr.count > HMC7044_PROFILE_MAX_ENTRIES ||
+		(size_t)rc != sizeof(hmc7044_profile_hdr_t) + len)
+	{
+		printf("error: %s has an unsupported profile layout\n", path);
+		free(buf);
+		hmc7044_profile_init(profile);
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+	if (hmc7044_profile_crc32(buf + sizeof(hmc7044_profile_hdr_t), len) != profile->hdr.crc32)
+	{
+		printf("error: %s checksum mismatch\n", path);
+		free(buf);
+		hmc7044_profile_init(profile);
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+
+	// entries are used in place, the header copy stays in profile->hdr
+	memmove(buf, buf + sizeof(hmc7044_profile_hdr_t), len);
+	profile->entries = (hmc7044_profile_entry_t *)buf;
+	profile->size = profile->hdr.count;
+	for (i = 0; i < profile->hdr.count; i++)
+	{
+		if (profile->entries[i].op >= HMC7044_PROFILE_NOF_OPS)
+		{
+			printf("error: %s entry %u has unknown op %u\n", path, i, profile->entries[i].op);
+			hmc7044_profile_free(profile);
+			return API_CMS_ERROR_INVALID_PARAM;
+		}
+	}
+	return API_CMS_ERROR_OK;
+}
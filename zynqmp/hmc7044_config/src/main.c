@@ -17,22 +17,23 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include "spi.h"
+#include "spi_transport.h"
+#include "spi_stats.h"
+#include "adi_hmc7044.h"
+#include "hmc7044_hal.h"
 #include "command_line_parser.h"
 
 int debug_print_on = 0;
 
-uint32_t get_product_id( void )
+uint32_t get_product_id( adi_hmc7044_device_t *device )
 {
     // read product ID
     uint8_t data[4] = {0,0,0,0};
-    uint8_t txbuf[2];
     for(uint16_t addr = 0x78, k = 0; addr < 0x7B; addr++, k++)
     {
-        // byte swap (MSB first)
-        txbuf[0] = ((addr >> 8) & 0x1F);
-        txbuf[1] = addr & 0xFF;
-        if( HAL_spiRead(SPI0_SS_HMC7044, txbuf, 2, &data[k]) < 0 ) {
+        if( hmc7044_spi_reg_get(device, addr, &data[k]) != API_CMS_ERROR_OK ) {
             printf("failed to read address [0x%X]\n", addr);
             return 0x0;
         }
@@ -42,13 +43,40 @@ uint32_t get_product_id( void )
 
 int main(int argc, char *argv[])
 {
-    int rc, ret = 0;
+    int ret = 0;
+    const char *spi_spec = SPI_TRANSPORT_DEFAULT;
+    adi_hmc7044_device_t hmc7044_dev;
+    spi_transport_t *spi;
+    int x, n = 1;
 
-    rc = HAL_initSpi(SPI0_SS_HMC7044, 0, 10000000);
-    if( rc < 0 ){
+    // leading --options are consumed here, the command follows
+    for( x = 1; x < argc; x++ ){
+        if( strncmp(argv[x], "--spi=", 6) == 0 ) {
+            spi_spec = argv[x] + 6;
+        }
+        else if( strcmp(argv[x], "--stats") == 0 ) {
+            spi_stats_enable(SPI_STATS_TEXT);
+        }
+        else if( strcmp(argv[x], "--stats=json") == 0 ) {
+            spi_stats_enable(SPI_STATS_JSON);
+        }
+        else if( n == 1 && strncmp(argv[x], "--", 2) == 0 ) {
+            printf("unknown option [%s]\n", argv[x]);
+            return 1;
+        }
+        else {
+            argv[n++] = argv[x];
+        }
+    }
+    argc = n;
+
+    spi = spi_transport_open(spi_spec, SPI0_SS_HMC7044, 0, 10000000);
+    if( spi == NULL ){
         printf("failed to initialize SPI.. aborting\n");
         return 1;
     }
+    memset(&hmc7044_dev, 0, sizeof(hmc7044_dev));
+    hmc7044_spi_transport_set(&hmc7044_dev, spi);
 
     //! @note The HMC7044 returns an invalid product ID after power-up
 
@@ -56,21 +84,29 @@ int main(int argc, char *argv[])
     int retry = 5;
     uint32_t pid = 0;
     while( retry > 0 ){
-        pid = get_product_id();
+        pid = get_product_id(&hmc7044_dev);
         if( pid == 0x045201 || pid == 0x301651  ) {
             break;
         }
         retry--;
     }
+    spi_stats_retry(SPI_STAT_REG_GET, 5 - retry);
 
     if( retry < 0 ){
         printf("failed verify product ID.. aborting\n");
+        spi_stats_print();
+        spi_transport_close(spi);
         return 1;
     }
 
     printf("product ID found: [0x%X]\n", pid);
 	if( argc > 1 ){
-		command_line_parser(argc, argv);
+		ret = command_line_parser(&hmc7044_dev, argc, argv);
 	}
-    return 0;
+    if( strcmp(spi->name, "emu") == 0 ) {
+        spi_transport_print_stats(spi);
+    }
+    spi_stats_print();
+    spi_transport_close(spi);
+    return ret ? 1 : 0;
 }
@@ -10,9 +10,11 @@
 #include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <linux/spi/spidev.h>
 #include "spi.h"
+#include "spi_stats.h"
 
 #define NUM_SPI_CHIP_SELECTS 1  /*valid range 1-6*/
 int spifd[NUM_SPI_CHIP_SELECTS] = {0};
@@ -145,6 +147,8 @@ int32_t HAL_initSpi(uint8_t chipSelectIndex, uint8_t spiMode, uint32_t spiClk_Hz
 ****************************************************************************/
 int HAL_spiWrite(uint8_t chipSelectIndex, const unsigned char *txbuf, uint32_t n_tx)
 {
+    uint64_t t0;
+    int ret;
     int fd = 0;
 	char str[100];
 
@@ -159,7 +163,10 @@ int HAL_spiWrite(uint8_t chipSelectIndex, const unsigned char *txbuf, uint32_t n
 		printf("HAL_spiWrite: CS=%d, addr = 0x%02X%02X, data = 0x%02X \n", chipSelectIndex, txbuf[0], txbuf[1], txbuf[2]);  // DEBUG - JLS
     fd = spifd[chipSelectIndex-1];
 
-    return write(fd, txbuf, n_tx);
+    t0 = spi_stats_begin();
+    ret = write(fd, txbuf, n_tx);
+    spi_stats_end(SPI_STAT_SPIDEV_WRITE, t0, n_tx);
+    return ret;
 }
 
 /***************************************************************************
@@ -177,6 +184,7 @@ int HAL_spiRead(uint8_t chipSelectIndex, unsigned char *txbuf, uint8_t n_tx,
     /*four bytes because it gets cast to a long below*/
     unsigned char tx[] = {0x00,0x00,0x00,0x00};
     unsigned char rx[] = {0x00,0x00,0x00,0x00};
+    uint64_t t0;
     int ret = 0;
     int fd = 0;
 	char str[100];
@@ -208,7 +216,9 @@ int HAL_spiRead(uint8_t chipSelectIndex, unsigned char *txbuf, uint8_t n_tx,
         .delay_usecs = 1,
     };
 
+    t0 = spi_stats_begin();
     ret = ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
+    spi_stats_end(SPI_STAT_SPIDEV_READ, t0, n_tx + 1);
     if (ret == -1)
     {
         perror("can't send spi message");
@@ -220,3 +230,169 @@ int HAL_spiRead(uint8_t chipSelectIndex, unsigned char *txbuf, uint8_t n_tx,
 
     return ret;
 }
+
+/***************************************************************************
+ * @brief Shift n bytes out the SPI in one chip-select frame, capturing the
+ * n bytes shifted in. Returns 0 on success, -1 on error.
+****************************************************************************/
+int HAL_spiXfer(uint8_t chipSelectIndex, const unsigned char *txbuf, unsigned char *rxbuf, uint32_t n)
+{
+    struct spi_ioc_transfer tr;
+    uint64_t t0;
+    int ret;
+    int fd = 0;
+    char str[100];
+
+    if ((chipSelectIndex > NUM_SPI_CHIP_SELECTS) || (chipSelectIndex == 0))
+    {
+        sprintf(str, "HAL_spiXfer chip select out of range, chipSelectIndex=%d", chipSelectIndex);
+        perror(str);
+        return -1;
+    }
+    fd = spifd[chipSelectIndex-1];
+
+    memset(&tr, 0, sizeof(tr));
+    tr.tx_buf = (unsigned long)txbuf;
+    tr.rx_buf = (unsigned long)rxbuf;
+    tr.len = n;
+
+    if (debug_print_on)
+        printf("HAL_spiXfer: CS=%d, addr = 0x%02X%02X\n", chipSelectIndex, txbuf[0], txbuf[1]);
+
+    t0 = spi_stats_begin();
+    ret = ioctl(fd, SPI_IOC_MESSAGE(1), &tr);
+    spi_stats_end(SPI_STAT_SPIDEV_XFER, t0, n);
+    if (ret == -1)
+    {
+        perror("can't send spi message");
+        return -1;
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+ * @brief Shift count fixed-size messages out the SPI in as few ioctls as
+ * possible. Each message is its own chip-select frame; delay_us (may be
+ * NULL) gives the settle time after each message.
+ * Returns 0 on success, -1 on error.
+****************************************************************************/
+int HAL_spiWriteBatch(uint8_t chipSelectIndex, const unsigned char *txbuf, uint32_t n_tx,
+                      uint32_t count, const uint16_t *delay_us)
+{
+    struct spi_ioc_transfer tr[SPI_BATCH_MAX_XFERS];
+    uint32_t i, k, n;
+    uint64_t t0;
+    int fd = 0;
+    int ret;
+    char str[100];
+
+    if ((chipSelectIndex > NUM_SPI_CHIP_SELECTS) || (chipSelectIndex == 0))
+    {
+        sprintf(str, "HAL_spiWriteBatch chip select out of range, chipSelectIndex=%d", chipSelectIndex);
+        perror(str);
+        return -1;
+    }
+    fd = spifd[chipSelectIndex-1];
+
+    for (i = 0; i < count; i += n)
+    {
+        n = count - i;
+        if (n > SPI_BATCH_MAX_XFERS)
+            n = SPI_BATCH_MAX_XFERS;
+
+        memset(tr, 0, n * sizeof(tr[0]));
+        for (k = 0; k < n; k++)
+        {
+            tr[k].tx_buf = (unsigned long)&txbuf[(i + k) * n_tx];
+            tr[k].len = n_tx;
+            tr[k].delay_usecs = delay_us ? delay_us[i + k] : 0;
+            // release chip select between messages, not after the last one
+            tr[k].cs_change = (k + 1 < n);
+
+            if (debug_print_on)
+                printf("HAL_spiWriteBatch: CS=%d, addr = 0x%02X%02X, data = 0x%02X \n", chipSelectIndex,
+                       txbuf[(i + k) * n_tx], txbuf[(i + k) * n_tx + 1], txbuf[(i + k) * n_tx + 2]);
+        }
+
+        t0 = spi_stats_begin();
+        ret = ioctl(fd, SPI_IOC_MESSAGE(n), tr);
+        spi_stats_end(SPI_STAT_SPIDEV_WRITE_BATCH, t0, n * n_tx);
+        if (ret == -1)
+        {
+            perror("can't send spi batch");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/***************************************************************************
+ * @brief Queue count single-byte register reads into as few ioctls as
+ * possible. txbuf holds count instruction words of n_tx bytes each (the
+ * read bit is set here), one data byte per read lands in readdata.
+ * Returns 0 on success, -1 on error.
+****************************************************************************/
+int HAL_spiReadBatch(uint8_t chipSelectIndex, const unsigned char *txbuf, uint8_t n_tx,
+                     uint32_t count, unsigned char *readdata)
+{
+    struct spi_ioc_transfer tr[SPI_BATCH_MAX_XFERS];
+    unsigned char tx[SPI_BATCH_MAX_XFERS][4];
+    unsigned char rx[SPI_BATCH_MAX_XFERS][4];
+    uint32_t i, k, n;
+    uint64_t t0;
+    int fd = 0;
+    int ret;
+    char str[100];
+
+    if ((chipSelectIndex > NUM_SPI_CHIP_SELECTS) || (chipSelectIndex == 0))
+    {
+        sprintf(str, "HAL_spiReadBatch chip select out of range, chipSelectIndex=%d", chipSelectIndex);
+        perror(str);
+        return -1;
+    }
+    fd = spifd[chipSelectIndex-1];
+
+    /*n_tx can be 1 or 2 bytes (8bit or 16bit instruction word)*/
+    if (n_tx < 1 || n_tx > 2)
+    {
+        perror("HAL_spiReadBatch had invalid tx data size. Valid size is 1 or 2 bytes.");
+        return -1;
+    }
+
+    for (i = 0; i < count; i += n)
+    {
+        n = count - i;
+        if (n > SPI_BATCH_MAX_XFERS)
+            n = SPI_BATCH_MAX_XFERS;
+
+        memset(tr, 0, n * sizeof(tr[0]));
+        memset(tx, 0, n * sizeof(tx[0]));
+        for (k = 0; k < n; k++)
+        {
+            memcpy(tx[k], &txbuf[(i + k) * n_tx], n_tx);
+            tx[k][0] |= 0x80;
+            tr[k].tx_buf = (unsigned long)tx[k];
+            tr[k].rx_buf = (unsigned long)rx[k];
+            tr[k].len = n_tx + 1;
+            // release chip select between reads, not after the last one
+            tr[k].cs_change = (k + 1 < n);
+        }
+
+        t0 = spi_stats_begin();
+        ret = ioctl(fd, SPI_IOC_MESSAGE(n), tr);
+        spi_stats_end(SPI_STAT_SPIDEV_READ_BATCH, t0, n * (n_tx + 1));
+        if (ret == -1)
+        {
+            perror("can't send spi batch");
+            return -EIO;
+        }
+        for (k = 0; k < n; k++)
+        {
+            readdata[i + k] = rx[k][n_tx];
+        }
+    }
+
+    return 0;
+}
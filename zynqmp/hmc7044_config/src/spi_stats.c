@@ -0,0 +1,217 @@
+/*
+ * spi_stats.c
+ *
+ * SPI bring-up instrumentation, see spi_stats.h. Single threaded like
+ * the rest of hmc7044_config.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "spi_stats.h"
+
+typedef struct
+{
+	uint64_t	calls;
+	uint64_t	bytes;
+	uint64_t	retries;
+	uint64_t	total_ns;
+	uint64_t	min_ns;
+	uint64_t	max_ns;
+	uint32_t	hist[SPI_STATS_NOF_BUCKETS];
+} spi_stat_t;
+
+int spi_stats_on = 0;
+
+static spi_stats_mode_e spi_stats_mode = SPI_STATS_OFF;
+static uint64_t spi_stats_start_ns;
+static spi_stat_t spi_stats[SPI_STAT_NOF_OPS];
+
+static const char *spi_stats_names[SPI_STAT_NOF_OPS] = {
+	"spidev_write",
+	"spidev_read",
+	"spidev_xfer",
+	"spidev_write_batch",
+	"spidev_read_batch",
+	"transport_xfer",
+	"transport_write_batch",
+	"transport_read_batch",
+	"reg_get",
+	"reg_set",
+	"reg_tbl_set",
+	"reg_list_get",
+	"sleep",
+	"lock_wait",
+};
+
+uint64_t spi_stats_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void spi_stats_enable(spi_stats_mode_e mode)
+{
+	spi_stats_mode = mode;
+	spi_stats_on = (mode != SPI_STATS_OFF);
+	spi_stats_start_ns = spi_stats_now_ns();
+	memset(spi_stats, 0, sizeof(spi_stats));
+}
+
+/**
+ * \brief Histogram bucket: 0 below 1 us, k for [2^(k-1), 2^k) us
+ */
+static uint32_t spi_stats_bucket(uint64_t ns)
+{
+	uint64_t us = ns / 1000;
+	uint32_t k = 0;
+
+	while (us && k < SPI_STATS_NOF_BUCKETS - 1)
+	{
+		us >>= 1;
+		k++;
+	}
+	return k;
+}
+
+void spi_stats_record(spi_stat_op_e op, uint64_t start_ns, uint64_t bytes)
+{
+	spi_stat_t *s = &spi_stats[op];
+	uint64_t ns = spi_stats_now_ns() - start_ns;
+
+	if (s->calls == 0 || ns < s->min_ns)
+	{
+		s->min_ns = ns;
+	}
+	if (ns > s->max_ns)
+	{
+		s->max_ns = ns;
+	}
+	s->calls++;
+	s->bytes += bytes;
+	s->total_ns += ns;
+	s->hist[spi_stats_bucket(ns)]++;
+}
+
+void spi_stats_retry(spi_stat_op_e op, uint32_t retries)
+{
+	if (spi_stats_on)
+	{
+		spi_stats[op].retries += retries;
+	}
+}
+
+/**
+ * \brief usleep() accounted as sleep time
+ */
+void spi_stats_usleep(uint32_t us)
+{
+	uint64_t t0 = spi_stats_begin();
+
+	usleep(us);
+	spi_stats_end(SPI_STAT_SLEEP, t0, 0);
+}
+
+/* upper edge of a histogram bucket in us */
+static uint64_t spi_stats_bucket_us(uint32_t k)
+{
+	return 1ull << k;
+}
+
+static void spi_stats_print_text(uint64_t wall_ns)
+{
+	const spi_stat_t *s;
+	uint32_t op, k;
+
+	printf("stats: wall [%.3f ms]\n", wall_ns / 1e6);
+	printf("  %-22s %8s %9s %11s %10s %10s %10s %8s\n",
+		"op", "calls", "bytes", "total ms", "mean us", "min us", "max us", "retries");
+	for (op = 0; op < SPI_STAT_NOF_OPS; op++)
+	{
+		s = &spi_stats[op];
+		if (s->calls == 0)
+		{
+			continue;
+		}
+		printf("  %-22s %8llu %9llu %11.3f %10.1f %10.1f %10.1f %8llu\n", spi_stats_names[op],
+			(unsigned long long)s->calls, (unsigned long long)s->bytes, s->total_ns / 1e6,
+			s->total_ns / 1e3 / s->calls, s->min_ns / 1e3, s->max_ns / 1e3, (unsigned long long)s->retries);
+	}
+
+	printf("stats: latency histogram, calls below each bound in us\n");
+	for (op = 0; op < SPI_STAT_NOF_OPS; op++)
+	{
+		s = &spi_stats[op];
+		if (s->calls == 0)
+		{
+			continue;
+		}
+		printf("  %-22s", spi_stats_names[op]);
+		for (k = 0; k < SPI_STATS_NOF_BUCKETS; k++)
+		{
+			if (s->hist[k])
+			{
+				printf(" <%llu:%u", (unsigned long long)spi_stats_bucket_us(k), s->hist[k]);
+			}
+		}
+		printf("\n");
+	}
+}
+
+static void spi_stats_print_json(uint64_t wall_ns)
+{
+	const spi_stat_t *s;
+	uint32_t op, k;
+	int first = 1, first_bucket;
+
+	printf("{\"wall_us\": %.3f, \"ops\": [", wall_ns / 1e3);
+	for (op = 0; op < SPI_STAT_NOF_OPS; op++)
+	{
+		s = &spi_stats[op];
+		if (s->calls == 0)
+		{
+			continue;
+		}
+		printf("%s\n  {\"op\": \"%s\", \"calls\": %llu, \"bytes\": %llu, \"retries\": %llu, "
+			"\"total_us\": %.3f, \"min_us\": %.3f, \"max_us\": %.3f, \"hist_us\": [",
+			first ? "" : ",", spi_stats_names[op], (unsigned long long)s->calls, (unsigned long long)s->bytes,
+			(unsigned long long)s->retries, s->total_ns / 1e3, s->min_ns / 1e3, s->max_ns / 1e3);
+		first = 0;
+		first_bucket = 1;
+		for (k = 0; k < SPI_STATS_NOF_BUCKETS; k++)
+		{
+			if (s->hist[k])
+			{
+				printf("%s[%llu, %u]", first_bucket ? "" : ", ", (unsigned long long)spi_stats_bucket_us(k), s->hist[k]);
+				first_bucket = 0;
+			}
+		}
+		printf("]}");
+	}
+	printf("\n]}\n");
+}
+
+/**
+ * \brief Summary of everything recorded since spi_stats_enable()
+ */
+void spi_stats_print(void)
+{
+	uint64_t wall_ns;
+
+	if (!spi_stats_on)
+	{
+		return;
+	}
+	wall_ns = spi_stats_now_ns() - spi_stats_start_ns;
+	if (spi_stats_mode == SPI_STATS_JSON)
+	{
+		spi_stats_print_json(wall_ns);
+	}
+	else
+	{
+		spi_stats_print_text(wall_ns);
+	}
+}
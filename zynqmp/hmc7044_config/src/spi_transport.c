@@ -0,0 +1,226 @@
+/*
+ * spi_transport.c
+ *
+ * SPI transports for the HMC7044 HAL, see spi_transport.h. The spidev
+ * transports sit on the chip select opened by HAL_initSpi(), the
+ * emulator lives in hmc7044_emu.c.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "spi.h"
+#include "spi_transport.h"
+#include "spi_stats.h"
+#include "adi_cms_api_common.h"
+
+typedef struct
+{
+	uint8_t		cs;			// HAL_initSpi chip select index
+} spidev_ctx_t;
+
+static uint8_t spidev_cs(spi_transport_t *spi)
+{
+	return ((spidev_ctx_t *)spi->ctx)->cs;
+}
+
+static int32_t spidev_xfer(spi_transport_t *spi, uint8_t *in_data, uint8_t *out_data, uint32_t size_bytes)
+{
+	spi->stats.calls++;
+	return (HAL_spiXfer(spidev_cs(spi), in_data, out_data, size_bytes) == 0) ? API_CMS_ERROR_OK : API_CMS_ERROR_SPI_XFER;
+}
+
+/**
+ * \brief Table write with one ioctl per frame
+ */
+static int32_t spidev_write_batch(spi_transport_t *spi, const uint8_t *txbuf, uint32_t n_tx, uint32_t count,
+	const uint16_t *delay_us)
+{
+	uint8_t rx[8];
+	uint32_t i;
+
+	if (n_tx > sizeof(rx))
+	{
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+	for (i = 0; i < count; i++)
+	{
+		spi->stats.calls++;
+		if (HAL_spiXfer(spidev_cs(spi), &txbuf[i * n_tx], rx, n_tx) != 0)
+		{
+			return API_CMS_ERROR_SPI_XFER;
+		}
+		if (delay_us && delay_us[i])
+		{
+			spi_stats_usleep(delay_us[i]);
+		}
+	}
+	return API_CMS_ERROR_OK;
+}
+
+/**
+ * \brief Register list read with one ioctl per register
+ */
+static int32_t spidev_read_batch(spi_transport_t *spi, const uint8_t *txbuf, uint8_t n_tx, uint32_t count,
+	uint8_t *readdata)
+{
+	uint8_t tx[4], rx[4];
+	uint32_t i;
+
+	if (n_tx < 1 || n_tx > 2)
+	{
+		return API_CMS_ERROR_INVALID_PARAM;
+	}
+	for (i = 0; i < count; i++)
+	{
+		memset(tx, 0, sizeof(tx));
+		memcpy(tx, &txbuf[i * n_tx], n_tx);
+		tx[0] |= 0x80;
+		spi->stats.calls++;
+		if (HAL_spiXfer(spidev_cs(spi), tx, rx, n_tx + 1) != 0)
+		{
+			return API_CMS_ERROR_SPI_XFER;
+		}
+		readdata[i] = rx[n_tx];
+	}
+	return API_CMS_ERROR_OK;
+}
+
+static int32_t spidev_batch_write_batch(spi_transport_t *spi, const uint8_t *txbuf, uint32_t n_tx, uint32_t count,
+	const uint16_t *delay_us)
+{
+	spi->stats.calls += (count + SPI_BATCH_MAX_XFERS - 1) / SPI_BATCH_MAX_XFERS;
+	return (HAL_spiWriteBatch(spidev_cs(spi), txbuf, n_tx, count, delay_us) == 0) ? API_CMS_ERROR_OK : API_CMS_ERROR_SPI_XFER;
+}
+
+static int32_t spidev_batch_read_batch(spi_transport_t *spi, const uint8_t *txbuf, uint8_t n_tx, uint32_t count,
+	uint8_t *readdata)
+{
+	spi->stats.calls += (count + SPI_BATCH_MAX_XFERS - 1) / SPI_BATCH_MAX_XFERS;
+	return (HAL_spiReadBatch(spidev_cs(spi), txbuf, n_tx, count, readdata) == 0) ? API_CMS_ERROR_OK : API_CMS_ERROR_SPI_XFER;
+}
+
+/**
+ * \brief Opens a transport from its --spi spec, NULL on failure
+ */
+spi_transport_t *spi_transport_open(const char *spec, uint8_t chipSelectIndex, uint8_t spiMode, uint32_t spiClk_Hz)
+{
+	spi_transport_t *spi;
+	spidev_ctx_t *ctx;
+
+	if (strcmp(spec, "emu") == 0 || strncmp(spec, "emu:", 4) == 0)
+	{
+		return hmc7044_emu_open(spec[3] ? &spec[4] : "", spiClk_Hz);
+	}
+	if (strcmp(spec, "spidev") != 0 && strcmp(spec, "spidev-batch") != 0)
+	{
+		printf("error: unknown SPI transport [%s], expected spidev, spidev-batch or emu[:lock_us]\n", spec);
+		return NULL;
+	}
+
+	// errno on failure, not a negative value
+	if (HAL_initSpi(chipSelectIndex, spiMode, spiClk_Hz) != 0)
+	{
+		return NULL;
+	}
+	spi = calloc(1, sizeof(*spi));
+	ctx = calloc(1, sizeof(*ctx));
+	if (spi == NULL || ctx == NULL)
+	{
+		free(spi);
+		free(ctx);
+		return NULL;
+	}
+	ctx->cs = chipSelectIndex;
+	spi->ctx = ctx;
+	spi->clk_hz = spiClk_Hz;
+	spi->xfer = spidev_xfer;
+	if (strcmp(spec, "spidev") == 0)
+	{
+		spi->name = "spidev";
+		spi->write_batch = spidev_write_batch;
+		spi->read_batch = spidev_read_batch;
+	}
+	else
+	{
+		spi->name = "spidev-batch";
+		spi->write_batch = spidev_batch_write_batch;
+		spi->read_batch = spidev_batch_read_batch;
+	}
+	return spi;
+}
+
+void spi_transport_close(spi_transport_t *spi)
+{
+	if (spi == NULL)
+	{
+		return;
+	}
+	if (spi->close)
+	{
+		spi->close(spi);
+	}
+	free(spi->ctx);
+	free(spi);
+}
+
+/**
+ * \brief adi_spi_xfer_t entry point, user_data is the transport
+ */
+int32_t spi_transport_xfer(void *user_data, uint8_t *in_data, uint8_t *out_data, uint32_t size_bytes)
+{
+	spi_transport_t *spi = (spi_transport_t *)user_data;
+	uint64_t t0 = spi_stats_begin();
+	int32_t err;
+
+	spi->stats.frames++;
+	spi->stats.bytes += size_bytes;
+	err = spi->xfer(spi, in_data, out_data, size_bytes);
+	spi_stats_end(SPI_STAT_TRANSPORT_XFER, t0, size_bytes);
+	return err;
+}
+
+int32_t spi_transport_write_batch(spi_transport_t *spi, const uint8_t *txbuf, uint32_t n_tx,
+	uint32_t count, const uint16_t *delay_us)
+{
+	uint64_t t0 = spi_stats_begin();
+	int32_t err;
+	uint32_t i;
+
+	spi->stats.frames += count;
+	spi->stats.bytes += (uint64_t)count * n_tx;
+	for (i = 0; delay_us && i < count; i++)
+	{
+		spi->stats.settle_us += delay_us[i];
+	}
+	err = spi->write_batch(spi, txbuf, n_tx, count, delay_us);
+	spi_stats_end(SPI_STAT_TRANSPORT_WRITE_BATCH, t0, (uint64_t)count * n_tx);
+	return err;
+}
+
+int32_t spi_transport_read_batch(spi_transport_t *spi, const uint8_t *txbuf, uint8_t n_tx,
+	uint32_t count, uint8_t *readdata)
+{
+	uint64_t t0 = spi_stats_begin();
+	int32_t err;
+
+	spi->stats.frames += count;
+	spi->stats.bytes += (uint64_t)count * (n_tx + 1);
+	err = spi->read_batch(spi, txbuf, n_tx, count, readdata);
+	spi_stats_end(SPI_STAT_TRANSPORT_READ_BATCH, t0, (uint64_t)count * (n_tx + 1));
+	return err;
+}
+
+/**
+ * \brief One line summary, with the time the frames occupy the bus at
+ * the configured clock
+ */
+void spi_transport_print_stats(const spi_transport_t *spi)
+{
+	double bus_ms = spi->clk_hz ? (spi->stats.bytes * 8.0 * 1e3 / spi->clk_hz) : 0;
+
+	printf("spi [%s]: [%llu] frames in [%llu] calls, [%llu] bytes, bus [%.3f ms] at [%.1f MHz], settle [%.3f ms]\n",
+		spi->name, (unsigned long long)spi->stats.frames, (unsigned long long)spi->stats.calls,
+		(unsigned long long)spi->stats.bytes, bus_ms, spi->clk_hz / 1e6, spi->stats.settle_us / 1e3);
+}
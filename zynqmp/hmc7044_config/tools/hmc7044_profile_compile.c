@@ -0,0 +1,114 @@
+/*
+ * hmc7044_profile_compile.c
+ *
+ * Offline compiler from HMC7044 GUI scripts (dut.write lines) to the
+ * binary clock profile loaded by "hmc7044_config clock_config".
+ *
+ *   hmc7044_profile_compile [-d defaults.py] input.py output.h7p
+ *
+ * With -d, writes that leave a register at its reset default are dropped.
+ * The defaults file uses the same dut.write() form, e.g. captured with
+ * "hmc7044_config clock_dump" right after a reset.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "hmc7044_profile.h"
+
+static void usage(const char *prog)
+{
+	printf("Usage:\n");
+	printf("%s [-d defaults.py] input.py output.h7p\n", prog);
+	printf("  -d  reset default register values, writes matching them are removed\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *defaults_file = NULL;
+	hmc7044_profile_t profile;
+	hmc7044_profile_t defaults;
+	adi_cms_reg_data_t *tbl = NULL;
+	uint32_t i, n = 0, writes = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "d:h")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd':
+				defaults_file = optarg;
+				break;
+			default:
+				usage(argv[0]);
+				return (opt == 'h') ? 0 : 1;
+		}
+	}
+	if (argc - optind != 2)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (hmc7044_profile_parse_script(argv[optind], 1, &profile) != API_CMS_ERROR_OK)
+	{
+		return 1;
+	}
+	for (i = 0; i < profile.hdr.count; i++)
+	{
+		writes += (profile.entries[i].op == HMC7044_PROFILE_OP_WRITE);
+	}
+	printf("%s: [%u] writes, [%u] entries\n", argv[optind], writes, profile.hdr.count);
+
+	if (defaults_file)
+	{
+		if (hmc7044_profile_parse_script(defaults_file, 0, &defaults) != API_CMS_ERROR_OK)
+		{
+			hmc7044_profile_free(&profile);
+			return 1;
+		}
+		tbl = malloc((defaults.hdr.count + 1) * sizeof(*tbl));
+		if (tbl == NULL)
+		{
+			hmc7044_profile_free(&defaults);
+			hmc7044_profile_free(&profile);
+			return 1;
+		}
+		for (i = 0; i < defaults.hdr.count; i++)
+		{
+			if (defaults.entries[i].op == HMC7044_PROFILE_OP_WRITE)
+			{
+				tbl[n].reg = defaults.entries[i].reg;
+				tbl[n].val = defaults.entries[i].val;
+				n++;
+			}
+		}
+		hmc7044_profile_free(&defaults);
+
+		if (hmc7044_profile_reduce(&profile, tbl, n) != API_CMS_ERROR_OK)
+		{
+			free(tbl);
+			hmc7044_profile_free(&profile);
+			return 1;
+		}
+		free(tbl);
+
+		writes = 0;
+		for (i = 0; i < profile.hdr.count; i++)
+		{
+			writes += (profile.entries[i].op == HMC7044_PROFILE_OP_WRITE);
+		}
+		printf("reduced against [%u] defaults: [%u] writes, [%u] entries\n", n, writes, profile.hdr.count);
+	}
+
+	if (hmc7044_profile_write(argv[optind + 1], &profile) != API_CMS_ERROR_OK)
+	{
+		hmc7044_profile_free(&profile);
+		return 1;
+	}
+	printf("wrote %s: [%zu] bytes, crc [0x%08X]\n", argv[optind + 1],
+		sizeof(hmc7044_profile_hdr_t) + profile.hdr.count * sizeof(hmc7044_profile_entry_t), profile.hdr.crc32);
+
+	hmc7044_profile_free(&profile);
+	return 0;
+}
@@ -0,0 +1,350 @@
+//!*********************************************************************
+//! @file cerb_capture_bench.cpp
+//!
+//! @brief
+//! Times the stages of the capture path separately, DMA read, sc16 to
+//! fc32 conversion and file write, for buffer sizes from 4 KiB up to
+//! CERB_MAX_IQ_CNT samples, and reports MB/s, MSPS and per-buffer
+//! latency percentiles:
+//!
+//!   cerb_capture_bench --dma-dev=synthetic --output /data/bench.dat --json bench.json
+//!
+//! --dma-dev takes the DMA channel (/dev/cerb_dmarx_ch0 on the board),
+//! any readable file, or "synthetic", an in-process producer copying a
+//! precomputed tone, so the convert and write stages can be sized on a
+//! PC. The mapped DMA path is measured by the stream statistics of
+//! rx_samples_to_file --dma-mode=mmap.
+//!
+//! MB/s counts the bytes a stage produces (fc32 for the conversion, the
+//! written format for the write); "capture" is the serial time of one
+//! buffer through all stages, in DMA bytes, i.e. the sustainable rate.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <math.h>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cerb_common.h"
+#include "cerb_convert.h"
+#include "cerb_stream.h"
+#include "cerb_writer.h"
+
+namespace po = boost::program_options;
+
+#define BENCH_SYNTHETIC     "synthetic"
+#define BENCH_MIN_BYTES     4096
+#define BENCH_STAGES        4
+
+// globals
+po::variables_map   m_opts;
+std::string         m_dma_dev = BENCH_SYNTHETIC;
+std::string         m_output = "/tmp/cerb_capture_bench.dat";
+std::string         m_json;
+std::string         m_format_def = "fc32";
+cerb_format_e       m_format = CERB_FORMAT_FC32;
+std::string         m_kernel_def = "auto";
+cerb_convert_kernel_e m_kernel = cerb_convert_best_kernel();
+size_t              m_min_bytes = BENCH_MIN_BYTES;
+size_t              m_max_samps = CERB_MAX_IQ_CNT;
+size_t              m_iterations = 0;
+size_t              m_bytes_per_size = (64 << 20);
+
+static const char* s_stage_names[BENCH_STAGES] = { "dma_read", "convert", "file_write", "capture" };
+
+//! Per-stage results for one buffer size
+typedef struct {
+    double mbps;        // bytes moved by the stage / total stage time
+    double msps;
+    double min_us;
+    double p50_us;
+    double p90_us;
+    double p99_us;
+    double max_us;
+} bench_stage_t;
+
+typedef struct {
+    size_t        buffer_bytes;   // sc16 bytes per DMA buffer
+    size_t        nsamps;
+    size_t        iterations;
+    bench_stage_t stages[BENCH_STAGES];
+} bench_result_t;
+
+//!******************************************************
+//! @brief
+//! Handles command line options
+//!
+//!******************************************************
+int init_options(int argc, char *argv[])
+{
+    po::options_description desc("Command Line Options");
+    desc.add_options()
+        ("help,h",          "help message")
+        ("dma-dev",         po::value<std::string>(&m_dma_dev)->default_value(m_dma_dev),           "DMA channel, a readable file, or \"synthetic\" for an in-process producer")
+        ("output",          po::value<std::string>(&m_output)->default_value(m_output),             "Scratch file for the write stage, removed afterwards")
+        ("json",            po::value<std::string>(&m_json),                                        "Write the results as JSON to this file (- for stdout)")
+        ("format",          po::value<std::string>(&m_format_def)->default_value(m_format_def),     "Written format: fc32 (converted) or sc16 (raw DMA buffers)")
+        ("kernel",          po::value<std::string>(&m_kernel_def)->default_value(m_kernel_def),     "Conversion kernel: auto, scalar, neon, sse2 or avx2")
+        ("min-bytes",       po::value<size_t>(&m_min_bytes)->default_value(m_min_bytes),            "Smallest DMA buffer in bytes")
+        ("max-samps",       po::value<size_t>(&m_max_samps)->default_value(m_max_samps),            "Largest DMA buffer in samples")
+        ("iterations",      po::value<size_t>(&m_iterations)->default_value(m_iterations),          "Buffers per size (0 = enough to move --bytes-per-size)")
+        ("bytes-per-size",  po::value<size_t>(&m_bytes_per_size)->default_value(m_bytes_per_size),  "DMA bytes per buffer size when --iterations is 0")
+        ("buffered",        "Write through the page cache instead of O_DIRECT")
+    ;
+
+    po::store( po::parse_command_line(argc, argv, desc), m_opts);
+    if (m_opts.count("help")){
+        std::cout << "Usage: options_description [options]\n";
+        std::cout << desc;
+        return 0;
+    }
+
+    try {
+        po::notify(m_opts);
+    }
+    catch (std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 0;
+    }
+
+    if( !cerb_format_parse(m_format_def, m_format) ) {
+        std::cerr << "error: unknown format [" << m_format_def << "]\n";
+        return 0;
+    }
+    if( m_kernel_def != "auto" ) {
+        bool found = false;
+        for (int k = 0; k < CERB_CONVERT_NOF_KERNELS; k++) {
+            if( m_kernel_def == cerb_convert_kernel_name(static_cast<cerb_convert_kernel_e>(k)) ) {
+                m_kernel = static_cast<cerb_convert_kernel_e>(k);
+                found = true;
+            }
+        }
+        if( !found || !cerb_convert_select(m_kernel) ) {
+            std::cerr << "error: conversion kernel [" << m_kernel_def << "] not available\n";
+            return 0;
+        }
+    }
+    if( m_min_bytes < sizeof(cmplx_wire_t) || m_max_samps * sizeof(cmplx_wire_t) < m_min_bytes ) {
+        std::cerr << "error: --min-bytes must be between one sample and --max-samps\n";
+        return 0;
+    }
+    return 1;
+}
+
+//!******************************************************
+//! @brief
+//! Stage statistics from per-buffer durations in ns
+//!
+//!******************************************************
+bench_stage_t summarize(std::vector<uint64_t>& ns, size_t bytes, size_t nsamps)
+{
+    bench_stage_t st;
+    memset(&st, 0, sizeof(st));
+    if( ns.empty() ) {
+        return st;
+    }
+    uint64_t total = 0;
+    for (size_t k = 0; k < ns.size(); k++) {
+        total += ns[k];
+    }
+    std::sort(ns.begin(), ns.end());
+    // nearest-rank percentiles
+    size_t n = ns.size();
+    st.min_us = ns[0] * 1e-3;
+    st.p50_us = ns[(n * 50 + 99) / 100 - 1] * 1e-3;
+    st.p90_us = ns[(n * 90 + 99) / 100 - 1] * 1e-3;
+    st.p99_us = ns[(n * 99 + 99) / 100 - 1] * 1e-3;
+    st.max_us = ns[n - 1] * 1e-3;
+    if( total ) {
+        st.mbps = double(bytes) * n / total * 1e3;
+        st.msps = double(nsamps) * n / total * 1e3;
+    }
+    return st;
+}
+
+//!******************************************************
+//! @brief
+//! Runs every stage for one buffer size
+//!
+//!******************************************************
+bool bench_size(int fd, const cmplx_wire_vec_t& tone, cerb_file_writer& fout, size_t nsamps, bench_result_t& res)
+{
+    typedef std::chrono::steady_clock clk;
+
+    size_t wire_bytes = nsamps * sizeof(cmplx_wire_t);
+    size_t iterations = m_iterations ? m_iterations : std::max<size_t>(16, m_bytes_per_size / wire_bytes);
+    cmplx_wire_vec_t   wire(nsamps);
+    cmplx_sample_vec_t samples(nsamps);
+    const void* out = (m_format == CERB_FORMAT_SC16) ? static_cast<const void*>(&wire[0]) : static_cast<const void*>(&samples[0]);
+    size_t out_bytes = nsamps * cerb_format_sample_size(m_format);
+
+    std::vector<uint64_t> ns[BENCH_STAGES];
+    for (int s = 0; s < BENCH_STAGES; s++) {
+        ns[s].reserve(iterations);
+    }
+
+    for (size_t it = 0; it < iterations; it++)
+    {
+        clk::time_point t0 = clk::now();
+        if( fd < 0 ) {
+            memcpy(&wire[0], &tone[0], wire_bytes);
+        }
+        else if( cerb_dma_read(fd, reinterpret_cast<uint8_t*>(&wire[0]), wire_bytes) <= 0 ) {
+            printf("error: dma read of [%zu] bytes failed\n", wire_bytes);
+            return false;
+        }
+        clk::time_point t1 = clk::now();
+        cerb_convert_sc16_to_fc32(&wire[0], &samples[0], nsamps);
+        clk::time_point t2 = clk::now();
+        if( !fout.write(out, out_bytes) ) {
+            return false;
+        }
+        clk::time_point t3 = clk::now();
+
+        ns[0].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+        ns[1].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count());
+        ns[2].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count());
+        // sc16 captures skip the conversion
+        ns[3].push_back(ns[0].back() + ns[2].back() + (m_format == CERB_FORMAT_FC32 ? ns[1].back() : 0));
+    }
+
+    res.buffer_bytes = wire_bytes;
+    res.nsamps       = nsamps;
+    res.iterations   = iterations;
+    res.stages[0] = summarize(ns[0], wire_bytes, nsamps);
+    res.stages[1] = summarize(ns[1], nsamps * sizeof(cmplx_sample_t), nsamps);
+    res.stages[2] = summarize(ns[2], out_bytes, nsamps);
+    res.stages[3] = summarize(ns[3], wire_bytes, nsamps);
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Writes the results as one JSON document
+//!
+//!******************************************************
+bool write_json(const std::vector<bench_result_t>& results, bool direct)
+{
+    FILE* f = (m_json == "-") ? stdout : fopen(m_json.c_str(), "w");
+    if( !f ) {
+        printf("error: failed to open [%s] [%s]\n", m_json.c_str(), strerror(errno));
+        return false;
+    }
+    fprintf(f, "{\n");
+    fprintf(f, "  \"tool\": \"cerb_capture_bench\",\n");
+    fprintf(f, "  \"dma_dev\": \"%s\",\n", m_dma_dev.c_str());
+    fprintf(f, "  \"output\": \"%s\",\n", m_output.c_str());
+    fprintf(f, "  \"format\": \"%s\",\n", cerb_format_name(m_format));
+    fprintf(f, "  \"kernel\": \"%s\",\n", cerb_convert_kernel_name(m_kernel));
+    fprintf(f, "  \"direct_io\": %s,\n", direct ? "true" : "false");
+    fprintf(f, "  \"results\": [\n");
+    for (size_t r = 0; r < results.size(); r++) {
+        const bench_result_t& res = results[r];
+        fprintf(f, "    {\n");
+        fprintf(f, "      \"buffer_bytes\": %zu,\n", res.buffer_bytes);
+        fprintf(f, "      \"nsamps\": %zu,\n", res.nsamps);
+        fprintf(f, "      \"iterations\": %zu,\n", res.iterations);
+        fprintf(f, "      \"stages\": {\n");
+        for (int s = 0; s < BENCH_STAGES; s++) {
+            const bench_stage_t& st = res.stages[s];
+            fprintf(f, "        \"%s\": { \"mbps\": %.3f, \"msps\": %.3f, \"min_us\": %.3f, \"p50_us\": %.3f, "
+                       "\"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f }%s\n",
+                    s_stage_names[s], st.mbps, st.msps, st.min_us, st.p50_us, st.p90_us, st.p99_us, st.max_us,
+                    (s + 1 < BENCH_STAGES) ? "," : "");
+        }
+        fprintf(f, "      }\n");
+        fprintf(f, "    }%s\n", (r + 1 < results.size()) ? "," : "");
+    }
+    fprintf(f, "  ]\n");
+    fprintf(f, "}\n");
+    if( f != stdout ) {
+        return fclose(f) == 0;
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Main entry point
+//!
+//!******************************************************
+int main(int argc, char *argv[])
+{
+    if( !init_options(argc, argv) ) {
+        return 1;
+    }
+
+    // the synthetic producer copies a tone at 1/64 of the sample rate
+    cmplx_wire_vec_t tone;
+    int fd = -1;
+    if( m_dma_dev == BENCH_SYNTHETIC ) {
+        tone.resize(m_max_samps);
+        for (size_t k = 0; k < m_max_samps; k++) {
+            double ph = 2.0 * M_PI * (k % 64) / 64.0;
+            tone[k] = cmplx_wire_t(static_cast<int16_t>(16384 * cos(ph)), static_cast<int16_t>(16384 * sin(ph)));
+        }
+    }
+    else {
+        fd = open(m_dma_dev.c_str(), O_RDWR | O_SYNC);
+        if( fd < 0 ) {
+            fd = open(m_dma_dev.c_str(), O_RDONLY);
+        }
+        if( fd < 0 ) {
+            printf("error: failed to open [%s] [%s]\n", m_dma_dev.c_str(), strerror(errno));
+            return 1;
+        }
+    }
+
+    cerb_file_writer fout;
+    if( !fout.open(m_output, !m_opts.count("buffered")) ) {
+        return 1;
+    }
+    bool direct = fout.is_direct();
+
+    bool human = (m_json != "-");
+    if( human ) {
+        printf("dma [%s] output [%s] format [%s] kernel [%s] %s\n", m_dma_dev.c_str(), m_output.c_str(),
+               cerb_format_name(m_format), cerb_convert_kernel_name(m_kernel),
+               direct ? "O_DIRECT" : "buffered");
+        printf("%10s %8s %-10s %10s %10s %10s %10s %10s\n", "bytes", "iters", "stage", "MB/s", "MSPS", "p50 us", "p99 us", "max us");
+    }
+
+    bool ok = true;
+    std::vector<bench_result_t> results;
+    for (size_t nsamps = m_min_bytes / sizeof(cmplx_wire_t); ok && nsamps <= m_max_samps; nsamps *= 2)
+    {
+        bench_result_t res;
+        ok = bench_size(fd, tone, fout, nsamps, res);
+        if( !ok ) {
+            break;
+        }
+        results.push_back(res);
+        // the writer may have dropped O_DIRECT for an unaligned size
+        direct = direct && fout.is_direct();
+        for (int s = 0; human && s < BENCH_STAGES; s++) {
+            const bench_stage_t& st = res.stages[s];
+            printf("%10zu %8zu %-10s %10.1f %10.1f %10.1f %10.1f %10.1f\n", res.buffer_bytes, res.iterations,
+                   s_stage_names[s], st.mbps, st.msps, st.p50_us, st.p99_us, st.max_us);
+        }
+        // keep the scratch file from filling the disk
+        fout.close();
+        if( !fout.open(m_output, direct) ) {
+            ok = false;
+        }
+    }
+
+    fout.close();
+    unlink(m_output.c_str());
+    if( fd >= 0 ) {
+        close(fd);
+    }
+    if( ok && !m_json.empty() ) {
+        ok = write_json(results, direct);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,586 @@
+//!*********************************************************************
+//! @file cerb_capture_server.cpp
+//!
+//! @brief
+//! Resident capture server for the Cerberus SDR. The DMA channel and
+//! the CWGEN stay open and capture requests are served over TCP and/or
+//! a Unix socket, with the samples sent straight back on the
+//! connection instead of through a file:
+//!
+//!   cerb_capture_server --port 5600 &
+//!   python3 cerb_capture_client.py <board ip>
+//!
+//! Protocol, one request line per capture:
+//!
+//!   CAPTURE <nsamps> [format=sc16|fc32] [cwgen_freq=<hz>] [cwgen_ampl=<n>]
+//!     -> OK <nsamps> <format> <seqno> <timestamp_ns>\n + samples
+//!   INFO
+//!     -> OK backend=<name> sample_rate=<hz> max_nsamps=<n> ...\n
+//!   QUIT
+//!
+//! Errors are answered with "ERR <message>\n". Samples are little
+//! endian complex int16 (sc16) or complex float (fc32); the seqno counts
+//! the CAPTURE requests handled by this server, and the timestamp is the
+//! CLOCK_MONOTONIC completion time of the DMA.
+//!
+//! --backend=loopback replaces the DMA and CWGEN with a software
+//! CWGEN model so the server and its clients can be tested on a PC.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <math.h>
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <sstream>
+#include <memory>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "cerb_common.h"
+#include "cerb_convert.h"
+#include "cerb_cwgen.h"
+#include "cerb_stream.h"
+#include "cerb_writer.h"
+
+#define CERB_CAPTURE_PORT     5600
+#define CERB_CAPTURE_MAX_LINE 256   // longest request line
+#define CERB_CAPTURE_SNDBUF   (4 << 20)
+
+namespace po = boost::program_options;
+
+// globals
+po::variables_map   m_opts;
+int                 m_port = CERB_CAPTURE_PORT;
+std::string         m_unix_path;
+std::string         m_backend_def = "dma";
+std::string         m_dma_dev = CERB_DMA_DEV;
+double              m_freq_hz = 10e6;
+size_t              m_ampl_scale = 1;
+volatile sig_atomic_t m_stop = 0;
+
+//!******************************************************
+//! @brief
+//! Sample source behind the server
+//!
+//!******************************************************
+class capture_backend
+{
+public:
+    virtual ~capture_backend() {}
+    virtual const char* name() const = 0;
+    virtual bool open() = 0;
+    virtual bool set_cwgen(double freq_hz, size_t ampl_scale) = 0;
+    virtual int  capture(cmplx_wire_t* dst, size_t nsamps) = 0;  // 1 ok, 0 timeout, -1 error
+};
+
+//!******************************************************
+//! @brief
+//! cerb_dmarx channel and SDR device, both kept open
+//!
+//!******************************************************
+class dma_backend : public capture_backend
+{
+public:
+    explicit dma_backend(const std::string& dev) : m_dev(dev), m_dma_fd(-1), m_sdr_fd(-1) {}
+    ~dma_backend() {
+        if( m_dma_fd >= 0 ) {
+            close(m_dma_fd);
+        }
+        if( m_sdr_fd >= 0 ) {
+            close(m_sdr_fd);
+        }
+    }
+
+    const char* name() const { return "dma"; }
+
+    bool open() {
+        m_sdr_fd = cerb_cwgen_open();
+        if( m_sdr_fd < 0 ) {
+            return false;
+        }
+        m_dma_fd = ::open(m_dev.c_str(), O_RDWR | O_SYNC);
+        if( m_dma_fd < 0 ) {
+            printf("error: failed to open DMA device [%s].. aborting\n", m_dev.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    bool set_cwgen(double freq_hz, size_t ampl_scale) {
+        return cerb_cwgen_set(m_sdr_fd, freq_hz, 0, ampl_scale);
+    }
+
+    int capture(cmplx_wire_t* dst, size_t nsamps) {
+        return cerb_dma_read(m_dma_fd, reinterpret_cast<uint8_t*>(dst), nsamps * sizeof(cmplx_wire_t));
+    }
+
+private:
+    std::string m_dev;
+    int         m_dma_fd;
+    int         m_sdr_fd;
+};
+
+//!******************************************************
+//! @brief
+//! Software model of the CWGEN: a 16-bit phase
+//! accumulator stepped by the frequency word, phase
+//! continuous across captures
+//!
+//!******************************************************
+class loopback_backend : public capture_backend
+{
+public:
+    loopback_backend() : m_table(1 << CERB_CWGEN_PHASE_BITS), m_freq_word(0), m_phase(0) {}
+
+    const char* name() const { return "loopback"; }
+    bool open() { return true; }
+
+    bool set_cwgen(double freq_hz, size_t ampl_scale) {
+        cerb_cwgen_t msg = cerb_cwgen_settings(freq_hz, 0, ampl_scale);
+        double ampl = 32767.0 / (1 << msg.ampl_scale);
+        for (size_t k = 0; k < m_table.size(); k++) {
+            double ph = 2 * M_PI * k / m_table.size();
+            m_table[k] = cmplx_wire_t(static_cast<int16_t>(std::round(ampl * cos(ph))),
+                                      static_cast<int16_t>(std::round(ampl * sin(ph))));
+        }
+        m_freq_word = msg.freq_word;
+        return true;
+    }
+
+    int capture(cmplx_wire_t* dst, size_t nsamps) {
+        uint32_t mask = m_table.size() - 1;
+        for (size_t k = 0; k < nsamps; k++) {
+            dst[k] = m_table[m_phase & mask];
+            m_phase += m_freq_word;
+        }
+        return 1;
+    }
+
+private:
+    cmplx_wire_vec_t m_table;
+    uint32_t         m_freq_word;
+    uint32_t         m_phase;
+};
+
+//! Connected client and its partial request line
+struct capture_client {
+    int         fd;
+    std::string line;
+};
+
+//!******************************************************
+//! @brief
+//! Handles command line options
+//!
+//!******************************************************
+int init_options(int argc, char *argv[])
+{
+    po::options_description desc("Command Line Options");
+    desc.add_options()
+        ("help,h",     "help message")
+        ("port",       po::value<int>(&m_port)->default_value(m_port),                  "TCP port (0 = no TCP listener)")
+        ("unix",       po::value<std::string>(&m_unix_path),                            "Also listen on this Unix socket path")
+        ("backend",    po::value<std::string>(&m_backend_def)->default_value(m_backend_def), "Sample source: dma (cerb_dmarx + CWGEN) or loopback (software CWGEN model)")
+        ("dma-dev",    po::value<std::string>(&m_dma_dev)->default_value(m_dma_dev),    "DMA device")
+        ("cwgen-freq", po::value<double>(&m_freq_hz)->default_value(m_freq_hz),         "Initial CW Generator baseband frequency in Hz")
+        ("cwgen-ampl", po::value<size_t>(&m_ampl_scale)->default_value(m_ampl_scale),   "Initial CW Generator power-of-2 amplitude scale")
+    ;
+
+    po::store( po::parse_command_line(argc, argv, desc), m_opts);
+    if (m_opts.count("help")){
+        std::cout << "Usage: options_description [options]\n";
+        std::cout << desc;
+        return 0;
+    }
+
+    try {
+        po::notify(m_opts);
+    }
+    catch (std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 0;
+    }
+
+    if( m_backend_def != "dma" && m_backend_def != "loopback" ) {
+        std::cerr << "error: unknown backend [" << m_backend_def << "]\n";
+        return 0;
+    }
+    if( m_port <= 0 && m_unix_path.empty() ) {
+        std::cerr << "error: no TCP port or Unix socket to listen on\n";
+        return 0;
+    }
+    return 1;
+}
+
+void signal_handler( int )
+{
+    m_stop = 1;
+}
+
+//!******************************************************
+//! @brief
+//! Creates the TCP listener, -1 on failure
+//!
+//!******************************************************
+int listen_tcp( int port )
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if( fd < 0 ) {
+        printf("error: socket failed [%s]\n", strerror(errno));
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port        = htons(port);
+    if( bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0 ) {
+        printf("error: failed to listen on port [%d] [%s]\n", port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//!******************************************************
+//! @brief
+//! Creates the Unix socket listener, -1 on failure
+//!
+//!******************************************************
+int listen_unix( const std::string& path )
+{
+    struct sockaddr_un addr;
+    if( path.size() >= sizeof(addr.sun_path) ) {
+        printf("error: socket path too long [%s]\n", path.c_str());
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if( fd < 0 ) {
+        printf("error: socket failed [%s]\n", strerror(errno));
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(path.c_str());
+    if( bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 4) < 0 ) {
+        printf("error: failed to listen on [%s] [%s]\n", path.c_str(), strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool send_all( int fd, const void* data, size_t bytes )
+{
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    while( bytes > 0 )
+    {
+        ssize_t rc = send(fd, ptr, bytes, MSG_NOSIGNAL);
+        if( rc < 0 ) {
+            if( errno == EINTR ) {
+                continue;
+            }
+            return false;
+        }
+        ptr   += rc;
+        bytes -= rc;
+    }
+    return true;
+}
+
+bool send_line( int fd, const std::string& line )
+{
+    std::string out = line + "\n";
+    return send_all(fd, out.data(), out.size());
+}
+
+//!******************************************************
+//! @brief
+//! Capture state shared by all clients; requests are
+//! served one at a time
+//!
+//!******************************************************
+class capture_server
+{
+public:
+    explicit capture_server(capture_backend& backend)
+        : m_backend(backend), m_wire(CERB_MAX_IQ_CNT), m_samples(CERB_MAX_IQ_CNT),
+          m_freq_hz(-1), m_ampl_scale(0), m_seqno(0) {}
+
+    bool set_cwgen(double freq_hz, size_t ampl_scale);
+    bool handle(int fd, const std::string& line);
+
+private:
+    bool capture(int fd, std::istringstream& args);
+
+    capture_backend&   m_backend;
+    cmplx_wire_vec_t   m_wire;
+    cmplx_sample_vec_t m_samples;
+    double             m_freq_hz;      // current CWGEN settings
+    size_t             m_ampl_scale;
+    uint64_t           m_seqno;
+};
+
+//!******************************************************
+//! @brief
+//! Reprograms the CWGEN only when the settings change
+//!
+//!******************************************************
+bool capture_server::set_cwgen(double freq_hz, size_t ampl_scale)
+{
+    if( freq_hz == m_freq_hz && ampl_scale == m_ampl_scale ) {
+        return true;
+    }
+    if( !m_backend.set_cwgen(freq_hz, ampl_scale) ) {
+        return false;
+    }
+    m_freq_hz    = freq_hz;
+    m_ampl_scale = ampl_scale;
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Serves one CAPTURE request. Returns false when the
+//! connection has to be dropped.
+//!
+//!******************************************************
+bool capture_server::capture(int fd, std::istringstream& args)
+{
+    size_t        nsamps = 0;
+    cerb_format_e format = CERB_FORMAT_SC16;
+    double        freq_hz = m_freq_hz;
+    size_t        ampl_scale = m_ampl_scale;
+
+    if( !(args >> nsamps) || !nsamps || nsamps > CERB_MAX_IQ_CNT ) {
+        return send_line(fd, "ERR nsamps must be between 1 and " + std::to_string(CERB_MAX_IQ_CNT));
+    }
+    std::string opt;
+    while( args >> opt ) {
+        size_t eq = opt.find('=');
+        std::string key = opt.substr(0, eq);
+        std::string val = (eq == std::string::npos) ? "" : opt.substr(eq + 1);
+        char* end = nullptr;
+        if( key == "format" && cerb_format_parse(val, format) ) {
+            continue;
+        }
+        else if( key == "cwgen_freq" ) {
+            freq_hz = strtod(val.c_str(), &end);
+        }
+        else if( key == "cwgen_ampl" ) {
+            ampl_scale = strtoul(val.c_str(), &end, 10);
+        }
+        if( !end || val.empty() || *end != '\0' ) {
+            return send_line(fd, "ERR bad option " + opt);
+        }
+    }
+
+    if( !set_cwgen(freq_hz, ampl_scale) ) {
+        return send_line(fd, "ERR cwgen configuration failed");
+    }
+    int rc = m_backend.capture(&m_wire[0], nsamps);
+    uint64_t timestamp_ns = cerb_monotonic_ns();
+    uint64_t seqno = m_seqno++;
+    if( rc <= 0 ) {
+        return send_line(fd, rc ? "ERR dma error" : "ERR dma timeout");
+    }
+
+    char hdr[128];
+    snprintf(hdr, sizeof(hdr), "OK %zu %s %llu %llu", nsamps, cerb_format_name(format),
+             (unsigned long long)seqno, (unsigned long long)timestamp_ns);
+    if( !send_line(fd, hdr) ) {
+        return false;
+    }
+    if( format == CERB_FORMAT_SC16 ) {
+        return send_all(fd, &m_wire[0], nsamps * sizeof(cmplx_wire_t));
+    }
+    cerb_convert_sc16_to_fc32(&m_wire[0], &m_samples[0], nsamps);
+    return send_all(fd, &m_samples[0], nsamps * sizeof(cmplx_sample_t));
+}
+
+//!******************************************************
+//! @brief
+//! Dispatches one request line. Returns false when the
+//! connection has to be closed.
+//!
+//!******************************************************
+bool capture_server::handle(int fd, const std::string& line)
+{
+    std::istringstream args(line);
+    std::string cmd;
+    if( !(args >> cmd) ) {
+        return true;
+    }
+    if( cmd == "CAPTURE" ) {
+        return capture(fd, args);
+    }
+    if( cmd == "INFO" ) {
+        char info[160];
+        snprintf(info, sizeof(info), "OK backend=%s sample_rate=%.0f max_nsamps=%d cwgen_freq=%.1f cwgen_ampl=%zu",
+                 m_backend.name(), CERB_SAMP_RATE, CERB_MAX_IQ_CNT, m_freq_hz, m_ampl_scale);
+        return send_line(fd, info);
+    }
+    if( cmd == "QUIT" ) {
+        return false;
+    }
+    return send_line(fd, "ERR unknown command " + cmd);
+}
+
+//!******************************************************
+//! @brief
+//! Reads what the client sent and serves every complete
+//! request line. Returns false once the client is gone.
+//!
+//!******************************************************
+bool serve_client( capture_server& server, capture_client& client )
+{
+    char buf[CERB_CAPTURE_MAX_LINE];
+    ssize_t n = recv(client.fd, buf, sizeof(buf), 0);
+    if( n < 0 && errno == EINTR ) {
+        return true;
+    }
+    if( n <= 0 ) {
+        return false;
+    }
+    client.line.append(buf, n);
+
+    size_t eol;
+    while( (eol = client.line.find('\n')) != std::string::npos ) {
+        std::string line = client.line.substr(0, eol);
+        client.line.erase(0, eol + 1);
+        if( !server.handle(client.fd, line) ) {
+            return false;
+        }
+    }
+    if( client.line.size() > CERB_CAPTURE_MAX_LINE ) {
+        send_line(client.fd, "ERR request too long");
+        return false;
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Main entry point
+//!
+//!******************************************************
+int main(int argc, char *argv[])
+{
+    if( !init_options(argc, argv) ) {
+        return 1;
+    }
+
+    std::unique_ptr<capture_backend> backend;
+    if( m_backend_def == "loopback" ) {
+        backend.reset(new loopback_backend());
+    }
+    else {
+        backend.reset(new dma_backend(m_dma_dev));
+    }
+    if( !backend->open() ) {
+        return 1;
+    }
+
+    capture_server server(*backend);
+    if( !server.set_cwgen(m_freq_hz, m_ampl_scale) ) {
+        printf("error: failed to configure CWGEN... aborting\n");
+        return 1;
+    }
+
+    std::vector<int> listeners;
+    if( m_port > 0 ) {
+        int fd = listen_tcp(m_port);
+        if( fd < 0 ) {
+            return 1;
+        }
+        listeners.push_back(fd);
+    }
+    if( !m_unix_path.empty() ) {
+        int fd = listen_unix(m_unix_path);
+        if( fd < 0 ) {
+            return 1;
+        }
+        listeners.push_back(fd);
+    }
+    printf("serving [%s] captures on port [%d]%s%s\n", backend->name(), m_port,
+           m_unix_path.empty() ? "" : " and ", m_unix_path.c_str());
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigaction(SIGINT,  &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    std::vector<capture_client> clients;
+    while( !m_stop )
+    {
+        std::vector<struct pollfd> pfds;
+        for (size_t k = 0; k < listeners.size(); k++) {
+            struct pollfd p = { listeners[k], POLLIN, 0 };
+            pfds.push_back(p);
+        }
+        for (size_t k = 0; k < clients.size(); k++) {
+            struct pollfd p = { clients[k].fd, POLLIN, 0 };
+            pfds.push_back(p);
+        }
+        if( poll(&pfds[0], pfds.size(), -1) < 0 ) {
+            if( errno == EINTR ) {
+                continue;
+            }
+            printf("error: poll failed [%s]\n", strerror(errno));
+            break;
+        }
+
+        // serve existing clients first, new ones are appended behind them
+        for (size_t k = clients.size(); k-- > 0; ) {
+            if( !(pfds[listeners.size() + k].revents & (POLLIN | POLLHUP | POLLERR)) ) {
+                continue;
+            }
+            if( !serve_client(server, clients[k]) ) {
+                close(clients[k].fd);
+                clients.erase(clients.begin() + k);
+            }
+        }
+        for (size_t k = 0; k < listeners.size(); k++) {
+            if( !(pfds[k].revents & POLLIN) ) {
+                continue;
+            }
+            int fd = accept(listeners[k], NULL, NULL);
+            if( fd < 0 ) {
+                continue;
+            }
+            int one = 1;
+            int sndbuf = CERB_CAPTURE_SNDBUF;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+            capture_client client = { fd, std::string() };
+            clients.push_back(client);
+        }
+    }
+
+    for (size_t k = 0; k < clients.size(); k++) {
+        close(clients[k].fd);
+    }
+    for (size_t k = 0; k < listeners.size(); k++) {
+        close(listeners[k]);
+    }
+    if( !m_unix_path.empty() ) {
+        unlink(m_unix_path.c_str());
+    }
+    printf("Done\n");
+    return 0;
+}
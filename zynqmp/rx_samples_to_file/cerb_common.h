@@ -0,0 +1,62 @@
+//!*********************************************************************
+//! @file cerb_common.h
+//!
+//! @brief
+//! Sample types and device constants shared by the Cerberus SDR
+//! capture applications.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_COMMON_H_
+#define CERB_COMMON_H_
+
+#include <complex>
+#include <vector>
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+
+#define CERB_PAGE_ALIGN 4096 // DMA and O_DIRECT buffer alignment
+
+//!******************************************************
+//! @brief
+//! Page aligned allocator so sample buffers can be
+//! handed to O_DIRECT writes and DMA mappings as-is
+//!
+//!******************************************************
+template <typename T>
+struct cerb_page_allocator {
+    typedef T value_type;
+
+    cerb_page_allocator() {}
+    template <typename U> cerb_page_allocator(const cerb_page_allocator<U>&) {}
+
+    T* allocate(size_t n) {
+        void* p = nullptr;
+        if( posix_memalign(&p, CERB_PAGE_ALIGN, n * sizeof(T)) ) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+    void deallocate(T* p, size_t) { free(p); }
+};
+
+template <typename T, typename U>
+bool operator==(const cerb_page_allocator<T>&, const cerb_page_allocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const cerb_page_allocator<T>&, const cerb_page_allocator<U>&) { return false; }
+
+typedef std::complex<int16_t>                                             cmplx_wire_t;
+typedef std::complex<float>                                               cmplx_sample_t;
+typedef std::vector<cmplx_wire_t, cerb_page_allocator<cmplx_wire_t> >     cmplx_wire_vec_t;
+typedef std::vector<cmplx_sample_t, cerb_page_allocator<cmplx_sample_t> > cmplx_sample_vec_t;
+
+#define CERB_IQ_SCALE   (1.0f / 32768.0f)
+#define CERB_MAX_IQ_CNT (1 << 20)
+#define CERB_SAMP_RATE  500e6
+#define CERB_CENTER_FREQ 250e6 // ADC[0] band center
+#define CERB_SDR_DEV    "/dev/cerberus-sdr"
+#define CERB_DMA_DEV    "/dev/cerb_dmarx_ch0"
+
+#endif /* CERB_COMMON_H_ */
@@ -0,0 +1,222 @@
+//!*********************************************************************
+//! @file cerb_convert.cpp
+//!
+//! @brief
+//! Wire to complex float conversion kernels. See cerb_convert.h.
+//!
+//! The conversion is exact: every int16 is representable as a float and
+//! the scale is a power of two, so the SIMD kernels match the scalar
+//! reference bit for bit.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include "cerb_convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CERB_CONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define CERB_CONVERT_ARM 1
+#include <arm_neon.h>
+#endif
+
+//!******************************************************
+//! @brief
+//! Scalar reference kernel
+//!
+//!******************************************************
+static void convert_scalar(const cmplx_wire_t* wire, cmplx_sample_t* samples, size_t nsamps)
+{
+    for (size_t k = 0; k < nsamps; k++) {
+        samples[k] = std::complex<float>(static_cast<float>(wire[k].real()) * CERB_IQ_SCALE,
+                                         static_cast<float>(wire[k].imag()) * CERB_IQ_SCALE);
+    }
+}
+
+#ifdef CERB_CONVERT_X86
+//!******************************************************
+//! @brief
+//! SSE2 kernel, 4 complex samples per iteration
+//!
+//!******************************************************
+__attribute__((target("sse2")))
+static void convert_sse2(const cmplx_wire_t* wire, cmplx_sample_t* samples, size_t nsamps)
+{
+    const int16_t* in  = reinterpret_cast<const int16_t*>(wire);
+    float*         out = reinterpret_cast<float*>(samples);
+    const __m128   scale = _mm_set1_ps(CERB_IQ_SCALE);
+
+    size_t k = 0;
+    for (; k + 4 <= nsamps; k += 4) {
+        __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[2*k]));
+        // sign extend by placing each int16 in the upper half and shifting down
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(&out[2*k],     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(&out[2*k + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    convert_scalar(&wire[k], &samples[k], nsamps - k);
+}
+
+//!******************************************************
+//! @brief
+//! AVX2 kernel, 8 complex samples per iteration
+//!
+//!******************************************************
+__attribute__((target("avx2")))
+static void convert_avx2(const cmplx_wire_t* wire, cmplx_sample_t* samples, size_t nsamps)
+{
+    const int16_t* in  = reinterpret_cast<const int16_t*>(wire);
+    float*         out = reinterpret_cast<float*>(samples);
+    const __m256   scale = _mm256_set1_ps(CERB_IQ_SCALE);
+
+    size_t k = 0;
+    for (; k + 8 <= nsamps; k += 8) {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[2*k]));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[2*k + 8]));
+        __m256  f0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v0));
+        __m256  f1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v1));
+        _mm256_storeu_ps(&out[2*k],     _mm256_mul_ps(f0, scale));
+        _mm256_storeu_ps(&out[2*k + 8], _mm256_mul_ps(f1, scale));
+    }
+    convert_sse2(&wire[k], &samples[k], nsamps - k);
+}
+#endif
+
+#ifdef CERB_CONVERT_ARM
+//!******************************************************
+//! @brief
+//! NEON kernel, 8 complex samples per iteration
+//!
+//!******************************************************
+static void convert_neon(const cmplx_wire_t* wire, cmplx_sample_t* samples, size_t nsamps)
+{
+    const int16_t* in  = reinterpret_cast<const int16_t*>(wire);
+    float*         out = reinterpret_cast<float*>(samples);
+
+    size_t k = 0;
+    for (; k + 8 <= nsamps; k += 8) {
+        int16x8_t v0 = vld1q_s16(&in[2*k]);
+        int16x8_t v1 = vld1q_s16(&in[2*k + 8]);
+        vst1q_f32(&out[2*k],      vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v0))),  CERB_IQ_SCALE));
+        vst1q_f32(&out[2*k + 4],  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v0))), CERB_IQ_SCALE));
+        vst1q_f32(&out[2*k + 8],  vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v1))),  CERB_IQ_SCALE));
+        vst1q_f32(&out[2*k + 12], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v1))), CERB_IQ_SCALE));
+    }
+    convert_scalar(&wire[k], &samples[k], nsamps - k);
+}
+#endif
+
+// selected kernel, resolved on first use
+static std::atomic<cerb_convert_fn_t> s_convert(nullptr);
+
+//!******************************************************
+//! @brief
+//! Returns the kernel if it is built in and supported by
+//! the running CPU, nullptr otherwise
+//!
+//!******************************************************
+cerb_convert_fn_t cerb_convert_kernel(cerb_convert_kernel_e kernel)
+{
+#ifdef CERB_CONVERT_X86
+    __builtin_cpu_init();
+#endif
+    switch( kernel ) {
+    case CERB_CONVERT_SCALAR:
+        return convert_scalar;
+#ifdef CERB_CONVERT_X86
+    case CERB_CONVERT_SSE2:
+        return __builtin_cpu_supports("sse2") ? convert_sse2 : nullptr;
+    case CERB_CONVERT_AVX2:
+        return __builtin_cpu_supports("avx2") ? convert_avx2 : nullptr;
+#endif
+#ifdef CERB_CONVERT_ARM
+    case CERB_CONVERT_NEON:
+        return convert_neon;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Returns the fastest kernel supported by the CPU
+//!
+//!******************************************************
+cerb_convert_kernel_e cerb_convert_best_kernel()
+{
+    static const cerb_convert_kernel_e order[] = {
+        CERB_CONVERT_AVX2, CERB_CONVERT_NEON, CERB_CONVERT_SSE2
+    };
+    for (size_t k = 0; k < sizeof(order)/sizeof(order[0]); k++) {
+        if( cerb_convert_kernel(order[k]) ) {
+            return order[k];
+        }
+    }
+    return CERB_CONVERT_SCALAR;
+}
+
+//!******************************************************
+//! @brief
+//! Overrides the kernel used by cerb_convert_sc16_to_fc32
+//!
+//!******************************************************
+bool cerb_convert_select(cerb_convert_kernel_e kernel)
+{
+    cerb_convert_fn_t fn = cerb_convert_kernel(kernel);
+    if( !fn ) {
+        return false;
+    }
+    s_convert = fn;
+    return true;
+}
+
+const char* cerb_convert_kernel_name(cerb_convert_kernel_e kernel)
+{
+    switch( kernel ) {
+    case CERB_CONVERT_SCALAR: return "scalar";
+    case CERB_CONVERT_SSE2:   return "sse2";
+    case CERB_CONVERT_AVX2:   return "avx2";
+    case CERB_CONVERT_NEON:   return "neon";
+    default:                  return "unknown";
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Converts wire samples to normalized complex floats
+//! using the selected kernel
+//!
+//!******************************************************
+void cerb_convert_sc16_to_fc32(const cmplx_wire_t* wire, cmplx_sample_t* samples, size_t nsamps)
+{
+    cerb_convert_fn_t fn = s_convert.load(std::memory_order_relaxed);
+    if( !fn ) {
+        fn = cerb_convert_kernel(cerb_convert_best_kernel());
+        s_convert = fn;
+    }
+    fn(wire, samples, nsamps);
+}
+
+//!******************************************************
+//! @brief
+//! Converts normalized complex floats back to wire
+//! samples, rounded and saturated. Used on decimated
+//! output only, so there is no SIMD kernel.
+//!
+//!******************************************************
+void cerb_convert_fc32_to_sc16(const cmplx_sample_t* samples, cmplx_wire_t* wire, size_t nsamps)
+{
+    for (size_t k = 0; k < nsamps; k++) {
+        float i = std::min(std::max(samples[k].real() * 32768.0f, -32768.0f), 32767.0f);
+        float q = std::min(std::max(samples[k].imag() * 32768.0f, -32768.0f), 32767.0f);
+        wire[k] = cmplx_wire_t(static_cast<int16_t>(lrintf(i)), static_cast<int16_t>(lrintf(q)));
+    }
+}
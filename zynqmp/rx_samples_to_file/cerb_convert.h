@@ -0,0 +1,34 @@
+//!*********************************************************************
+//! @file cerb_convert.h
+//!
+//! @brief
+//! Wire (complex int16) to normalized complex float conversion. The
+//! fastest kernel supported by the running CPU is selected at runtime;
+//! every kernel produces bit-identical output to the scalar reference.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_CONVERT_H_
+#define CERB_CONVERT_H_
+
+#include "cerb_common.h"
+
+typedef void (*cerb_convert_fn_t)(const cmplx_wire_t* wire, cmplx_sample_t* samples, size_t nsamps);
+
+typedef enum {
+    CERB_CONVERT_SCALAR = 0,
+    CERB_CONVERT_SSE2,
+    CERB_CONVERT_AVX2,
+    CERB_CONVERT_NEON,
+    CERB_CONVERT_NOF_KERNELS
+} cerb_convert_kernel_e;
+
+void                 cerb_convert_sc16_to_fc32(const cmplx_wire_t* wire, cmplx_sample_t* samples, size_t nsamps);
+void                 cerb_convert_fc32_to_sc16(const cmplx_sample_t* samples, cmplx_wire_t* wire, size_t nsamps);
+cerb_convert_fn_t    cerb_convert_kernel(cerb_convert_kernel_e kernel);
+cerb_convert_kernel_e cerb_convert_best_kernel();
+bool                 cerb_convert_select(cerb_convert_kernel_e kernel);
+const char*          cerb_convert_kernel_name(cerb_convert_kernel_e kernel);
+
+#endif /* CERB_CONVERT_H_ */
@@ -0,0 +1,62 @@
+//!*********************************************************************
+//! @file cerb_cwgen.cpp
+//!
+//! @brief
+//! AXI CW generator control. See cerb_cwgen.h.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <math.h>
+#include <cstdio>
+#include <fcntl.h>
+#include "cerb_common.h"
+#include "cerb_cwgen.h"
+
+//!******************************************************
+//! @brief
+//! Register words for a tone at freq_hz (fs=500MHz)
+//!
+//!******************************************************
+cerb_cwgen_t cerb_cwgen_settings(double freq_hz, double phase, size_t ampl_scale)
+{
+    int32_t freq_word  = std::round(freq_hz / CERB_SAMP_RATE * (1 << CERB_CWGEN_PHASE_BITS));
+    int32_t phase_word = std::round(phase / (2*M_PI) * (1 << CERB_CWGEN_PHASE_BITS));
+    cerb_cwgen_t msg = {
+        0,
+        static_cast<uint32_t>(freq_word),
+        static_cast<uint32_t>(phase_word),
+        static_cast<uint32_t>(ampl_scale & CERB_CWGEN_AMPL_MASK),
+    };
+    return msg;
+}
+
+//!******************************************************
+//! @brief
+//! Opens the SDR control device, -1 on failure
+//!
+//!******************************************************
+int cerb_cwgen_open()
+{
+    int fd = open(CERB_SDR_DEV, O_RDWR | O_SYNC);
+    if( fd < 0 ) {
+        printf("error: failed to open SDR device.. aborting\n");
+    }
+    return fd;
+}
+
+//!******************************************************
+//! @brief
+//! Programs the CW generator through an open SDR device
+//!
+//!******************************************************
+bool cerb_cwgen_set(int fd, double freq_hz, double phase, size_t ampl_scale)
+{
+    cerb_cwgen_t msg = cerb_cwgen_settings(freq_hz, phase, ampl_scale);
+    int rc = ioctl(fd, CERB_IOCTL_CWGEN, (void*)&msg);
+    if( rc < 0 ){
+        printf("failed to call [CERB_IOCTL_CWGEN] => [%d]\n", rc);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,32 @@
+//!*********************************************************************
+//! @file cerb_cwgen.h
+//!
+//! @brief
+//! AXI CW generator control through the Cerberus SDR driver.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_CWGEN_H_
+#define CERB_CWGEN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <sys/ioctl.h>
+
+typedef struct __attribute__((__packed__)) {
+    uint32_t     mute;       // not supported
+    uint32_t     freq_word;
+    uint32_t     phase_word;
+    uint32_t     ampl_scale;
+} cerb_cwgen_t;
+#define CERB_IOCTL_CWGEN     _IOW('C', 2, struct cerberus_cwgen_t*)
+
+#define CERB_CWGEN_PHASE_BITS 16      // frequency/phase word resolution
+#define CERB_CWGEN_AMPL_MASK  0x1F
+
+cerb_cwgen_t cerb_cwgen_settings(double freq_hz, double phase, size_t ampl_scale);
+int          cerb_cwgen_open();
+bool         cerb_cwgen_set(int fd, double freq_hz, double phase, size_t ampl_scale);
+
+#endif /* CERB_CWGEN_H_ */
@@ -0,0 +1,240 @@
+//!*********************************************************************
+//! @file cerb_ddc.cpp
+//!
+//! @brief
+//! Digital down converter. See cerb_ddc.h.
+//!
+//! The mixer writes planar I and Q so the FIR kernels are plain real
+//! dot products. The NCO recomputes its phasor in double precision at
+//! the start of every chunk and steps through a table inside it, so
+//! the phase error does not grow with the length of the capture.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <math.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include "cerb_ddc.h"
+
+#if defined(__SSE2__)
+#define CERB_DDC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define CERB_DDC_NEON 1
+#include <arm_neon.h>
+#endif
+
+//!******************************************************
+//! @brief
+//! Mixes n wire samples with e^-j(a + w k): c0/s0 are
+//! cos/sin(a), already scaled to full scale, and tc/ts
+//! cos/sin(w k). Writes planar I and Q.
+//!
+//!******************************************************
+static void nco_mix(const cmplx_wire_t* x, size_t n, const float* tc, const float* ts,
+                    float c0, float s0, float* re, float* im)
+{
+    const int16_t* in = reinterpret_cast<const int16_t*>(x);
+    size_t k = 0;
+#if defined(CERB_DDC_SSE2)
+    const __m128 vc0 = _mm_set1_ps(c0);
+    const __m128 vs0 = _mm_set1_ps(s0);
+    for (; k + 4 <= n; k += 4) {
+        __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[2*k]));
+        __m128  f0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));  // I0 Q0 I1 Q1
+        __m128  f1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));  // I2 Q2 I3 Q3
+        __m128  i  = _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128  q  = _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1));
+        __m128  c  = _mm_loadu_ps(&tc[k]);
+        __m128  s  = _mm_loadu_ps(&ts[k]);
+        __m128  pc = _mm_sub_ps(_mm_mul_ps(vc0, c), _mm_mul_ps(vs0, s));
+        __m128  ps = _mm_add_ps(_mm_mul_ps(vs0, c), _mm_mul_ps(vc0, s));
+        _mm_storeu_ps(&re[k], _mm_add_ps(_mm_mul_ps(i, pc), _mm_mul_ps(q, ps)));
+        _mm_storeu_ps(&im[k], _mm_sub_ps(_mm_mul_ps(q, pc), _mm_mul_ps(i, ps)));
+    }
+#elif defined(CERB_DDC_NEON)
+    for (; k + 4 <= n; k += 4) {
+        int16x4x2_t v  = vld2_s16(&in[2*k]);                     // deinterleaves I and Q
+        float32x4_t i  = vcvtq_f32_s32(vmovl_s16(v.val[0]));
+        float32x4_t q  = vcvtq_f32_s32(vmovl_s16(v.val[1]));
+        float32x4_t c  = vld1q_f32(&tc[k]);
+        float32x4_t s  = vld1q_f32(&ts[k]);
+        float32x4_t pc = vmlsq_n_f32(vmulq_n_f32(c, c0), s, s0);
+        float32x4_t ps = vmlaq_n_f32(vmulq_n_f32(c, s0), s, c0);
+        vst1q_f32(&re[k], vmlaq_f32(vmulq_f32(i, pc), q, ps));
+        vst1q_f32(&im[k], vmlsq_f32(vmulq_f32(q, pc), i, ps));
+    }
+#endif
+    for (; k < n; k++) {
+        float i  = in[2*k];
+        float q  = in[2*k + 1];
+        float pc = c0 * tc[k] - s0 * ts[k];
+        float ps = s0 * tc[k] + c0 * ts[k];
+        re[k] = i * pc + q * ps;
+        im[k] = q * pc - i * ps;
+    }
+}
+
+//!******************************************************
+//! @brief
+//! One filter output: taps h against n planar samples
+//!
+//!******************************************************
+static void fir_dot(const float* h, const float* re, const float* im, size_t n, float& yr, float& yi)
+{
+    size_t k = 0;
+    float  sr = 0.0f;
+    float  si = 0.0f;
+#if defined(CERB_DDC_SSE2)
+    __m128 ar = _mm_setzero_ps();
+    __m128 ai = _mm_setzero_ps();
+    for (; k + 4 <= n; k += 4) {
+        __m128 t = _mm_loadu_ps(&h[k]);
+        ar = _mm_add_ps(ar, _mm_mul_ps(t, _mm_loadu_ps(&re[k])));
+        ai = _mm_add_ps(ai, _mm_mul_ps(t, _mm_loadu_ps(&im[k])));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, ar);
+    sr = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm_storeu_ps(lanes, ai);
+    si = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(CERB_DDC_NEON)
+    float32x4_t ar = vdupq_n_f32(0.0f);
+    float32x4_t ai = vdupq_n_f32(0.0f);
+    for (; k + 4 <= n; k += 4) {
+        float32x4_t t = vld1q_f32(&h[k]);
+        ar = vmlaq_f32(ar, t, vld1q_f32(&re[k]));
+        ai = vmlaq_f32(ai, t, vld1q_f32(&im[k]));
+    }
+    sr = (vgetq_lane_f32(ar, 0) + vgetq_lane_f32(ar, 1)) + (vgetq_lane_f32(ar, 2) + vgetq_lane_f32(ar, 3));
+    si = (vgetq_lane_f32(ai, 0) + vgetq_lane_f32(ai, 1)) + (vgetq_lane_f32(ai, 2) + vgetq_lane_f32(ai, 3));
+#endif
+    for (; k < n; k++) {
+        sr += h[k] * re[k];
+        si += h[k] * im[k];
+    }
+    yr = sr;
+    yi = si;
+}
+
+cerb_ddc::cerb_ddc()
+    : m_decim(1), m_max_in(0), m_step(0), m_phase(0), m_next(0)
+{
+}
+
+//!******************************************************
+//! @brief
+//! Designs the filter and NCO tables. max_in is the
+//! largest block process() handles in one pass.
+//!
+//!******************************************************
+bool cerb_ddc::configure(const cerb_ddc_config_t& cfg, size_t max_in)
+{
+    if( !cfg.decim || !cfg.taps_per_phase || !max_in ) {
+        printf("error: decimation, taps per phase and block size must be at least 1\n");
+        return false;
+    }
+    if( fabs(cfg.center_freq_hz) > CERB_SAMP_RATE / 2 ) {
+        printf("error: center frequency [%.0f] outside +/-[%.0f] Hz\n", cfg.center_freq_hz, CERB_SAMP_RATE / 2);
+        return false;
+    }
+
+    m_decim  = cfg.decim;
+    m_max_in = max_in;
+
+    // windowed sinc, cutoff at the output Nyquist frequency, unity DC gain
+    size_t ntaps = (m_decim > 1) ? m_decim * cfg.taps_per_phase : 1;
+    std::vector<double> h(ntaps, 1.0);
+    if( ntaps > 1 ) {
+        double mid = (ntaps - 1) / 2.0;
+        double sum = 0;
+        for (size_t k = 0; k < ntaps; k++) {
+            double t = (k - mid) / m_decim;
+            double w = 2 * M_PI * k / (ntaps - 1);
+            double sinc = (t == 0) ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            h[k] = sinc * (0.42 - 0.5 * cos(w) + 0.08 * cos(2 * w));
+            sum += h[k];
+        }
+        for (size_t k = 0; k < ntaps; k++) {
+            h[k] /= sum;
+        }
+    }
+    m_taps.resize(ntaps);
+    for (size_t k = 0; k < ntaps; k++) {
+        m_taps[k] = static_cast<float>(h[ntaps - 1 - k]);
+    }
+
+    m_step = cfg.center_freq_hz / CERB_SAMP_RATE;
+    m_cos.resize(CERB_DDC_NCO_CHUNK);
+    m_sin.resize(CERB_DDC_NCO_CHUNK);
+    for (size_t k = 0; k < CERB_DDC_NCO_CHUNK; k++) {
+        double a = 2 * M_PI * fmod(m_step * k, 1.0);
+        m_cos[k] = static_cast<float>(cos(a));
+        m_sin[k] = static_cast<float>(sin(a));
+    }
+
+    m_re.resize(ntaps - 1 + max_in);
+    m_im.resize(ntaps - 1 + max_in);
+    reset();
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Clears the filter history and NCO phase
+//!
+//!******************************************************
+void cerb_ddc::reset()
+{
+    std::fill(m_re.begin(), m_re.end(), 0.0f);
+    std::fill(m_im.begin(), m_im.end(), 0.0f);
+    m_phase = 0;
+    m_next  = 0;
+}
+
+//!******************************************************
+//! @brief
+//! Down converts n wire samples into y, which must hold
+//! max_output(n) samples. Returns the outputs written.
+//!
+//!******************************************************
+size_t cerb_ddc::process(const cmplx_wire_t* x, size_t n, cmplx_sample_t* y)
+{
+    const size_t ntaps = m_taps.size();
+    const size_t hist  = ntaps - 1;
+    size_t out = 0;
+
+    while( n ) {
+        size_t len = std::min(n, m_max_in);
+
+        for (size_t k = 0; k < len; k += CERB_DDC_NCO_CHUNK) {
+            size_t chunk = std::min<size_t>(CERB_DDC_NCO_CHUNK, len - k);
+            double a = 2 * M_PI * m_phase;
+            nco_mix(&x[k], chunk, &m_cos[0], &m_sin[0],
+                    static_cast<float>(cos(a)) * CERB_IQ_SCALE, static_cast<float>(sin(a)) * CERB_IQ_SCALE,
+                    &m_re[hist + k], &m_im[hist + k]);
+            m_phase += m_step * chunk;
+            m_phase -= floor(m_phase);
+        }
+
+        for (; m_next + ntaps <= hist + len; m_next += m_decim) {
+            float yr, yi;
+            fir_dot(&m_taps[0], &m_re[m_next], &m_im[m_next], ntaps, yr, yi);
+            y[out++] = cmplx_sample_t(yr, yi);
+        }
+
+        // the last ntaps - 1 samples become the history of the next pass
+        if( hist ) {
+            memmove(&m_re[0], &m_re[len], hist * sizeof(float));
+            memmove(&m_im[0], &m_im[len], hist * sizeof(float));
+        }
+        m_next -= len;
+        x += len;
+        n -= len;
+    }
+    return out;
+}
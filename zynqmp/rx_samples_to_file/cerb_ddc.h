@@ -0,0 +1,67 @@
+//!*********************************************************************
+//! @file cerb_ddc.h
+//!
+//! @brief
+//! Digital down converter run by the writer thread between the DMA
+//! buffer and the capture file. The wire samples are mixed down by an
+//! NCO so that --center-freq lands at 0 Hz, then low pass filtered and
+//! decimated by a polyphase FIR; only every decim-th filter output is
+//! computed. The output sample rate is CERB_SAMP_RATE / decim.
+//!
+//! The filter is a Blackman windowed sinc of decim * taps_per_phase
+//! taps with its cutoff at the output Nyquist frequency; the central
+//! ~2/3 of the output band is free of aliases (> 70 dB down) at the
+//! default 16 taps per phase.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_DDC_H_
+#define CERB_DDC_H_
+
+#include <vector>
+#include "cerb_common.h"
+
+#define CERB_DDC_DEFAULT_TAPS 16     // FIR taps per polyphase branch
+#define CERB_DDC_NCO_CHUNK    1024   // samples per NCO table pass
+
+//! Down converter settings
+typedef struct {
+    size_t decim;            // 1 = mix only
+    double center_freq_hz;   // baseband frequency moved to 0 Hz, |f| <= fs/2
+    size_t taps_per_phase;
+} cerb_ddc_config_t;
+
+//!******************************************************
+//! @brief
+//! NCO mix-down and decimating FIR, one stream. State
+//! carries across calls, blocks of any size can be fed.
+//!
+//!******************************************************
+class cerb_ddc
+{
+public:
+    cerb_ddc();
+
+    bool   configure(const cerb_ddc_config_t& cfg, size_t max_in);
+    void   reset();
+    size_t process(const cmplx_wire_t* x, size_t n, cmplx_sample_t* y);
+
+    size_t max_output(size_t n) const { return n / m_decim + 1; }
+    double sample_rate() const        { return CERB_SAMP_RATE / m_decim; }
+    size_t ntaps() const              { return m_taps.size(); }
+
+private:
+    size_t              m_decim;
+    size_t              m_max_in;
+    std::vector<float>  m_taps;     // time reversed, dot product runs forward
+    std::vector<float>  m_cos;      // NCO phase steps over one chunk
+    std::vector<float>  m_sin;
+    double              m_step;     // NCO cycles per sample
+    double              m_phase;    // NCO phase at the next input, cycles
+    std::vector<float>  m_re;       // ntaps - 1 history + max_in mixed samples
+    std::vector<float>  m_im;
+    size_t              m_next;     // window start of the next output in m_re/m_im
+};
+
+#endif /* CERB_DDC_H_ */
@@ -0,0 +1,683 @@
+//!*********************************************************************
+//! @file cerb_dev_sim.cpp
+//!
+//! @brief
+//! LD_PRELOAD simulator of /dev/cerberus-sdr and /dev/cerb_dmarx_ch*,
+//! so the capture tools run unmodified on a PC for benchmarks and
+//! soak tests:
+//!
+//!   LD_PRELOAD=libcerb_dev_sim.so rx_samples_to_file --duration 60
+//!
+//! open() of a simulated device returns a placeholder descriptor and
+//! the calls the tools make on it are served here:
+//!  - ioctl(CERB_IOCTL_CWGEN) on the SDR device programs a software
+//!    model of the CW generator (16-bit phase accumulator, power-of-2
+//!    amplitude, like the capture server loopback backend)
+//!  - read() on a DMA channel returns the generated tone
+//!  - the mapped interface (MAP_INFO, mmap, QBUF/DQBUF, poll, STREAMON
+//!    and STREAMOFF) completes buffers in sequence, dropping blocks
+//!    when no buffer is queued like the driver does
+//!  - splice() fails with EINVAL so writers fall back to read()
+//!
+//! Environment:
+//!   CERB_SIM_RATE           samples/s per channel, 0 = unthrottled (500e6)
+//!   CERB_SIM_NOISE_DBFS     complex gaussian noise power, off when unset
+//!   CERB_SIM_TIMEOUT_EVERY  every Nth transfer times out, 0 = never (0)
+//!   CERB_SIM_TIMEOUT_MS     time a timed out transfer blocks (100)
+//!   CERB_SIM_BUFFERS        mapped buffers (16)
+//!   CERB_SIM_BUFFER_SIZE    mapped buffer bytes, page multiple (1 MiB)
+//!   CERB_SIM_VERBOSE        log device calls to stderr
+//!
+//! The CWGEN state lives in the process, it is not kept between runs
+//! the way the FPGA keeps it, and reads silence until programmed.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <math.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "cerb_common.h"
+#include "cerb_cwgen.h"
+#include "cerb_dma.h"
+
+#define SIM_DMA_PREFIX   "/dev/cerb_dmarx_ch"
+#define SIM_NOISE_LEN    (1 << 20)   // complex noise table entries, power of 2
+#define SIM_MAX_BACKLOG  100000000ull // ns behind schedule before the clock is rebased
+
+namespace {
+
+//! Settings from the environment, read once
+struct sim_config {
+    double   rate;
+    bool     noise;
+    double   noise_dbfs;
+    uint64_t timeout_every;
+    int      timeout_ms;
+    uint32_t nbuffers;
+    uint32_t buffer_size;
+    bool     verbose;
+
+    sim_config() {
+        const char* s;
+        rate          = (s = getenv("CERB_SIM_RATE")) ? atof(s) : CERB_SAMP_RATE;
+        noise         = (s = getenv("CERB_SIM_NOISE_DBFS")) != nullptr;
+        noise_dbfs    = noise ? atof(s) : 0;
+        timeout_every = (s = getenv("CERB_SIM_TIMEOUT_EVERY")) ? strtoull(s, nullptr, 0) : 0;
+        timeout_ms    = (s = getenv("CERB_SIM_TIMEOUT_MS")) ? atoi(s) : 100;
+        nbuffers      = (s = getenv("CERB_SIM_BUFFERS")) ? strtoul(s, nullptr, 0) : 16;
+        buffer_size   = (s = getenv("CERB_SIM_BUFFER_SIZE")) ? strtoul(s, nullptr, 0) : (1 << 20);
+        verbose       = getenv("CERB_SIM_VERBOSE") != nullptr;
+
+        nbuffers    = std::max<uint32_t>(1, std::min<uint32_t>(nbuffers, CERB_DMA_MAX_BUFFERS));
+        buffer_size = std::max<uint32_t>(CERB_PAGE_ALIGN, buffer_size & ~(CERB_PAGE_ALIGN - 1));
+    }
+};
+
+//! Programmed CW generator, swapped whole on every CWGEN ioctl
+struct sim_tone {
+    cmplx_wire_vec_t table;
+    uint32_t         freq_word;
+    uint32_t         phase_word;
+
+    sim_tone() : table(1 << CERB_CWGEN_PHASE_BITS), freq_word(0), phase_word(0) {}
+};
+
+enum sim_kind { SIM_SDR, SIM_DMA };
+
+//! State of one open simulated device
+struct sim_dev {
+    sim_kind  kind;
+    unsigned  channel;
+    uint32_t  phase;         // CWGEN phase accumulator
+    uint64_t  rng;           // noise table offsets
+    uint64_t  t0_ns;         // pacing origin, 0 = not started
+    uint64_t  produced;      // samples since t0_ns
+    uint64_t  transfers;     // reads or completed blocks, for timeout injection
+
+    // mapped interface
+    uint8_t*                    base;
+    bool                        streaming;
+    uint64_t                    seqno;
+    std::deque<uint32_t>        queued;
+    std::deque<cerb_dma_desc_t> done;
+
+    sim_dev(sim_kind k, unsigned ch)
+        : kind(k), channel(ch), phase(0), rng(0x9E3779B97F4A7C15ull ^ ch), t0_ns(0), produced(0),
+          transfers(0), base(nullptr), streaming(false), seqno(0) {}
+};
+
+std::mutex                                m_lock;
+std::map<int, std::shared_ptr<sim_dev> >  m_devs;
+std::shared_ptr<const sim_tone>           m_tone = std::make_shared<sim_tone>();
+
+const sim_config& config()
+{
+    static sim_config cfg;
+    return cfg;
+}
+
+#define SIM_LOG(...) do { if( config().verbose ) fprintf(stderr, "cerb_sim: " __VA_ARGS__); } while( 0 )
+
+//! libc symbol behind this library
+template <typename F>
+F next_symbol(const char* name)
+{
+    return reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+}
+
+typedef int     (*open_fn_t)(const char*, int, ...);
+typedef int     (*openat_fn_t)(int, const char*, int, ...);
+typedef int     (*close_fn_t)(int);
+typedef ssize_t (*read_fn_t)(int, void*, size_t);
+typedef int     (*ioctl_fn_t)(int, unsigned long, ...);
+typedef int     (*poll_fn_t)(struct pollfd*, nfds_t, int);
+typedef void*   (*mmap_fn_t)(void*, size_t, int, int, int, off_t);
+typedef ssize_t (*splice_fn_t)(int, loff_t*, int, loff_t*, size_t, unsigned int);
+
+uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void sleep_until_ns(uint64_t t_ns)
+{
+    struct timespec ts;
+    ts.tv_sec  = t_ns / 1000000000ull;
+    ts.tv_nsec = t_ns % 1000000000ull;
+    while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR ) {
+    }
+}
+
+uint64_t xorshift(uint64_t& s)
+{
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+}
+
+int16_t saturate(int32_t v)
+{
+    return static_cast<int16_t>(std::max<int32_t>(-32768, std::min<int32_t>(32767, v)));
+}
+
+//!******************************************************
+//! @brief
+//! Gaussian noise at CERB_SIM_NOISE_DBFS, made once and
+//! read from a random offset on every transfer
+//!
+//!******************************************************
+const cmplx_wire_vec_t& noise_table()
+{
+    static cmplx_wire_vec_t table;
+    static std::once_flag once;
+    std::call_once(once, [] {
+        if( !config().noise ) {
+            return;
+        }
+        double sigma = 32768.0 * pow(10.0, config().noise_dbfs / 20) / sqrt(2.0);
+        uint64_t s = 0x2545F4914F6CDD1Dull;
+        table.resize(SIM_NOISE_LEN);
+        for (size_t k = 0; k < table.size(); k++) {
+            double u1 = (xorshift(s) >> 11) * (1.0 / 9007199254740992.0);
+            double u2 = (xorshift(s) >> 11) * (1.0 / 9007199254740992.0);
+            double r  = sigma * sqrt(-2 * log(1 - u1));
+            table[k] = cmplx_wire_t(saturate(lround(r * cos(2 * M_PI * u2))), saturate(lround(r * sin(2 * M_PI * u2))));
+        }
+    });
+    return table;
+}
+
+std::shared_ptr<const sim_tone> current_tone()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_tone;
+}
+
+//!******************************************************
+//! @brief
+//! Next n samples of a channel: the programmed tone
+//! plus noise
+//!
+//!******************************************************
+void generate(sim_dev& dev, cmplx_wire_t* dst, size_t n)
+{
+    std::shared_ptr<const sim_tone> tone = current_tone();
+    const cmplx_wire_t* table = tone->table.data();
+    uint32_t mask  = tone->table.size() - 1;
+    uint32_t phase = dev.phase + tone->phase_word;
+    for (size_t k = 0; k < n; k++) {
+        dst[k] = table[phase & mask];
+        phase += tone->freq_word;
+    }
+    dev.phase = phase - tone->phase_word;
+
+    const cmplx_wire_vec_t& noise = noise_table();
+    if( noise.empty() ) {
+        return;
+    }
+    // saturating adds over runs that do not wrap the table, the loop vectorizes
+    size_t nmask = noise.size() - 1;
+    size_t off   = xorshift(dev.rng) & nmask;
+    for (size_t k = 0; k < n; ) {
+        size_t run = std::min(n - k, noise.size() - off);
+        int16_t*       y = reinterpret_cast<int16_t*>(dst + k);
+        const int16_t* v = reinterpret_cast<const int16_t*>(&noise[off]);
+        for (size_t j = 0; j < 2 * run; j++) {
+            y[j] = saturate(y[j] + v[j]);
+        }
+        k  += run;
+        off = 0;
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Completion time of the next n samples at
+//! CERB_SIM_RATE, now when unthrottled
+//!
+//!******************************************************
+uint64_t due_ns(sim_dev& dev, size_t n)
+{
+    double rate = config().rate;
+    uint64_t now = monotonic_ns();
+    if( rate <= 0 ) {
+        return now;
+    }
+    if( !dev.t0_ns ) {
+        dev.t0_ns    = now;
+        dev.produced = 0;
+    }
+    return dev.t0_ns + (uint64_t)((dev.produced + n) * 1e9 / rate);
+}
+
+//! True when this transfer is one CERB_SIM_TIMEOUT_EVERY asks to fail
+bool inject_timeout(sim_dev& dev)
+{
+    uint64_t every = config().timeout_every;
+    if( !every || ++dev.transfers % every ) {
+        return false;
+    }
+    SIM_LOG("ch%u: injected timeout\n", dev.channel);
+    return true;
+}
+
+std::shared_ptr<sim_dev> lookup(int fd)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::map<int, std::shared_ptr<sim_dev> >::iterator it = m_devs.find(fd);
+    return (it != m_devs.end()) ? it->second : std::shared_ptr<sim_dev>();
+}
+
+//!******************************************************
+//! @brief
+//! Opens a placeholder descriptor for a simulated
+//! device, -2 when path is not one
+//!
+//!******************************************************
+int sim_open(const char* path, int flags)
+{
+    if( !path ) {
+        return -2;
+    }
+    sim_kind kind;
+    unsigned channel = 0;
+    size_t   plen = strlen(SIM_DMA_PREFIX);
+    if( !strcmp(path, CERB_SDR_DEV) ) {
+        kind = SIM_SDR;
+    }
+    else if( !strncmp(path, SIM_DMA_PREFIX, plen) && path[plen] ) {
+        char* end = nullptr;
+        channel = strtoul(path + plen, &end, 10);
+        if( *end ) {
+            return -2;
+        }
+        kind = SIM_DMA;
+    }
+    else {
+        return -2;
+    }
+
+    static std::once_flag banner;
+    std::call_once(banner, [] {
+        const sim_config& cfg = config();
+        fprintf(stderr, "cerb_sim: simulating %s and %s* rate [%.6g] noise [%s%.1f dBFS] timeout every [%llu]\n",
+                CERB_SDR_DEV, SIM_DMA_PREFIX, cfg.rate, cfg.noise ? "" : "off ", cfg.noise_dbfs,
+                (unsigned long long)cfg.timeout_every);
+    });
+
+    static open_fn_t real_open = next_symbol<open_fn_t>("open");
+    int fd = real_open("/dev/null", O_RDWR | (flags & O_CLOEXEC));
+    if( fd < 0 ) {
+        return fd;
+    }
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_devs[fd] = std::make_shared<sim_dev>(kind, channel);
+    SIM_LOG("open %s -> fd %d\n", path, fd);
+    return fd;
+}
+
+//!******************************************************
+//! @brief
+//! Programs the CW generator model
+//!
+//!******************************************************
+int sim_cwgen(const cerb_cwgen_t* msg)
+{
+    if( !msg ) {
+        errno = EFAULT;
+        return -1;
+    }
+    std::shared_ptr<sim_tone> tone = std::make_shared<sim_tone>();
+    double ampl = 32767.0 / (1 << (msg->ampl_scale & CERB_CWGEN_AMPL_MASK));
+    for (size_t k = 0; k < tone->table.size(); k++) {
+        double ph = 2 * M_PI * k / tone->table.size();
+        tone->table[k] = cmplx_wire_t(static_cast<int16_t>(round(ampl * cos(ph))),
+                                      static_cast<int16_t>(round(ampl * sin(ph))));
+    }
+    tone->freq_word  = msg->freq_word;
+    tone->phase_word = msg->phase_word;
+    SIM_LOG("cwgen freq [%.0f Hz] ampl_scale [%u]\n",
+            (int32_t)msg->freq_word * CERB_SAMP_RATE / (1 << CERB_CWGEN_PHASE_BITS), msg->ampl_scale);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_tone = tone;
+    return 0;
+}
+
+//!******************************************************
+//! @brief
+//! read() on a DMA channel: a full transfer once its
+//! last sample is due, or 0 on an injected timeout
+//!
+//!******************************************************
+ssize_t sim_read(sim_dev& dev, void* buf, size_t bytes)
+{
+    if( dev.kind != SIM_DMA ) {
+        errno = EINVAL;
+        return -1;
+    }
+    if( inject_timeout(dev) ) {
+        usleep(config().timeout_ms * 1000);
+        dev.t0_ns = 0;
+        return 0;
+    }
+    // a reader that fell far behind restarts the schedule rather than
+    // being handed a burst at full speed
+    size_t n = bytes / sizeof(cmplx_wire_t);
+    uint64_t due = due_ns(dev, n);
+    if( monotonic_ns() > due + SIM_MAX_BACKLOG ) {
+        dev.t0_ns = 0;
+        due = due_ns(dev, n);
+    }
+    generate(dev, static_cast<cmplx_wire_t*>(buf), n);
+    sleep_until_ns(due);
+    dev.produced += n;
+    return n * sizeof(cmplx_wire_t);
+}
+
+//!******************************************************
+//! @brief
+//! Completes the next block into the first queued
+//! buffer, or drops it when nothing is queued
+//!
+//!******************************************************
+void complete_block(sim_dev& dev, size_t n, uint64_t due)
+{
+    if( dev.queued.empty() ) {
+        dev.phase += n * current_tone()->freq_word;
+    }
+    else {
+        uint32_t index = dev.queued.front();
+        dev.queued.pop_front();
+        generate(dev, reinterpret_cast<cmplx_wire_t*>(dev.base + (size_t)index * config().buffer_size), n);
+        cerb_dma_desc_t desc = { index, config().buffer_size, dev.seqno, due };
+        dev.done.push_back(desc);
+    }
+    dev.produced += n;
+    dev.seqno++;
+}
+
+//!******************************************************
+//! @brief
+//! poll() on a mapped DMA channel. Every block that
+//! came due since the last call is completed, so a
+//! consumer that falls behind runs out of queued
+//! buffers and sees seqno gaps like on the driver.
+//! Returns 1 when a buffer is done, 0 on timeout.
+//!
+//!******************************************************
+int sim_poll(sim_dev& dev, int timeout_ms)
+{
+    uint64_t deadline = (timeout_ms < 0) ? UINT64_MAX : monotonic_ns() + (uint64_t)timeout_ms * 1000000ull;
+    size_t   n = config().buffer_size / sizeof(cmplx_wire_t);
+    while( dev.done.empty() ) {
+        uint64_t due = due_ns(dev, n);
+        if( !dev.streaming || !dev.base || due > deadline || (dev.queued.empty() && config().rate <= 0) ) {
+            sleep_until_ns(std::min<uint64_t>(deadline, monotonic_ns() + (uint64_t)std::max(timeout_ms, 0) * 1000000ull));
+            return 0;
+        }
+        if( inject_timeout(dev) ) {
+            sleep_until_ns(std::min<uint64_t>(deadline, monotonic_ns() + config().timeout_ms * 1000000ull));
+            dev.t0_ns = 0;
+            return 0;
+        }
+        sleep_until_ns(due);
+        uint64_t now = monotonic_ns();
+        do {
+            complete_block(dev, n, due);
+            due = due_ns(dev, n);
+        } while( due <= now );
+    }
+    return 1;
+}
+
+//!******************************************************
+//! @brief
+//! ioctl() on a simulated device
+//!
+//!******************************************************
+int sim_ioctl(sim_dev& dev, unsigned long req, void* arg)
+{
+    if( dev.kind == SIM_SDR ) {
+        if( req == (unsigned long)CERB_IOCTL_CWGEN ) {
+            return sim_cwgen(static_cast<const cerb_cwgen_t*>(arg));
+        }
+        errno = ENOTTY;
+        return -1;
+    }
+
+    switch( req ) {
+    case CERB_IOCTL_DMA_MAP_INFO: {
+        cerb_dma_map_info_t* info = static_cast<cerb_dma_map_info_t*>(arg);
+        info->nbuffers    = config().nbuffers;
+        info->buffer_size = config().buffer_size;
+        return 0;
+    }
+    case CERB_IOCTL_DMA_QBUF: {
+        const cerb_dma_desc_t* desc = static_cast<const cerb_dma_desc_t*>(arg);
+        if( desc->index >= config().nbuffers ) {
+            errno = EINVAL;
+            return -1;
+        }
+        dev.queued.push_back(desc->index);
+        return 0;
+    }
+    case CERB_IOCTL_DMA_DQBUF:
+        if( dev.done.empty() ) {
+            errno = EAGAIN;
+            return -1;
+        }
+        *static_cast<cerb_dma_desc_t*>(arg) = dev.done.front();
+        dev.done.pop_front();
+        return 0;
+    case CERB_IOCTL_DMA_STREAMON:
+        if( !dev.base ) {
+            errno = EINVAL;
+            return -1;
+        }
+        dev.streaming = true;
+        dev.t0_ns     = 0;
+        SIM_LOG("ch%u: stream on [%u x %u]\n", dev.channel, config().nbuffers, config().buffer_size);
+        return 0;
+    case CERB_IOCTL_DMA_STREAMOFF:
+        dev.streaming = false;
+        dev.base      = nullptr;    // unmapped next
+        dev.queued.clear();
+        dev.done.clear();
+        return 0;
+    default:
+        errno = ENOTTY;
+        return -1;
+    }
+}
+
+//!******************************************************
+//! @brief
+//! fd of the first poll() entry. glibc declares the
+//! poll() array write-only, so the override reads it
+//! through an out of line call, where that attribute
+//! does not apply, to stay -Wmaybe-uninitialized clean
+//!
+//!******************************************************
+__attribute__((noinline)) int sim_poll_fd(const struct pollfd* fds)
+{
+    return fds[0].fd;
+}
+
+} // namespace
+
+//!******************************************************
+//! @brief
+//! Interposed libc entry points. Anything not on a
+//! simulated device goes to the next definition.
+//!
+//!******************************************************
+extern "C" {
+
+int open(const char* path, int flags, ...)
+{
+    mode_t mode = 0;
+    if( flags & (O_CREAT | O_TMPFILE) ) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    int fd = sim_open(path, flags);
+    if( fd != -2 ) {
+        return fd;
+    }
+    static open_fn_t real_open = next_symbol<open_fn_t>("open");
+    return real_open(path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...)
+{
+    mode_t mode = 0;
+    if( flags & (O_CREAT | O_TMPFILE) ) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    int fd = sim_open(path, flags);
+    if( fd != -2 ) {
+        return fd;
+    }
+    static open_fn_t real_open64 = next_symbol<open_fn_t>("open64");
+    return real_open64(path, flags, mode);
+}
+
+int openat(int dirfd, const char* path, int flags, ...)
+{
+    mode_t mode = 0;
+    if( flags & (O_CREAT | O_TMPFILE) ) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    int fd = sim_open(path, flags);
+    if( fd != -2 ) {
+        return fd;
+    }
+    static openat_fn_t real_openat = next_symbol<openat_fn_t>("openat");
+    return real_openat(dirfd, path, flags, mode);
+}
+
+int openat64(int dirfd, const char* path, int flags, ...)
+{
+    mode_t mode = 0;
+    if( flags & (O_CREAT | O_TMPFILE) ) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    int fd = sim_open(path, flags);
+    if( fd != -2 ) {
+        return fd;
+    }
+    static openat_fn_t real_openat64 = next_symbol<openat_fn_t>("openat64");
+    return real_openat64(dirfd, path, flags, mode);
+}
+
+int close(int fd)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if( m_devs.erase(fd) ) {
+            SIM_LOG("close fd %d\n", fd);
+        }
+    }
+    static close_fn_t real_close = next_symbol<close_fn_t>("close");
+    return real_close(fd);
+}
+
+ssize_t read(int fd, void* buf, size_t bytes)
+{
+    std::shared_ptr<sim_dev> dev = lookup(fd);
+    if( dev ) {
+        return sim_read(*dev, buf, bytes);
+    }
+    static read_fn_t real_read = next_symbol<read_fn_t>("read");
+    return real_read(fd, buf, bytes);
+}
+
+int ioctl(int fd, unsigned long req, ...)
+{
+    va_list ap;
+    va_start(ap, req);
+    void* arg = va_arg(ap, void*);
+    va_end(ap);
+
+    std::shared_ptr<sim_dev> dev = lookup(fd);
+    if( dev ) {
+        return sim_ioctl(*dev, req, arg);
+    }
+    static ioctl_fn_t real_ioctl = next_symbol<ioctl_fn_t>("ioctl");
+    return real_ioctl(fd, req, arg);
+}
+
+int poll(struct pollfd* fds, nfds_t nfds, int timeout)
+{
+    std::shared_ptr<sim_dev> dev;
+    if( nfds == 1 && fds ) {
+        dev = lookup(sim_poll_fd(fds));
+    }
+    if( dev && dev->kind == SIM_DMA ) {
+        int rc = sim_poll(*dev, timeout);
+        fds[0].revents = rc ? (fds[0].events & POLLIN) : 0;
+        return rc;
+    }
+    static poll_fn_t real_poll = next_symbol<poll_fn_t>("poll");
+    return real_poll(fds, nfds, timeout);
+}
+
+void* mmap(void* addr, size_t len, int prot, int flags, int fd, off_t off)
+{
+    static mmap_fn_t real_mmap = next_symbol<mmap_fn_t>("mmap");
+    std::shared_ptr<sim_dev> dev = (fd >= 0) ? lookup(fd) : std::shared_ptr<sim_dev>();
+    if( !dev ) {
+        return real_mmap(addr, len, prot, flags, fd, off);
+    }
+    if( dev->kind != SIM_DMA || off || len != (size_t)config().nbuffers * config().buffer_size ) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    void* ptr = real_mmap(addr, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if( ptr != MAP_FAILED ) {
+        dev->base = static_cast<uint8_t*>(ptr);
+    }
+    return ptr;
+}
+
+ssize_t splice(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out, size_t len, unsigned int flags)
+{
+    if( lookup(fd_in) || lookup(fd_out) ) {
+        errno = EINVAL;
+        return -1;
+    }
+    static splice_fn_t real_splice = next_symbol<splice_fn_t>("splice");
+    return real_splice(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+} // extern "C"
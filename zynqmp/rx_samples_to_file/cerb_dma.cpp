@@ -0,0 +1,259 @@
+//!*********************************************************************
+//! @file cerb_dma.cpp
+//!
+//! @brief
+//! Zero-copy access to the Cerberus DMA buffers. See cerb_dma.h.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cerb_dma.h"
+
+//!******************************************************
+//! @brief
+//! Appends a descriptor, returns false when full
+//!
+//!******************************************************
+bool cerb_dma_queue_push(cerb_dma_shm_queue_t& q, const cerb_dma_desc_t& desc)
+{
+    uint32_t head = q.head.load(std::memory_order_relaxed);
+    uint32_t tail = q.tail.load(std::memory_order_acquire);
+    if( head - tail >= CERB_DMA_MAX_BUFFERS ) {
+        return false;
+    }
+    q.desc[head % CERB_DMA_MAX_BUFFERS] = desc;
+    q.head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Removes the oldest descriptor, returns false when
+//! empty
+//!
+//!******************************************************
+bool cerb_dma_queue_pop(cerb_dma_shm_queue_t& q, cerb_dma_desc_t& desc)
+{
+    uint32_t tail = q.tail.load(std::memory_order_relaxed);
+    uint32_t head = q.head.load(std::memory_order_acquire);
+    if( head == tail ) {
+        return false;
+    }
+    desc = q.desc[tail % CERB_DMA_MAX_BUFFERS];
+    q.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Maps the driver buffers, queues all of them and
+//! starts the DMA engine
+//!
+//!******************************************************
+bool cerb_dma_ioctl_source::open(const std::string& dev)
+{
+    m_fd = ::open(dev.c_str(), O_RDWR | O_SYNC);
+    if( m_fd < 0 ) {
+        printf("error: failed to open DMA device [%s]\n", dev.c_str());
+        return false;
+    }
+
+    cerb_dma_map_info_t info;
+    if( ioctl(m_fd, CERB_IOCTL_DMA_MAP_INFO, &info) < 0 ) {
+        printf("error: [%s] does not support mapped buffers [%s]\n", dev.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+    if( !info.nbuffers || info.nbuffers > CERB_DMA_MAX_BUFFERS || !info.buffer_size ) {
+        printf("error: invalid DMA mapping [%u x %u]\n", info.nbuffers, info.buffer_size);
+        close();
+        return false;
+    }
+
+    m_nbuffers    = info.nbuffers;
+    m_buffer_size = info.buffer_size;
+    m_map_size    = m_nbuffers * m_buffer_size;
+    void* ptr = mmap(NULL, m_map_size, PROT_READ, MAP_SHARED, m_fd, 0);
+    if( ptr == MAP_FAILED ) {
+        printf("error: failed to map DMA buffers [%s]\n", strerror(errno));
+        m_map_size = 0;
+        close();
+        return false;
+    }
+    m_base = static_cast<uint8_t*>(ptr);
+
+    for (uint32_t k = 0; k < m_nbuffers; k++) {
+        cerb_dma_desc_t desc = { k, 0, 0, 0 };
+        if( !enqueue(desc) ) {
+            close();
+            return false;
+        }
+    }
+    if( ioctl(m_fd, CERB_IOCTL_DMA_STREAMON) < 0 ) {
+        printf("error: failed to start DMA [%s]\n", strerror(errno));
+        close();
+        return false;
+    }
+    return true;
+}
+
+int cerb_dma_ioctl_source::dequeue(cerb_dma_desc_t& desc, int timeout_ms)
+{
+    struct pollfd pfd = { m_fd, POLLIN, 0 };
+    int rc = poll(&pfd, 1, timeout_ms);
+    if( rc < 0 ) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    if( !rc ) {
+        return 0;
+    }
+    if( ioctl(m_fd, CERB_IOCTL_DMA_DQBUF, &desc) < 0 ) {
+        if( errno == EAGAIN ) {
+            return 0;
+        }
+        printf("error: dma dequeue failed [%s]\n", strerror(errno));
+        return -1;
+    }
+    return 1;
+}
+
+bool cerb_dma_ioctl_source::enqueue(const cerb_dma_desc_t& desc)
+{
+    if( ioctl(m_fd, CERB_IOCTL_DMA_QBUF, &desc) < 0 ) {
+        printf("error: dma enqueue failed [%s]\n", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void cerb_dma_ioctl_source::close()
+{
+    if( m_fd >= 0 && m_base ) {
+        ioctl(m_fd, CERB_IOCTL_DMA_STREAMOFF);
+    }
+    if( m_base ) {
+        munmap(m_base, m_map_size);
+    }
+    if( m_fd >= 0 ) {
+        ::close(m_fd);
+    }
+    m_base = nullptr;
+    m_fd   = -1;
+}
+
+//!******************************************************
+//! @brief
+//! Attaches to a running cerb_dma_shm_producer and
+//! returns any stale completions so the capture starts
+//! with fresh data
+//!
+//!******************************************************
+bool cerb_dma_shm_source::open(const std::string& name)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if( fd < 0 ) {
+        printf("error: failed to open shared memory [%s] (is cerb_dma_shm_producer running?)\n", name.c_str());
+        return false;
+    }
+
+    struct stat st;
+    if( fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(cerb_dma_shm_header_t) ) {
+        printf("error: invalid shared memory [%s]\n", name.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    m_map_size = st.st_size;
+    void* ptr = mmap(NULL, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if( ptr == MAP_FAILED ) {
+        printf("error: failed to map shared memory [%s]\n", strerror(errno));
+        return false;
+    }
+
+    m_hdr = static_cast<cerb_dma_shm_header_t*>(ptr);
+    if( m_hdr->magic != CERB_DMA_SHM_MAGIC || m_hdr->version != CERB_DMA_SHM_VERSION ||
+        (size_t)m_hdr->data_offset + (size_t)m_hdr->nbuffers * m_hdr->buffer_size > m_map_size ) {
+        printf("error: shared memory [%s] layout mismatch\n", name.c_str());
+        close();
+        return false;
+    }
+
+    m_nbuffers    = m_hdr->nbuffers;
+    m_buffer_size = m_hdr->buffer_size;
+    m_base        = reinterpret_cast<uint8_t*>(m_hdr) + m_hdr->data_offset;
+
+    cerb_dma_desc_t desc;
+    while( sem_trywait(&m_hdr->done_sem) == 0 ) {
+        if( cerb_dma_queue_pop(m_hdr->done, desc) ) {
+            enqueue(desc);
+        }
+    }
+    return true;
+}
+
+int cerb_dma_shm_source::dequeue(cerb_dma_desc_t& desc, int timeout_ms)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec  += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if( ts.tv_nsec >= 1000000000 ) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    if( sem_timedwait(&m_hdr->done_sem, &ts) < 0 ) {
+        return (errno == ETIMEDOUT || errno == EINTR) ? 0 : -1;
+    }
+    return cerb_dma_queue_pop(m_hdr->done, desc) ? 1 : -1;
+}
+
+bool cerb_dma_shm_source::enqueue(const cerb_dma_desc_t& desc)
+{
+    return cerb_dma_queue_push(m_hdr->free, desc);
+}
+
+void cerb_dma_shm_source::close()
+{
+    if( m_hdr ) {
+        munmap(m_hdr, m_map_size);
+    }
+    m_hdr  = nullptr;
+    m_base = nullptr;
+}
+
+//!******************************************************
+//! @brief
+//! Opens the mapped source named by dev, either a DMA
+//! device node or "shm:<name>" for the stand-in
+//!
+//!******************************************************
+cerb_dma_mapped* cerb_dma_mapped_open(const std::string& dev)
+{
+    cerb_dma_mapped* src;
+    std::string prefix(CERB_DMA_SHM_PREFIX);
+    if( dev.compare(0, prefix.size(), prefix) == 0 ) {
+        src = new cerb_dma_shm_source();
+        if( src->open(dev.substr(prefix.size())) ) {
+            return src;
+        }
+    }
+    else {
+        src = new cerb_dma_ioctl_source();
+        if( src->open(dev) ) {
+            return src;
+        }
+    }
+    delete src;
+    return nullptr;
+}
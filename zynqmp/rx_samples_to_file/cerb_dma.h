@@ -0,0 +1,148 @@
+//!*********************************************************************
+//! @file cerb_dma.h
+//!
+//! @brief
+//! Zero-copy access to the Cerberus DMA buffers. The DMA-coherent
+//! buffers are mapped into user space and completed buffers are handed
+//! over by index, so samples are never copied by read().
+//!
+//! Two sources are provided:
+//!  - the cerb_dmarx driver, through the mmap/ioctl interface below
+//!  - a shared-memory stand-in ("shm:<name>") fed by
+//!    cerb_dma_shm_producer, so the path can be exercised and
+//!    benchmarked on a PC without the FPGA
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_DMA_H_
+#define CERB_DMA_H_
+
+#include <atomic>
+#include <string>
+#include <semaphore.h>
+#include <sys/ioctl.h>
+#include "cerb_common.h"
+
+#define CERB_DMA_SHM_PREFIX      "shm:"
+#define CERB_DMA_SHM_MAGIC       0x43455242  // 'CERB'
+#define CERB_DMA_SHM_VERSION     1
+#define CERB_DMA_MAX_BUFFERS     64
+
+//! Completed DMA buffer descriptor
+typedef struct __attribute__((__packed__)) {
+    uint32_t index;          // buffer index within the mapping
+    uint32_t bytes;          // valid bytes in the buffer
+    uint64_t seqno;          // block sequence number, gaps mean dropped blocks
+    uint64_t timestamp_ns;   // CLOCK_MONOTONIC completion time
+} cerb_dma_desc_t;
+
+//! Mapping geometry reported by the driver
+typedef struct __attribute__((__packed__)) {
+    uint32_t nbuffers;
+    uint32_t buffer_size;    // bytes, page multiple
+} cerb_dma_map_info_t;
+
+//! cerb_dmarx zero-copy interface: map nbuffers * buffer_size bytes at
+//! offset 0, queue every buffer, stream on, then poll()/DQBUF/QBUF.
+#define CERB_IOCTL_DMA_MAP_INFO  _IOR('C', 3, cerb_dma_map_info_t)
+#define CERB_IOCTL_DMA_DQBUF     _IOWR('C', 4, cerb_dma_desc_t)
+#define CERB_IOCTL_DMA_QBUF      _IOW('C', 5, cerb_dma_desc_t)
+#define CERB_IOCTL_DMA_STREAMON  _IO('C', 6)
+#define CERB_IOCTL_DMA_STREAMOFF _IO('C', 7)
+
+//! Single-producer/single-consumer index queue in shared memory
+typedef struct {
+    std::atomic<uint32_t> head;  // written by the producer
+    std::atomic<uint32_t> tail;  // written by the consumer
+    cerb_dma_desc_t       desc[CERB_DMA_MAX_BUFFERS];
+} cerb_dma_shm_queue_t;
+
+//! Shared-memory stand-in layout, buffers follow at data_offset
+typedef struct {
+    uint32_t              magic;
+    uint32_t              version;
+    uint32_t              nbuffers;
+    uint32_t              buffer_size;
+    uint32_t              data_offset;
+    std::atomic<uint64_t> dropped;   // blocks dropped by the producer
+    sem_t                 done_sem;  // counts entries in done
+    cerb_dma_shm_queue_t  done;      // producer -> consumer completions
+    cerb_dma_shm_queue_t  free;      // consumer -> producer returns
+} cerb_dma_shm_header_t;
+
+bool cerb_dma_queue_push(cerb_dma_shm_queue_t& q, const cerb_dma_desc_t& desc);
+bool cerb_dma_queue_pop(cerb_dma_shm_queue_t& q, cerb_dma_desc_t& desc);
+
+//!******************************************************
+//! @brief
+//! Mapped DMA buffer source
+//!
+//!******************************************************
+class cerb_dma_mapped
+{
+public:
+    cerb_dma_mapped() : m_base(nullptr), m_map_size(0), m_nbuffers(0), m_buffer_size(0) {}
+    virtual ~cerb_dma_mapped() {}
+
+    virtual bool open(const std::string& dev) = 0;
+    virtual int  dequeue(cerb_dma_desc_t& desc, int timeout_ms) = 0;  // 1 ok, 0 timeout, -1 error
+    virtual bool enqueue(const cerb_dma_desc_t& desc) = 0;
+    virtual void close() = 0;
+
+    const cmplx_wire_t* buffer(uint32_t index) const {
+        return reinterpret_cast<const cmplx_wire_t*>(m_base + (size_t)index * m_buffer_size);
+    }
+    size_t nbuffers() const    { return m_nbuffers; }
+    size_t buffer_size() const { return m_buffer_size; }
+
+protected:
+    uint8_t* m_base;
+    size_t   m_map_size;
+    size_t   m_nbuffers;
+    size_t   m_buffer_size;
+};
+
+//!******************************************************
+//! @brief
+//! cerb_dmarx driver buffers mapped through mmap()
+//!
+//!******************************************************
+class cerb_dma_ioctl_source : public cerb_dma_mapped
+{
+public:
+    cerb_dma_ioctl_source() : m_fd(-1) {}
+    ~cerb_dma_ioctl_source() { close(); }
+
+    bool open(const std::string& dev);
+    int  dequeue(cerb_dma_desc_t& desc, int timeout_ms);
+    bool enqueue(const cerb_dma_desc_t& desc);
+    void close();
+
+private:
+    int m_fd;
+};
+
+//!******************************************************
+//! @brief
+//! Shared-memory stand-in for the driver buffers
+//!
+//!******************************************************
+class cerb_dma_shm_source : public cerb_dma_mapped
+{
+public:
+    cerb_dma_shm_source() : m_hdr(nullptr) {}
+    ~cerb_dma_shm_source() { close(); }
+
+    bool open(const std::string& name);
+    int  dequeue(cerb_dma_desc_t& desc, int timeout_ms);
+    bool enqueue(const cerb_dma_desc_t& desc);
+    void close();
+
+private:
+    cerb_dma_shm_header_t* m_hdr;
+};
+
+cerb_dma_mapped* cerb_dma_mapped_open(const std::string& dev);
+
+#endif /* CERB_DMA_H_ */
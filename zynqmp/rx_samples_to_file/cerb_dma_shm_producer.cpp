@@ -0,0 +1,219 @@
+//!*********************************************************************
+//! @file cerb_dma_shm_producer.cpp
+//!
+//! @brief
+//! User-space stand-in for the cerb_dmarx mapped buffers. Creates a
+//! shared memory pool laid out like the driver mapping and completes
+//! buffers holding a CW tone at the configured sample rate, so the
+//! zero-copy capture path can be exercised and benchmarked on a PC:
+//!
+//!   cerb_dma_shm_producer --name /cerb_dmarx_ch0 &
+//!   rx_samples_to_file --dma-mode=mmap --dma-dev=shm:/cerb_dmarx_ch0 --duration 5
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <math.h>
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <new>
+#include <atomic>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "cerb_common.h"
+#include "cerb_dma.h"
+
+namespace po = boost::program_options;
+
+// globals
+po::variables_map   m_opts;
+std::string         m_name = "/cerb_dmarx_ch0";
+size_t              m_nbuffers = 16;
+size_t              m_buffer_samps = (1 << 18);
+double              m_rate = CERB_SAMP_RATE;
+double              m_tone_hz = 10e6;
+uint64_t            m_count = 0;
+std::atomic<bool>   m_stop(false);
+
+//!******************************************************
+//! @brief
+//! Handles command line options
+//!
+//!******************************************************
+int init_options(int argc, char *argv[])
+{
+    po::options_description desc("Command Line Options");
+    desc.add_options()
+        ("help,h",       "help message")
+        ("name",         po::value<std::string>(&m_name)->default_value(m_name),                "Shared memory object name")
+        ("nbuffers",     po::value<size_t>(&m_nbuffers)->default_value(m_nbuffers),             "Number of mapped DMA buffers")
+        ("buffer-samps", po::value<size_t>(&m_buffer_samps)->default_value(m_buffer_samps),     "Complex samples per DMA buffer")
+        ("rate",         po::value<double>(&m_rate)->default_value(m_rate),                     "Sample rate in Hz (0 = as fast as the consumer drains)")
+        ("tone",         po::value<double>(&m_tone_hz)->default_value(m_tone_hz),               "Tone frequency in Hz, rounded to a whole number of cycles per buffer")
+        ("count",        po::value<uint64_t>(&m_count)->default_value(m_count),                 "Number of blocks to produce (0 = until interrupted)")
+    ;
+
+    po::store( po::parse_command_line(argc, argv, desc), m_opts);
+    if (m_opts.count("help")){
+        std::cout << "Usage: options_description [options]\n";
+        std::cout << desc;
+        return 0;
+    }
+
+    try {
+        po::notify(m_opts);
+    }
+    catch (std::exception& e) {
+        std::cerr << "error: " << e.what() << "\n";
+        return 0;
+    }
+
+    if( !m_nbuffers || m_nbuffers > CERB_DMA_MAX_BUFFERS || !m_buffer_samps ) {
+        std::cerr << "error: nbuffers must be 1.." << CERB_DMA_MAX_BUFFERS << "\n";
+        return 0;
+    }
+    return 1;
+}
+
+void signal_handler( int )
+{
+    m_stop = true;
+}
+
+//!******************************************************
+//! @brief
+//! Creates and initializes the shared memory pool
+//!
+//!******************************************************
+cerb_dma_shm_header_t* create_pool( size_t& map_size )
+{
+    size_t buffer_size = m_buffer_samps * sizeof(cmplx_wire_t);
+    size_t data_offset = (sizeof(cerb_dma_shm_header_t) + CERB_PAGE_ALIGN - 1) & ~(size_t)(CERB_PAGE_ALIGN - 1);
+    map_size = data_offset + m_nbuffers * buffer_size;
+
+    shm_unlink(m_name.c_str());
+    int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+    if( fd < 0 ) {
+        printf("error: failed to create shared memory [%s] [%s]\n", m_name.c_str(), strerror(errno));
+        return nullptr;
+    }
+    if( ftruncate(fd, map_size) < 0 ) {
+        printf("error: failed to size shared memory [%s]\n", strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    void* ptr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if( ptr == MAP_FAILED ) {
+        printf("error: failed to map shared memory [%s]\n", strerror(errno));
+        return nullptr;
+    }
+
+    memset(ptr, 0, sizeof(cerb_dma_shm_header_t));
+    cerb_dma_shm_header_t* hdr = new (ptr) cerb_dma_shm_header_t;
+    hdr->nbuffers    = m_nbuffers;
+    hdr->buffer_size = buffer_size;
+    hdr->data_offset = data_offset;
+    hdr->dropped     = 0;
+    hdr->done.head   = 0;
+    hdr->done.tail   = 0;
+    hdr->free.head   = 0;
+    hdr->free.tail   = 0;
+    sem_init(&hdr->done_sem, 1, 0);
+
+    // every buffer starts queued to the "DMA"
+    for (uint32_t k = 0; k < m_nbuffers; k++) {
+        cerb_dma_desc_t desc = { k, 0, 0, 0 };
+        cerb_dma_queue_push(hdr->free, desc);
+    }
+
+    // publish last, consumers check the magic
+    hdr->version = CERB_DMA_SHM_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    hdr->magic   = CERB_DMA_SHM_MAGIC;
+    return hdr;
+}
+
+//!******************************************************
+//! @brief
+//! Main entry point
+//!
+//!******************************************************
+int main(int argc, char *argv[])
+{
+    if( !init_options(argc, argv) ) {
+        return 1;
+    }
+
+    size_t map_size;
+    cerb_dma_shm_header_t* hdr = create_pool(map_size);
+    if( !hdr ) {
+        return 1;
+    }
+    uint8_t* base = reinterpret_cast<uint8_t*>(hdr) + hdr->data_offset;
+
+    // one buffer of tone with a whole number of cycles keeps the phase continuous
+    double rate = m_rate > 0 ? m_rate : CERB_SAMP_RATE;
+    double bin  = std::round(m_tone_hz / rate * m_buffer_samps);
+    cmplx_wire_vec_t tone(m_buffer_samps);
+    for (size_t k = 0; k < m_buffer_samps; k++) {
+        double ph = 2 * M_PI * bin * k / m_buffer_samps;
+        tone[k] = cmplx_wire_t(static_cast<int16_t>(std::round(16384 * cos(ph))),
+                               static_cast<int16_t>(std::round(16384 * sin(ph))));
+    }
+    printf("producing [%zu x %zu] samples on [%s], tone [%.3f MHz]\n", m_nbuffers, m_buffer_samps,
+           m_name.c_str(), bin * rate / m_buffer_samps / 1e6);
+
+    signal(SIGINT,  signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    uint64_t period_ns = m_rate > 0 ? static_cast<uint64_t>(m_buffer_samps / m_rate * 1e9) : 0;
+    uint64_t seqno = 0;
+    while( !m_stop && (!m_count || seqno < m_count) )
+    {
+        cerb_dma_desc_t desc;
+        if( cerb_dma_queue_pop(hdr->free, desc) ) {
+            memcpy(base + (size_t)desc.index * hdr->buffer_size, &tone[0], hdr->buffer_size);
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            desc.bytes        = hdr->buffer_size;
+            desc.seqno        = seqno;
+            desc.timestamp_ns = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+            cerb_dma_queue_push(hdr->done, desc);
+            sem_post(&hdr->done_sem);
+        }
+        else if( !period_ns ) {
+            // unthrottled: wait for the consumer, measures its peak rate
+            usleep(10);
+            continue;
+        }
+        else {
+            // no buffer queued by the consumer, the block is lost
+            hdr->dropped++;
+        }
+        seqno++;
+
+        if( period_ns ) {
+            deadline.tv_nsec += period_ns;
+            while( deadline.tv_nsec >= 1000000000 ) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        }
+    }
+
+    printf("produced [%llu] blocks, dropped [%llu]\n", (unsigned long long)seqno,
+           (unsigned long long)hdr->dropped.load());
+    sem_destroy(&hdr->done_sem);
+    munmap(hdr, map_size);
+    shm_unlink(m_name.c_str());
+    return 0;
+}
@@ -0,0 +1,269 @@
+//!*********************************************************************
+//! @file cerb_net.cpp
+//!
+//! @brief
+//! Framed network transport for IQ samples. See cerb_net.h.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // sendmmsg()
+#endif
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "cerb_net.h"
+
+//!******************************************************
+//! @brief
+//! Splits udp://host:port or tcp://host:port
+//!
+//!******************************************************
+bool cerb_net_parse_url(const std::string& url, bool& udp, std::string& host, int& port)
+{
+    if( url.compare(0, 6, "udp://") == 0 ) {
+        udp = true;
+    }
+    else if( url.compare(0, 6, "tcp://") == 0 ) {
+        udp = false;
+    }
+    else {
+        return false;
+    }
+    size_t colon = url.find_last_of(':');
+    if( colon <= 5 || colon + 1 >= url.size() ) {
+        return false;
+    }
+    host = url.substr(6, colon - 6);
+    char* end = nullptr;
+    port = strtol(url.c_str() + colon + 1, &end, 10);
+    return !host.empty() && *end == '\0' && port > 0 && port < 65536;
+}
+
+cerb_net_sender::cerb_net_sender()
+    : m_fd(-1), m_udp(true), m_format(CERB_FORMAT_SC16), m_frag_samps(0), m_packet_seqno(0)
+{
+}
+
+cerb_net_sender::~cerb_net_sender()
+{
+    close();
+}
+
+//!******************************************************
+//! @brief
+//! Connects to the receiver. mtu sizes the UDP
+//! datagrams; TCP frames always carry a whole block.
+//!
+//!******************************************************
+bool cerb_net_sender::open(const std::string& url, cerb_format_e format, size_t mtu)
+{
+    std::string host;
+    int port;
+    if( !cerb_net_parse_url(url, m_udp, host, port) ) {
+        printf("error: invalid network destination [%s], expected udp://host:port or tcp://host:port\n", url.c_str());
+        return false;
+    }
+
+    size_t sample_size = cerb_format_sample_size(format);
+    if( m_udp && mtu < CERB_NET_IP_UDP_OVERHEAD + sizeof(cerb_net_hdr_t) + sample_size ) {
+        printf("error: MTU [%zu] too small\n", mtu);
+        return false;
+    }
+    m_format       = format;
+    m_frag_samps   = m_udp ? (mtu - CERB_NET_IP_UDP_OVERHEAD - sizeof(cerb_net_hdr_t)) / sample_size : 0;
+    m_packet_seqno = 0;
+
+    struct addrinfo hints;
+    struct addrinfo* res = nullptr;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = m_udp ? SOCK_DGRAM : SOCK_STREAM;
+    int rc = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &res);
+    if( rc ) {
+        printf("error: failed to resolve [%s] [%s]\n", host.c_str(), gai_strerror(rc));
+        return false;
+    }
+
+    m_fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if( m_fd >= 0 ) {
+        int sndbuf = CERB_NET_SNDBUF;
+        setsockopt(m_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+        // a connected UDP socket needs no address per datagram
+        if( connect(m_fd, res->ai_addr, res->ai_addrlen) < 0 ) {
+            printf("error: failed to connect to [%s] [%s]\n", url.c_str(), strerror(errno));
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return m_fd >= 0;
+}
+
+void cerb_net_sender::close()
+{
+    if( m_fd >= 0 ) {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+}
+
+//!******************************************************
+//! @brief
+//! Queues one frame; iovecs are built at flush time so
+//! the header vector may grow
+//!
+//!******************************************************
+void cerb_net_sender::add_frame(const cerb_net_block_t& blk, size_t offset, size_t nsamps, uint16_t flags)
+{
+    size_t sample_size = cerb_format_sample_size(m_format);
+
+    cerb_net_hdr_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic         = CERB_NET_MAGIC;
+    hdr.version       = CERB_NET_VERSION;
+    hdr.hdr_bytes     = sizeof(cerb_net_hdr_t);
+    hdr.format        = m_format;
+    hdr.channels      = 1;
+    hdr.flags         = flags;
+    hdr.payload_bytes = nsamps * sample_size;
+    hdr.packet_seqno  = m_packet_seqno++;
+    hdr.block_seqno   = blk.seqno;
+    hdr.timestamp_ns  = blk.timestamp_ns;
+    hdr.sample_offset = offset;
+    hdr.block_samps   = blk.nsamps;
+    hdr.sample_rate   = static_cast<uint32_t>(CERB_SAMP_RATE);
+    m_hdrs.push_back(hdr);
+
+    struct iovec payload;
+    payload.iov_base = const_cast<uint8_t*>(static_cast<const uint8_t*>(blk.data) + offset * sample_size);
+    payload.iov_len  = hdr.payload_bytes;
+    m_iov.push_back(payload);
+}
+
+//!******************************************************
+//! @brief
+//! Sends the pending datagrams, CERB_NET_MAX_MSGS per
+//! sendmmsg() call
+//!
+//!******************************************************
+bool cerb_net_sender::flush_udp()
+{
+    size_t nframes = m_hdrs.size();
+    std::vector<struct iovec>   iov(2 * nframes);
+    std::vector<struct mmsghdr> msgs(std::min<size_t>(nframes, CERB_NET_MAX_MSGS));
+    for (size_t k = 0; k < nframes; k++) {
+        iov[2*k].iov_base = &m_hdrs[k];
+        iov[2*k].iov_len  = sizeof(cerb_net_hdr_t);
+        iov[2*k + 1]      = m_iov[k];
+    }
+
+    size_t sent = 0;
+    while( sent < nframes )
+    {
+        size_t n = std::min<size_t>(nframes - sent, CERB_NET_MAX_MSGS);
+        for (size_t k = 0; k < n; k++) {
+            memset(&msgs[k], 0, sizeof(msgs[k]));
+            msgs[k].msg_hdr.msg_iov    = &iov[2 * (sent + k)];
+            msgs[k].msg_hdr.msg_iovlen = m_iov[sent + k].iov_len ? 2 : 1;
+        }
+        int rc = sendmmsg(m_fd, &msgs[0], n, 0);
+        if( rc < 0 ) {
+            // ECONNREFUSED reports an earlier datagram nobody received, e.g.
+            // while the receiver restarts; the error is cleared by reporting it
+            if( errno == EINTR || errno == ENOBUFS || errno == ECONNREFUSED ) {
+                continue;
+            }
+            printf("error: udp send failed [%s]\n", strerror(errno));
+            return false;
+        }
+        sent += rc;
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Writes the pending frames to the TCP stream, picking
+//! up where a short write stopped
+//!
+//!******************************************************
+bool cerb_net_sender::flush_tcp()
+{
+    std::vector<struct iovec> iov;
+    for (size_t k = 0; k < m_hdrs.size(); k++) {
+        struct iovec h = { &m_hdrs[k], sizeof(cerb_net_hdr_t) };
+        iov.push_back(h);
+        if( m_iov[k].iov_len ) {
+            iov.push_back(m_iov[k]);
+        }
+    }
+
+    size_t first = 0;
+    while( first < iov.size() )
+    {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov    = &iov[first];
+        msg.msg_iovlen = std::min<size_t>(iov.size() - first, CERB_NET_MAX_MSGS);
+        ssize_t rc = sendmsg(m_fd, &msg, MSG_NOSIGNAL);
+        if( rc < 0 ) {
+            if( errno == EINTR ) {
+                continue;
+            }
+            printf("error: tcp send failed [%s]\n", strerror(errno));
+            return false;
+        }
+        while( rc > 0 ) {
+            size_t n = std::min<size_t>(rc, iov[first].iov_len);
+            iov[first].iov_base = static_cast<uint8_t*>(iov[first].iov_base) + n;
+            iov[first].iov_len -= n;
+            rc -= n;
+            if( !iov[first].iov_len ) {
+                first++;
+            }
+        }
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Sends a batch of blocks with as few system calls as
+//! the transport allows
+//!
+//!******************************************************
+bool cerb_net_sender::send(const std::vector<cerb_net_block_t>& blocks)
+{
+    m_hdrs.clear();
+    m_iov.clear();
+    for (size_t b = 0; b < blocks.size(); b++) {
+        const cerb_net_block_t& blk = blocks[b];
+        size_t frag = m_udp ? m_frag_samps : blk.nsamps;
+        for (size_t offset = 0; offset < blk.nsamps; offset += frag) {
+            size_t n = std::min(frag, blk.nsamps - offset);
+            add_frame(blk, offset, n, (offset + n == blk.nsamps) ? CERB_NET_FLAG_LAST_FRAG : 0);
+        }
+    }
+    return m_udp ? flush_udp() : flush_tcp();
+}
+
+//!******************************************************
+//! @brief
+//! Tells the receiver the stream is complete
+//!
+//!******************************************************
+bool cerb_net_sender::finish()
+{
+    cerb_net_block_t end = { nullptr, 0, 0, 0 };
+    m_hdrs.clear();
+    m_iov.clear();
+    add_frame(end, 0, 0, CERB_NET_FLAG_END);
+    return m_udp ? flush_udp() : flush_tcp();
+}
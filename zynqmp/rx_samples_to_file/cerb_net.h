@@ -0,0 +1,102 @@
+//!*********************************************************************
+//! @file cerb_net.h
+//!
+//! @brief
+//! Framed network transport for IQ samples. Every DMA block is sent as
+//! one or more frames, each a cerb_net_hdr_t followed by its payload:
+//!
+//!  - udp://host:port  a block is split into datagrams that fit the
+//!                     MTU (9000 byte jumbo frames by default); frames
+//!                     of several blocks go out in one sendmmsg()
+//!  - tcp://host:port  one frame per block, several blocks per
+//!                     sendmsg()
+//!
+//! The receiver listens (host/receiver, or the slower
+//! host/python/cerb_net_receiver.py) and the board connects or sends
+//! to it. Payloads are the samples exactly as they would be written to
+//! a capture file; an END frame without payload closes the stream.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_NET_H_
+#define CERB_NET_H_
+
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "cerb_common.h"
+#include "cerb_writer.h"
+
+#define CERB_NET_MAGIC          0x46524543  // 'CERF'
+#define CERB_NET_VERSION        1
+#define CERB_NET_DEFAULT_MTU    9000
+#define CERB_NET_IP_UDP_OVERHEAD 28         // IPv4 + UDP headers
+#define CERB_NET_MAX_MSGS       1024        // datagrams per sendmmsg()
+#define CERB_NET_SNDBUF         (8 << 20)
+
+#define CERB_NET_FLAG_LAST_FRAG 0x0001      // last frame of a DMA block
+#define CERB_NET_FLAG_END       0x0002      // end of stream, no payload
+
+//! Frame header, little endian
+typedef struct __attribute__((__packed__)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t hdr_bytes;      // sizeof(cerb_net_hdr_t), payload follows
+    uint8_t  format;         // cerb_format_e of the payload
+    uint8_t  channels;       // interleaved channels
+    uint16_t flags;
+    uint32_t payload_bytes;
+    uint64_t packet_seqno;   // per stream, gaps mean lost datagrams
+    uint64_t block_seqno;    // DMA block sequence number
+    uint64_t timestamp_ns;   // CLOCK_MONOTONIC DMA completion time
+    uint32_t sample_offset;  // first payload sample within the block
+    uint32_t block_samps;    // samples in the whole block
+    uint32_t sample_rate;    // Hz
+    uint32_t reserved;
+} cerb_net_hdr_t;
+
+//! Block handed to the sender, data in the sender's format
+typedef struct {
+    const void* data;
+    size_t      nsamps;
+    uint64_t    seqno;
+    uint64_t    timestamp_ns;
+} cerb_net_block_t;
+
+//!******************************************************
+//! @brief
+//! Sends sample blocks to a cerb_net receiver
+//!
+//!******************************************************
+class cerb_net_sender
+{
+public:
+    cerb_net_sender();
+    ~cerb_net_sender();
+
+    bool open(const std::string& url, cerb_format_e format, size_t mtu);
+    bool send(const std::vector<cerb_net_block_t>& blocks);
+    bool finish();
+    void close();
+
+    uint64_t packets() const { return m_packet_seqno; }
+
+private:
+    void add_frame(const cerb_net_block_t& blk, size_t offset, size_t nsamps, uint16_t flags);
+    bool flush_udp();
+    bool flush_tcp();
+
+    int                         m_fd;
+    bool                        m_udp;
+    cerb_format_e               m_format;
+    size_t                      m_frag_samps;   // samples per datagram
+    uint64_t                    m_packet_seqno;
+    std::vector<cerb_net_hdr_t> m_hdrs;         // frames of the pending send
+    std::vector<struct iovec>   m_iov;          // header + payload per frame
+};
+
+bool cerb_net_parse_url(const std::string& url, bool& udp, std::string& host, int& port);
+
+#endif /* CERB_NET_H_ */
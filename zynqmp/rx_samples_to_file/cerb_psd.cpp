@@ -0,0 +1,406 @@
+//!*********************************************************************
+//! @file cerb_psd.cpp
+//!
+//! @brief
+//! Welch power spectrum. See cerb_psd.h.
+//!
+//! Segments never straddle a restart(): the caller restarts after
+//! dropped DMA blocks so a frame only averages contiguous samples.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <math.h>
+#include <algorithm>
+#include <cstdio>
+#include "cerb_psd.h"
+
+#ifdef CERB_HAVE_FFTW
+#include <fftw3.h>
+#endif
+
+//!******************************************************
+//! @brief
+//! FFT scratch and power accumulator of one thread
+//!
+//!******************************************************
+class cerb_psd_worker
+{
+public:
+    explicit cerb_psd_worker(size_t nfft);
+    ~cerb_psd_worker();
+
+    void segment(const cmplx_sample_t* x, const float* window);
+    void clear() { std::fill(acc.begin(), acc.end(), 0.0f); }
+
+    std::vector<float> acc;     // sum of |X[k]|^2, FFT bin order
+
+private:
+    size_t m_nfft;
+#ifdef CERB_HAVE_FFTW
+    fftwf_complex* m_in;
+    fftwf_complex* m_out;
+    fftwf_plan     m_plan;
+#else
+    void fft();
+
+    std::vector<uint32_t> m_rev;    // bit reversed input order
+    std::vector<float>    m_twr;    // e^(-j 2 pi k / len) of every stage, back to back
+    std::vector<float>    m_twi;
+    std::vector<float>    m_re;
+    std::vector<float>    m_im;
+#endif
+};
+
+#ifdef CERB_HAVE_FFTW
+cerb_psd_worker::cerb_psd_worker(size_t nfft)
+    : acc(nfft, 0.0f), m_nfft(nfft)
+{
+    // planning is not thread safe, workers are built on the caller's thread
+    m_in   = fftwf_alloc_complex(nfft);
+    m_out  = fftwf_alloc_complex(nfft);
+    m_plan = fftwf_plan_dft_1d(static_cast<int>(nfft), m_in, m_out, FFTW_FORWARD, FFTW_MEASURE);
+}
+
+cerb_psd_worker::~cerb_psd_worker()
+{
+    fftwf_destroy_plan(m_plan);
+    fftwf_free(m_in);
+    fftwf_free(m_out);
+}
+
+void cerb_psd_worker::segment(const cmplx_sample_t* x, const float* window)
+{
+    for (size_t k = 0; k < m_nfft; k++) {
+        m_in[k][0] = x[k].real() * window[k];
+        m_in[k][1] = x[k].imag() * window[k];
+    }
+    fftwf_execute(m_plan);
+    for (size_t k = 0; k < m_nfft; k++) {
+        acc[k] += m_out[k][0] * m_out[k][0] + m_out[k][1] * m_out[k][1];
+    }
+}
+#else
+cerb_psd_worker::cerb_psd_worker(size_t nfft)
+    : acc(nfft, 0.0f), m_nfft(nfft), m_rev(nfft), m_twr(nfft - 1), m_twi(nfft - 1), m_re(nfft), m_im(nfft)
+{
+    size_t bits = 0;
+    while( (size_t(1) << bits) < nfft ) {
+        bits++;
+    }
+    for (size_t k = 0; k < nfft; k++) {
+        uint32_t r = 0;
+        for (size_t b = 0; b < bits; b++) {
+            r |= ((k >> b) & 1) << (bits - 1 - b);
+        }
+        m_rev[k] = r;
+    }
+    // stage of length len keeps its len/2 twiddles at offset len/2 - 1
+    for (size_t len = 2; len <= nfft; len <<= 1) {
+        size_t half = len / 2;
+        for (size_t j = 0; j < half; j++) {
+            double a = -2 * M_PI * j / len;
+            m_twr[half - 1 + j] = static_cast<float>(cos(a));
+            m_twi[half - 1 + j] = static_cast<float>(sin(a));
+        }
+    }
+}
+
+cerb_psd_worker::~cerb_psd_worker()
+{
+}
+
+//!******************************************************
+//! @brief
+//! In-place radix-2 decimation in time on bit reversed
+//! input; the inner loop runs over contiguous twiddles
+//!
+//!******************************************************
+void cerb_psd_worker::fft()
+{
+    float* re = &m_re[0];
+    float* im = &m_im[0];
+    for (size_t len = 2; len <= m_nfft; len <<= 1) {
+        size_t half = len / 2;
+        const float* twr = &m_twr[half - 1];
+        const float* twi = &m_twi[half - 1];
+        for (size_t i = 0; i < m_nfft; i += len) {
+            float* ar = &re[i];
+            float* ai = &im[i];
+            float* br = &re[i + half];
+            float* bi = &im[i + half];
+            for (size_t j = 0; j < half; j++) {
+                float tr = br[j] * twr[j] - bi[j] * twi[j];
+                float ti = br[j] * twi[j] + bi[j] * twr[j];
+                br[j] = ar[j] - tr;
+                bi[j] = ai[j] - ti;
+                ar[j] += tr;
+                ai[j] += ti;
+            }
+        }
+    }
+}
+
+void cerb_psd_worker::segment(const cmplx_sample_t* x, const float* window)
+{
+    for (size_t k = 0; k < m_nfft; k++) {
+        m_re[m_rev[k]] = x[k].real() * window[k];
+        m_im[m_rev[k]] = x[k].imag() * window[k];
+    }
+    fft();
+    for (size_t k = 0; k < m_nfft; k++) {
+        acc[k] += m_re[k] * m_re[k] + m_im[k] * m_im[k];
+    }
+}
+#endif
+
+const char* cerb_psd::backend()
+{
+#ifdef CERB_HAVE_FFTW
+    return "fftw";
+#else
+    return "radix-2";
+#endif
+}
+
+cerb_psd::cerb_psd()
+    : m_hop(0), m_norm(0), m_enbw(0), m_generation(0), m_pending(0), m_quit(false),
+      m_job_x(nullptr), m_job_nsegs(0), m_segs(0), m_frames(0)
+{
+    m_cfg = cerb_psd_config_t();
+}
+
+cerb_psd::~cerb_psd()
+{
+    stop_workers();
+}
+
+void cerb_psd::stop_workers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_quit = true;
+    }
+    m_start.notify_all();
+    for (size_t k = 0; k < m_threads.size(); k++) {
+        m_threads[k].join();
+    }
+    m_threads.clear();
+    m_workers.clear();
+    m_quit = false;
+}
+
+//!******************************************************
+//! @brief
+//! Builds the window and one worker per thread; frame
+//! is called with every averaged spectrum
+//!
+//!******************************************************
+bool cerb_psd::configure(const cerb_psd_config_t& cfg, const frame_fn_t& frame)
+{
+    if( cfg.nfft < CERB_PSD_MIN_NFFT || cfg.nfft > CERB_PSD_MAX_NFFT || (cfg.nfft & (cfg.nfft - 1)) ) {
+        printf("error: FFT size must be a power of two between [%d] and [%d]\n", CERB_PSD_MIN_NFFT, CERB_PSD_MAX_NFFT);
+        return false;
+    }
+    if( cfg.overlap >= cfg.nfft || !cfg.navg ) {
+        printf("error: overlap must be below the FFT size and averaging at least 1\n");
+        return false;
+    }
+    stop_workers();
+
+    m_cfg   = cfg;
+    m_hop   = cfg.nfft - cfg.overlap;
+    m_frame = frame;
+    if( !m_cfg.nthreads ) {
+        m_cfg.nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // periodic Hann
+    m_window.resize(cfg.nfft);
+    double sum = 0, sum2 = 0;
+    for (size_t k = 0; k < cfg.nfft; k++) {
+        double w = 0.5 - 0.5 * cos(2 * M_PI * k / cfg.nfft);
+        m_window[k] = static_cast<float>(w);
+        sum  += w;
+        sum2 += w * w;
+    }
+    m_norm = static_cast<float>(1.0 / (cfg.navg * sum * sum));
+    m_enbw = cfg.nfft * sum2 / (sum * sum);
+
+    for (size_t w = 0; w < m_cfg.nthreads; w++) {
+        m_workers.push_back(std::unique_ptr<cerb_psd_worker>(new cerb_psd_worker(cfg.nfft)));
+    }
+    for (size_t w = 1; w < m_cfg.nthreads; w++) {
+        m_threads.push_back(std::thread(&cerb_psd::worker_main, this, w));
+    }
+
+    m_acc.assign(cfg.nfft, 0.0f);
+    m_dbfs.assign(cfg.nfft, 0.0f);
+    m_carry.clear();
+    m_segs   = 0;
+    m_frames = 0;
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Drops the samples held for the next segment, the
+//! next block starts a new segment
+//!
+//!******************************************************
+void cerb_psd::restart()
+{
+    m_carry.clear();
+}
+
+//!******************************************************
+//! @brief
+//! Helper thread w, takes its share of every job
+//!
+//!******************************************************
+void cerb_psd::worker_main(size_t w)
+{
+    uint64_t seen = 0;
+    for (;;) {
+        const cmplx_sample_t* x;
+        size_t nsegs;
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+            m_start.wait(lock, [&]() { return m_quit || m_generation != seen; });
+            if( m_quit ) {
+                return;
+            }
+            seen  = m_generation;
+            x     = m_job_x;
+            nsegs = m_job_nsegs;
+        }
+
+        size_t nw = m_workers.size();
+        for (size_t k = w * nsegs / nw; k < (w + 1) * nsegs / nw; k++) {
+            m_workers[w]->segment(&x[k * m_hop], &m_window[0]);
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        if( --m_pending == 0 ) {
+            m_done.notify_one();
+        }
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Accumulates nsegs segments starting at x, hop apart,
+//! split over the workers; returns when all are done
+//!
+//!******************************************************
+void cerb_psd::dispatch(const cmplx_sample_t* x, size_t nsegs)
+{
+    size_t nw = m_workers.size();
+    if( nw == 1 || nsegs < nw ) {
+        for (size_t k = 0; k < nsegs; k++) {
+            m_workers[0]->segment(&x[k * m_hop], &m_window[0]);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_job_x     = x;
+        m_job_nsegs = nsegs;
+        m_pending   = nw - 1;
+        m_generation++;
+    }
+    m_start.notify_all();
+
+    for (size_t k = 0; k < nsegs / nw; k++) {
+        m_workers[0]->segment(&x[k * m_hop], &m_window[0]);
+    }
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_done.wait(lock, [&]() { return m_pending == 0; });
+}
+
+//!******************************************************
+//! @brief
+//! Runs nsegs segments, emitting a frame each time navg
+//! have been accumulated
+//!
+//!******************************************************
+bool cerb_psd::run(const cmplx_sample_t* x, size_t nsegs, uint64_t seqno, uint64_t timestamp_ns)
+{
+    const size_t nfft = m_cfg.nfft;
+    while( nsegs ) {
+        size_t k = std::min(nsegs, m_cfg.navg - m_segs);
+        dispatch(x, k);
+        m_segs += k;
+        x      += k * m_hop;
+        nsegs  -= k;
+        if( m_segs < m_cfg.navg ) {
+            break;
+        }
+
+        std::fill(m_acc.begin(), m_acc.end(), 0.0f);
+        for (size_t w = 0; w < m_workers.size(); w++) {
+            const float* acc = &m_workers[w]->acc[0];
+            for (size_t b = 0; b < nfft; b++) {
+                m_acc[b] += acc[b];
+            }
+            m_workers[w]->clear();
+        }
+        // DC to the middle of the frame
+        for (size_t b = 0; b < nfft; b++) {
+            m_dbfs[b] = 10.0f * log10f(m_acc[(b + nfft / 2) & (nfft - 1)] * m_norm + 1e-20f);
+        }
+        m_segs = 0;
+
+        cerb_psd_frame_t frame;
+        frame.index        = m_frames++;
+        frame.seqno        = seqno;
+        frame.timestamp_ns = timestamp_ns;
+        if( m_frame && !m_frame(frame, &m_dbfs[0]) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Feeds n samples of one block. Segments that start in
+//! the previous block run from a joined copy, the rest
+//! straight from x.
+//!
+//!******************************************************
+bool cerb_psd::process(const cmplx_sample_t* x, size_t n, uint64_t seqno, uint64_t timestamp_ns)
+{
+    const size_t nfft = m_cfg.nfft;
+    size_t c = m_carry.size();
+
+    if( c ) {
+        size_t nc   = (c + m_hop - 1) / m_hop;
+        size_t need = (nc - 1) * m_hop + nfft - c;
+        if( n < need ) {
+            m_carry.insert(m_carry.end(), x, x + n);
+            size_t cnt = (m_carry.size() >= nfft) ? (m_carry.size() - nfft) / m_hop + 1 : 0;
+            if( !run(&m_carry[0], cnt, seqno, timestamp_ns) ) {
+                return false;
+            }
+            m_carry.erase(m_carry.begin(), m_carry.begin() + cnt * m_hop);
+            return true;
+        }
+        m_join.assign(m_carry.begin(), m_carry.end());
+        m_join.insert(m_join.end(), x, x + need);
+        if( !run(&m_join[0], nc, seqno, timestamp_ns) ) {
+            return false;
+        }
+        x += nc * m_hop - c;
+        n -= nc * m_hop - c;
+    }
+
+    size_t cnt = (n >= nfft) ? (n - nfft) / m_hop + 1 : 0;
+    if( !run(x, cnt, seqno, timestamp_ns) ) {
+        return false;
+    }
+    m_carry.assign(x + cnt * m_hop, x + n);
+    return true;
+}
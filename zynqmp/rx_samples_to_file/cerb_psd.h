@@ -0,0 +1,107 @@
+//!*********************************************************************
+//! @file cerb_psd.h
+//!
+//! @brief
+//! Welch power spectrum of the streaming capture. Samples are cut into
+//! Hann windowed segments of nfft samples, overlapping by overlap
+//! samples, and the squared FFT magnitudes of navg segments are
+//! averaged into one frame. Frames are scaled so that a full scale
+//! tone on a bin reads 0 dBFS and come out as nfft floats in dBFS,
+//! ordered from -fs/2 to fs/2.
+//!
+//! The segments of a block are spread over a pool of worker threads,
+//! each with its own FFT scratch and accumulator. FFTW is used when
+//! the build finds it (CERB_HAVE_FFTW), otherwise a radix-2 FFT.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_PSD_H_
+#define CERB_PSD_H_
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cerb_common.h"
+
+#define CERB_PSD_MIN_NFFT 16
+#define CERB_PSD_MAX_NFFT (1 << 16)
+
+//! Spectrum settings
+typedef struct {
+    size_t nfft;             // power of two
+    size_t overlap;          // samples shared by consecutive segments, < nfft
+    size_t navg;             // segments averaged per frame
+    size_t nthreads;         // 0 = one per core
+} cerb_psd_config_t;
+
+//! One averaged spectrum
+typedef struct {
+    uint64_t index;          // frame number, from 0
+    uint64_t seqno;          // DMA block that completed the frame
+    uint64_t timestamp_ns;   // CLOCK_MONOTONIC completion time of that block
+} cerb_psd_frame_t;
+
+class cerb_psd_worker;
+
+//!******************************************************
+//! @brief
+//! Averages spectra of a sample stream. process() and
+//! the frame callback run on the caller's thread, which
+//! also takes a share of the segments.
+//!
+//!******************************************************
+class cerb_psd
+{
+public:
+    typedef std::function<bool(const cerb_psd_frame_t&, const float* dbfs)> frame_fn_t;
+
+    cerb_psd();
+    ~cerb_psd();
+
+    bool configure(const cerb_psd_config_t& cfg, const frame_fn_t& frame);
+    bool process(const cmplx_sample_t* x, size_t n, uint64_t seqno, uint64_t timestamp_ns);
+    void restart();
+
+    size_t   threads() const { return m_workers.size(); }
+    uint64_t frames() const  { return m_frames; }
+    double   enbw() const    { return m_enbw; }
+
+    static const char* backend();
+
+private:
+    bool run(const cmplx_sample_t* x, size_t nsegs, uint64_t seqno, uint64_t timestamp_ns);
+    void dispatch(const cmplx_sample_t* x, size_t nsegs);
+    void worker_main(size_t w);
+    void stop_workers();
+
+    cerb_psd_config_t   m_cfg;
+    size_t              m_hop;
+    frame_fn_t          m_frame;
+    std::vector<float>  m_window;
+    float               m_norm;         // 1 / (navg (sum w)^2)
+    double              m_enbw;         // equivalent noise bandwidth, bins
+
+    std::vector<std::unique_ptr<cerb_psd_worker> > m_workers;
+    std::vector<std::thread>                       m_threads;
+    std::mutex              m_lock;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    uint64_t                m_generation;   // bumped per dispatched job
+    size_t                  m_pending;      // helper threads still on the job
+    bool                    m_quit;
+    const cmplx_sample_t*   m_job_x;
+    size_t                  m_job_nsegs;
+
+    cmplx_sample_vec_t  m_carry;        // tail of the stream not yet segmented
+    cmplx_sample_vec_t  m_join;         // carry + head of the next block
+    size_t              m_segs;         // segments in the current frame
+    std::vector<float>  m_acc;
+    std::vector<float>  m_dbfs;
+    uint64_t            m_frames;
+};
+
+#endif /* CERB_PSD_H_ */
@@ -0,0 +1,166 @@
+//!*********************************************************************
+//! @file cerb_sigmf.cpp
+//!
+//! @brief
+//! SigMF metadata for capture files. See cerb_sigmf.h.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include "cerb_sigmf.h"
+
+static uint64_t clock_ns(clockid_t clk)
+{
+    struct timespec ts;
+    clock_gettime(clk, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+//!******************************************************
+//! @brief
+//! Quotes a string for JSON
+//!
+//!******************************************************
+static std::string json_string(const std::string& s)
+{
+    std::string out = "\"";
+    for (size_t k = 0; k < s.size(); k++) {
+        char c = s[k];
+        if( c == '"' || c == '\\' ) {
+            out += '\\';
+            out += c;
+        }
+        else if( (unsigned char)c < 0x20 ) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        }
+        else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+cerb_sigmf_writer::cerb_sigmf_writer()
+    : m_fp(nullptr), m_sample_start(0), m_nblocks(0),
+      m_start_mono_ns(0), m_start_real_ns(0), m_sample_rate(CERB_SAMP_RATE), m_center_freq_hz(0)
+{
+}
+
+cerb_sigmf_writer::~cerb_sigmf_writer()
+{
+    if( m_fp ) {
+        fclose(m_fp);
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Creates <data_path>.sigmf-meta and writes the global
+//! object. The capture start time is taken here.
+//!
+//!******************************************************
+bool cerb_sigmf_writer::open(const std::string& data_path, const cerb_sigmf_info_t& info)
+{
+    std::string fn = data_path + CERB_SIGMF_EXT;
+    m_fp = fopen(fn.c_str(), "w");
+    if( !m_fp ) {
+        printf("failed to open file [%s]: %s\n", fn.c_str(), strerror(errno));
+        return false;
+    }
+
+    m_sample_start   = 0;
+    m_nblocks        = 0;
+    m_start_mono_ns  = clock_ns(CLOCK_MONOTONIC);
+    m_start_real_ns  = clock_ns(CLOCK_REALTIME);
+    m_sample_rate    = info.sample_rate;
+    m_center_freq_hz = info.center_freq_hz;
+
+    size_t slash = data_path.find_last_of('/');
+    std::string dataset = (slash == std::string::npos) ? data_path : data_path.substr(slash + 1);
+
+    fprintf(m_fp, "{\n  \"global\": {\n");
+    fprintf(m_fp, "    \"core:datatype\": \"%s\",\n", (info.format == CERB_FORMAT_SC16) ? "ci16_le" : "cf32_le");
+    fprintf(m_fp, "    \"core:sample_rate\": %.3f,\n", m_sample_rate);
+    fprintf(m_fp, "    \"core:version\": \"%s\",\n", CERB_SIGMF_VERSION);
+    fprintf(m_fp, "    \"core:num_channels\": %zu,\n", info.nchannels);
+    fprintf(m_fp, "    \"core:dataset\": %s,\n", json_string(dataset).c_str());
+    fprintf(m_fp, "    \"core:recorder\": \"rx_samples_to_file\",\n");
+    fprintf(m_fp, "    \"core:hw\": \"Cerberus SDR\",\n");
+    fprintf(m_fp, "    \"core:extensions\": [{\"name\": \"cerb\", \"version\": \"1.0.0\", \"optional\": true}],\n");
+    fprintf(m_fp, "    \"cerb:dma_dev\": %s,\n", json_string(info.dma_dev).c_str());
+    fprintf(m_fp, "    \"cerb:scale\": %.10e,\n", cerb_format_scale(info.format));
+    if( info.cwgen ) {
+        fprintf(m_fp, "    \"cerb:cwgen_freq\": %.1f,\n", info.cwgen_freq_hz);
+        fprintf(m_fp, "    \"cerb:cwgen_ampl\": %zu,\n", info.cwgen_ampl);
+    }
+    fprintf(m_fp, "    \"cerb:start_monotonic_ns\": %llu,\n", (unsigned long long)m_start_mono_ns);
+    fprintf(m_fp, "    \"cerb:start_realtime_ns\": %llu\n", (unsigned long long)m_start_real_ns);
+    fprintf(m_fp, "  },\n  \"captures\": [");
+    return !ferror(m_fp);
+}
+
+//!******************************************************
+//! @brief
+//! UTC time of a CLOCK_MONOTONIC instant, in SigMF's
+//! ISO-8601 form
+//!
+//!******************************************************
+std::string cerb_sigmf_writer::datetime(uint64_t monotonic_ns) const
+{
+    uint64_t real_ns = m_start_real_ns + (monotonic_ns - m_start_mono_ns);
+    time_t   secs = static_cast<time_t>(real_ns / 1000000000ull);
+    struct tm tm;
+    gmtime_r(&secs, &tm);
+
+    char buf[48];
+    size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(buf + n, sizeof(buf) - n, ".%09lluZ", (unsigned long long)(real_ns % 1000000000ull));
+    return buf;
+}
+
+//!******************************************************
+//! @brief
+//! Adds the capture segment of one DMA block. nsamps is
+//! per channel; the datetime is that of the block's
+//! first sample, derived from its completion time.
+//!
+//!******************************************************
+bool cerb_sigmf_writer::add_block(uint64_t nsamps, uint64_t seqno, uint64_t timestamp_ns)
+{
+    if( !m_fp ) {
+        return false;
+    }
+    uint64_t duration_ns = static_cast<uint64_t>(nsamps * 1e9 / m_sample_rate);
+    uint64_t first_ns = (timestamp_ns > duration_ns) ? timestamp_ns - duration_ns : timestamp_ns;
+
+    fprintf(m_fp, "%s\n    {\"core:sample_start\": %llu, \"core:frequency\": %.1f, \"core:datetime\": \"%s\", "
+                  "\"cerb:seqno\": %llu, \"cerb:timestamp_ns\": %llu}",
+            m_nblocks ? "," : "",
+            (unsigned long long)m_sample_start, m_center_freq_hz, datetime(first_ns).c_str(),
+            (unsigned long long)seqno, (unsigned long long)timestamp_ns);
+    m_sample_start += nsamps;
+    m_nblocks++;
+    return !ferror(m_fp);
+}
+
+//!******************************************************
+//! @brief
+//! Terminates the captures array and closes the file
+//!
+//!******************************************************
+bool cerb_sigmf_writer::close()
+{
+    if( !m_fp ) {
+        return false;
+    }
+    fprintf(m_fp, "\n  ],\n  \"annotations\": []\n}\n");
+    bool ok = !ferror(m_fp);
+    ok = (fclose(m_fp) == 0) && ok;
+    m_fp = nullptr;
+    return ok;
+}
@@ -0,0 +1,66 @@
+//!*********************************************************************
+//! @file cerb_sigmf.h
+//!
+//! @brief
+//! SigMF metadata for capture files. A <file>.sigmf-meta is written
+//! next to the samples; the data file keeps its name and is referenced
+//! through core:dataset. Every DMA block becomes a capture segment that
+//! carries its sequence number and CLOCK_MONOTONIC completion time, so
+//! dropped blocks show up as sequence gaps between segments.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_SIGMF_H_
+#define CERB_SIGMF_H_
+
+#include <cstdio>
+#include <string>
+#include "cerb_common.h"
+#include "cerb_writer.h"
+
+#define CERB_SIGMF_EXT     ".sigmf-meta"
+#define CERB_SIGMF_VERSION "1.0.0"
+
+//! Capture settings recorded in the global object
+typedef struct {
+    cerb_format_e format;
+    size_t        nchannels;     // interleaved channels in the data file
+    double        sample_rate;   // Hz, lower than CERB_SAMP_RATE when decimating
+    double        center_freq_hz;
+    bool          cwgen;         // CWGEN settings below are valid
+    double        cwgen_freq_hz;
+    size_t        cwgen_ampl;
+    std::string   dma_dev;
+} cerb_sigmf_info_t;
+
+//!******************************************************
+//! @brief
+//! Streams the metadata as blocks are written, the file
+//! is complete once close() returns true
+//!
+//!******************************************************
+class cerb_sigmf_writer
+{
+public:
+    cerb_sigmf_writer();
+    ~cerb_sigmf_writer();
+
+    bool open(const std::string& data_path, const cerb_sigmf_info_t& info);
+    bool add_block(uint64_t nsamps, uint64_t seqno, uint64_t timestamp_ns);
+    bool close();
+    bool is_open() const { return m_fp != nullptr; }
+
+private:
+    std::string datetime(uint64_t monotonic_ns) const;
+
+    FILE*    m_fp;
+    uint64_t m_sample_start;     // samples written so far
+    uint64_t m_nblocks;
+    uint64_t m_start_mono_ns;    // CLOCK_MONOTONIC / CLOCK_REALTIME pair taken
+    uint64_t m_start_real_ns;    // at open(), maps DMA timestamps to UTC
+    double   m_sample_rate;
+    double   m_center_freq_hz;
+};
+
+#endif /* CERB_SIGMF_H_ */
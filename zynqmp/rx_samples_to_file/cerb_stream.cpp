@@ -0,0 +1,689 @@
+//!*********************************************************************
+//! @file cerb_stream.cpp
+//!
+//! @brief
+//! Continuous DMA streaming for the Cerberus SDR. See cerb_stream.h.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "cerb_stream.h"
+
+// set asynchronously (e.g. from a signal handler) to end a capture
+static std::atomic<bool> s_stop(false);
+
+//!******************************************************
+//! @brief
+//! Allocates the buffer pool, all buffers start free
+//!
+//!******************************************************
+cerb_dma_ring::cerb_dma_ring(size_t nbuffers, size_t buffer_samps)
+    : m_pool(nbuffers), m_closed(false)
+{
+    for (size_t k = 0; k < m_pool.size(); k++) {
+        m_pool[k].storage.resize(buffer_samps);
+        m_pool[k].samps        = &m_pool[k].storage[0];
+        m_pool[k].nsamps       = 0;
+        m_pool[k].seqno        = 0;
+        m_pool[k].timestamp_ns = 0;
+        m_free.push_back(&m_pool[k]);
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Takes a free buffer without blocking, returns
+//! nullptr when the writer has fallen behind
+//!
+//!******************************************************
+cerb_dma_buffer_t* cerb_dma_ring::try_acquire()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if( m_free.empty() ) {
+        return nullptr;
+    }
+    cerb_dma_buffer_t* buf = m_free.front();
+    m_free.pop_front();
+    return buf;
+}
+
+//!******************************************************
+//! @brief
+//! Queues a filled buffer for the writer
+//!
+//!******************************************************
+void cerb_dma_ring::commit(cerb_dma_buffer_t* buf)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_filled.push_back(buf);
+    }
+    m_cond.notify_one();
+}
+
+//!******************************************************
+//! @brief
+//! Blocks until a filled buffer is available, returns
+//! nullptr once the ring is closed and drained
+//!
+//!******************************************************
+cerb_dma_buffer_t* cerb_dma_ring::wait_filled()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_cond.wait(lock, [this]{ return !m_filled.empty() || m_closed; });
+    if( m_filled.empty() ) {
+        return nullptr;
+    }
+    cerb_dma_buffer_t* buf = m_filled.front();
+    m_filled.pop_front();
+    return buf;
+}
+
+//!******************************************************
+//! @brief
+//! Blocks until a filled buffer is available and takes
+//! up to max of them in order. Returns 0 once the ring
+//! is closed and drained.
+//!
+//!******************************************************
+size_t cerb_dma_ring::wait_filled(std::vector<cerb_dma_buffer_t*>& bufs, size_t max)
+{
+    bufs.clear();
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_cond.wait(lock, [this]{ return !m_filled.empty() || m_closed; });
+    while( !m_filled.empty() && bufs.size() < max ) {
+        bufs.push_back(m_filled.front());
+        m_filled.pop_front();
+    }
+    return bufs.size();
+}
+
+//!******************************************************
+//! @brief
+//! Returns a drained buffer to the free list
+//!
+//!******************************************************
+void cerb_dma_ring::release(cerb_dma_buffer_t* buf)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_free.push_back(buf);
+}
+
+//!******************************************************
+//! @brief
+//! Wakes the writer once no more buffers will be queued
+//!
+//!******************************************************
+void cerb_dma_ring::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_closed = true;
+    }
+    m_cond.notify_all();
+}
+
+size_t cerb_dma_ring::queued() const
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_filled.size();
+}
+
+uint64_t cerb_monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+//!******************************************************
+//! @brief
+//! Reads exactly req_bytes from an open DMA channel.
+//! Returns 1 on success, 0 on DMA timeout and -1 on
+//! error.
+//!
+//!******************************************************
+int cerb_dma_read(int fd, uint8_t* buffer, size_t req_bytes)
+{
+    size_t pos = 0;
+    while( req_bytes > 0 )
+    {
+        ssize_t rc = ::read(fd, &buffer[pos], req_bytes);
+        if( !rc ){
+            return 0;
+        }
+        else if( rc < 0 ){
+            if( errno == EINTR ) {
+                continue;
+            }
+            printf("error: dma error [%s]\n", strerror(errno));
+            return -1;
+        }
+        req_bytes -= rc;
+        pos += rc;
+    }
+    return 1;
+}
+
+//!******************************************************
+//! @brief
+//! Drains filled buffers into the sink, up to batch at
+//! a time, until the ring is closed. Runs on its own
+//! thread.
+//!
+//!******************************************************
+static void writer_thread(cerb_dma_ring& ring, size_t batch, const cerb_stream_batch_sink_t& sink,
+                          cerb_stream_stats_t& stats, bool& failed)
+{
+    uint64_t expected = 0;
+    std::vector<cerb_dma_buffer_t*>       bufs;
+    std::vector<const cerb_dma_buffer_t*> blocks;
+    while( ring.wait_filled(bufs, batch) )
+    {
+        blocks.clear();
+        for (size_t k = 0; k < bufs.size(); k++) {
+            cerb_dma_buffer_t* buf = bufs[k];
+            if( buf->seqno != expected ) {
+                printf("warn: gap before block [%llu], [%llu] block(s) missing\n",
+                       (unsigned long long)buf->seqno, (unsigned long long)(buf->seqno - expected));
+                stats.gaps += buf->seqno - expected;
+            }
+            expected = buf->seqno + 1;
+            blocks.push_back(buf);
+        }
+
+        // keep draining after a sink failure so the reader never blocks
+        if( !failed ) {
+            if( sink(blocks) ) {
+                for (size_t k = 0; k < blocks.size(); k++) {
+                    stats.buffers_written++;
+                    stats.bytes_written += blocks[k]->nsamps * sizeof(cmplx_wire_t);
+                }
+            }
+            else {
+                failed = true;
+                s_stop = true;
+            }
+        }
+        for (size_t k = 0; k < bufs.size(); k++) {
+            ring.release(bufs[k]);
+        }
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Reads DMA blocks from fd into the ring until
+//! total_samps have been read or the capture is
+//! stopped. Returns false on a DMA error.
+//!
+//!******************************************************
+static bool read_loop(int fd, const cerb_stream_config_t& cfg, cerb_dma_ring& ring,
+                      cerb_stream_stats_t& stats)
+{
+    cmplx_wire_vec_t scratch(cfg.buffer_samps); // overrun sink, keeps the DMA flowing
+    uint64_t seqno = 0;
+    uint64_t remaining = cfg.total_samps;
+    int      timeouts = 0;
+    while( !s_stop && (!cfg.total_samps || remaining > 0) )
+    {
+        size_t nsamps = cfg.buffer_samps;
+        if( cfg.total_samps && remaining < nsamps ) {
+            nsamps = remaining;
+        }
+
+        cerb_dma_buffer_t* buf = ring.try_acquire();
+        if( !buf ) {
+            stats.overruns++;
+        }
+        uint8_t* dst = reinterpret_cast<uint8_t*>(buf ? &buf->storage[0] : &scratch[0]);
+
+        int rc = cerb_dma_read(fd, dst, nsamps * sizeof(cmplx_wire_t));
+        if( rc <= 0 ) {
+            if( buf ) {
+                ring.release(buf);
+            }
+            if( rc < 0 ) {
+                return false;
+            }
+            stats.dma_timeouts++;
+            if( ++timeouts >= CERB_STREAM_MAX_TIMEOUTS ) {
+                printf("error: [%d] consecutive dma timeouts.. aborting\n", timeouts);
+                return false;
+            }
+            printf("warn: dma timeout\n");
+            seqno++;
+            continue;
+        }
+        timeouts = 0;
+
+        if( buf ) {
+            buf->nsamps       = nsamps;
+            buf->seqno        = seqno;
+            buf->timestamp_ns = cerb_monotonic_ns();
+            ring.commit(buf);
+            stats.buffers_read++;
+            stats.max_queued = std::max(stats.max_queued, ring.queued());
+        }
+        seqno++;
+        if( cfg.total_samps ) {
+            remaining -= nsamps;
+        }
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Streams DMA blocks from dev into sink until
+//! total_samps have been read or cerb_stream_stop()
+//! is called.
+//!
+//!******************************************************
+bool cerb_stream_capture(const std::string& dev, const cerb_stream_config_t& cfg,
+                         const cerb_stream_sink_t& sink, cerb_stream_stats_t& stats)
+{
+    cerb_stream_batch_sink_t one = [&](const std::vector<const cerb_dma_buffer_t*>& blocks) {
+        return sink(*blocks[0]);
+    };
+    return cerb_stream_capture_batched(dev, cfg, 1, one, stats);
+}
+
+//!******************************************************
+//! @brief
+//! Same as cerb_stream_capture(), with the sink taking
+//! up to batch queued blocks per call
+//!
+//!******************************************************
+bool cerb_stream_capture_batched(const std::string& dev, const cerb_stream_config_t& cfg, size_t batch,
+                                 const cerb_stream_batch_sink_t& sink, cerb_stream_stats_t& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+    if( !batch ) {
+        batch = 1;
+    }
+    if( !cfg.nbuffers || !cfg.buffer_samps ) {
+        printf("error: invalid stream configuration\n");
+        return false;
+    }
+
+    int fd = open(dev.c_str(), O_RDWR | O_SYNC);
+    if( fd < 0 ) {
+        printf("error: failed to open DMA device.. aborting\n");
+        return false;
+    }
+
+    cerb_dma_ring    ring(cfg.nbuffers, cfg.buffer_samps);
+    bool             sink_failed = false;
+    std::thread      writer(writer_thread, std::ref(ring), batch, std::cref(sink),
+                            std::ref(stats), std::ref(sink_failed));
+
+    uint64_t start_ns = cerb_monotonic_ns();
+    bool failed = !read_loop(fd, cfg, ring, stats);
+
+    ring.close();
+    writer.join();
+    close(fd);
+    stats.elapsed_s = (cerb_monotonic_ns() - start_ns) * 1e-9;
+    return !failed && !sink_failed;
+}
+
+//!******************************************************
+//! @brief
+//! Releases the channel readers together once all of
+//! them are pinned, so their first blocks line up
+//!
+//!******************************************************
+class cerb_start_gate
+{
+public:
+    explicit cerb_start_gate(size_t count) : m_count(count) {}
+
+    void arrive_and_wait() {
+        std::unique_lock<std::mutex> lock(m_lock);
+        if( --m_count == 0 ) {
+            m_cond.notify_all();
+            return;
+        }
+        m_cond.wait(lock, [this]{ return m_count == 0; });
+    }
+
+private:
+    size_t                  m_count;
+    std::mutex              m_lock;
+    std::condition_variable m_cond;
+};
+
+//! Per-channel reader state of a multi-channel capture
+struct cerb_stream_channel {
+    int                  fd;
+    int                  cpu;
+    cerb_dma_ring        ring;
+    cerb_stream_stats_t* stats;
+    bool                 failed;
+    std::thread          reader;
+
+    cerb_stream_channel(const cerb_stream_config_t& cfg)
+        : fd(-1), cpu(-1), ring(cfg.nbuffers, cfg.buffer_samps), stats(nullptr), failed(false) {}
+};
+
+//!******************************************************
+//! @brief
+//! Reads one channel into its ring. Runs on its own
+//! thread, pinned to cpu when one is given.
+//!
+//!******************************************************
+static void channel_reader_thread(cerb_stream_channel& ch, const cerb_stream_config_t& cfg,
+                                  cerb_start_gate& gate)
+{
+    if( ch.cpu >= 0 ) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(ch.cpu, &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if( rc ) {
+            printf("warn: failed to pin reader to cpu [%d] [%s]\n", ch.cpu, strerror(rc));
+        }
+    }
+    gate.arrive_and_wait();
+    ch.failed = !read_loop(ch.fd, cfg, ch.ring, *ch.stats);
+    ch.ring.close();
+}
+
+//!******************************************************
+//! @brief
+//! Streams several DMA channels at once. Every channel
+//! has its own ring and reader thread; the calling
+//! thread hands the sink one block per channel with the
+//! same sequence number. A block missing on any channel
+//! (overrun or timeout) is dropped on all of them, so
+//! the outputs stay aligned, and counted as a gap.
+//!
+//!******************************************************
+bool cerb_stream_capture_multi(const std::vector<std::string>& devs, const std::vector<int>& cpus,
+                               const cerb_stream_config_t& cfg, const cerb_stream_multi_sink_t& sink,
+                               std::vector<cerb_stream_stats_t>& stats)
+{
+    cerb_stream_stats_t zero;
+    memset(&zero, 0, sizeof(zero));
+    stats.assign(devs.size(), zero);
+    if( devs.empty() || !cfg.nbuffers || !cfg.buffer_samps ) {
+        printf("error: invalid stream configuration\n");
+        return false;
+    }
+
+    std::vector<std::unique_ptr<cerb_stream_channel> > chans;
+    for (size_t c = 0; c < devs.size(); c++) {
+        std::unique_ptr<cerb_stream_channel> ch(new cerb_stream_channel(cfg));
+        ch->fd = open(devs[c].c_str(), O_RDWR | O_SYNC);
+        if( ch->fd < 0 ) {
+            printf("error: failed to open DMA device [%s].. aborting\n", devs[c].c_str());
+            for (size_t k = 0; k < chans.size(); k++) {
+                close(chans[k]->fd);
+            }
+            return false;
+        }
+        ch->cpu   = (c < cpus.size()) ? cpus[c] : -1;
+        ch->stats = &stats[c];
+        chans.push_back(std::move(ch));
+    }
+
+    uint64_t start_ns = cerb_monotonic_ns();
+    cerb_start_gate gate(chans.size());
+    for (size_t c = 0; c < chans.size(); c++) {
+        chans[c]->reader = std::thread(channel_reader_thread, std::ref(*chans[c]),
+                                       std::cref(cfg), std::ref(gate));
+    }
+
+    std::vector<const cerb_dma_buffer_t*> blocks(chans.size());
+    std::vector<cerb_dma_buffer_t*>       heads(chans.size(), nullptr);
+    bool sink_failed = false;
+    bool done = false;
+    while( !done )
+    {
+        // head block of every channel, the newest one sets the pace
+        uint64_t seqno = 0;
+        for (size_t c = 0; c < chans.size() && !done; c++) {
+            if( !heads[c] ) {
+                heads[c] = chans[c]->ring.wait_filled();
+            }
+            if( !heads[c] ) {
+                done = true;
+            }
+            else {
+                seqno = std::max(seqno, heads[c]->seqno);
+            }
+        }
+        if( done ) {
+            break;
+        }
+
+        bool aligned = true;
+        for (size_t c = 0; c < chans.size(); c++) {
+            if( heads[c]->seqno != seqno ) {
+                stats[c].gaps++;
+                chans[c]->ring.release(heads[c]);
+                heads[c] = nullptr;
+                aligned = false;
+            }
+        }
+        if( !aligned ) {
+            continue;
+        }
+
+        // keep draining after a sink failure so the readers never block
+        if( !sink_failed ) {
+            for (size_t c = 0; c < chans.size(); c++) {
+                blocks[c] = heads[c];
+            }
+            if( sink(blocks) ) {
+                for (size_t c = 0; c < chans.size(); c++) {
+                    stats[c].buffers_written++;
+                    stats[c].bytes_written += heads[c]->nsamps * sizeof(cmplx_wire_t);
+                }
+            }
+            else {
+                sink_failed = true;
+                s_stop = true;
+            }
+        }
+        for (size_t c = 0; c < chans.size(); c++) {
+            chans[c]->ring.release(heads[c]);
+            heads[c] = nullptr;
+        }
+    }
+
+    // one channel ended, stop the others and drain what they still queue
+    s_stop = true;
+    bool failed = sink_failed;
+    for (size_t c = 0; c < chans.size(); c++) {
+        if( heads[c] ) {
+            chans[c]->ring.release(heads[c]);
+        }
+        cerb_dma_buffer_t* buf;
+        while( (buf = chans[c]->ring.wait_filled()) != nullptr ) {
+            chans[c]->ring.release(buf);
+        }
+        chans[c]->reader.join();
+        close(chans[c]->fd);
+        failed = failed || chans[c]->failed;
+    }
+
+    double elapsed_s = (cerb_monotonic_ns() - start_ns) * 1e-9;
+    for (size_t c = 0; c < stats.size(); c++) {
+        stats[c].elapsed_s = elapsed_s;
+    }
+    return !failed;
+}
+
+//!******************************************************
+//! @brief
+//! Streams mapped DMA buffers into sink without copying.
+//! The driver's buffer pool is the ring: a buffer is
+//! returned to the DMA as soon as the sink is done with
+//! it, and blocks the DMA had to drop show up as
+//! sequence gaps.
+//!
+//!******************************************************
+bool cerb_stream_capture_mapped(cerb_dma_mapped& src, const cerb_stream_config_t& cfg,
+                                const cerb_stream_sink_t& sink, cerb_stream_stats_t& stats)
+{
+    cerb_stream_batch_sink_t one = [&](const std::vector<const cerb_dma_buffer_t*>& blocks) {
+        return sink(*blocks[0]);
+    };
+    return cerb_stream_capture_mapped_batched(src, cfg, 1, one, stats);
+}
+
+//!******************************************************
+//! @brief
+//! Same as cerb_stream_capture_mapped(). After each
+//! completion, buffers the DMA has already finished are
+//! collected without waiting, up to batch, and handed
+//! to the sink together.
+//!
+//!******************************************************
+bool cerb_stream_capture_mapped_batched(cerb_dma_mapped& src, const cerb_stream_config_t& cfg, size_t batch,
+                                        const cerb_stream_batch_sink_t& sink, cerb_stream_stats_t& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+    if( !batch ) {
+        batch = 1;
+    }
+
+    uint64_t start_ns = cerb_monotonic_ns();
+    uint64_t remaining = cfg.total_samps;
+    uint64_t expected = 0;
+    bool     first = true;
+    bool     failed = false;
+    int      timeouts = 0;
+    std::vector<cerb_dma_desc_t>          descs;
+    std::vector<cerb_dma_buffer_t>        bufs(batch);
+    std::vector<const cerb_dma_buffer_t*> blocks;
+    while( !s_stop && (!cfg.total_samps || remaining > 0) )
+    {
+        cerb_dma_desc_t desc;
+        int rc = src.dequeue(desc, CERB_STREAM_TIMEOUT_MS);
+        if( rc < 0 ) {
+            failed = true;
+            break;
+        }
+        if( !rc ) {
+            stats.dma_timeouts++;
+            if( ++timeouts >= CERB_STREAM_MAX_TIMEOUTS ) {
+                printf("error: [%d] consecutive dma timeouts.. aborting\n", timeouts);
+                failed = true;
+                break;
+            }
+            printf("warn: dma timeout\n");
+            continue;
+        }
+        timeouts = 0;
+
+        descs.clear();
+        descs.push_back(desc);
+        while( descs.size() < batch && (rc = src.dequeue(desc, 0)) > 0 ) {
+            descs.push_back(desc);
+        }
+
+        blocks.clear();
+        for (size_t k = 0; k < descs.size(); k++) {
+            stats.buffers_read++;
+            if( !first && descs[k].seqno != expected ) {
+                printf("warn: gap before block [%llu], [%llu] block(s) missing\n",
+                       (unsigned long long)descs[k].seqno, (unsigned long long)(descs[k].seqno - expected));
+                stats.gaps += descs[k].seqno - expected;
+                stats.overruns += descs[k].seqno - expected;
+            }
+            first = false;
+            expected = descs[k].seqno + 1;
+
+            // blocks past total_samps are only returned to the DMA
+            cerb_dma_buffer_t& buf = bufs[k];
+            buf.samps        = src.buffer(descs[k].index);
+            buf.nsamps       = descs[k].bytes / sizeof(cmplx_wire_t);
+            buf.seqno        = descs[k].seqno;
+            buf.timestamp_ns = descs[k].timestamp_ns;
+            if( cfg.total_samps ) {
+                buf.nsamps = std::min<uint64_t>(buf.nsamps, remaining);
+                remaining -= buf.nsamps;
+            }
+            if( buf.nsamps ) {
+                blocks.push_back(&buf);
+            }
+        }
+
+        bool ok = blocks.empty() || sink(blocks);
+        for (size_t k = 0; k < descs.size(); k++) {
+            ok = src.enqueue(descs[k]) && ok;
+        }
+        if( !ok || rc < 0 ) {
+            failed = true;
+            break;
+        }
+        for (size_t k = 0; k < blocks.size(); k++) {
+            stats.buffers_written++;
+            stats.bytes_written += blocks[k]->nsamps * sizeof(cmplx_wire_t);
+        }
+    }
+
+    stats.elapsed_s = (cerb_monotonic_ns() - start_ns) * 1e-9;
+    return !failed;
+}
+
+//!******************************************************
+//! @brief
+//! Requests the running capture to stop. Safe to call
+//! from a signal handler.
+//!
+//!******************************************************
+void cerb_stream_stop()
+{
+    s_stop = true;
+}
+
+//!******************************************************
+//! @brief
+//! Clears a pending stop request. Call before installing
+//! the signal handlers that use cerb_stream_stop(), so a
+//! stop that arrives afterwards is never discarded.
+//!
+//!******************************************************
+void cerb_stream_reset()
+{
+    s_stop = false;
+}
+
+//!******************************************************
+//! @brief
+//! Prints the streaming counters
+//!
+//!******************************************************
+void cerb_stream_print_stats(const cerb_stream_stats_t& stats)
+{
+    printf("stream: read=[%llu] written=[%llu] bytes=[%llu]\n",
+           (unsigned long long)stats.buffers_read,
+           (unsigned long long)stats.buffers_written,
+           (unsigned long long)stats.bytes_written);
+    printf("stream: overruns=[%llu] gaps=[%llu] timeouts=[%llu] max-queued=[%zu]\n",
+           (unsigned long long)stats.overruns,
+           (unsigned long long)stats.gaps,
+           (unsigned long long)stats.dma_timeouts,
+           stats.max_queued);
+    if( stats.elapsed_s > 0 ) {
+        printf("stream: elapsed=[%.3f s] throughput=[%.1f MB/s] [%.1f MSPS]\n", stats.elapsed_s,
+               stats.bytes_written / stats.elapsed_s / 1e6,
+               stats.bytes_written / sizeof(cmplx_wire_t) / stats.elapsed_s / 1e6);
+    }
+}
@@ -0,0 +1,110 @@
+//!*********************************************************************
+//! @file cerb_stream.h
+//!
+//! @brief
+//! Continuous DMA streaming for the Cerberus SDR. The DMA channel is
+//! kept open and read into a ring of preallocated buffers while a
+//! separate writer thread drains the filled buffers into a sink.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_STREAM_H_
+#define CERB_STREAM_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <deque>
+#include <string>
+#include <vector>
+#include "cerb_common.h"
+#include "cerb_dma.h"
+
+#define CERB_STREAM_MAX_TIMEOUTS 3    // consecutive DMA timeouts before aborting
+#define CERB_STREAM_TIMEOUT_MS   1000 // mapped buffer completion timeout
+
+//! DMA block handed to the sink
+typedef struct {
+    cmplx_wire_vec_t    storage;      // backing memory for read() captures
+    const cmplx_wire_t* samps;        // first sample of the block
+    size_t              nsamps;       // valid samples in this block
+    uint64_t            seqno;        // DMA block sequence number
+    uint64_t            timestamp_ns; // CLOCK_MONOTONIC completion time
+} cerb_dma_buffer_t;
+
+//! Streaming configuration
+typedef struct {
+    size_t   nbuffers;           // number of buffers in the ring
+    size_t   buffer_samps;       // complex samples per DMA block
+    uint64_t total_samps;        // samples to capture (0 = until stopped)
+} cerb_stream_config_t;
+
+//! Streaming counters, valid once cerb_stream_capture() returns
+typedef struct {
+    uint64_t buffers_read;       // DMA blocks read into the ring
+    uint64_t buffers_written;    // DMA blocks handed to the sink
+    uint64_t overruns;           // DMA blocks dropped because the ring was full
+    uint64_t gaps;               // sequence discontinuities seen by the writer
+    uint64_t dma_timeouts;       // DMA reads that returned no data
+    uint64_t bytes_written;      // wire bytes handed to the sink
+    size_t   max_queued;         // ring high-water mark
+    double   elapsed_s;          // capture wall time
+} cerb_stream_stats_t;
+
+//! Called from the writer thread for every filled buffer, returns false on error
+typedef std::function<bool(const cerb_dma_buffer_t&)> cerb_stream_sink_t;
+
+//! Multi-channel sink, one block per channel (same order as the devices), all
+//! with the same sequence number
+typedef std::function<bool(const std::vector<const cerb_dma_buffer_t*>&)> cerb_stream_multi_sink_t;
+
+//! Batch sink, 1..batch consecutive blocks of one channel per call
+typedef std::function<bool(const std::vector<const cerb_dma_buffer_t*>&)> cerb_stream_batch_sink_t;
+
+//!******************************************************
+//! @brief
+//! Fixed pool of DMA buffers shared by the reader and
+//! writer threads.
+//!
+//!******************************************************
+class cerb_dma_ring
+{
+public:
+    cerb_dma_ring(size_t nbuffers, size_t buffer_samps);
+
+    cerb_dma_buffer_t* try_acquire();
+    void               commit(cerb_dma_buffer_t* buf);
+    cerb_dma_buffer_t* wait_filled();
+    size_t             wait_filled(std::vector<cerb_dma_buffer_t*>& bufs, size_t max);
+    void               release(cerb_dma_buffer_t* buf);
+    void               close();
+    size_t             queued() const;
+
+private:
+    std::vector<cerb_dma_buffer_t> m_pool;
+    std::deque<cerb_dma_buffer_t*> m_free;
+    std::deque<cerb_dma_buffer_t*> m_filled;
+    mutable std::mutex             m_lock;
+    std::condition_variable        m_cond;
+    bool                           m_closed;
+};
+
+int  cerb_dma_read(int fd, uint8_t* buffer, size_t req_bytes);
+bool cerb_stream_capture(const std::string& dev, const cerb_stream_config_t& cfg,
+                         const cerb_stream_sink_t& sink, cerb_stream_stats_t& stats);
+bool cerb_stream_capture_batched(const std::string& dev, const cerb_stream_config_t& cfg, size_t batch,
+                                 const cerb_stream_batch_sink_t& sink, cerb_stream_stats_t& stats);
+bool cerb_stream_capture_multi(const std::vector<std::string>& devs, const std::vector<int>& cpus,
+                               const cerb_stream_config_t& cfg, const cerb_stream_multi_sink_t& sink,
+                               std::vector<cerb_stream_stats_t>& stats);
+bool cerb_stream_capture_mapped(cerb_dma_mapped& src, const cerb_stream_config_t& cfg,
+                                const cerb_stream_sink_t& sink, cerb_stream_stats_t& stats);
+bool cerb_stream_capture_mapped_batched(cerb_dma_mapped& src, const cerb_stream_config_t& cfg, size_t batch,
+                                        const cerb_stream_batch_sink_t& sink, cerb_stream_stats_t& stats);
+uint64_t cerb_monotonic_ns();
+void cerb_stream_stop();
+void cerb_stream_reset();
+void cerb_stream_print_stats(const cerb_stream_stats_t& stats);
+
+#endif /* CERB_STREAM_H_ */
@@ -0,0 +1,445 @@
+//!*********************************************************************
+//! @file cerb_trigger.cpp
+//!
+//! @brief
+//! Triggered capture. See cerb_trigger.h.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <math.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include "cerb_trigger.h"
+
+#if defined(__SSE2__)
+#define CERB_TRIGGER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(__ARM_NEON)
+#define CERB_TRIGGER_NEON 1
+#include <arm_neon.h>
+#endif
+
+bool cerb_trigger_parse(const std::string& name, cerb_trigger_type_e& type)
+{
+    if( name == "power" ) {
+        type = CERB_TRIGGER_POWER;
+    }
+    else if( name == "tone" ) {
+        type = CERB_TRIGGER_TONE;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+const char* cerb_trigger_name(cerb_trigger_type_e type)
+{
+    return (type == CERB_TRIGGER_TONE) ? "tone" : "power";
+}
+
+//!******************************************************
+//! @brief
+//! Sum of |x|^2 over n samples. I^2 + Q^2 of a full
+//! scale sample is 2^31, so the per-sample sums are
+//! taken as unsigned 32-bit.
+//!
+//!******************************************************
+static uint64_t power_sum(const cmplx_wire_t* x, size_t n)
+{
+    const int16_t* in = reinterpret_cast<const int16_t*>(x);
+    uint64_t acc = 0;
+    size_t k = 0;
+#if defined(CERB_TRIGGER_SSE2)
+    __m128i acc64 = _mm_setzero_si128();
+    const __m128i zero = _mm_setzero_si128();
+    for (; k + 4 <= n; k += 4) {
+        __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[2*k]));
+        __m128i p  = _mm_madd_epi16(v, v);                       // I^2 + Q^2 per sample
+        acc64 = _mm_add_epi64(acc64, _mm_unpacklo_epi32(p, zero));
+        acc64 = _mm_add_epi64(acc64, _mm_unpackhi_epi32(p, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc64);
+    acc = lanes[0] + lanes[1];
+#elif defined(CERB_TRIGGER_NEON)
+    uint64x2_t acc64 = vdupq_n_u64(0);
+    for (; k + 4 <= n; k += 4) {
+        int16x8_t v  = vld1q_s16(&in[2*k]);
+        uint32x4_t lo = vreinterpretq_u32_s32(vmull_s16(vget_low_s16(v), vget_low_s16(v)));
+        uint32x4_t hi = vreinterpretq_u32_s32(vmull_s16(vget_high_s16(v), vget_high_s16(v)));
+        acc64 = vpadalq_u32(acc64, lo);
+        acc64 = vpadalq_u32(acc64, hi);
+    }
+    acc = vgetq_lane_u64(acc64, 0) + vgetq_lane_u64(acc64, 1);
+#endif
+    for (; k < n; k++) {
+        acc += static_cast<uint32_t>(in[2*k] * in[2*k]) + static_cast<uint32_t>(in[2*k+1] * in[2*k+1]);
+    }
+    return acc;
+}
+
+//!******************************************************
+//! @brief
+//! Accumulates x[n] e^(-j w n) over n samples. cc holds
+//! (cos, cos) and sn (sin, -sin) pairs of the window
+//! positions: re += I cos + Q sin, im += Q cos - I sin.
+//!
+//!******************************************************
+static void tone_sum(const cmplx_wire_t* x, const float* cc, const float* sn, size_t n, float& re, float& im)
+{
+    const int16_t* in = reinterpret_cast<const int16_t*>(x);
+    size_t k = 0;
+#if defined(CERB_TRIGGER_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; k + 4 <= n; k += 4) {
+        __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&in[2*k]));
+        __m128  f0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));  // I0 Q0 I1 Q1
+        __m128  f1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));  // I2 Q2 I3 Q3
+        __m128  s0 = _mm_shuffle_ps(f0, f0, _MM_SHUFFLE(2, 3, 0, 1));                // Q0 I0 Q1 I1
+        __m128  s1 = _mm_shuffle_ps(f1, f1, _MM_SHUFFLE(2, 3, 0, 1));
+        acc = _mm_add_ps(acc, _mm_mul_ps(f0, _mm_loadu_ps(&cc[2*k])));
+        acc = _mm_add_ps(acc, _mm_mul_ps(s0, _mm_loadu_ps(&sn[2*k])));
+        acc = _mm_add_ps(acc, _mm_mul_ps(f1, _mm_loadu_ps(&cc[2*k + 4])));
+        acc = _mm_add_ps(acc, _mm_mul_ps(s1, _mm_loadu_ps(&sn[2*k + 4])));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, acc);
+    re += lanes[0] + lanes[2];
+    im += lanes[1] + lanes[3];
+#elif defined(CERB_TRIGGER_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; k + 4 <= n; k += 4) {
+        int16x8_t   v  = vld1q_s16(&in[2*k]);
+        float32x4_t f0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t f1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        acc = vmlaq_f32(acc, f0, vld1q_f32(&cc[2*k]));
+        acc = vmlaq_f32(acc, vrev64q_f32(f0), vld1q_f32(&sn[2*k]));
+        acc = vmlaq_f32(acc, f1, vld1q_f32(&cc[2*k + 4]));
+        acc = vmlaq_f32(acc, vrev64q_f32(f1), vld1q_f32(&sn[2*k + 4]));
+    }
+    re += vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 2);
+    im += vgetq_lane_f32(acc, 1) + vgetq_lane_f32(acc, 3);
+#endif
+    for (; k < n; k++) {
+        float i = in[2*k];
+        float q = in[2*k + 1];
+        re += i * cc[2*k] + q * sn[2*k];
+        im += q * cc[2*k + 1] + i * sn[2*k + 1];
+    }
+}
+
+cerb_trigger_detector::cerb_trigger_detector()
+    : m_type(CERB_TRIGGER_POWER), m_window(0), m_threshold(0), m_fill(0), m_power(0), m_re(0), m_im(0)
+{
+}
+
+//!******************************************************
+//! @brief
+//! Precomputes the threshold as a window sum and, for
+//! the tone detector, one window of the reference
+//!
+//!******************************************************
+bool cerb_trigger_detector::configure(const cerb_trigger_config_t& cfg)
+{
+    if( !cfg.window ) {
+        printf("error: trigger window must be at least one sample\n");
+        return false;
+    }
+    m_type   = cfg.type;
+    m_window = cfg.window;
+
+    double level = pow(10.0, cfg.level_dbfs / 10.0);
+    double fs2   = CERB_TRIGGER_FULL_SCALE * CERB_TRIGGER_FULL_SCALE;
+    if( m_type == CERB_TRIGGER_POWER ) {
+        m_threshold = level * fs2 * m_window;
+    }
+    else {
+        m_threshold = level * fs2 * m_window * m_window;
+        m_cos.resize(2 * m_window);
+        m_sin.resize(2 * m_window);
+        for (size_t n = 0; n < m_window; n++) {
+            double ph = 2.0 * M_PI * cfg.freq_hz * n / CERB_SAMP_RATE;
+            m_cos[2*n]     = static_cast<float>(cos(ph));
+            m_cos[2*n + 1] = static_cast<float>(cos(ph));
+            m_sin[2*n]     = static_cast<float>(sin(ph));
+            m_sin[2*n + 1] = static_cast<float>(-sin(ph));
+        }
+    }
+    reset();
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Drops the partial window, e.g. after a gap
+//!
+//!******************************************************
+void cerb_trigger_detector::reset()
+{
+    m_fill  = 0;
+    m_power = 0;
+    m_re    = 0;
+    m_im    = 0;
+}
+
+//!******************************************************
+//! @brief
+//! Consumes samples until a window at or above the
+//! level completes (true, used = samples up to its
+//! end) or all n are consumed (false)
+//!
+//!******************************************************
+bool cerb_trigger_detector::process(const cmplx_wire_t* x, size_t n, size_t& used, double& level_dbfs)
+{
+    size_t pos = 0;
+    while( pos < n )
+    {
+        size_t k = std::min(m_window - m_fill, n - pos);
+        if( m_type == CERB_TRIGGER_POWER ) {
+            m_power += power_sum(&x[pos], k);
+        }
+        else {
+            tone_sum(&x[pos], &m_cos[2*m_fill], &m_sin[2*m_fill], k, m_re, m_im);
+        }
+        pos    += k;
+        m_fill += k;
+        if( m_fill < m_window ) {
+            break;
+        }
+
+        double sum = (m_type == CERB_TRIGGER_POWER) ? static_cast<double>(m_power)
+                                                    : static_cast<double>(m_re) * m_re + static_cast<double>(m_im) * m_im;
+        bool fired = (sum >= m_threshold);
+        if( fired ) {
+            double norm = CERB_TRIGGER_FULL_SCALE * CERB_TRIGGER_FULL_SCALE * m_window;
+            if( m_type == CERB_TRIGGER_TONE ) {
+                norm *= m_window;
+            }
+            level_dbfs = (sum > 0) ? 10.0 * log10(sum / norm) : -INFINITY;
+        }
+        reset();
+        if( fired ) {
+            used = pos;
+            return true;
+        }
+    }
+    used = n;
+    return false;
+}
+
+cerb_trigger_capture::cerb_trigger_capture()
+    : m_history_fill(0), m_next_sample(0), m_next_seqno(0), m_started(false),
+      m_in_event(false), m_event_end(0), m_events(0)
+{
+    memset(&m_cfg, 0, sizeof(m_cfg));
+    memset(&m_event, 0, sizeof(m_event));
+}
+
+bool cerb_trigger_capture::configure(const cerb_trigger_config_t& cfg, const event_fn_t& begin,
+                                     const data_fn_t& data, const event_fn_t& end)
+{
+    if( !m_detector.configure(cfg) ) {
+        return false;
+    }
+    m_cfg   = cfg;
+    m_begin = begin;
+    m_data  = data;
+    m_end   = end;
+    // the window that fires may start in an earlier block
+    m_history.resize(cfg.pre_samps + cfg.window);
+    m_history_fill = 0;
+    m_blocks.clear();
+    m_next_sample  = 0;
+    m_started      = false;
+    m_in_event     = false;
+    m_events       = 0;
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Hands samples [from, to) of the stream to the data
+//! callback, taking those before buf from the history
+//!
+//!******************************************************
+bool cerb_trigger_capture::emit(const cerb_dma_buffer_t& buf, uint64_t buf_start, uint64_t from, uint64_t to)
+{
+    size_t hsize = m_history.size();
+    std::deque<block_t>::const_iterator blk = m_blocks.begin();
+    while( from < to )
+    {
+        const cmplx_wire_t* data;
+        uint64_t n, seqno, timestamp_ns;
+        if( from >= buf_start ) {
+            data         = &buf.samps[from - buf_start];
+            n            = to - from;
+            seqno        = buf.seqno;
+            timestamp_ns = buf.timestamp_ns;
+        }
+        else {
+            while( blk != m_blocks.end() && blk->start + blk->nsamps <= from ) {
+                ++blk;
+            }
+            if( blk == m_blocks.end() ) {
+                return false;
+            }
+            size_t idx   = from % hsize;
+            data         = &m_history[idx];
+            n            = std::min(std::min(to, buf_start), blk->start + blk->nsamps) - from;
+            n            = std::min<uint64_t>(n, hsize - idx);
+            seqno        = blk->seqno;
+            timestamp_ns = blk->timestamp_ns;
+        }
+        if( !m_data(m_event, data, n, seqno, timestamp_ns) ) {
+            return false;
+        }
+        m_event.nsamps += n;
+        from += n;
+    }
+    return true;
+}
+
+bool cerb_trigger_capture::end_event(bool truncated)
+{
+    m_in_event = false;
+    m_event.truncated = truncated;
+    m_events++;
+    m_detector.reset();
+    return m_end(m_event);
+}
+
+//!******************************************************
+//! @brief
+//! Keeps the tail of buf for the pre-trigger window of
+//! later events
+//!
+//!******************************************************
+void cerb_trigger_capture::remember(const cerb_dma_buffer_t& buf, uint64_t buf_start)
+{
+    size_t hsize = m_history.size();
+    size_t n     = std::min<size_t>(buf.nsamps, hsize);
+    uint64_t from = buf_start + buf.nsamps - n;
+    while( n )
+    {
+        size_t idx = from % hsize;
+        size_t k   = std::min(n, hsize - idx);
+        memcpy(&m_history[idx], &buf.samps[from - buf_start], k * sizeof(cmplx_wire_t));
+        from += k;
+        n    -= k;
+    }
+    m_history_fill = std::min<uint64_t>(m_history_fill + buf.nsamps, hsize);
+
+    block_t blk = { buf_start, buf.nsamps, buf.seqno, buf.timestamp_ns };
+    m_blocks.push_back(blk);
+    uint64_t oldest = buf_start + buf.nsamps - m_history_fill;
+    while( !m_blocks.empty() && m_blocks.front().start + m_blocks.front().nsamps <= oldest ) {
+        m_blocks.pop_front();
+    }
+}
+
+//!******************************************************
+//! @brief
+//! Runs one DMA block through the detector and the
+//! event in progress
+//!
+//!******************************************************
+bool cerb_trigger_capture::process(const cerb_dma_buffer_t& buf)
+{
+    // samples on either side of a dropped block are not contiguous
+    if( m_started && buf.seqno != m_next_seqno ) {
+        if( m_in_event && !end_event(true) ) {
+            return false;
+        }
+        m_history_fill = 0;
+        m_blocks.clear();
+        m_detector.reset();
+    }
+    m_started    = true;
+    m_next_seqno = buf.seqno + 1;
+
+    uint64_t start = m_next_sample;
+    uint64_t end   = start + buf.nsamps;
+    size_t   pos   = 0;
+    while( pos < buf.nsamps )
+    {
+        if( m_in_event ) {
+            uint64_t to = std::min(m_event_end, end);
+            if( !emit(buf, start, start + pos, to) ) {
+                return false;
+            }
+            pos = to - start;
+            if( to == m_event_end && !end_event(false) ) {
+                return false;
+            }
+            continue;
+        }
+        if( done() ) {
+            break;
+        }
+
+        size_t used;
+        double level;
+        if( !m_detector.process(&buf.samps[pos], buf.nsamps - pos, used, level) ) {
+            break;
+        }
+        pos += used;
+
+        uint64_t trigger = start + pos - m_cfg.window;
+        uint64_t first   = std::max(trigger - std::min<uint64_t>(trigger, m_cfg.pre_samps), start - m_history_fill);
+        m_event.index                = m_events;
+        m_event.start_sample         = first;
+        m_event.trigger_sample       = trigger;
+        m_event.nsamps               = 0;
+        m_event.level_dbfs           = level;
+        m_event.truncated            = false;
+        m_event.trigger_seqno        = buf.seqno;
+        m_event.trigger_timestamp_ns = buf.timestamp_ns;
+        for (size_t k = 0; trigger < start && k < m_blocks.size(); k++) {
+            if( trigger < m_blocks[k].start + m_blocks[k].nsamps ) {
+                m_event.trigger_seqno        = m_blocks[k].seqno;
+                m_event.trigger_timestamp_ns = m_blocks[k].timestamp_ns;
+                break;
+            }
+        }
+        if( !m_begin(m_event) ) {
+            return false;
+        }
+
+        // pre-trigger part and whatever of the post-trigger part this block holds
+        m_in_event  = true;
+        m_event_end = trigger + m_cfg.post_samps;
+        uint64_t to = std::min(m_event_end, end);
+        if( !emit(buf, start, first, to) ) {
+            return false;
+        }
+        if( to > start + pos ) {
+            pos = to - start;
+        }
+        if( to == m_event_end && !end_event(false) ) {
+            return false;
+        }
+    }
+
+    remember(buf, start);
+    m_next_sample = end;
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Closes an event still waiting for post-trigger
+//! samples when the stream ends
+//!
+//!******************************************************
+bool cerb_trigger_capture::finish()
+{
+    if( m_in_event ) {
+        return end_event(true);
+    }
+    return true;
+}
@@ -0,0 +1,147 @@
+//!*********************************************************************
+//! @file cerb_trigger.h
+//!
+//! @brief
+//! Triggered capture. The DMA stream runs continuously through a
+//! detector evaluated on the wire samples, fixed windows of
+//! --trigger-window samples compared against a level in dBFS:
+//!
+//!  - power  mean |x|^2 of the window
+//!  - tone   |sum x[n] e^(-j 2 pi f n / fs)|^2 of the window, i.e. one
+//!           DFT bin at the given baseband frequency
+//!
+//! Only the samples from pre_samps before to post_samps after the
+//! start of the window that fired are handed on as an event; a copy of
+//! the most recent pre_samps + window samples is kept to provide the
+//! pre-trigger part. The detector re-arms once an event is complete.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_TRIGGER_H_
+#define CERB_TRIGGER_H_
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include "cerb_common.h"
+#include "cerb_stream.h"
+
+#define CERB_TRIGGER_FULL_SCALE 32768.0 // 0 dBFS amplitude of a wire sample
+
+//! Detector types
+typedef enum {
+    CERB_TRIGGER_POWER = 0,
+    CERB_TRIGGER_TONE,
+} cerb_trigger_type_e;
+
+//! Trigger settings
+typedef struct {
+    cerb_trigger_type_e type;
+    double   level_dbfs;     // fires at or above this level
+    double   freq_hz;        // tone detector frequency, baseband
+    size_t   window;         // samples per detector window
+    size_t   pre_samps;      // samples kept before the trigger
+    size_t   post_samps;     // samples kept from the trigger on
+    uint64_t max_events;     // 0 = unlimited
+} cerb_trigger_config_t;
+
+//! One triggered event. Sample indices count from the start of the stream.
+typedef struct {
+    uint64_t index;                 // event number, from 0
+    uint64_t start_sample;          // first sample of the event
+    uint64_t trigger_sample;        // first sample of the window that fired
+    uint64_t nsamps;                // samples handed on so far
+    uint64_t trigger_seqno;         // DMA block holding the trigger sample
+    uint64_t trigger_timestamp_ns;  // CLOCK_MONOTONIC completion time of that block
+    double   level_dbfs;            // detector level of the window that fired
+    bool     truncated;             // cut short by dropped DMA blocks or the end of the stream
+} cerb_trigger_event_t;
+
+bool        cerb_trigger_parse(const std::string& name, cerb_trigger_type_e& type);
+const char* cerb_trigger_name(cerb_trigger_type_e type);
+
+//!******************************************************
+//! @brief
+//! Windowed power / single bin detector on sc16
+//!
+//!******************************************************
+class cerb_trigger_detector
+{
+public:
+    cerb_trigger_detector();
+
+    bool configure(const cerb_trigger_config_t& cfg);
+    void reset();
+    bool process(const cmplx_wire_t* x, size_t n, size_t& used, double& level_dbfs);
+
+private:
+    cerb_trigger_type_e m_type;
+    size_t              m_window;
+    double              m_threshold;    // window sum at the trigger level
+    std::vector<float>  m_cos;          // tone detector reference, one window
+    std::vector<float>  m_sin;
+    size_t              m_fill;         // samples in the current window
+    uint64_t            m_power;
+    float               m_re;
+    float               m_im;
+};
+
+//!******************************************************
+//! @brief
+//! Cuts events out of the DMA stream. Callbacks run on
+//! the stream writer thread; data chunks carry the
+//! sequence number and timestamp of their DMA block.
+//!
+//!******************************************************
+class cerb_trigger_capture
+{
+public:
+    typedef std::function<bool(const cerb_trigger_event_t&)> event_fn_t;
+    typedef std::function<bool(const cerb_trigger_event_t&, const cmplx_wire_t*, size_t,
+                               uint64_t seqno, uint64_t timestamp_ns)> data_fn_t;
+
+    cerb_trigger_capture();
+
+    bool configure(const cerb_trigger_config_t& cfg, const event_fn_t& begin,
+                   const data_fn_t& data, const event_fn_t& end);
+    bool process(const cerb_dma_buffer_t& buf);
+    bool finish();
+
+    uint64_t events() const { return m_events; }
+    bool     done() const   { return m_cfg.max_events && m_events >= m_cfg.max_events && !m_in_event; }
+
+private:
+    //! Block whose samples are (partly) in the history
+    typedef struct {
+        uint64_t start;
+        uint64_t nsamps;
+        uint64_t seqno;
+        uint64_t timestamp_ns;
+    } block_t;
+
+    bool emit(const cerb_dma_buffer_t& buf, uint64_t buf_start, uint64_t from, uint64_t to);
+    bool end_event(bool truncated);
+    void remember(const cerb_dma_buffer_t& buf, uint64_t buf_start);
+
+    cerb_trigger_config_t       m_cfg;
+    cerb_trigger_detector       m_detector;
+    event_fn_t                  m_begin;
+    data_fn_t                   m_data;
+    event_fn_t                  m_end;
+
+    cmplx_wire_vec_t            m_history;      // ring indexed by stream sample % size
+    uint64_t                    m_history_fill;
+    std::deque<block_t>         m_blocks;
+    uint64_t                    m_next_sample;  // stream index of the next block
+    uint64_t                    m_next_seqno;
+    bool                        m_started;
+
+    bool                        m_in_event;
+    uint64_t                    m_event_end;
+    cerb_trigger_event_t        m_event;
+    uint64_t                    m_events;
+};
+
+#endif /* CERB_TRIGGER_H_ */
@@ -0,0 +1,285 @@
+//!*********************************************************************
+//! @file cerb_writer.cpp
+//!
+//! @brief
+//! Capture file output. See cerb_writer.h.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // O_DIRECT, splice()
+#endif
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cerb_writer.h"
+
+#define CERB_SPLICE_PIPE_SZ (1 << 20)
+
+bool cerb_format_parse(const std::string& name, cerb_format_e& format)
+{
+    if( name == "fc32" ) {
+        format = CERB_FORMAT_FC32;
+    }
+    else if( name == "sc16" ) {
+        format = CERB_FORMAT_SC16;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+const char* cerb_format_name(cerb_format_e format)
+{
+    return (format == CERB_FORMAT_SC16) ? "sc16" : "fc32";
+}
+
+size_t cerb_format_sample_size(cerb_format_e format)
+{
+    return (format == CERB_FORMAT_SC16) ? sizeof(cmplx_wire_t) : sizeof(cmplx_sample_t);
+}
+
+//!******************************************************
+//! @brief
+//! Factor that converts stored samples to full scale
+//!
+//!******************************************************
+float cerb_format_scale(cerb_format_e format)
+{
+    return (format == CERB_FORMAT_SC16) ? CERB_IQ_SCALE : 1.0f;
+}
+
+cerb_file_writer::cerb_file_writer()
+    : m_fd(-1), m_direct(false)
+{
+}
+
+cerb_file_writer::~cerb_file_writer()
+{
+    close();
+}
+
+//!******************************************************
+//! @brief
+//! Creates the output file. O_DIRECT is requested when
+//! direct is set and silently dropped on filesystems
+//! that reject it.
+//!
+//!******************************************************
+bool cerb_file_writer::open(const std::string& path, bool direct)
+{
+    close();
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    if( direct ) {
+        m_fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        m_direct = (m_fd >= 0);
+    }
+    if( m_fd < 0 ) {
+        m_fd = ::open(path.c_str(), flags, 0644);
+    }
+    if( m_fd < 0 ) {
+        printf("failed to open file [%s]: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void cerb_file_writer::close()
+{
+    if( m_fd >= 0 ) {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+    m_direct = false;
+}
+
+//!******************************************************
+//! @brief
+//! Falls back to buffered I/O for the rest of the file
+//!
+//!******************************************************
+void cerb_file_writer::disable_direct()
+{
+    int flags = fcntl(m_fd, F_GETFL);
+    fcntl(m_fd, F_SETFL, flags & ~O_DIRECT);
+    m_direct = false;
+}
+
+bool cerb_file_writer::write_all(const uint8_t* data, size_t bytes)
+{
+    while( bytes > 0 )
+    {
+        ssize_t rc = ::write(m_fd, data, bytes);
+        if( rc < 0 ) {
+            if( errno == EINTR ) {
+                continue;
+            }
+            if( errno == EINVAL && m_direct ) {
+                disable_direct();
+                continue;
+            }
+            printf("error: file write failed [%s]\n", strerror(errno));
+            return false;
+        }
+        data  += rc;
+        bytes -= rc;
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! Appends bytes to the file. Page aligned blocks go out
+//! with O_DIRECT; an unaligned tail switches the file
+//! back to buffered I/O.
+//!
+//!******************************************************
+bool cerb_file_writer::write(const void* data, size_t bytes)
+{
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    if( m_direct ) {
+        if( reinterpret_cast<uintptr_t>(ptr) % CERB_PAGE_ALIGN ) {
+            disable_direct();
+        }
+        else {
+            size_t aligned = bytes - (bytes % CERB_PAGE_ALIGN);
+            if( !write_all(ptr, aligned) ) {
+                return false;
+            }
+            ptr   += aligned;
+            bytes -= aligned;
+            if( bytes ) {
+                disable_direct();
+            }
+        }
+    }
+    return write_all(ptr, bytes);
+}
+
+//!******************************************************
+//! @brief
+//! Moves bytes from the DMA channel to the file through
+//! a pipe without copying them into user space. Sets
+//! unsupported when the driver cannot splice, in which
+//! case nothing has been consumed from the channel.
+//!
+//!******************************************************
+bool cerb_file_writer::splice_from(int fd, size_t bytes, bool& unsupported)
+{
+    unsupported = false;
+
+    int pfd[2];
+    if( pipe(pfd) < 0 ) {
+        unsupported = true;
+        return false;
+    }
+    fcntl(pfd[1], F_SETPIPE_SZ, CERB_SPLICE_PIPE_SZ);
+
+    // page cache writes, splice does not mix with O_DIRECT
+    if( m_direct ) {
+        disable_direct();
+    }
+
+    bool ok = true;
+    bool first = true;
+    while( ok && bytes > 0 )
+    {
+        ssize_t n = splice(fd, NULL, pfd[1], NULL, std::min<size_t>(bytes, CERB_SPLICE_PIPE_SZ),
+                           SPLICE_F_MOVE | SPLICE_F_MORE);
+        if( n < 0 && errno == EINTR ) {
+            continue;
+        }
+        if( n <= 0 ) {
+            if( n < 0 && first && (errno == EINVAL || errno == ENOSYS) ) {
+                unsupported = true;
+            }
+            else if( !n ) {
+                printf("warn: dma timeout\n");
+            }
+            else {
+                printf("error: dma splice failed [%s]\n", strerror(errno));
+            }
+            ok = false;
+            break;
+        }
+        first = false;
+        bytes -= n;
+
+        while( n > 0 ) {
+            ssize_t m = splice(pfd[0], NULL, m_fd, NULL, n, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if( m < 0 && errno == EINTR ) {
+                continue;
+            }
+            if( m <= 0 ) {
+                printf("error: file splice failed [%s]\n", strerror(errno));
+                ok = false;
+                break;
+            }
+            n -= m;
+        }
+    }
+
+    ::close(pfd[0]);
+    ::close(pfd[1]);
+    return ok;
+}
+
+//!******************************************************
+//! @brief
+//! Writes the sidecar header describing a capture file
+//! so host tools can convert the samples lazily
+//!
+//!******************************************************
+bool cerb_write_header(const std::string& path, cerb_format_e format, double sample_rate)
+{
+    return cerb_write_header(path, format, std::vector<cerb_channel_marker_t>(), false, sample_rate);
+}
+
+//!******************************************************
+//! @brief
+//! Writes the sidecar header. Multi-channel captures
+//! also record the channel layout and one start marker
+//! per channel; interleaved files hold one sample per
+//! channel per time step, in marker order.
+//!
+//!******************************************************
+bool cerb_write_header(const std::string& path, cerb_format_e format,
+                       const std::vector<cerb_channel_marker_t>& markers, bool interleaved,
+                       double sample_rate)
+{
+    std::string fn = path + CERB_HEADER_EXT;
+    FILE* fp = fopen(fn.c_str(), "w");
+    if( !fp ) {
+        printf("failed to open file [%s]\n", fn.c_str());
+        return false;
+    }
+    fprintf(fp, "# Cerberus SDR capture header\n");
+    fprintf(fp, "format=%s\n", cerb_format_name(format));
+    fprintf(fp, "sample_rate=%.12g\n", sample_rate);
+    fprintf(fp, "scale=%.10e\n", cerb_format_scale(format));
+    if( !markers.empty() ) {
+        fprintf(fp, "layout=%s\n", interleaved ? "interleaved" : "split");
+        fprintf(fp, "channels=");
+        for (size_t k = 0; k < markers.size(); k++) {
+            fprintf(fp, "%s%u", k ? "," : "", markers[k].channel);
+        }
+        fprintf(fp, "\n");
+        for (size_t k = 0; k < markers.size(); k++) {
+            fprintf(fp, "start_ch%u=%llu,%llu\n", markers[k].channel,
+                    (unsigned long long)markers[k].seqno,
+                    (unsigned long long)markers[k].timestamp_ns);
+        }
+    }
+    bool ok = !ferror(fp);
+    ok = (fclose(fp) == 0) && ok;
+    if( !ok ) {
+        printf("failed to write file [%s]\n", fn.c_str());
+    }
+    return ok;
+}
@@ -0,0 +1,72 @@
+//!*********************************************************************
+//! @file cerb_writer.h
+//!
+//! @brief
+//! Capture file output. Raw wire (sc16) captures are written straight
+//! from the DMA buffers, using O_DIRECT when the filesystem allows it
+//! or splice() from the DMA channel when the driver supports it, and
+//! are described by a small sidecar header.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#ifndef CERB_WRITER_H_
+#define CERB_WRITER_H_
+
+#include <string>
+#include <vector>
+#include "cerb_common.h"
+
+#define CERB_HEADER_EXT ".hdr"
+
+//! Output sample formats
+typedef enum {
+    CERB_FORMAT_FC32 = 0,   // complex float, scaled to [-1, 1)
+    CERB_FORMAT_SC16,       // complex int16, as received from the DMA
+} cerb_format_e;
+
+//! Start of one channel in a multi-channel capture. All channels start on
+//! the same DMA block, the timestamps show how far apart their DMAs ran.
+typedef struct {
+    unsigned channel;       // cerb_dmarx_chN
+    uint64_t seqno;         // DMA block holding the first written sample
+    uint64_t timestamp_ns;  // CLOCK_MONOTONIC completion time of that block
+} cerb_channel_marker_t;
+
+bool        cerb_format_parse(const std::string& name, cerb_format_e& format);
+const char* cerb_format_name(cerb_format_e format);
+size_t      cerb_format_sample_size(cerb_format_e format);
+float       cerb_format_scale(cerb_format_e format);
+
+//!******************************************************
+//! @brief
+//! Sequential capture file writer
+//!
+//!******************************************************
+class cerb_file_writer
+{
+public:
+    cerb_file_writer();
+    ~cerb_file_writer();
+
+    bool open(const std::string& path, bool direct);
+    bool write(const void* data, size_t bytes);
+    bool splice_from(int fd, size_t bytes, bool& unsupported);
+    void close();
+    bool is_direct() const { return m_direct; }
+
+private:
+    bool write_all(const uint8_t* data, size_t bytes);
+    void disable_direct();
+
+    int  m_fd;
+    bool m_direct;
+};
+
+bool cerb_write_header(const std::string& path, cerb_format_e format,
+                       double sample_rate = CERB_SAMP_RATE);
+bool cerb_write_header(const std::string& path, cerb_format_e format,
+                       const std::vector<cerb_channel_marker_t>& markers, bool interleaved,
+                       double sample_rate = CERB_SAMP_RATE);
+
+#endif /* CERB_WRITER_H_ */
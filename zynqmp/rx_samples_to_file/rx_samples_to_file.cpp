@@ -12,27 +12,38 @@
 //!
 //! THe Xilinx DMA IP is connected to the RFDC ADC[0] channel. The ADC
 //! channel's sample rate is 500MHz and center frequency of 250MHz.
+//! With --channels, several cerb_dmarx_chN channels are captured in
+//! the same run, aligned on DMA block boundaries.
 //!
 //! Copyright (C) 2022 Ipsolon Research, Inc
 //! All rights reserved.
 //!*********************************************************************
 #include <math.h>
 #include <boost/program_options.hpp>
-#include <iostream>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/ioctl.h>
+#include <unistd.h>
+#include "cerb_common.h"
+#include "cerb_convert.h"
+#include "cerb_cwgen.h"
+#include "cerb_ddc.h"
+#include "cerb_dma.h"
+#include "cerb_net.h"
+#include "cerb_psd.h"
+#include "cerb_sigmf.h"
+#include "cerb_stream.h"
+#include "cerb_trigger.h"
+#include "cerb_writer.h"
 
 namespace po = boost::program_options;
-typedef std::complex<int16_t>       cmplx_wire_t;
-typedef std::complex<float>         cmplx_sample_t;
-typedef std::vector<cmplx_wire_t>   cmplx_wire_vec_t;
-typedef std::vector<cmplx_sample_t> cmplx_sample_vec_t;
-
-#define CERB_IQ_SCALE   (1.0f / 32768.0f)
-#define CERB_MAX_IQ_CNT (1 << 20)
-#define CERB_SDR_DEV    "/dev/cerberus-sdr"
-#define CERB_DMA_DEV    "/dev/cerb_dmarx_ch0"
 
 // globals
 po::variables_map   m_opts;
@@ -40,6 +51,114 @@ std::string         m_file_def = "samples_to_file.cfile";
 size_t              m_nsamps = 65536;
 double              m_freq_hz = 10e6;
 size_t              m_ampl_scale = 1;
+double              m_duration = 0;
+size_t              m_nbuffers = 8;
+size_t              m_buffer_samps = (1 << 18);
+std::string         m_format_def = "fc32";
+cerb_format_e       m_format = CERB_FORMAT_FC32;
+std::string         m_dma_dev = CERB_DMA_DEV;
+std::string         m_dma_mode = "read";
+std::string         m_channels_def;
+std::vector<unsigned> m_channels;
+std::string         m_channel_output = "interleaved";
+std::string         m_net_url;
+size_t              m_net_mtu = CERB_NET_DEFAULT_MTU;
+size_t              m_net_batch = 4;
+std::string         m_trigger_def;
+cerb_trigger_config_t m_trigger = { CERB_TRIGGER_POWER, -30.0, 10e6, 256, (1 << 16), (1 << 18), 0 };
+cerb_ddc_config_t   m_ddc = { 1, 0, CERB_DDC_DEFAULT_TAPS };
+cerb_psd_config_t   m_psd = { 1024, 0, 16384, 0 };
+double              m_psd_overlap = 50;
+std::string         m_sweep_def;
+double              m_settle_ms = 1.0;
+
+//! One CWGEN setting of a sweep
+typedef struct {
+    double freq_hz;
+    size_t ampl_scale;
+} sweep_step_t;
+std::vector<sweep_step_t> m_sweep;
+volatile sig_atomic_t m_sweep_stop = 0;
+
+//!******************************************************
+//! @brief
+//! Parses a comma separated list of distinct DMA
+//! channel numbers
+//!
+//!******************************************************
+bool parse_channels( const std::string& def, std::vector<unsigned>& channels )
+{
+    std::stringstream ss(def);
+    std::string item;
+    channels.clear();
+    while( std::getline(ss, item, ',') ) {
+        char* end = nullptr;
+        unsigned long ch = strtoul(item.c_str(), &end, 10);
+        if( item.empty() || *end != '\0' ) {
+            return false;
+        }
+        for (size_t k = 0; k < channels.size(); k++) {
+            if( channels[k] == ch ) {
+                return false;
+            }
+        }
+        channels.push_back(static_cast<unsigned>(ch));
+    }
+    return !channels.empty();
+}
+
+//!******************************************************
+//! @brief
+//! Reads a sweep list: one step per line, frequency in
+//! Hz and optional amplitude scale (--cwgen-ampl when
+//! absent), separated by blanks or a comma; '#' starts
+//! a comment
+//!
+//!******************************************************
+bool parse_sweep( const std::string& fn, std::vector<sweep_step_t>& steps )
+{
+    std::ifstream in(fn.c_str());
+    if( !in ) {
+        std::cerr << "error: failed to open sweep list [" << fn << "]\n";
+        return false;
+    }
+    std::string line;
+    size_t lineno = 0;
+    steps.clear();
+    while( std::getline(in, line) ) {
+        lineno++;
+        line = line.substr(0, line.find('#'));
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::stringstream ss(line);
+        sweep_step_t step = { 0, m_ampl_scale };
+        if( !(ss >> step.freq_hz) ) {
+            if( line.find_first_not_of(" \t\r") != std::string::npos ) {
+                std::cerr << "error: bad sweep step on line [" << lineno << "]\n";
+                return false;
+            }
+            continue;
+        }
+        if( !(ss >> step.ampl_scale) ) {
+            step.ampl_scale = m_ampl_scale;
+        }
+        steps.push_back(step);
+    }
+    if( steps.empty() ) {
+        std::cerr << "error: sweep list [" << fn << "] has no steps\n";
+        return false;
+    }
+    return true;
+}
+
+//!******************************************************
+//! @brief
+//! True when samples go through the down converter
+//!
+//!******************************************************
+bool ddc_enabled()
+{
+    return m_ddc.decim > 1 || m_ddc.center_freq_hz != 0;
+}
 
 //!******************************************************
 //! @brief
@@ -55,6 +174,36 @@ int init_options(int argc, char *argv[])
         ("nsamps,n",   po::value<size_t>(&m_nsamps)->default_value(m_nsamps),           "Requested number of complex samples (< 2^20) ")
         ("cwgen-freq", po::value<double>(&m_freq_hz)->default_value(m_freq_hz),         "CW Generator baseband frequency in Hz")
         ("cwgen-ampl", po::value<size_t>(&m_ampl_scale)->default_value(m_ampl_scale),   "CW Generator power-of-2 amplitude scale")
+        ("continuous",                                                                  "Stream until interrupted (Ctrl-C)")
+        ("duration",   po::value<double>(&m_duration)->default_value(m_duration),       "Stream for the given number of seconds")
+        ("nbuffers",   po::value<size_t>(&m_nbuffers)->default_value(m_nbuffers),       "Number of DMA buffers in the streaming ring")
+        ("buffer-samps", po::value<size_t>(&m_buffer_samps)->default_value(m_buffer_samps), "Complex samples per streaming DMA buffer (<= 2^20)")
+        ("format",     po::value<std::string>(&m_format_def)->default_value(m_format_def), "Output sample format: fc32 (complex float) or sc16 (raw wire, complex int16)")
+        ("dma-dev",    po::value<std::string>(&m_dma_dev)->default_value(m_dma_dev),    "DMA device, or shm:<name> for the cerb_dma_shm_producer stand-in")
+        ("dma-mode",   po::value<std::string>(&m_dma_mode)->default_value(m_dma_mode),  "DMA access: read (copy through read()) or mmap (zero-copy mapped buffers)")
+        ("channels",   po::value<std::string>(&m_channels_def),                         "Capture several DMA channels together, e.g. 0,1,2,3 (replaces the --dma-dev channel number)")
+        ("channel-output", po::value<std::string>(&m_channel_output)->default_value(m_channel_output), "Multi-channel output: interleaved (one file) or split (one file per channel)")
+        ("net",        po::value<std::string>(&m_net_url),                              "Stream to a receiver instead of a file: udp://host:port or tcp://host:port")
+        ("net-mtu",    po::value<size_t>(&m_net_mtu)->default_value(m_net_mtu),         "UDP datagram size including IP/UDP headers (9000 = jumbo frames)")
+        ("net-batch",  po::value<size_t>(&m_net_batch)->default_value(m_net_batch),     "Maximum DMA buffers sent per system call")
+        ("sigmf",                                                                       "Write SigMF metadata (<file>.sigmf-meta) with capture time and per-block DMA timestamps")
+        ("trigger",    po::value<std::string>(&m_trigger_def),                          "Triggered capture, only windows around events are written: power or tone")
+        ("trigger-level", po::value<double>(&m_trigger.level_dbfs)->default_value(m_trigger.level_dbfs), "Trigger level in dBFS (window mean power, or tone bin power)")
+        ("trigger-freq", po::value<double>(&m_trigger.freq_hz)->default_value(m_trigger.freq_hz), "Tone trigger baseband frequency in Hz")
+        ("trigger-window", po::value<size_t>(&m_trigger.window)->default_value(m_trigger.window), "Samples per detector window")
+        ("pre-samps",  po::value<size_t>(&m_trigger.pre_samps)->default_value(m_trigger.pre_samps), "Samples written before the trigger")
+        ("post-samps", po::value<size_t>(&m_trigger.post_samps)->default_value(m_trigger.post_samps), "Samples written from the trigger on")
+        ("max-events", po::value<uint64_t>(&m_trigger.max_events)->default_value(m_trigger.max_events), "Stop after this many events (0 = until --duration or interrupted)")
+        ("decim",      po::value<size_t>(&m_ddc.decim)->default_value(m_ddc.decim),     "Decimate by this factor before writing (output rate = 500 MSPS / decim)")
+        ("center-freq", po::value<double>(&m_ddc.center_freq_hz)->default_value(m_ddc.center_freq_hz), "Baseband frequency in Hz mixed down to 0 Hz before decimating")
+        ("decim-taps", po::value<size_t>(&m_ddc.taps_per_phase)->default_value(m_ddc.taps_per_phase), "Decimation FIR taps per polyphase branch")
+        ("psd",                                                                         "Write averaged power spectrum frames (float dBFS, -fs/2..fs/2) instead of samples")
+        ("psd-nfft",   po::value<size_t>(&m_psd.nfft)->default_value(m_psd.nfft),       "FFT size of the spectrum, a power of two")
+        ("psd-overlap", po::value<double>(&m_psd_overlap)->default_value(m_psd_overlap), "Overlap of consecutive Hann windowed segments in percent")
+        ("psd-avg",    po::value<size_t>(&m_psd.navg)->default_value(m_psd.navg),       "Segments averaged per spectrum frame")
+        ("psd-threads", po::value<size_t>(&m_psd.nthreads)->default_value(m_psd.nthreads), "FFT threads (0 = one per core)")
+        ("sweep",      po::value<std::string>(&m_sweep_def),                            "CWGEN sweep: file of 'freq_hz [ampl_scale]' lines, --nsamps captured per step into one file")
+        ("settle-ms",  po::value<double>(&m_settle_ms)->default_value(m_settle_ms),     "Time to let the CWGEN settle after each retune")
     ;
 
     po::store( po::parse_command_line(argc, argv, desc), m_opts);
@@ -72,6 +221,109 @@ int init_options(int argc, char *argv[])
         return 0;
     }
 
+    if( !cerb_format_parse(m_format_def, m_format) ) {
+        std::cerr << "error: unknown sample format [" << m_format_def << "]\n";
+        return 0;
+    }
+
+    if( m_dma_mode != "read" && m_dma_mode != "mmap" ) {
+        std::cerr << "error: unknown DMA mode [" << m_dma_mode << "]\n";
+        return 0;
+    }
+    if( m_dma_mode == "read" && m_dma_dev.compare(0, 4, CERB_DMA_SHM_PREFIX) == 0 ) {
+        std::cerr << "error: shared memory DMA requires --dma-mode=mmap\n";
+        return 0;
+    }
+
+    if( !m_channels_def.empty() ) {
+        if( !parse_channels(m_channels_def, m_channels) ) {
+            std::cerr << "error: invalid channel list [" << m_channels_def << "]\n";
+            return 0;
+        }
+        if( m_dma_mode != "read" ) {
+            std::cerr << "error: --channels requires --dma-mode=read\n";
+            return 0;
+        }
+        if( m_channel_output != "interleaved" && m_channel_output != "split" ) {
+            std::cerr << "error: unknown channel output [" << m_channel_output << "]\n";
+            return 0;
+        }
+    }
+
+    if( !m_net_url.empty() ) {
+        if( !m_channels.empty() ) {
+            std::cerr << "error: --net streams a single channel\n";
+            return 0;
+        }
+        if( !m_net_batch ) {
+            std::cerr << "error: --net-batch must be at least 1\n";
+            return 0;
+        }
+    }
+
+    if( !m_trigger_def.empty() ) {
+        if( !cerb_trigger_parse(m_trigger_def, m_trigger.type) ) {
+            std::cerr << "error: unknown trigger [" << m_trigger_def << "]\n";
+            return 0;
+        }
+        if( !m_channels.empty() || !m_net_url.empty() ) {
+            std::cerr << "error: --trigger captures a single channel to file\n";
+            return 0;
+        }
+        if( !m_trigger.window || !m_trigger.post_samps ) {
+            std::cerr << "error: --trigger-window and --post-samps must be at least 1\n";
+            return 0;
+        }
+    }
+
+    if( !m_ddc.decim || !m_ddc.taps_per_phase ) {
+        std::cerr << "error: --decim and --decim-taps must be at least 1\n";
+        return 0;
+    }
+    if( fabs(m_ddc.center_freq_hz) > CERB_SAMP_RATE / 2 ) {
+        std::cerr << "error: --center-freq must be within +/-" << CERB_SAMP_RATE / 2 << " Hz\n";
+        return 0;
+    }
+    if( ddc_enabled() && (!m_channels.empty() || !m_net_url.empty() || !m_trigger_def.empty()) ) {
+        std::cerr << "error: --decim and --center-freq apply to single channel file captures\n";
+        return 0;
+    }
+
+    if( !m_sweep_def.empty() ) {
+        if( !parse_sweep(m_sweep_def, m_sweep) ) {
+            return 0;
+        }
+        if( !m_channels.empty() || !m_net_url.empty() || !m_trigger_def.empty() || m_opts.count("psd") ||
+            ddc_enabled() || m_opts.count("continuous") || m_duration > 0 ) {
+            std::cerr << "error: --sweep captures --nsamps per step from a single channel\n";
+            return 0;
+        }
+        if( !m_nsamps || m_nsamps > CERB_MAX_IQ_CNT ) {
+            std::cerr << "error: --nsamps must be between 1 and " << CERB_MAX_IQ_CNT << " per sweep step\n";
+            return 0;
+        }
+    }
+
+    if( m_opts.count("psd") ) {
+        if( !m_channels.empty() || !m_net_url.empty() || !m_trigger_def.empty() ) {
+            std::cerr << "error: --psd analyses a single channel to file\n";
+            return 0;
+        }
+        if( m_opts.count("sigmf") ) {
+            std::cerr << "error: --sigmf describes IQ samples, --psd writes spectrum frames\n";
+            return 0;
+        }
+        if( !m_opts["nsamps"].defaulted() && (!m_nsamps || m_nsamps > CERB_MAX_IQ_CNT) ) {
+            std::cerr << "error: --nsamps must be between 1 and " << CERB_MAX_IQ_CNT << " with --psd, use --duration for longer spectra\n";
+            return 0;
+        }
+        if( m_psd_overlap < 0 || m_psd_overlap >= 100 ) {
+            std::cerr << "error: --psd-overlap must be at least 0 and below 100 percent\n";
+            return 0;
+        }
+        m_psd.overlap = static_cast<size_t>(m_psd.nfft * m_psd_overlap / 100);
+    }
+
     return 1;
 }
 
@@ -82,75 +334,916 @@ int init_options(int argc, char *argv[])
 //!**************************************************
 bool cwgen_configure( double freq_hz, double phase, size_t ampl_scale )
 {
-    typedef struct __attribute__((__packed__)) {
-        uint32_t     mute;       // not supported
-        uint32_t     freq_word;
-        uint32_t     phase_word;
-        uint32_t     ampl_scale;
-    } cerb_cwgen_t;
-    #define CERB_IOCTL_CWGEN     _IOW('C', 2, struct cerberus_cwgen_t*)
-
-    int32_t freq_word  = std::round(freq_hz / 500e6 * 65536);
-    int32_t phase_word = std::round(phase / (2*M_PI) * 65536);
-    cerb_cwgen_t msg = {
-        0,
-        static_cast<uint32_t>(freq_word),
-        static_cast<uint32_t>(phase_word),
-        static_cast<uint32_t>(ampl_scale & 0x1F),
-    };
+    int fd = cerb_cwgen_open();
+    if( fd < 0 ) {
+        return false;
+    }
+    bool ok = cerb_cwgen_set(fd, freq_hz, phase, ampl_scale);
+    close(fd);
+    return ok;
+}
 
-    // perform IQ capture (fs=500MHz)
-    int fd = open(CERB_SDR_DEV, O_RDWR | O_SYNC);
+//!******************************************************
+//! @brief
+//! Starts the SigMF metadata of a capture file when
+//! --sigmf is given. The capture time is taken here.
+//!
+//!******************************************************
+bool sigmf_open( cerb_sigmf_writer& meta, const std::string& path, size_t nchannels )
+{
+    if( !m_opts.count("sigmf") ) {
+        return true;
+    }
+    cerb_sigmf_info_t info;
+    info.format         = m_format;
+    info.nchannels      = nchannels;
+    info.sample_rate    = CERB_SAMP_RATE / m_ddc.decim;
+    info.center_freq_hz = CERB_CENTER_FREQ + m_ddc.center_freq_hz;
+    info.cwgen          = (m_dma_dev.compare(0, 4, CERB_DMA_SHM_PREFIX) != 0);
+    info.cwgen_freq_hz  = m_freq_hz;
+    info.cwgen_ampl     = m_ampl_scale;
+    info.dma_dev        = m_dma_dev;
+    return meta.open(path, info);
+}
+
+//!******************************************************
+//! @brief
+//! Performs a single DMA request
+//!
+//!******************************************************
+bool request( uint8_t* buffer, ssize_t req_bytes )
+{
+    // open DMA channel
+    int fd = open(m_dma_dev.c_str(), O_RDWR | O_SYNC);
     if( fd < 0 ) {
         printf("error: failed to open DMA device.. aborting\n");
         return false;
     }
 
-    int rc = ioctl(fd, CERB_IOCTL_CWGEN, (void*)&msg);
-    if( rc < 0 ){
-        printf("failed to call [CERB_IOCTL_CWGEN] => [%d]\n", rc);
+    int rc = cerb_dma_read(fd, buffer, req_bytes);
+    close(fd);
+    if( !rc ) {
+        printf("warn: dma timeout\n");
+    }
+    if( rc <= 0 ) {
         return false;
     }
+
+    printf("dma request completed: [%ld] bytes received\n", req_bytes);
     return true;
 }
 
 //!******************************************************
 //! @brief
-//! Performs a single DMA request
+//! Performs a single DMA request straight into the
+//! output file. The DMA channel is spliced to the file
+//! when the driver supports it, otherwise the wire
+//! buffer is written as received.
 //!
 //!******************************************************
-bool request( uint8_t* buffer, ssize_t req_bytes )
+bool request_to_file( cerb_file_writer& fout, size_t req_bytes )
 {
-    // open DMA channel
-    int fd = open(CERB_DMA_DEV, O_RDWR | O_SYNC);
+    int fd = open(m_dma_dev.c_str(), O_RDWR | O_SYNC);
     if( fd < 0 ) {
         printf("error: failed to open DMA device.. aborting\n");
         return false;
     }
 
-    ssize_t pos = 0;
-    while( req_bytes > 0 )
-    {
-        ssize_t rc = ::read(fd, &buffer[pos], req_bytes);
-        if( !rc ){
-            printf("warn: dma timeout\n");
-            close(fd);
+    bool unsupported = false;
+    bool ok = fout.splice_from(fd, req_bytes, unsupported);
+    close(fd);
+    if( ok ) {
+        printf("dma request completed: [%zu] bytes spliced\n", req_bytes);
+        return true;
+    }
+    if( !unsupported ) {
+        return false;
+    }
+
+    cmplx_wire_vec_t wire(req_bytes / sizeof(cmplx_wire_t));
+    if( !request( reinterpret_cast<uint8_t*>(&wire[0]), req_bytes) ) {
+        return false;
+    }
+    return fout.write(&wire[0], req_bytes);
+}
+
+//!******************************************************
+//! @brief
+//! Sidecar header of a down converted capture, also
+//! written for fc32 since the sample rate is not the
+//! ADC rate
+//!
+//!******************************************************
+bool write_ddc_header( const std::string& path )
+{
+    if( !cerb_write_header(path, m_format, CERB_SAMP_RATE / m_ddc.decim) ) {
+        return false;
+    }
+    FILE* fp = fopen((path + CERB_HEADER_EXT).c_str(), "a");
+    if( !fp ) {
+        printf("error: failed to open [%s%s]\n", path.c_str(), CERB_HEADER_EXT);
+        return false;
+    }
+    fprintf(fp, "decim=%zu\n", m_ddc.decim);
+    fprintf(fp, "center_freq=%.1f\n", CERB_CENTER_FREQ + m_ddc.center_freq_hz);
+    return fclose(fp) == 0;
+}
+
+//!******************************************************
+//! @brief
+//! Stops a continuous capture on SIGINT/SIGTERM
+//!
+//!******************************************************
+void stream_signal_handler( int )
+{
+    cerb_stream_stop();
+}
+
+//!******************************************************
+//! @brief
+//! Streams DMA blocks to file until total_samps have
+//! been captured (0 = until the user interrupts)
+//!
+//!******************************************************
+bool stream_to_file( uint64_t total_samps )
+{
+    if( !m_buffer_samps || m_buffer_samps > CERB_MAX_IQ_CNT ) {
+        printf("error: buffer size must be between 1 and [%d] samples\n", CERB_MAX_IQ_CNT);
+        return false;
+    }
+
+    cerb_file_writer fout;
+    if( !fout.open(m_file_def, true) ){
+        return false;
+    }
+    if( ddc_enabled() ) {
+        if( !write_ddc_header(m_file_def) ) {
             return false;
         }
-        else if( rc < 0 ){
-            printf("error: dma error [%s]\n", strerror(errno));
-            close(fd);
+    }
+    else if( m_format == CERB_FORMAT_SC16 && !cerb_write_header(m_file_def, m_format) ) {
+        return false;
+    }
+
+    cerb_sigmf_writer meta;
+    if( !sigmf_open(meta, m_file_def, 1) ) {
+        return false;
+    }
+
+    cerb_stream_config_t cfg;
+    cfg.nbuffers     = m_nbuffers;
+    cfg.buffer_samps = m_buffer_samps;
+    cfg.total_samps  = total_samps;
+
+    cerb_ddc ddc;
+    if( ddc_enabled() ) {
+        if( !ddc.configure(m_ddc, m_buffer_samps) ) {
             return false;
         }
-        req_bytes -= rc;
-        pos += rc;
+        printf("ddc: center [%.0f Hz] decim [%zu] taps [%zu] -> [%.0f S/s]\n",
+               m_ddc.center_freq_hz, m_ddc.decim, ddc.ntaps(), ddc.sample_rate());
     }
 
-    close(fd);
-    printf("dma request completed: [%ld] bytes received\n", pos);
+    // conversion scratch, down converter and metadata are owned by the writer thread
+    cmplx_sample_vec_t samples(ddc_enabled() ? ddc.max_output(m_buffer_samps) :
+                               m_format == CERB_FORMAT_FC32 ? m_buffer_samps : 0);
+    cmplx_wire_vec_t   wire(ddc_enabled() && m_format == CERB_FORMAT_SC16 ? samples.size() : 0);
+    cerb_stream_sink_t sink = [&](const cerb_dma_buffer_t& buf) {
+        bool ok;
+        if( ddc_enabled() ) {
+            size_t n = ddc.process(buf.samps, buf.nsamps, &samples[0]);
+            if( m_format == CERB_FORMAT_SC16 ) {
+                cerb_convert_fc32_to_sc16(&samples[0], &wire[0], n);
+                ok = fout.write(&wire[0], n*sizeof(cmplx_wire_t));
+            }
+            else {
+                ok = fout.write(&samples[0], n*sizeof(samples[0]));
+            }
+            if( ok && meta.is_open() ) {
+                ok = meta.add_block(n, buf.seqno, buf.timestamp_ns);
+            }
+            return ok;
+        }
+        if( m_format == CERB_FORMAT_SC16 ) {
+            ok = fout.write(buf.samps, buf.nsamps*sizeof(cmplx_wire_t));
+        }
+        else {
+            cerb_convert_sc16_to_fc32(buf.samps, &samples[0], buf.nsamps);
+            ok = fout.write(&samples[0], buf.nsamps*sizeof(samples[0]));
+        }
+        if( ok && meta.is_open() ) {
+            ok = meta.add_block(buf.nsamps, buf.seqno, buf.timestamp_ns);
+        }
+        return ok;
+    };
+
+    cerb_stream_reset();
+    signal(SIGINT,  stream_signal_handler);
+    signal(SIGTERM, stream_signal_handler);
+
+    cerb_stream_stats_t stats = {};
+    bool ok = false;
+    if( m_dma_mode == "mmap" ) {
+        cerb_dma_mapped* src = cerb_dma_mapped_open(m_dma_dev);
+        if( src ) {
+            ok = cerb_stream_capture_mapped(*src, cfg, sink, stats);
+            delete src;
+        }
+    }
+    else {
+        ok = cerb_stream_capture(m_dma_dev, cfg, sink, stats);
+    }
+    cerb_stream_print_stats(stats);
+    if( meta.is_open() && !meta.close() ) {
+        ok = false;
+    }
+    if( !ok ) {
+        printf("error: streaming capture failed\n");
+    }
+    return ok;
+}
+
+//!******************************************************
+//! @brief
+//! Sidecar header of a spectrum capture. The data file
+//! holds nfft floats per frame.
+//!
+//!******************************************************
+bool write_psd_header( const std::string& path, const cerb_psd& psd )
+{
+    std::string fn = path + CERB_HEADER_EXT;
+    FILE* fp = fopen(fn.c_str(), "w");
+    if( !fp ) {
+        printf("failed to open file [%s]\n", fn.c_str());
+        return false;
+    }
+    fprintf(fp, "# Cerberus SDR capture header\n");
+    fprintf(fp, "format=psd_dbfs\n");
+    fprintf(fp, "sample_rate=%.12g\n", CERB_SAMP_RATE / m_ddc.decim);
+    fprintf(fp, "center_freq=%.1f\n", CERB_CENTER_FREQ + m_ddc.center_freq_hz);
+    fprintf(fp, "nfft=%zu\n", m_psd.nfft);
+    fprintf(fp, "overlap=%zu\n", m_psd.overlap);
+    fprintf(fp, "navg=%zu\n", m_psd.navg);
+    fprintf(fp, "window=hann\n");
+    fprintf(fp, "enbw_bins=%.4f\n", psd.enbw());
+    return fclose(fp) == 0;
+}
+
+//!******************************************************
+//! @brief
+//! Streams through the (optional) down converter into
+//! the Welch averager; only spectrum frames are written
+//!
+//!******************************************************
+bool stream_psd( uint64_t total_samps )
+{
+    if( !m_buffer_samps || m_buffer_samps > CERB_MAX_IQ_CNT ) {
+        printf("error: buffer size must be between 1 and [%d] samples\n", CERB_MAX_IQ_CNT);
+        return false;
+    }
+
+    cerb_ddc ddc;
+    if( ddc_enabled() && !ddc.configure(m_ddc, m_buffer_samps) ) {
+        return false;
+    }
+
+    cerb_file_writer fout;
+    if( !fout.open(m_file_def, false) ){
+        return false;
+    }
+    cerb_psd psd;
+    cerb_psd::frame_fn_t frame = [&](const cerb_psd_frame_t&, const float* dbfs) {
+        return fout.write(dbfs, m_psd.nfft*sizeof(float));
+    };
+    if( !psd.configure(m_psd, frame) || !write_psd_header(m_file_def, psd) ) {
+        return false;
+    }
+    double rate = CERB_SAMP_RATE / m_ddc.decim;
+    printf("psd: [%zu] bins of [%.1f Hz], overlap [%zu], [%zu] averages, [%s] FFT on [%zu] threads\n",
+           m_psd.nfft, rate / m_psd.nfft, m_psd.overlap, m_psd.navg, cerb_psd::backend(), psd.threads());
+
+    cerb_stream_config_t cfg;
+    cfg.nbuffers     = m_nbuffers;
+    cfg.buffer_samps = m_buffer_samps;
+    cfg.total_samps  = total_samps;
+
+    cmplx_sample_vec_t samples(ddc_enabled() ? ddc.max_output(m_buffer_samps) : m_buffer_samps);
+    uint64_t next_seqno = 0;
+    bool     started    = false;
+    cerb_stream_sink_t sink = [&](const cerb_dma_buffer_t& buf) {
+        // segments and filter history never span dropped blocks
+        if( started && buf.seqno != next_seqno ) {
+            psd.restart();
+            ddc.reset();
+        }
+        started    = true;
+        next_seqno = buf.seqno + 1;
+
+        size_t n = buf.nsamps;
+        if( ddc_enabled() ) {
+            n = ddc.process(buf.samps, buf.nsamps, &samples[0]);
+        }
+        else {
+            cerb_convert_sc16_to_fc32(buf.samps, &samples[0], buf.nsamps);
+        }
+        return psd.process(&samples[0], n, buf.seqno, buf.timestamp_ns);
+    };
+
+    cerb_stream_reset();
+    signal(SIGINT,  stream_signal_handler);
+    signal(SIGTERM, stream_signal_handler);
+
+    cerb_stream_stats_t stats = {};
+    bool ok = false;
+    if( m_dma_mode == "mmap" ) {
+        cerb_dma_mapped* src = cerb_dma_mapped_open(m_dma_dev);
+        if( src ) {
+            ok = cerb_stream_capture_mapped(*src, cfg, sink, stats);
+            delete src;
+        }
+    }
+    else {
+        ok = cerb_stream_capture(m_dma_dev, cfg, sink, stats);
+    }
+    cerb_stream_print_stats(stats);
+    printf("psd: [%llu] frames\n", (unsigned long long)psd.frames());
+    if( !ok ) {
+        printf("error: spectrum capture failed\n");
+    }
+    return ok;
+}
+
+//!******************************************************
+//! @brief
+//! DMA device of channel ch: the channel number at the
+//! end of dev (e.g. /dev/cerb_dmarx_ch0) is replaced
+//!
+//!******************************************************
+std::string channel_dev( const std::string& dev, unsigned ch )
+{
+    size_t end = dev.find_last_not_of("0123456789");
+    return dev.substr(0, end + 1) + std::to_string(ch);
+}
+
+//!******************************************************
+//! @brief
+//! Output file with suffix inserted before the
+//! extension
+//!
+//!******************************************************
+std::string suffixed_file( const std::string& path, const std::string& suffix )
+{
+    size_t dot   = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if( dot == std::string::npos || (slash != std::string::npos && dot < slash) ) {
+        dot = path.size();
+    }
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+//!******************************************************
+//! @brief
+//! Per-channel output file, _chN before the extension
+//!
+//!******************************************************
+std::string channel_file( const std::string& path, unsigned ch )
+{
+    return suffixed_file(path, "_ch" + std::to_string(ch));
+}
+
+//!******************************************************
+//! @brief
+//! Captures all --channels at once, one reader thread
+//! per channel pinned to its own core, into one
+//! interleaved file or one file per channel. Blocks
+//! are aligned by DMA sequence number and the start of
+//! every channel is recorded in the sidecar header.
+//!
+//!******************************************************
+bool stream_channels_to_file( uint64_t total_samps )
+{
+    if( !m_buffer_samps || m_buffer_samps > CERB_MAX_IQ_CNT ) {
+        printf("error: buffer size must be between 1 and [%d] samples\n", CERB_MAX_IQ_CNT);
+        return false;
+    }
+
+    size_t nchans      = m_channels.size();
+    bool   interleaved = (m_channel_output == "interleaved");
+    unsigned ncpus     = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::string> devs(nchans);
+    std::vector<std::string> files(interleaved ? 1 : nchans);
+    std::vector<int>         cpus(nchans);
+    for (size_t c = 0; c < nchans; c++) {
+        devs[c] = channel_dev(m_dma_dev, m_channels[c]);
+        cpus[c] = static_cast<int>(c % ncpus);
+        if( !interleaved ) {
+            files[c] = channel_file(m_file_def, m_channels[c]);
+        }
+    }
+    if( interleaved ) {
+        files[0] = m_file_def;
+    }
+
+    std::vector<std::unique_ptr<cerb_file_writer> >  fout(files.size());
+    std::vector<std::unique_ptr<cerb_sigmf_writer> > meta(files.size());
+    for (size_t k = 0; k < files.size(); k++) {
+        fout[k].reset(new cerb_file_writer());
+        if( !fout[k]->open(files[k], true) ) {
+            return false;
+        }
+        meta[k].reset(new cerb_sigmf_writer());
+        if( !sigmf_open(*meta[k], files[k], interleaved ? nchans : 1) ) {
+            return false;
+        }
+    }
+
+    cerb_stream_config_t cfg;
+    cfg.nbuffers     = m_nbuffers;
+    cfg.buffer_samps = m_buffer_samps;
+    cfg.total_samps  = total_samps;
+
+    // interleave and conversion scratch, owned by the capture thread
+    size_t scratch_samps = interleaved ? nchans * m_buffer_samps : m_buffer_samps;
+    cmplx_wire_vec_t   wire(interleaved ? scratch_samps : 0);
+    cmplx_sample_vec_t samples(m_format == CERB_FORMAT_FC32 ? scratch_samps : 0);
+    std::vector<cerb_channel_marker_t> markers;
+    cerb_stream_multi_sink_t sink = [&](const std::vector<const cerb_dma_buffer_t*>& blocks) {
+        if( markers.empty() ) {
+            for (size_t c = 0; c < nchans; c++) {
+                cerb_channel_marker_t m = { m_channels[c], blocks[c]->seqno, blocks[c]->timestamp_ns };
+                markers.push_back(m);
+            }
+        }
+        size_t nsamps = blocks[0]->nsamps;
+        for (size_t k = 0; k < meta.size(); k++) {
+            const cerb_dma_buffer_t* b = blocks[interleaved ? 0 : k];
+            if( meta[k]->is_open() && !meta[k]->add_block(nsamps, b->seqno, b->timestamp_ns) ) {
+                return false;
+            }
+        }
+        if( !interleaved ) {
+            for (size_t c = 0; c < nchans; c++) {
+                if( m_format == CERB_FORMAT_SC16 ) {
+                    if( !fout[c]->write(blocks[c]->samps, nsamps*sizeof(cmplx_wire_t)) ) {
+                        return false;
+                    }
+                    continue;
+                }
+                cerb_convert_sc16_to_fc32(blocks[c]->samps, &samples[0], nsamps);
+                if( !fout[c]->write(&samples[0], nsamps*sizeof(samples[0])) ) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // one sample per channel per time step
+        for (size_t c = 0; c < nchans; c++) {
+            const cmplx_wire_t* src = blocks[c]->samps;
+            cmplx_wire_t*       dst = &wire[c];
+            for (size_t n = 0; n < nsamps; n++) {
+                dst[n * nchans] = src[n];
+            }
+        }
+        if( m_format == CERB_FORMAT_SC16 ) {
+            return fout[0]->write(&wire[0], nchans*nsamps*sizeof(cmplx_wire_t));
+        }
+        cerb_convert_sc16_to_fc32(&wire[0], &samples[0], nchans*nsamps);
+        return fout[0]->write(&samples[0], nchans*nsamps*sizeof(samples[0]));
+    };
+
+    cerb_stream_reset();
+    signal(SIGINT,  stream_signal_handler);
+    signal(SIGTERM, stream_signal_handler);
+
+    std::vector<cerb_stream_stats_t> stats;
+    bool ok = cerb_stream_capture_multi(devs, cpus, cfg, sink, stats);
+    for (size_t c = 0; c < stats.size(); c++) {
+        printf("channel [%u] on cpu [%d]:\n", m_channels[c], cpus[c]);
+        cerb_stream_print_stats(stats[c]);
+    }
+    for (size_t k = 0; k < fout.size(); k++) {
+        fout[k]->close();
+        if( meta[k]->is_open() && !meta[k]->close() ) {
+            ok = false;
+        }
+    }
+    if( !ok ) {
+        printf("error: multi-channel capture failed\n");
+        return false;
+    }
+
+    for (size_t k = 0; k < files.size(); k++) {
+        if( !cerb_write_header(files[k], m_format, markers, interleaved) ) {
+            return false;
+        }
+    }
     return true;
 }
 
+//!******************************************************
+//! @brief
+//! Streams DMA blocks to a network receiver as framed
+//! packets. Up to --net-batch queued blocks go out per
+//! system call.
+//!
+//!******************************************************
+bool stream_to_net( uint64_t total_samps )
+{
+    if( !m_buffer_samps || m_buffer_samps > CERB_MAX_IQ_CNT ) {
+        printf("error: buffer size must be between 1 and [%d] samples\n", CERB_MAX_IQ_CNT);
+        return false;
+    }
+
+    cerb_net_sender net;
+    if( !net.open(m_net_url, m_format, m_net_mtu) ) {
+        return false;
+    }
+
+    cerb_stream_config_t cfg;
+    cfg.nbuffers     = m_nbuffers;
+    cfg.buffer_samps = m_buffer_samps;
+    cfg.total_samps  = total_samps;
+
+    // sc16 blocks are sent straight from the DMA buffers
+    cmplx_sample_vec_t samples(m_format == CERB_FORMAT_FC32 ? m_net_batch * m_buffer_samps : 0);
+    std::vector<cerb_net_block_t> out;
+    cerb_stream_batch_sink_t sink = [&](const std::vector<const cerb_dma_buffer_t*>& blocks) {
+        out.clear();
+        size_t pos = 0;
+        for (size_t k = 0; k < blocks.size(); k++) {
+            cerb_net_block_t blk = { blocks[k]->samps, blocks[k]->nsamps, blocks[k]->seqno, blocks[k]->timestamp_ns };
+            if( m_format == CERB_FORMAT_FC32 ) {
+                cerb_convert_sc16_to_fc32(blocks[k]->samps, &samples[pos], blocks[k]->nsamps);
+                blk.data = &samples[pos];
+                pos += blocks[k]->nsamps;
+            }
+            out.push_back(blk);
+        }
+        return net.send(out);
+    };
+
+    cerb_stream_reset();
+    signal(SIGINT,  stream_signal_handler);
+    signal(SIGTERM, stream_signal_handler);
+
+    cerb_stream_stats_t stats = {};
+    bool ok = false;
+    if( m_dma_mode == "mmap" ) {
+        cerb_dma_mapped* src = cerb_dma_mapped_open(m_dma_dev);
+        if( src ) {
+            ok = cerb_stream_capture_mapped_batched(*src, cfg, m_net_batch, sink, stats);
+            delete src;
+        }
+    }
+    else {
+        ok = cerb_stream_capture_batched(m_dma_dev, cfg, m_net_batch, sink, stats);
+    }
+    ok = net.finish() && ok;
+    cerb_stream_print_stats(stats);
+    printf("net: [%llu] packets sent to [%s]\n", (unsigned long long)net.packets(), m_net_url.c_str());
+    if( !ok ) {
+        printf("error: network streaming failed\n");
+    }
+    return ok;
+}
+
+//!******************************************************
+//! @brief
+//! Appends the trigger details of an event to its
+//! sidecar header
+//!
+//!******************************************************
+bool write_event_header( const std::string& path, const cerb_trigger_event_t& evt )
+{
+    if( !cerb_write_header(path, m_format) ) {
+        return false;
+    }
+    FILE* fp = fopen((path + CERB_HEADER_EXT).c_str(), "a");
+    if( !fp ) {
+        printf("error: failed to open [%s%s]\n", path.c_str(), CERB_HEADER_EXT);
+        return false;
+    }
+    fprintf(fp, "trigger=%s\n", cerb_trigger_name(m_trigger.type));
+    fprintf(fp, "trigger_level_dbfs=%.2f\n", m_trigger.level_dbfs);
+    if( m_trigger.type == CERB_TRIGGER_TONE ) {
+        fprintf(fp, "trigger_freq=%.0f\n", m_trigger.freq_hz);
+    }
+    fprintf(fp, "event_level_dbfs=%.2f\n", evt.level_dbfs);
+    fprintf(fp, "trigger_offset=%llu\n", (unsigned long long)(evt.trigger_sample - evt.start_sample));
+    fprintf(fp, "trigger_seqno=%llu\n", (unsigned long long)evt.trigger_seqno);
+    fprintf(fp, "trigger_timestamp_ns=%llu\n", (unsigned long long)evt.trigger_timestamp_ns);
+    fprintf(fp, "truncated=%d\n", evt.truncated ? 1 : 0);
+    return fclose(fp) == 0;
+}
+
+//!******************************************************
+//! @brief
+//! Streams continuously through the trigger detector
+//! and writes every event, pre- to post-trigger window,
+//! to <file>_evtN with its own header (and SigMF)
+//!
+//!******************************************************
+bool stream_triggered( uint64_t total_samps )
+{
+    if( !m_buffer_samps || m_buffer_samps > CERB_MAX_IQ_CNT ) {
+        printf("error: buffer size must be between 1 and [%d] samples\n", CERB_MAX_IQ_CNT);
+        return false;
+    }
+
+    cerb_stream_config_t cfg;
+    cfg.nbuffers     = m_nbuffers;
+    cfg.buffer_samps = m_buffer_samps;
+    cfg.total_samps  = total_samps;
+
+    // data chunks come from one DMA block or from the pre-trigger history
+    size_t max_chunk = std::max(m_buffer_samps, m_trigger.pre_samps + m_trigger.window);
+    cmplx_sample_vec_t samples(m_format == CERB_FORMAT_FC32 ? max_chunk : 0);
+    cerb_file_writer   fout;
+    cerb_sigmf_writer  meta;
+    std::string        path;
+
+    cerb_trigger_capture::event_fn_t begin = [&](const cerb_trigger_event_t& evt) {
+        path = suffixed_file(m_file_def, "_evt" + std::to_string(evt.index));
+        return fout.open(path, true) && sigmf_open(meta, path, 1);
+    };
+    cerb_trigger_capture::data_fn_t data = [&](const cerb_trigger_event_t&, const cmplx_wire_t* x, size_t n,
+                                               uint64_t seqno, uint64_t timestamp_ns) {
+        bool ok;
+        if( m_format == CERB_FORMAT_SC16 ) {
+            ok = fout.write(x, n*sizeof(cmplx_wire_t));
+        }
+        else {
+            cerb_convert_sc16_to_fc32(x, &samples[0], n);
+            ok = fout.write(&samples[0], n*sizeof(samples[0]));
+        }
+        if( ok && meta.is_open() ) {
+            ok = meta.add_block(n, seqno, timestamp_ns);
+        }
+        return ok;
+    };
+    cerb_trigger_capture::event_fn_t end = [&](const cerb_trigger_event_t& evt) {
+        fout.close();
+        if( meta.is_open() && !meta.close() ) {
+            return false;
+        }
+        printf("trigger: event [%llu] level=[%.1f dBFS] seqno=[%llu] samples=[%llu]%s -> [%s]\n",
+               (unsigned long long)evt.index, evt.level_dbfs, (unsigned long long)evt.trigger_seqno,
+               (unsigned long long)evt.nsamps, evt.truncated ? " truncated" : "", path.c_str());
+        if( m_trigger.max_events && evt.index + 1 >= m_trigger.max_events ) {
+            cerb_stream_stop();
+        }
+        return write_event_header(path, evt);
+    };
+
+    cerb_trigger_capture trig;
+    if( !trig.configure(m_trigger, begin, data, end) ) {
+        return false;
+    }
+    cerb_stream_sink_t sink = [&](const cerb_dma_buffer_t& buf) {
+        return trig.process(buf);
+    };
+
+    cerb_stream_reset();
+    signal(SIGINT,  stream_signal_handler);
+    signal(SIGTERM, stream_signal_handler);
+    printf("trigger: armed [%s] at [%.1f dBFS], window [%zu] pre [%zu] post [%zu] samples\n",
+           cerb_trigger_name(m_trigger.type), m_trigger.level_dbfs, m_trigger.window,
+           m_trigger.pre_samps, m_trigger.post_samps);
+
+    cerb_stream_stats_t stats = {};
+    bool ok = false;
+    if( m_dma_mode == "mmap" ) {
+        cerb_dma_mapped* src = cerb_dma_mapped_open(m_dma_dev);
+        if( src ) {
+            ok = cerb_stream_capture_mapped(*src, cfg, sink, stats);
+            delete src;
+        }
+    }
+    else {
+        ok = cerb_stream_capture(m_dma_dev, cfg, sink, stats);
+    }
+    ok = trig.finish() && ok;
+    cerb_stream_print_stats(stats);
+    printf("trigger: [%llu] events\n", (unsigned long long)trig.events());
+    if( !ok ) {
+        printf("error: triggered capture failed\n");
+    }
+    return ok;
+}
+
+//!******************************************************
+//! @brief
+//! DMA side of a sweep, opened once for all steps
+//!
+//!******************************************************
+class sweep_source
+{
+public:
+    sweep_source() : m_fd(-1), m_mapped(nullptr), m_reads(0) {}
+    ~sweep_source() {
+        if( m_fd >= 0 ) {
+            close(m_fd);
+        }
+        delete m_mapped;
+    }
+
+    bool open() {
+        if( m_dma_mode == "mmap" ) {
+            m_mapped = cerb_dma_mapped_open(m_dma_dev);
+            return m_mapped != nullptr;
+        }
+        m_fd = ::open(m_dma_dev.c_str(), O_RDWR | O_SYNC);
+        if( m_fd < 0 ) {
+            printf("error: failed to open DMA device.. aborting\n");
+            return false;
+        }
+        return true;
+    }
+
+    //! nsamps contiguous samples whose first sample is not older than
+    //! not_before_ns; seqno/timestamp_ns are those of the first block
+    bool capture( cmplx_wire_t* dst, size_t nsamps, uint64_t not_before_ns, uint64_t& seqno, uint64_t& timestamp_ns ) {
+        if( !m_mapped ) {
+            int rc = cerb_dma_read(m_fd, reinterpret_cast<uint8_t*>(dst), nsamps * sizeof(cmplx_wire_t));
+            if( rc == 0 ) {
+                printf("warn: dma timeout\n");
+            }
+            seqno        = m_reads++;
+            timestamp_ns = cerb_monotonic_ns();
+            return rc > 0;
+        }
+
+        // mapped buffers may have completed before the retune, skip those
+        size_t   got  = 0;
+        uint64_t next = 0;
+        while( got < nsamps ) {
+            cerb_dma_desc_t desc;
+            int rc = m_mapped->dequeue(desc, 1000);
+            if( rc <= 0 ) {
+                printf("%s\n", rc ? "error: dma error" : "warn: dma timeout");
+                return false;
+            }
+            size_t   n     = desc.bytes / sizeof(cmplx_wire_t);
+            uint64_t first = desc.timestamp_ns - static_cast<uint64_t>(n * 1e9 / CERB_SAMP_RATE);
+            if( got && desc.seqno != next ) {
+                got = 0;    // dropped block inside the step, start over
+            }
+            if( got || first >= not_before_ns ) {
+                if( !got ) {
+                    seqno        = desc.seqno;
+                    timestamp_ns = desc.timestamp_ns;
+                }
+                size_t take = std::min(n, nsamps - got);
+                memcpy(&dst[got], m_mapped->buffer(desc.index), take * sizeof(cmplx_wire_t));
+                got += take;
+                next = desc.seqno + 1;
+            }
+            if( !m_mapped->enqueue(desc) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    int              m_fd;
+    cerb_dma_mapped* m_mapped;
+    uint64_t         m_reads;
+};
+
+//!******************************************************
+//! @brief
+//! Sidecar header of a sweep: the steps follow each
+//! other in the data file, nsamps each, and are listed
+//! as step_N=freq_hz,ampl_scale,seqno,timestamp_ns
+//!
+//!******************************************************
+bool write_sweep_header( const std::string& path, const std::vector<cerb_channel_marker_t>& marks )
+{
+    if( !cerb_write_header(path, m_format) ) {
+        return false;
+    }
+    FILE* fp = fopen((path + CERB_HEADER_EXT).c_str(), "a");
+    if( !fp ) {
+        printf("error: failed to open [%s%s]\n", path.c_str(), CERB_HEADER_EXT);
+        return false;
+    }
+    fprintf(fp, "sweep_steps=%zu\n", marks.size());
+    fprintf(fp, "sweep_nsamps=%zu\n", m_nsamps);
+    fprintf(fp, "settle_ms=%.3f\n", m_settle_ms);
+    for (size_t k = 0; k < marks.size(); k++) {
+        fprintf(fp, "step_%zu=%.1f,%zu,%llu,%llu\n", k, m_sweep[k].freq_hz, m_sweep[k].ampl_scale,
+                (unsigned long long)marks[k].seqno, (unsigned long long)marks[k].timestamp_ns);
+    }
+    return fclose(fp) == 0;
+}
+
+//!******************************************************
+//! @brief
+//! Ends a sweep after the current step
+//!
+//!******************************************************
+void sweep_signal_handler( int )
+{
+    m_sweep_stop = 1;
+}
+
+//!******************************************************
+//! @brief
+//! Steps the CWGEN through the sweep list with the SDR
+//! and DMA devices held open, capturing --nsamps after
+//! each retune into one file
+//!
+//!******************************************************
+bool sweep_to_file( bool standin )
+{
+    int sdr_fd = -1;
+    if( !standin ) {
+        sdr_fd = cerb_cwgen_open();
+        if( sdr_fd < 0 ) {
+            return false;
+        }
+    }
+    sweep_source src;
+    cerb_file_writer fout;
+    cerb_sigmf_writer meta;
+    bool ok = src.open() && fout.open(m_file_def, true) && sigmf_open(meta, m_file_def, 1);
+
+    cmplx_wire_vec_t   wire(m_nsamps);
+    cmplx_sample_vec_t samples(m_format == CERB_FORMAT_FC32 ? m_nsamps : 0);
+    std::vector<cerb_channel_marker_t> marks;
+    uint64_t t0 = cerb_monotonic_ns();
+
+    signal(SIGINT,  sweep_signal_handler);
+    signal(SIGTERM, sweep_signal_handler);
+    for (size_t k = 0; ok && k < m_sweep.size() && !m_sweep_stop; k++) {
+        const sweep_step_t& step = m_sweep[k];
+        if( sdr_fd >= 0 && !cerb_cwgen_set(sdr_fd, step.freq_hz, 0, step.ampl_scale) ) {
+            ok = false;
+            break;
+        }
+        uint64_t settled = cerb_monotonic_ns() + static_cast<uint64_t>(m_settle_ms * 1e6);
+        if( m_settle_ms > 0 ) {
+            usleep(static_cast<useconds_t>(m_settle_ms * 1e3));
+        }
+
+        cerb_channel_marker_t mark = { static_cast<unsigned>(k), 0, 0 };
+        if( !src.capture(&wire[0], m_nsamps, settled, mark.seqno, mark.timestamp_ns) ) {
+            printf("error: sweep step [%zu] capture failed\n", k);
+            ok = false;
+            break;
+        }
+        if( m_format == CERB_FORMAT_SC16 ) {
+            ok = fout.write(&wire[0], m_nsamps*sizeof(cmplx_wire_t));
+        }
+        else {
+            cerb_convert_sc16_to_fc32(&wire[0], &samples[0], m_nsamps);
+            ok = fout.write(&samples[0], m_nsamps*sizeof(samples[0]));
+        }
+        if( ok && meta.is_open() ) {
+            ok = meta.add_block(m_nsamps, mark.seqno, mark.timestamp_ns);
+        }
+        marks.push_back(mark);
+    }
+    fout.close();
+    if( sdr_fd >= 0 ) {
+        close(sdr_fd);
+    }
+    if( meta.is_open() && !meta.close() ) {
+        ok = false;
+    }
+    if( !marks.empty() && !write_sweep_header(m_file_def, marks) ) {
+        ok = false;
+    }
+
+    double secs = (cerb_monotonic_ns() - t0) / 1e9;
+    printf("sweep: [%zu/%zu] steps of [%zu] samples in [%.3f s] -> [%s]\n",
+           marks.size(), m_sweep.size(), m_nsamps, secs, m_file_def.c_str());
+    if( !ok ) {
+        printf("error: sweep failed\n");
+    }
+    return ok;
+}
+
+//!******************************************************
+//! @brief
+//! Samples requested on the command line, 0 when
+//! streaming until interrupted
+//!
+//!******************************************************
+uint64_t requested_samps()
+{
+    if( m_opts.count("continuous") ) {
+        return 0;
+    }
+    if( m_duration > 0 ) {
+        return static_cast<uint64_t>(m_duration * CERB_SAMP_RATE);
+    }
+    return std::min<uint64_t>(m_nsamps, CERB_MAX_IQ_CNT);
+}
+
 //!******************************************************
 //! @brief
 //! Main entry point
@@ -162,11 +1255,58 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    if( !cwgen_configure( m_freq_hz, 0, m_ampl_scale) ){
+    // the shared memory stand-in has no CWGEN behind it
+    bool standin = (m_dma_dev.compare(0, 4, CERB_DMA_SHM_PREFIX) == 0);
+    if( !m_sweep.empty() ) {
+        if( !sweep_to_file(standin) ) {
+            return 1;
+        }
+        printf("Done\n");
+        return 0;
+    }
+
+    if( !standin && !cwgen_configure( m_freq_hz, 0, m_ampl_scale) ){
         printf("error: failed to configure CWGEN... aborting\n");
         return 1;
     }
 
+    if( !m_trigger_def.empty() || m_opts.count("psd") ) {
+        // both run until interrupted unless bounded; --psd also takes -n
+        uint64_t total_samps = (m_duration > 0) ? static_cast<uint64_t>(m_duration * CERB_SAMP_RATE) : 0;
+        if( m_opts.count("psd") && !m_opts["nsamps"].defaulted() ) {
+            total_samps = requested_samps();
+        }
+        bool ok = m_trigger_def.empty() ? stream_psd(total_samps) : stream_triggered(total_samps);
+        if( !ok ) {
+            return 1;
+        }
+        printf("Done\n");
+        return 0;
+    }
+
+    if( !m_channels.empty() || !m_net_url.empty() ) {
+        uint64_t total_samps = requested_samps();
+        if( !total_samps && !m_opts.count("continuous") ) {
+            printf("Done\n");
+            return 0;
+        }
+        bool ok = m_net_url.empty() ? stream_channels_to_file(total_samps) : stream_to_net(total_samps);
+        if( !ok ) {
+            return 1;
+        }
+        printf("Done\n");
+        return 0;
+    }
+
+    if( m_opts.count("continuous") || m_duration > 0 ) {
+        uint64_t total_samps = m_opts.count("continuous") ? 0 : static_cast<uint64_t>(m_duration * CERB_SAMP_RATE);
+        if( !stream_to_file(total_samps) ) {
+            return 1;
+        }
+        printf("Done\n");
+        return 0;
+    }
+
     if( !m_nsamps ) {
         printf("Done\n");
         return 0;
@@ -176,30 +1316,62 @@ int main(int argc, char *argv[])
         m_nsamps = CERB_MAX_IQ_CNT;
     }
 
+    // mapped buffers are consumed in place and down conversion runs in the
+    // writer, one pass through the stream path
+    if( m_dma_mode == "mmap" || ddc_enabled() ) {
+        if( !stream_to_file(m_nsamps) ) {
+            return 1;
+        }
+        printf("Done\n");
+        return 0;
+    }
+
+    size_t req_bytes = (m_nsamps << 2); // 32-bit complex samples
+    cerb_file_writer fout;
+    if( !fout.open(m_file_def, true) ){
+        return 1;
+    }
+    cerb_sigmf_writer meta;
+    if( !sigmf_open(meta, m_file_def, 1) ) {
+        return 1;
+    }
+
+    if( m_format == CERB_FORMAT_SC16 ) {
+        // raw wire samples go straight to disk (fs=500MHz)
+        if( !request_to_file(fout, req_bytes) ) {
+            printf("error: dma requested failed.. aborting\n");
+            return 1;
+        }
+        if( meta.is_open() && !(meta.add_block(m_nsamps, 0, cerb_monotonic_ns()) && meta.close()) ) {
+            return 1;
+        }
+        if( !cerb_write_header(m_file_def, m_format) ) {
+            return 1;
+        }
+        printf("Done\n");
+        return 0;
+    }
+
     // alloc memory
     cmplx_wire_vec_t wire(m_nsamps);
-    size_t req_bytes = (m_nsamps << 2); // 32-bit complex samples
 
     // perform IQ capture (fs=500MHz)
     if( !request( reinterpret_cast<uint8_t*>(&wire[0]), req_bytes) ) {
         printf("error: dma requested failed.. aborting\n");
         return 1;
     }
+    if( meta.is_open() && !(meta.add_block(m_nsamps, 0, cerb_monotonic_ns()) && meta.close()) ) {
+        return 1;
+    }
 
     // data type conversion
     cmplx_sample_vec_t samples(m_nsamps);
-    for (size_t k = 0; k < m_nsamps; k++) {
-        samples[k] = std::complex<float>(static_cast<float>(wire[k].real()) * CERB_IQ_SCALE,
-                                         static_cast<float>(wire[k].imag()) * CERB_IQ_SCALE);
-    }
+    cerb_convert_sc16_to_fc32(&wire[0], &samples[0], m_nsamps);
 
     // write to file
-    std::ofstream fout(m_file_def.c_str(), std::ios::binary);
-    if( !fout.is_open() ){
-        printf("failed to open file [%s]\n", m_file_def.c_str());
+    if( !fout.write(&samples[0], samples.size()*sizeof(samples[0])) ) {
         return 1;
     }
-    fout.write((char*)&samples[0], samples.size()*sizeof(samples[0]));
 
     printf("Done\n");
     return 0;
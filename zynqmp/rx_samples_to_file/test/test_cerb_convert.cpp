@@ -0,0 +1,82 @@
+//!*********************************************************************
+//! @file test_cerb_convert.cpp
+//!
+//! @brief
+//! Checks that every conversion kernel the running CPU supports matches
+//! the scalar reference bit for bit, for odd and even lengths, lengths
+//! below one vector width and source/destination pointers offset from
+//! the vector alignment. Returns non-zero on the first mismatch.
+//!
+//! Copyright (C) 2022 Ipsolon Research, Inc
+//! All rights reserved.
+//!*********************************************************************
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "cerb_convert.h"
+
+#define TEST_MAX_NSAMPS     4099
+#define TEST_MAX_OFFSET     3
+#define TEST_POISON         1.0e30f
+
+static const size_t s_lengths[] = {
+    0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 1000, 1023, 4096, TEST_MAX_NSAMPS
+};
+
+//!******************************************************
+//! @brief
+//! Runs one kernel over every length and offset pair
+//!
+//!******************************************************
+static int test_kernel(cerb_convert_kernel_e kernel, const std::vector<cmplx_wire_t>& wire)
+{
+    cerb_convert_fn_t scalar = cerb_convert_kernel(CERB_CONVERT_SCALAR);
+    std::vector<cmplx_sample_t> ref(TEST_MAX_NSAMPS);
+    std::vector<cmplx_sample_t> out(TEST_MAX_NSAMPS + TEST_MAX_OFFSET);
+    int failures = 0;
+
+    if( !cerb_convert_select(kernel) ) {
+        printf("%-8s not supported by this CPU, skipped\n", cerb_convert_kernel_name(kernel));
+        return 0;
+    }
+    for (size_t l = 0; l < sizeof(s_lengths)/sizeof(s_lengths[0]); l++) {
+        size_t nsamps = s_lengths[l];
+        for (size_t src_off = 0; src_off <= TEST_MAX_OFFSET; src_off++) {
+            for (size_t dst_off = 0; dst_off <= TEST_MAX_OFFSET; dst_off++) {
+                scalar(&wire[src_off], &ref[0], nsamps);
+                // poison the output so a kernel that skips samples cannot pass
+                std::fill(out.begin(), out.end(), cmplx_sample_t(TEST_POISON, -TEST_POISON));
+                cerb_convert_sc16_to_fc32(&wire[src_off], &out[dst_off], nsamps);
+                if( memcmp(&ref[0], &out[dst_off], nsamps * sizeof(cmplx_sample_t)) != 0 ) {
+                    printf("%-8s mismatch: nsamps [%zu], src offset [%zu], dst offset [%zu]\n",
+                           cerb_convert_kernel_name(kernel), nsamps, src_off, dst_off);
+                    failures++;
+                }
+            }
+        }
+    }
+    printf("%-8s %s\n", cerb_convert_kernel_name(kernel), failures ? "FAILED" : "ok");
+    return failures;
+}
+
+int main()
+{
+    std::vector<cmplx_wire_t> wire(TEST_MAX_NSAMPS + TEST_MAX_OFFSET);
+    int failures = 0;
+
+    // full scale extremes first, then a fixed pseudo-random pattern
+    wire[0] = cmplx_wire_t(-32768, 32767);
+    wire[1] = cmplx_wire_t(32767, -32768);
+    wire[2] = cmplx_wire_t(0, -1);
+    srand(1);
+    for (size_t k = 3; k < wire.size(); k++) {
+        wire[k] = cmplx_wire_t(static_cast<int16_t>(rand()), static_cast<int16_t>(rand()));
+    }
+
+    for (int k = 0; k < CERB_CONVERT_NOF_KERNELS; k++) {
+        failures += test_kernel(static_cast<cerb_convert_kernel_e>(k), wire);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+"""
+:module: test_sweep_sigmf.py
+
+:author: Michael Clark <mclark@ipsolonresearch.com>
+
+:since:  March 2022
+
+:about:
+Runs a --sweep --sigmf capture on the device simulator and loads it
+back with utils.load_sweep(), which needs the .hdr step keys merged
+with the SigMF metadata. Checks the step list, the capture shape and
+that each step holds the tone it was swept to.
+
+    test_sweep_sigmf.py <rx_samples_to_file> <libcerb_dev_sim.so> <host/python>
+
+Exits 77 (skipped) when the host python packages are missing.
+
+:license:
+Copyright (C) 2022 Ipsolon Research, Inc
+All rights reserved.
+"""
+import os
+import sys
+import subprocess
+import tempfile
+
+SWEEP = [(10e6, 1), (20e6, 2), (-30e6, 1)]
+NSAMPS = 4096
+
+def main(rx_samples_to_file, dev_sim, host_python):
+    sys.path.insert(0, host_python)
+    try:
+        import numpy as np
+        import utils
+    except ImportError as e:
+        print('skipped: %s' % e)
+        return 77
+
+    with tempfile.TemporaryDirectory() as tmp:
+        sweep_def = os.path.join(tmp, 'sweep.txt')
+        with open(sweep_def, 'w') as f:
+            for freq, ampl in SWEEP:
+                f.write('%.1f %d\n' % (freq, ampl))
+        fn = os.path.join(tmp, 'sw.cfile')
+        env = dict(os.environ, LD_PRELOAD=dev_sim, CERB_SIM_RATE='0')
+        subprocess.check_call([rx_samples_to_file, '-f', fn, '--sweep', sweep_def,
+                               '-n', str(NSAMPS), '--sigmf'], env=env)
+        assert os.path.exists(fn + '.sigmf-meta')
+
+        steps, iq = utils.load_sweep(fn)
+        assert iq.shape == (len(SWEEP), NSAMPS), iq.shape
+        assert [(s[0], s[1]) for s in steps] == SWEEP, steps
+        assert all(b[2] > a[2] for a, b in zip(steps, steps[1:])), steps
+
+        hdr = utils.read_capture_header(fn)
+        assert len(hdr['blocks']) == len(SWEEP), hdr['blocks']
+        freqs = np.fft.fftfreq(NSAMPS, 1/hdr['sample_rate'])
+        for k, (freq, ampl) in enumerate(SWEEP):
+            peak = freqs[np.argmax(np.abs(np.fft.fft(iq[k])))]
+            assert abs(peak - freq) <= hdr['sample_rate'] / NSAMPS, (k, peak, freq)
+    print('ok')
+    return 0
+
+if __name__ == '__main__':
+    if len(sys.argv) != 4:
+        print(__doc__)
+        sys.exit(2)
+    sys.exit(main(*sys.argv[1:]))